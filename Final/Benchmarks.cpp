@@ -0,0 +1,288 @@
+//
+//  Benchmarks.cpp
+//
+//  The table of the runs of finalMain (see Benchmarks.h), and the
+//  reading of their options.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Rasterizer.h"
+#include "RayTracer.h"
+
+using namespace std;
+
+// how a run's option gives its argument
+enum BenchArg {
+    BENCH_COUNT,        // a number; the run is made if it is above 0
+    BENCH_SIZE,         // WxH
+    BENCH_SIZE_PATH,    // WxH and a file
+    BENCH_PATH,         // a file
+    BENCH_PATHS         // a file; the run is made once for each given
+};
+
+///
+// A run: its option, what the option takes, at most how much (the
+// count, or the width and height; 0 for no limit), and the function
+// that makes it; and what the option gave.  An option given more than
+// once keeps the last, unless it is BENCH_PATHS.
+///
+struct BenchRun {
+    const char *option;
+    const char *usage;          // its arguments, for the usage message
+    BenchArg arg;
+    int limit;
+    void (*run)( const BenchSettings &B );
+
+    bool given;
+    int count, width, height;
+    const char *path;
+    vector<const char *> paths;
+
+    BenchRun( const char *o, const char *u, BenchArg a, int l,
+              void (*r)( const BenchSettings & ) ) :
+        option(o), usage(u), arg(a), limit(l), run(r), given(false),
+        count(0), width(0), height(0), path(NULL) {}
+};
+
+// every run, in the order they are made
+static BenchRun benchRuns[] = {
+    BenchRun( "-multiview", "K [-poses N]", BENCH_COUNT, MAX_VIEWS,
+              multiViewBenchmark ),
+    BenchRun( "-gbuffer", "file [-frames N]", BENCH_PATH, 0,
+              gbufferExport ),
+    BenchRun( "-cpubench", "WxH [-frames N]", BENCH_SIZE, RASTER_MAX_DIM,
+              cpuBenchmark ),
+    BenchRun( "-rtbench", "WxH [-frames N]", BENCH_SIZE, RT_MAX_DIM,
+              rtBenchmark ),
+    BenchRun( "-pathtrace", "WxH file [-spp N] [-noise E] [-denoise]"
+              " [-checkpoint file [-every S]]", BENCH_SIZE_PATH, RT_MAX_DIM,
+              pathTrace ),
+    BenchRun( "-denoisebench", "WxH [-spp N] [-checkpoint file]",
+              BENCH_SIZE, RT_MAX_DIM, denoiseBenchmark ),
+    BenchRun( "-pickbench", "N", BENCH_COUNT, 0, pickBenchmark ),
+    BenchRun( "-transformbench", "N", BENCH_COUNT, 0, transformBenchmark ),
+    BenchRun( "-meshbench", "file", BENCH_PATHS, 0, meshBenchmark ),
+    BenchRun( "-normalbench", "file", BENCH_PATH, 0, normalBenchmark ),
+    BenchRun( "-objbench", "file", BENCH_PATH, 0, objBenchmark ),
+    BenchRun( "-lodbench", "N", BENCH_COUNT, 0, lodBenchmark ),
+    BenchRun( "-pmbench", "file", BENCH_PATH, 0, progressiveBenchmark ),
+    BenchRun( "-meshletbench", "N", BENCH_COUNT, 0, meshletBenchmark ),
+    BenchRun( "-instancebench", "N", BENCH_COUNT, 0, instanceBenchmark ),
+    BenchRun( "-cullbench", "N", BENCH_COUNT, 0, cullBenchmark ),
+    BenchRun( "-hizbench", "N", BENCH_COUNT, 0, hizBenchmark ),
+    BenchRun( "-impostorbench", "N", BENCH_COUNT, 0, impostorBenchmark ),
+    BenchRun( "-normalmapbench", "N", BENCH_COUNT, 0,
+              normalMapBenchmark ),
+    BenchRun( "-shadingbench", "N", BENCH_COUNT, 0, shadingBenchmark ),
+    BenchRun( "-shadowbench", "N", BENCH_COUNT, 0, shadowBenchmark )
+};
+#define BENCH_RUNS (int) (sizeof(benchRuns) / sizeof(*benchRuns))
+
+// the settings the runs share
+static BenchSettings shared;
+
+///
+// orbitCamera(k,eye) - camera position 'k' of the multi-view
+// benchmark, on the same arc around the table that renderClient uses
+///
+void orbitCamera( int k, float *eye )
+{
+    float phi = 0.35f * k - 2.8f;
+    eye[0] = 1.55f + 5.5f * sinf( phi );
+    eye[1] = 2.2f;
+    eye[2] = 5.5f * cosf( phi );
+}
+
+///
+// benchPose(f,stillLife) - the view of frame 'f' of the CPU benchmarks:
+// gbufferExport()'s camera path, with frame -1 (a warm-up) and frame 0
+// at the still-life camera
+///
+SceneView benchPose( int f, const SceneView &stillLife )
+{
+    SceneView V = stillLife;
+    for( int i = 0; i < 21; i++ ) {
+        V.angles[i] = 0.0f;
+    }
+    if( f > 0 ) {
+        orbitCamera( (f - 1) % 16, V.eye );
+        for( int i = 0; i < 21; i++ ) {
+            V.angles[i] = 15.0f * ((f - 1) / 16);
+        }
+    }
+    return V;
+}
+
+///
+// requested(R) - was a run asked for?
+///
+static bool requested( const BenchRun &R )
+{
+    switch( R.arg ) {
+        case BENCH_COUNT:
+            return R.count > 0;
+        case BENCH_SIZE:
+        case BENCH_SIZE_PATH:
+            return R.given;
+        case BENCH_PATH:
+            return R.path != NULL;
+        case BENCH_PATHS:
+            return !R.paths.empty();
+    }
+    return false;
+}
+
+///
+// benchOption(argc,argv,i) - read argv[i] if it is the option of a run
+//     or one of their settings
+///
+bool benchOption( int argc, char **argv, int &i )
+{
+    // the settings
+    if( strcmp( argv[i], "-poses" ) == 0 && i + 1 < argc ) {
+        shared.poses = atoi( argv[++i] );
+        return true;
+    } else if( strcmp( argv[i], "-frames" ) == 0 && i + 1 < argc ) {
+        shared.frames = atoi( argv[++i] );
+        return true;
+    } else if( strcmp( argv[i], "-spp" ) == 0 && i + 1 < argc ) {
+        shared.samples = atoi( argv[++i] );
+        return true;
+    } else if( strcmp( argv[i], "-noise" ) == 0 && i + 1 < argc ) {
+        shared.noise = atof( argv[++i] );
+        return true;
+    } else if( strcmp( argv[i], "-denoise" ) == 0 ) {
+        shared.denoise = true;
+        return true;
+    } else if( strcmp( argv[i], "-checkpoint" ) == 0 && i + 1 < argc ) {
+        shared.checkpoint = argv[++i];
+        return true;
+    } else if( strcmp( argv[i], "-every" ) == 0 && i + 1 < argc ) {
+        shared.every = atoi( argv[++i] );
+        return true;
+    }
+
+    // the runs
+    for( int r = 0; r < BENCH_RUNS; r++ ) {
+        BenchRun &R = benchRuns[r];
+        if( strcmp( argv[i], R.option ) != 0 ) {
+            continue;
+        }
+        int args = R.arg == BENCH_SIZE_PATH ? 2 : 1;
+        if( i + args >= argc ) {
+            return false;
+        }
+        switch( R.arg ) {
+            case BENCH_COUNT:
+                R.count = atoi( argv[i+1] );
+                break;
+            case BENCH_SIZE:
+            case BENCH_SIZE_PATH:
+                if( sscanf( argv[i+1], "%dx%d", &R.width,
+                            &R.height ) != 2 ) {
+                    return false;
+                }
+                R.given = true;
+                if( R.arg == BENCH_SIZE_PATH ) {
+                    R.path = argv[i+2];
+                }
+                break;
+            case BENCH_PATH:
+                R.path = argv[i+1];
+                break;
+            case BENCH_PATHS:
+                R.paths.push_back( argv[i+1] );
+                break;
+        }
+        i += args;
+        return true;
+    }
+    return false;
+}
+
+///
+// benchValid() - are the counts, sizes and settings all in range?
+///
+bool benchValid( void )
+{
+    if( shared.poses < 1 || shared.frames < 1 || shared.samples < 1 ||
+        !(shared.noise > 0.0f) || shared.every < 1 ) {
+        return false;
+    }
+    for( int r = 0; r < BENCH_RUNS; r++ ) {
+        const BenchRun &R = benchRuns[r];
+        if( R.arg == BENCH_COUNT && (R.count < 0 ||
+            (R.limit > 0 && R.count > R.limit)) ) {
+            return false;
+        }
+        if( (R.arg == BENCH_SIZE || R.arg == BENCH_SIZE_PATH) && R.given &&
+            (R.width < 1 || R.height < 1 || R.width > R.limit ||
+             R.height > R.limit) ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+// benchUsage() - the runs' part of the usage message
+///
+string benchUsage( void )
+{
+    string usage;
+    for( int r = 0; r < BENCH_RUNS; r++ ) {
+        const BenchRun &R = benchRuns[r];
+        usage += string( " [" ) + R.option + " " + R.usage + "]";
+        if( R.arg == BENCH_PATHS ) {
+            usage += "...";
+        }
+    }
+    return usage;
+}
+
+///
+// benchRequested() - was any run asked for?
+///
+bool benchRequested( void )
+{
+    for( int r = 0; r < BENCH_RUNS; r++ ) {
+        if( requested( benchRuns[r] ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+// runBenchmarks(draw) - make every run asked for, with the window's
+//     drawing options
+///
+void runBenchmarks( const RenderSettings &draw )
+{
+    for( int r = 0; r < BENCH_RUNS; r++ ) {
+        const BenchRun &R = benchRuns[r];
+        if( !requested( R ) ) {
+            continue;
+        }
+        BenchSettings B = shared;
+        B.count = R.count;
+        B.width = R.width;
+        B.height = R.height;
+        B.path = R.path;
+        B.draw = draw;
+        if( R.arg != BENCH_PATHS ) {
+            R.run( B );
+            continue;
+        }
+        for( size_t p = 0; p < R.paths.size(); p++ ) {
+            B.path = R.paths[p];
+            R.run( B );
+        }
+    }
+}
@@ -0,0 +1,361 @@
+//
+//  Benchmarks.h
+//
+//  The runs of finalMain that draw offscreen, report and exit instead
+//  of opening the window.  Each is asked for by an option of its own; a
+//  table in Benchmarks.cpp gives, for each, the option, what it takes
+//  and the function that makes the run, so main() hands the options it
+//  does not know to benchOption(), and runBenchmarks() makes the runs
+//  asked for in the table's order.  Each run lives in a file of its
+//  own and draws the scene through Scene.h.
+//
+//  OPTIONS:
+//
+//      -multiview K [-poses N] : benchmark rendering K cameras (at most 16)
+//          in one layered pass (multiview.geom) against K separate
+//          display() passes, over N object poses (default 20), and exit.
+//      -gbuffer file [-frames N] : render N frames (default 16) of color,
+//          eye-space depth, normals and object IDs in one pass each and
+//          write them to 'file' (see GBufferFile.h), then exit.  Frame 0
+//          uses the still-life camera; the rest orbit the table.
+//      -cpubench WxH [-frames N] : render N frames (default 16) at WxH
+//          with OpenGL and with the CPU rasterizer, report the speed of
+//          each and how far their images differ, and exit.
+//      -rtbench WxH [-frames N] : ray trace N frames (default 16) at WxH
+//          with 1, 2, 4 ... threads up to the -threads count, and report
+//          the BVH build time, Mrays/s and speedup of each, then exit.
+//      -pathtrace WxH file [-spp N] [-noise E] [-checkpoint ckpt
+//          [-every S]] : path trace the still life at WxH until every
+//          pixel's relative noise is down to E (default 0.02) or it has N
+//          samples (default 1024), write it to 'file' as a PPM image and
+//          exit; see PathTracer.h.  With -checkpoint the samples are saved
+//          to 'ckpt' every S seconds (default 60), on SIGINT/SIGTERM and at
+//          the end, and a render whose 'ckpt' exists continues from it.
+//          -denoise filters the image with the Denoiser (Denoiser.h)
+//          before writing it.
+//      -denoisebench WxH [-spp N] [-checkpoint ckpt] : path trace a
+//          reference of the still life with N samples per pixel (default
+//          1024; continued from and saved to 'ckpt' if given), then report
+//          the time and PSNR against it of 1, 2, 4 ... 64 sample images
+//          with and without the Denoiser, and exit.
+//      -pickbench N : make N mouse picks spread over the window, with the
+//          objects' BVHs and by testing every triangle, report the time
+//          per pick of each and whether they agree, and exit.
+//      -transformbench N : transform the grapes and the room N times with
+//          a plain loop and with the SIMD kernels of Transform.h, and all
+//          the objects at once on every thread, report vertices/s and the
+//          bounds found, and exit.
+//      -meshbench file : read the .obj 'file', build its half-edge
+//          connectivity (HalfEdge.h), report the time and memory taken
+//          and how fast one-ring queries run, and exit.  May be given
+//          more than once.
+//      -normalbench file : make smooth normals (Normals.h) for the .obj
+//          'file' with 1, 2, 4 ... threads up to the -threads count, report
+//          the time of each and how far each weighting strays from the
+//          file's own normals, and exit.
+//      -objbench file : time reading the .obj 'file' against the old
+//          fscanf() reader, write it back out with every face form the
+//          reader takes (v, v/vt, v//vn, v/vt/vn, negative indices,
+//          groups, CRLF, comments and continued lines) and some
+//          polygons, check that they all read back the same, and exit.
+//      -lodbench N : draw N frames with the camera at 1, 2, 4 and 8 times
+//          its distance from the still life, with and without levels of
+//          detail, report the triangles and time per frame of each, and
+//          exit.
+//      -pmbench file : encode the .obj 'file' as a progressive mesh (see
+//          Progressive.h), draw it from its base mesh up with a few
+//          milliseconds of refinement per frame, report the time to the
+//          first frame and to full detail against sending it whole,
+//          check that it refines back to the input, and exit.
+//      -meshletbench N : draw N frames with and without the meshlet
+//          culling, report the meshlets, triangles, vertices and fragments
+//          of each object and the time per frame of each, and exit.
+//      -instancebench N : report the copies found in every object and
+//          the buffer memory and upload time they save, draw the grapes
+//          N times instanced and as one mesh, report the time of each
+//          and how far the images differ, and exit.
+//      -cullbench N : turn the objects through N poses, draw each with and
+//          without culling the objects outside the view, report how many
+//          were culled, the time per frame and how far the images differ,
+//          and exit.
+//      -hizbench N : draw N poses from around the table and N frames of
+//          the animation with and without the hidden objects, report how
+//          many were left out, what finding them cost, the time per
+//          frame and how far the images differ, and exit.
+//      -impostorbench N : draw N frames at the window's size and at a
+//          half, a quarter and an eighth of it, with and without
+//          impostors, report the objects drawn as impostors, the
+//          triangles and time per frame of each and the share of pixels
+//          more than 16 levels off, and exit.
+//      -normalmapbench N : bake the normal maps, report the time taken and
+//          the vertices each object is left with, draw N frames with the
+//          full meshes, the coarse ones and the normal-mapped coarse
+//          ones, report the triangles and time per frame of each and the
+//          share of pixels more than 16 levels off the full meshes', and
+//          exit.
+//      -shadingbench N : draw N frames at the window's size and at a
+//          half, a quarter and an eighth of it, with and without the
+//          per-corner shading of small objects, report the objects shaded
+//          per corner, the time per frame of each and the share of pixels
+//          more than 16 levels off, and exit.
+//      -shadowbench N : draw N frames without shadows, with the shadow map
+//          while nothing changes and while the disco lights change only
+//          the light's color, and with it drawn again every frame while
+//          the objects turn and while nothing moves, report the time per
+//          frame of each, its overhead and how often the map was drawn,
+//          and exit.
+//
+
+#ifndef _BENCHMARKS_H_
+#define _BENCHMARKS_H_
+
+#include <string>
+
+#include "Scene.h"
+
+using namespace std;
+
+class Denoiser;
+class PathTracer;
+
+///
+// What the options gave a run: its count, size or file, the settings
+// that the runs share, and the drawing options of the window.
+///
+struct BenchSettings {
+    int count;
+    int width, height;
+    const char *path;
+    // the object poses of -multiview (-poses)
+    int poses;
+    // the frames of -gbuffer, -cpubench and -rtbench (-frames)
+    int frames;
+    // the samples per pixel (-spp) of -pathtrace and of -denoisebench's
+    // reference, -pathtrace's target noise (-noise) and whether it
+    // denoises (-denoise), and their checkpoint file (-checkpoint; NULL
+    // for none) and how often in seconds it is saved (-every)
+    int samples;
+    float noise;
+    bool denoise;
+    const char *checkpoint;
+    int every;
+    RenderSettings draw;
+
+    BenchSettings() : count(0), width(0), height(0), path(NULL), poses(20),
+        frames(16), samples(1024), noise(0.02f), denoise(false),
+        checkpoint(NULL), every(60) {}
+};
+
+// at most as many cameras as multiview.geom draws in one pass
+#define MAX_VIEWS 16
+
+///
+// multiViewBenchmark(B) - render B.count cameras per pose, once as
+//     separate display() passes and once as a single layered pass, over
+//     B.poses poses (MultiViewBench.cpp)
+///
+void multiViewBenchmark( const BenchSettings &B );
+
+///
+// gbufferExport(B) - render B.frames frames of the G-buffer, drawn with
+//     B.draw, into the G-buffer file B.path (GBufferExport.cpp)
+///
+void gbufferExport( const BenchSettings &B );
+
+///
+// cpuBenchmark(B) - render B.frames frames at B.width x B.height with
+//     OpenGL and with the CPU rasterizer, and compare them (CpuBench.cpp)
+///
+void cpuBenchmark( const BenchSettings &B );
+
+///
+// rtBenchmark(B) - ray trace B.frames frames at B.width x B.height with
+//     1, 2, 4 ... threads (RayTraceBench.cpp)
+///
+void rtBenchmark( const BenchSettings &B );
+
+///
+// pathTrace(B) - path trace the still life at B.width x B.height into
+//     the PPM image B.path (PathTraceRun.cpp)
+///
+void pathTrace( const BenchSettings &B );
+
+///
+// startPathTracer(T,B) - size a path tracer to B.width x B.height,
+//     continue from B.checkpoint if that exists, and give it the scene
+//
+// @return false on error
+///
+bool startPathTracer( PathTracer &T, const BenchSettings &B );
+
+///
+// refineUntilDone(T,B,targetMs) - run a path tracer until every pixel
+//     has enough samples or SIGINT/SIGTERM stops it, saving it to
+//     B.checkpoint (if set) as it goes
+//
+// @param targetMs - set to the tracing time at which the mean noise
+//                   first fell to T.targetNoise, or -1 if it never did
+// @return false if a signal stopped it
+///
+bool refineUntilDone( PathTracer &T, const BenchSettings &B,
+                      double *targetMs );
+
+///
+// denoise(T,D,out) - filter a path tracer's image so far, as w*h RGB
+//     triples, with a Denoiser
+//
+// @return milliseconds taken
+///
+double denoise( PathTracer &T, Denoiser &D, float *out );
+
+///
+// denoiseBenchmark(B) - compare path traced images of 1 to 64 samples
+//     per pixel, with and without the Denoiser, against a reference of
+//     B.samples at B.width x B.height (DenoiseBench.cpp)
+///
+void denoiseBenchmark( const BenchSettings &B );
+
+///
+// pickBenchmark(B) - time B.count mouse picks with the objects' BVHs
+//     and by testing every triangle (PickBench.cpp)
+///
+void pickBenchmark( const BenchSettings &B );
+
+///
+// transformBenchmark(B) - transform the objects into world space
+//     B.count times, with a plain loop and with the kernels of
+//     Transform.h (TransformBench.cpp)
+///
+void transformBenchmark( const BenchSettings &B );
+
+///
+// meshBenchmark(B) - build the half-edge connectivity of the .obj file
+//     B.path and time one-ring queries with it (MeshBench.cpp)
+///
+void meshBenchmark( const BenchSettings &B );
+
+///
+// normalBenchmark(B) - time smooth normals for the .obj file B.path on
+//     1, 2, 4 ... threads and compare them with the file's own
+//     (NormalBench.cpp)
+///
+void normalBenchmark( const BenchSettings &B );
+
+///
+// objBenchmark(B) - time the .obj reader on the file B.path against the
+//     old one, and check it on every face form and some polygons
+//     (ObjBench.cpp)
+///
+void objBenchmark( const BenchSettings &B );
+
+///
+// lodBenchmark(B) - time B.count frames with and without the levels of
+//     detail, from further and further away (LodBench.cpp)
+///
+void lodBenchmark( const BenchSettings &B );
+
+///
+// progressiveBenchmark(B) - stream the .obj file B.path as a progressive
+//     mesh and compare it with sending it whole (ProgressiveBench.cpp)
+///
+void progressiveBenchmark( const BenchSettings &B );
+
+///
+// meshletBenchmark(B) - time B.count frames drawing every triangle and
+//     drawing the meshlets left after culling (MeshletBench.cpp)
+///
+void meshletBenchmark( const BenchSettings &B );
+
+///
+// instanceBenchmark(B) - time B.count draws of each object made of
+//     copies, instanced and as one mesh (InstanceBench.cpp)
+///
+void instanceBenchmark( const BenchSettings &B );
+
+///
+// cullBenchmark(B) - draw B.count poses with and without leaving out
+//     the objects outside the view (CullBench.cpp)
+///
+void cullBenchmark( const BenchSettings &B );
+
+///
+// hizBenchmark(B) - draw B.count poses around the table and B.count
+//     frames of the animation with and without leaving out the objects
+//     the Hi-Z culler finds hidden (HiZBench.cpp)
+///
+void hizBenchmark( const BenchSettings &B );
+
+///
+// impostorBenchmark(B) - time B.count frames with and without
+//     impostors at the window's size and smaller (ImpostorBench.cpp)
+///
+void impostorBenchmark( const BenchSettings &B );
+
+///
+// normalMapBenchmark(B) - time B.count frames with the full meshes, the
+//     coarse ones and the normal-mapped coarse ones (NormalMapBench.cpp)
+///
+void normalMapBenchmark( const BenchSettings &B );
+
+///
+// shadingBenchmark(B) - time B.count frames with and without the
+//     per-corner shading of small objects, at B.draw's threshold, at the
+//     window's size and smaller (ShadingBench.cpp)
+///
+void shadingBenchmark( const BenchSettings &B );
+
+///
+// shadowBenchmark(B) - time B.count frames without shadows, with the
+//     cached shadow map and with it drawn again (ShadowBench.cpp)
+///
+void shadowBenchmark( const BenchSettings &B );
+
+///
+// orbitCamera(k,eye) - camera position 'k' of the multi-view
+//     benchmark, on the same arc around the table that renderClient uses
+///
+void orbitCamera( int k, float *eye );
+
+///
+// benchPose(f,stillLife) - the view of frame 'f' of the CPU benchmarks:
+//     gbufferExport()'s camera path, with frame -1 (a warm-up) and frame
+//     0 at the still-life camera
+///
+SceneView benchPose( int f, const SceneView &stillLife );
+
+///
+// benchOption(argc,argv,i) - read argv[i], and the arguments after it,
+//     if it is the option of a run or one of their settings
+//
+// @param i - the option's index; left on its last argument
+//
+// @return true if the option was read
+///
+bool benchOption( int argc, char **argv, int &i );
+
+///
+// benchValid() - are the counts, sizes and settings the options gave
+//     all in range?
+///
+bool benchValid( void );
+
+///
+// benchUsage() - the runs' part of the usage message
+///
+string benchUsage( void );
+
+///
+// benchRequested() - was any run asked for?
+///
+bool benchRequested( void );
+
+///
+// runBenchmarks(draw) - make every run asked for; the scene must be set
+//     up (see init())
+//
+// @param draw - the drawing options of the window, as the command line
+//               set them
+///
+void runBenchmarks( const RenderSettings &draw );
+
+#endif
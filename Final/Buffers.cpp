@@ -9,6 +9,8 @@
 //  This file should not be modified by students.
 //
 
+#include <algorithm>
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 
@@ -39,8 +41,13 @@ BufferSet::BufferSet( void ) {
 void BufferSet::initBuffer( void ) {
     vbuffer = ebuffer = 0;
     numElements = 0;
-    vSize = eSize = tSize = cSize = nSize = 0;
+    vSize = eSize = tSize = cSize = nSize = oSize = 0;
     bufferInit = false;
+    points.clear();
+    normals.clear();
+    uv.clear();
+    occlusion.clear();
+    radius = -1.0f;
 }
 
 ///
@@ -58,7 +65,8 @@ void BufferSet::dumpBuffer( const char *which ) {
     cout << "  IDs: v " << vbuffer << " e " << ebuffer <<
         " #elements: " << numElements << endl;
     cout << "  Sizes:  v " << vSize << " e " << eSize <<
-        " t " << tSize << " c " << cSize << " n " << nSize << endl;
+        " t " << tSize << " c " << cSize << " n " << nSize <<
+        " o " << oSize << endl;
 }
 
 ///
@@ -112,6 +120,9 @@ void BufferSet::createBuffers( Canvas &C ) {
     //          [ colors    ]  RGBA         vSize
     //          [ normals   ]  XYZ          vSize+cSize
     //          [ t. coords ]  UV           vSize+cSize+nSize
+    //          [ occlusion ]  A            vSize+cSize+nSize+tSize
+    //
+    // the occlusion is added later, by addOcclusion()
     ///
 
     // get the vertex count
@@ -194,6 +205,17 @@ void BufferSet::createBuffers( Canvas &C ) {
             offset << " vbufSize " << vbufSize << endl;
     }
 
+    // keep our own copies for the CPU renderers (the locals above
+    // hide the members of the same names)
+    this->points.assign( points, points + numElements * 4 );
+    if( nSize > 0 ) {
+        this->normals.assign( normals, normals + numElements * 3 );
+    }
+    if( tSize > 0 ) {
+        this->uv.assign( uv, uv + numElements * 2 );
+    }
+    computeBounds();
+
     // NOTE:  'points', 'colors', etc. are dynamically allocated, but
     // we don't free them here because they will be freed at the next
     // call to clear() or the get*() functions
@@ -201,3 +223,64 @@ void BufferSet::createBuffers( Canvas &C ) {
     // finally, mark it as set up
     bufferInit = true;
 }
+
+///
+// addOcclusion(values) - append one ambient occlusion value per vertex
+//     to the vertex buffer, replacing any added before
+//
+// @param values - numElements values, from 0 to 1
+///
+void BufferSet::addOcclusion( const float *values ) {
+
+    if( !bufferInit ) {
+        return;
+    }
+
+    // the buffer can't grow in place: copy the other sections into a
+    // larger one
+    GLsizeiptr keep = vSize + cSize + nSize + tSize;
+    oSize = numElements * sizeof(float);
+    GLuint buffer = makeBuffer( GL_COPY_WRITE_BUFFER, NULL, keep + oSize );
+    glBindBuffer( GL_COPY_READ_BUFFER, vbuffer );
+    glCopyBufferSubData( GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0,
+                         keep );
+    glBufferSubData( GL_COPY_WRITE_BUFFER, keep, oSize, values );
+    glDeleteBuffers( 1, &vbuffer );
+    vbuffer = buffer;
+
+    occlusion.assign( values, values + numElements );
+}
+
+///
+// computeBounds() - find the bounding box and sphere of the points
+///
+void BufferSet::computeBounds( void ) {
+    radius = -1.0f;
+    if( points.empty() ) {
+        return;
+    }
+
+    for( int k = 0; k < 3; k++ ) {
+        boxMin[k] = boxMax[k] = points[k];
+    }
+    for( size_t i = 0; i < points.size(); i += 4 ) {
+        for( int k = 0; k < 3; k++ ) {
+            boxMin[k] = min( boxMin[k], points[i + k] );
+            boxMax[k] = max( boxMax[k], points[i + k] );
+        }
+    }
+
+    // the sphere is centered on the box, but only as large as the
+    // farthest point needs, which is often well inside its corners
+    float farthest = 0.0f;
+    for( int k = 0; k < 3; k++ ) {
+        center[k] = 0.5f * (boxMin[k] + boxMax[k]);
+    }
+    for( size_t i = 0; i < points.size(); i += 4 ) {
+        float dx = points[i] - center[0];
+        float dy = points[i + 1] - center[1];
+        float dz = points[i + 2] - center[2];
+        farthest = max( farthest, dx * dx + dy * dy + dz * dz );
+    }
+    radius = sqrtf( farthest );
+}
@@ -19,6 +19,7 @@
 #endif
 
 #include <GLFW/glfw3.h>
+#include <vector>
 
 using namespace std;
 
@@ -39,11 +40,25 @@ public:
     int numElements;
 
     // component sizes (bytes)
-    long vSize, eSize, tSize, cSize, nSize;
+    long vSize, eSize, tSize, cSize, nSize, oSize;
 
     // have these already been set up?
     bool bufferInit;
 
+    // copies of the vertex data for the CPU renderers; the elements
+    // are always 0 .. numElements-1, so each run of three vertices
+    // is one triangle
+    vector<float> points;   // XYZW
+    vector<float> normals;  // XYZ, empty if the shape has none
+    vector<float> uv;       // UV, empty if the shape has none
+    vector<float> occlusion; // ambient occlusion, empty until added
+
+    // model space bounds of the points, for culling: the box's low and
+    // high corners, and a sphere about the box's center; a negative
+    // radius means there are none
+    float boxMin[3], boxMax[3];
+    float center[3], radius;
+
 public:
 
     ///
@@ -82,6 +97,19 @@ public:
     ///
     void createBuffers( Canvas &C );
 
+    ///
+    // addOcclusion(values) - append one ambient occlusion value per
+    //     vertex to the vertex buffer, replacing any added before
+    //
+    // @param values - numElements values, from 0 to 1
+    ///
+    void addOcclusion( const float *values );
+
+    ///
+    // computeBounds() - find the bounding box and sphere of the points
+    ///
+    void computeBounds( void );
+
 };
 
 #endif
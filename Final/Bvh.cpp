@@ -0,0 +1,512 @@
+//
+//  Bvh.cpp
+//
+//  Bounding volume hierarchy implementation.
+//
+
+#include <algorithm>
+#include <cfloat>
+
+#include "Bvh.h"
+
+using namespace std;
+
+// surface area of a box (0 if it is empty)
+static inline float area( const float *lo, const float *hi )
+{
+    float dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    if( dx < 0.0f || dy < 0.0f || dz < 0.0f ) {
+        return 0.0f;
+    }
+    return 2.0f * (dx * dy + dy * dz + dz * dx);
+}
+
+// grow lo/hi to include box b (lo xyz, hi xyz)
+static inline void grow( float *lo, float *hi, const float *b )
+{
+    for( int k = 0; k < 3; k++ ) {
+        lo[k] = min( lo[k], b[k] );
+        hi[k] = max( hi[k], b[3 + k] );
+    }
+}
+
+static inline void emptyBox( float *lo, float *hi )
+{
+    for( int k = 0; k < 3; k++ ) {
+        lo[k] = FLT_MAX;
+        hi[k] = -FLT_MAX;
+    }
+}
+
+///
+// build(vertices,count) - build the tree
+///
+void Bvh::build( const float *vertices, int count )
+{
+    nodes.clear();
+    triangles.clear();
+    bounds.resize( 6 * (size_t) count );
+    centroids.resize( 3 * (size_t) count );
+    order.resize( count );
+
+    for( int i = 0; i < count; i++ ) {
+        const float *v = &vertices[9 * (size_t) i];
+        float *b = &bounds[6 * (size_t) i];
+        for( int k = 0; k < 3; k++ ) {
+            b[k] = min( v[k], min( v[3 + k], v[6 + k] ) );
+            b[3 + k] = max( v[k], max( v[3 + k], v[6 + k] ) );
+            centroids[3 * (size_t) i + k] = 0.5f * (b[k] + b[3 + k]);
+        }
+        order[i] = i;
+    }
+
+    // at most 2n - 1 nodes
+    nodes.reserve( 2 * (size_t) max( count, 1 ) );
+    nodes.push_back( Node() );
+    if( count == 0 ) {
+        // a box nothing can hit
+        emptyBox( nodes[0].lo, nodes[0].hi );
+        nodes[0].offset = 0;
+        nodes[0].count = 0;
+        nodes[0].axis = -1;
+        return;
+    }
+    split( 0, 0, count, 0 );
+
+    triangles.resize( count );
+    for( int i = 0; i < count; i++ ) {
+        const float *v = &vertices[9 * (size_t) order[i]];
+        Triangle &T = triangles[i];
+        for( int k = 0; k < 3; k++ ) {
+            T.v0[k] = v[k];
+            T.e1[k] = v[3 + k] - v[k];
+            T.e2[k] = v[6 + k] - v[k];
+        }
+        T.index = order[i];
+    }
+}
+
+///
+// split(node,first,count,depth) - make 'node' the root of a subtree
+//     over order[first .. first+count-1]
+//
+// @return the number of nodes in the subtree
+///
+int Bvh::split( int node, int first, int count, int depth )
+{
+    float lo[3], hi[3], clo[3], chi[3];
+
+    emptyBox( lo, hi );
+    emptyBox( clo, chi );
+    for( int i = first; i < first + count; i++ ) {
+        const float *c = &centroids[3 * (size_t) order[i]];
+        grow( lo, hi, &bounds[6 * (size_t) order[i]] );
+        for( int k = 0; k < 3; k++ ) {
+            clo[k] = min( clo[k], c[k] );
+            chi[k] = max( chi[k], c[k] );
+        }
+    }
+    for( int k = 0; k < 3; k++ ) {
+        nodes[node].lo[k] = lo[k];
+        nodes[node].hi[k] = hi[k];
+    }
+
+    // SAH: a split costs one traversal step plus the triangles on each
+    // side weighted by the chance of entering that side, A(side)/A(node)
+    int bestAxis = -1, bestBin = 0;
+    float bestCost = FLT_MAX;
+
+    if( count > 1 && depth < BVH_MAX_DEPTH - 1 ) {
+        for( int axis = 0; axis < 3; axis++ ) {
+            float extent = chi[axis] - clo[axis];
+            if( extent <= 0.0f ) {
+                continue;
+            }
+            float scale = BVH_BINS / extent;
+
+            int binCount[BVH_BINS] = { 0 };
+            float binLo[BVH_BINS][3], binHi[BVH_BINS][3];
+            for( int b = 0; b < BVH_BINS; b++ ) {
+                emptyBox( binLo[b], binHi[b] );
+            }
+            for( int i = first; i < first + count; i++ ) {
+                float c = centroids[3 * (size_t) order[i] + axis];
+                int b = min( BVH_BINS - 1, (int) ((c - clo[axis]) * scale) );
+                binCount[b]++;
+                grow( binLo[b], binHi[b], &bounds[6 * (size_t) order[i]] );
+            }
+
+            // cost of the right side of every split, sweeping leftward
+            float rightCost[BVH_BINS];
+            float rlo[3], rhi[3];
+            int n = 0;
+            emptyBox( rlo, rhi );
+            for( int b = BVH_BINS - 1; b > 0; b-- ) {
+                float box[6] = { binLo[b][0], binLo[b][1], binLo[b][2],
+                                 binHi[b][0], binHi[b][1], binHi[b][2] };
+                grow( rlo, rhi, box );
+                n += binCount[b];
+                rightCost[b] = n * area( rlo, rhi );
+            }
+
+            // then the left sides; split b puts bins < b on the left
+            float llo[3], lhi[3];
+            n = 0;
+            emptyBox( llo, lhi );
+            for( int b = 1; b < BVH_BINS; b++ ) {
+                float box[6] = { binLo[b-1][0], binLo[b-1][1], binLo[b-1][2],
+                                 binHi[b-1][0], binHi[b-1][1], binHi[b-1][2] };
+                grow( llo, lhi, box );
+                n += binCount[b - 1];
+                if( n == 0 || n == count ) {
+                    continue;
+                }
+                float cost = n * area( llo, lhi ) + rightCost[b];
+                if( cost < bestCost ) {
+                    bestCost = cost;
+                    bestAxis = axis;
+                    bestBin = b;
+                }
+            }
+        }
+    }
+
+    float nodeArea = area( lo, hi );
+    bool leaf = bestAxis < 0 ||
+                (count <= BVH_LEAF_MAX &&
+                 count * nodeArea <= BVH_NODE_COST * nodeArea + bestCost);
+
+    if( leaf && (count <= BVH_LEAF_MAX || depth >= BVH_MAX_DEPTH - 1) ) {
+        nodes[node].offset = first;
+        nodes[node].count = count;
+        nodes[node].axis = -1;
+        return 1;
+    }
+
+    // too many triangles with one centroid for the bins to separate:
+    // halve them
+    int middle;
+    if( bestAxis < 0 ) {
+        bestAxis = 0;
+        middle = first + count / 2;
+    } else {
+        float scale = BVH_BINS / (chi[bestAxis] - clo[bestAxis]);
+        float base = clo[bestAxis];
+        int axis = bestAxis, bin = bestBin;
+        const float *c = centroids.data();
+        int32_t *mid = partition( &order[first], &order[first] + count,
+            [c, scale, base, axis, bin]( int32_t t ) {
+                int b = min( BVH_BINS - 1,
+                             (int) ((c[3 * (size_t) t + axis] - base) * scale) );
+                return b < bin;
+            } );
+        middle = mid - order.data();
+    }
+
+    nodes[node].count = 0;
+    nodes[node].axis = bestAxis;
+
+    // the first child follows its parent
+    nodes.push_back( Node() );
+    int size = split( node + 1, first, middle - first, depth + 1 );
+
+    int second = node + 1 + size;
+    nodes[node].offset = second;
+    nodes.push_back( Node() );
+    size += split( second, middle, first + count - middle, depth + 1 );
+
+    return size + 1;
+}
+
+///
+// Packet traversal
+///
+
+// ray origin, reciprocal direction and origin/direction, per lane
+struct PacketSetup {
+    SimdFloat ix, iy, iz;
+    SimdFloat sx, sy, sz;       // -origin / direction
+    int negative[3];            // most rays point down this axis
+};
+
+static inline void setUpPacket( const RayPacket &R, PacketSetup &S )
+{
+    S.ix = SimdFloat( 1.0f ) / R.dx;
+    S.iy = SimdFloat( 1.0f ) / R.dy;
+    S.iz = SimdFloat( 1.0f ) / R.dz;
+    S.sx = -R.ox * S.ix;
+    S.sy = -R.oy * S.iy;
+    S.sz = -R.oz * S.iz;
+
+    SimdFloat zero( 0.0f );
+    S.negative[0] = horizontalSum( select( R.active, R.dx, zero ) ) < 0.0f;
+    S.negative[1] = horizontalSum( select( R.active, R.dy, zero ) ) < 0.0f;
+    S.negative[2] = horizontalSum( select( R.active, R.dz, zero ) ) < 0.0f;
+}
+
+// lanes whose (tMin,tMax) overlaps the node's box
+static inline SimdMask hitBox( const Bvh::Node &N, const PacketSetup &S,
+                               SimdFloat tMin, SimdFloat tMax )
+{
+    SimdFloat x0 = fmadd( SimdFloat( N.lo[0] ), S.ix, S.sx );
+    SimdFloat x1 = fmadd( SimdFloat( N.hi[0] ), S.ix, S.sx );
+    SimdFloat y0 = fmadd( SimdFloat( N.lo[1] ), S.iy, S.sy );
+    SimdFloat y1 = fmadd( SimdFloat( N.hi[1] ), S.iy, S.sy );
+    SimdFloat z0 = fmadd( SimdFloat( N.lo[2] ), S.iz, S.sz );
+    SimdFloat z1 = fmadd( SimdFloat( N.hi[2] ), S.iz, S.sz );
+
+    SimdFloat enter = max( max( min( x0, x1 ), min( y0, y1 ) ),
+                           max( min( z0, z1 ), tMin ) );
+    SimdFloat leave = min( min( max( x0, x1 ), max( y0, y1 ) ),
+                           min( max( z0, z1 ), tMax ) );
+    return enter <= leave;
+}
+
+// Moller-Trumbore: the lanes of 'lanes' that hit T in (tMin,tMax)
+static inline SimdMask hitTriangle( const Bvh::Triangle &T, const RayPacket &R,
+                                    SimdMask lanes, SimdFloat tMax,
+                                    SimdFloat &t, SimdFloat &u, SimdFloat &v )
+{
+    SimdFloat e1x( T.e1[0] ), e1y( T.e1[1] ), e1z( T.e1[2] );
+    SimdFloat e2x( T.e2[0] ), e2y( T.e2[1] ), e2z( T.e2[2] );
+
+    SimdFloat px = R.dy * e2z - R.dz * e2y;
+    SimdFloat py = R.dz * e2x - R.dx * e2z;
+    SimdFloat pz = R.dx * e2y - R.dy * e2x;
+    SimdFloat inv = SimdFloat( 1.0f ) / dot( e1x, e1y, e1z, px, py, pz );
+
+    SimdFloat sx = R.ox - SimdFloat( T.v0[0] );
+    SimdFloat sy = R.oy - SimdFloat( T.v0[1] );
+    SimdFloat sz = R.oz - SimdFloat( T.v0[2] );
+    u = dot( sx, sy, sz, px, py, pz ) * inv;
+
+    SimdFloat qx = sy * e1z - sz * e1y;
+    SimdFloat qy = sz * e1x - sx * e1z;
+    SimdFloat qz = sx * e1y - sy * e1x;
+    v = dot( R.dx, R.dy, R.dz, qx, qy, qz ) * inv;
+    t = dot( e2x, e2y, e2z, qx, qy, qz ) * inv;
+
+    // a zero determinant makes u and v NaN, which fails every test
+    SimdFloat zero( 0.0f );
+    return lanes & (u >= zero) & (v >= zero) & (u + v <= SimdFloat( 1.0f )) &
+           (t > R.tMin) & (t < tMax);
+}
+
+///
+// intersect(R,H) - nearest hits of a packet
+///
+void Bvh::intersect( const RayPacket &R, PacketHit &H ) const
+{
+    SimdFloat zero( 0.0f );
+
+    H.t = R.tMax;
+    H.u = H.v = zero;
+    H.triangle = SimdInt( -1 );
+    H.hit = zero < zero;
+    if( nodes.empty() || !any( R.active ) ) {
+        return;
+    }
+
+    PacketSetup S;
+    setUpPacket( R, S );
+
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while( top > 0 ) {
+        int n = stack[--top];
+        const Node &N = nodes[n];
+        SimdMask lanes = R.active & hitBox( N, S, R.tMin, H.t );
+        if( !any( lanes ) ) {
+            continue;
+        }
+
+        if( N.count > 0 ) {
+            for( int i = N.offset; i < N.offset + N.count; i++ ) {
+                SimdFloat t, u, v;
+                SimdMask hit = hitTriangle( triangles[i], R, lanes, H.t,
+                                            t, u, v );
+                if( any( hit ) ) {
+                    H.t = select( hit, t, H.t );
+                    H.u = select( hit, u, H.u );
+                    H.v = select( hit, v, H.v );
+                    H.triangle = select( hit, SimdInt( triangles[i].index ),
+                                         H.triangle );
+                    H.hit = H.hit | hit;
+                }
+            }
+        } else {
+            // visit the near child first
+            int first = n + 1, second = N.offset;
+            if( S.negative[N.axis] ) {
+                swap( first, second );
+            }
+            stack[top++] = second;
+            stack[top++] = first;
+        }
+    }
+}
+
+///
+// occluded(R) - the active rays that hit anything
+///
+SimdMask Bvh::occluded( const RayPacket &R ) const
+{
+    SimdMask open = R.active;
+    if( nodes.empty() || !any( open ) ) {
+        return andNot( open, open );
+    }
+
+    PacketSetup S;
+    setUpPacket( R, S );
+
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while( top > 0 && any( open ) ) {
+        int n = stack[--top];
+        const Node &N = nodes[n];
+        SimdMask lanes = open & hitBox( N, S, R.tMin, R.tMax );
+        if( !any( lanes ) ) {
+            continue;
+        }
+
+        if( N.count > 0 ) {
+            for( int i = N.offset; i < N.offset + N.count; i++ ) {
+                SimdFloat t, u, v;
+                SimdMask hit = hitTriangle( triangles[i], R, lanes, R.tMax,
+                                            t, u, v );
+                open = andNot( open, hit );
+                lanes = andNot( lanes, hit );
+                if( !any( lanes ) ) {
+                    break;
+                }
+            }
+        } else {
+            int first = n + 1, second = N.offset;
+            if( S.negative[N.axis] ) {
+                swap( first, second );
+            }
+            stack[top++] = second;
+            stack[top++] = first;
+        }
+    }
+
+    return andNot( R.active, open );
+}
+
+///
+// Single-ray traversal
+///
+
+///
+// intersect(origin,direction,tMin,tMax,H) - nearest hit of one ray
+///
+bool Bvh::intersect( const float *origin, const float *direction,
+                     float tMin, float tMax, RayHit &H ) const
+{
+    H.t = tMax;
+    H.u = H.v = 0.0f;
+    H.triangle = -1;
+    if( nodes.empty() ) {
+        return false;
+    }
+
+    float inverse[3], shift[3];
+    int negative[3];
+    for( int k = 0; k < 3; k++ ) {
+        inverse[k] = 1.0f / direction[k];
+        shift[k] = -origin[k] * inverse[k];
+        negative[k] = direction[k] < 0.0f;
+    }
+
+    // the ray in every lane, for the triangle tests
+    SimdFloat ox( origin[0] ), oy( origin[1] ), oz( origin[2] );
+    SimdFloat dx( direction[0] ), dy( direction[1] ), dz( direction[2] );
+    SimdFloat zero( 0.0f ), one( 1.0f ), lower( tMin );
+
+    // a leaf's triangles are gathered straight out of 'triangles'
+    const int STRIDE = sizeof( Triangle ) / sizeof( float );
+    const float *base = (const float *) triangles.data();
+    SimdInt lanes = laneIndex();
+
+    int stack[BVH_MAX_DEPTH + 1];
+    int top = 0;
+    stack[top++] = 0;
+
+    while( top > 0 ) {
+        int n = stack[--top];
+        const Node &N = nodes[n];
+
+        float enter = tMin, leave = H.t;
+        for( int k = 0; k < 3; k++ ) {
+            float t0 = N.lo[k] * inverse[k] + shift[k];
+            float t1 = N.hi[k] * inverse[k] + shift[k];
+            enter = max( enter, min( t0, t1 ) );
+            leave = min( leave, max( t0, t1 ) );
+        }
+        if( !(enter <= leave) ) {
+            continue;
+        }
+
+        if( N.count == 0 ) {
+            // visit the near child first
+            int first = n + 1, second = N.offset;
+            if( negative[N.axis] ) {
+                swap( first, second );
+            }
+            stack[top++] = second;
+            stack[top++] = first;
+            continue;
+        }
+
+        // Moller-Trumbore on the leaf's triangles, one per lane; lanes
+        // past the end repeat the first triangle and are masked off
+        SimdMask valid = SimdInt( N.count ) > lanes;
+        SimdInt at = SimdInt( N.offset ) +
+                     min( lanes, SimdInt( N.count - 1 ) );
+        at = at * SimdInt( STRIDE );
+        SimdFloat tri[9];
+        for( int k = 0; k < 9; k++ ) {
+            tri[k] = gather( base, at + SimdInt( k ) );
+        }
+
+        SimdFloat px = dy * tri[8] - dz * tri[7];
+        SimdFloat py = dz * tri[6] - dx * tri[8];
+        SimdFloat pz = dx * tri[7] - dy * tri[6];
+        SimdFloat inv = one / dot( tri[3], tri[4], tri[5], px, py, pz );
+
+        SimdFloat sx = ox - tri[0], sy = oy - tri[1], sz = oz - tri[2];
+        SimdFloat u = dot( sx, sy, sz, px, py, pz ) * inv;
+
+        SimdFloat qx = sy * tri[5] - sz * tri[4];
+        SimdFloat qy = sz * tri[3] - sx * tri[5];
+        SimdFloat qz = sx * tri[4] - sy * tri[3];
+        SimdFloat v = dot( dx, dy, dz, qx, qy, qz ) * inv;
+        SimdFloat t = dot( tri[6], tri[7], tri[8], qx, qy, qz ) * inv;
+
+        int hit = bits( valid & (u >= zero) & (v >= zero) & (u + v <= one) &
+                        (t > lower) & (t < SimdFloat( H.t )) );
+        if( hit == 0 ) {
+            continue;
+        }
+
+        // the nearest of the lanes that hit
+        float ts[SIMD_WIDTH], us[SIMD_WIDTH], vs[SIMD_WIDTH];
+        storeFloat( ts, t );
+        storeFloat( us, u );
+        storeFloat( vs, v );
+        for( int i = 0; i < SIMD_WIDTH; i++ ) {
+            if( (hit >> i & 1) && ts[i] < H.t ) {
+                H.t = ts[i];
+                H.u = us[i];
+                H.v = vs[i];
+                H.triangle = triangles[N.offset + i].index;
+            }
+        }
+    }
+
+    return H.triangle >= 0;
+}
@@ -0,0 +1,132 @@
+//
+//  Bvh.h
+//
+//  Bounding volume hierarchy over a triangle soup, for the CPU ray
+//  tracer.
+//
+//  build() splits the triangles top-down with the surface area
+//  heuristic, evaluated over BVH_BINS centroid bins per axis, and lays
+//  the nodes out depth first: an interior node's first child follows
+//  it, and it records where the second one is.
+//
+//  Rays are traced in packets of SIMD_WIDTH.  A packet visits a node
+//  if any of its active rays hits the node's box, so packets of
+//  neighboring primary rays share nearly all of their traversal.
+//  A lone ray, such as a mouse pick, walks the tree by itself and tests
+//  all the triangles of a leaf at once instead.
+//
+
+#ifndef _BVH_H_
+#define _BVH_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Simd.h"
+
+using namespace std;
+
+// centroid bins per axis tried at each split
+#define BVH_BINS        16
+
+// leaves hold at most this many triangles
+#define BVH_LEAF_MAX    8
+
+// cost of visiting a node, in triangle tests, when weighing a split
+// against a leaf
+#define BVH_NODE_COST   2.0f
+
+// deepest tree traversal can handle
+#define BVH_MAX_DEPTH   64
+
+///
+// SIMD_WIDTH rays: origins, directions and the parametric range of
+// each; only lanes set in 'active' are traced
+///
+struct RayPacket {
+    SimdFloat ox, oy, oz;
+    SimdFloat dx, dy, dz;
+    SimdFloat tMin, tMax;
+    SimdMask active;
+};
+
+///
+// nearest hits of a packet: the lanes set in 'hit' found triangle
+// 'triangle' (its index in the array given to build()) at distance t,
+// with barycentric coordinates (1-u-v, u, v)
+///
+struct PacketHit {
+    SimdFloat t, u, v;
+    SimdInt triangle;
+    SimdMask hit;
+};
+
+///
+// nearest hit of a single ray, as in PacketHit; triangle is -1 if the
+// ray hit nothing
+///
+struct RayHit {
+    float t, u, v;
+    int32_t triangle;
+};
+
+class Bvh {
+
+public:
+    struct Node {
+        float lo[3], hi[3];     // bounding box
+        int32_t offset;         // leaf: first triangle; else second child
+        int16_t count;          // triangles in a leaf; 0 if interior
+        int16_t axis;           // split axis of an interior node
+    };
+
+    // one triangle as intersection wants it: a vertex and two edges
+    struct Triangle {
+        float v0[3], e1[3], e2[3];
+        int32_t index;          // in the array given to build()
+    };
+
+    vector<Node> nodes;
+    vector<Triangle> triangles; // in leaf order
+
+private:
+    // build scratch space: per-triangle bounds and centroids
+    vector<float> bounds;       // lo xyz, hi xyz
+    vector<float> centroids;    // xyz
+    vector<int32_t> order;
+
+    int split( int node, int first, int count, int depth );
+
+public:
+
+    ///
+    // build(vertices,count) - build the tree
+    //
+    // @param vertices - x,y,z of every triangle's three corners
+    // @param count    - number of triangles
+    ///
+    void build( const float *vertices, int count );
+
+    ///
+    // intersect(R,H) - find the nearest hit of every active ray in
+    //     (tMin,tMax); triangles are two-sided
+    ///
+    void intersect( const RayPacket &R, PacketHit &H ) const;
+
+    ///
+    // occluded(R) - the active rays that hit anything in (tMin,tMax)
+    ///
+    SimdMask occluded( const RayPacket &R ) const;
+
+    ///
+    // intersect(origin,direction,tMin,tMax,H) - find the nearest hit of
+    //     one ray in (tMin,tMax); triangles are two-sided
+    //
+    // @return true if the ray hit anything
+    ///
+    bool intersect( const float *origin, const float *direction,
+                    float tMin, float tMax, RayHit &H ) const;
+
+};
+
+#endif
@@ -10,6 +10,7 @@
 //  This file should not be modified by students.
 //
 
+#include <cmath>
 #include <cstdlib>
 #include <iostream>
 #include <iomanip>
@@ -132,6 +133,14 @@ void Canvas::addTriangleWithUV( Vertex p0, UVcoord uv0,
                   (uz * vx) - (ux * vz),
                   (ux * vy) - (uy * vx) };
 
+    // unit length, like the normals read from .obj files
+    float length = sqrtf( nn.x * nn.x + nn.y * nn.y + nn.z * nn.z );
+    if( length > 0.0f ) {
+        nn.x /= length;
+        nn.y /= length;
+        nn.z /= length;
+    }
+
     // Attach the normal to all 3 vertices
     addTriangleWithNorms( p0, nn, p1, nn, p2, nn );
 
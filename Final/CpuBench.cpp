@@ -0,0 +1,101 @@
+//
+//  CpuBench.cpp
+//
+//  The CPU rasterizer benchmark (-cpubench; see Benchmarks.h): the same
+//  frames drawn with OpenGL and with the Rasterizer, timed and compared.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Rasterizer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// cpuBenchmark() - render B.frames frames at B.width x B.height with
+// OpenGL (read back included, as the render service needs it) and with
+// the CPU rasterizer, and report the speed of each and how far the two
+// images differ.  The frames follow gbufferExport()'s camera path.
+///
+void cpuBenchmark( const BenchSettings &B )
+{
+    int w = B.width, h = B.height, frames = B.frames;
+    if( !initCPU() ) {
+        return;
+    }
+    const SceneParts &P = sceneParts();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( w, h ) || !P.rasterizer->resize( w, h ) ) {
+        return;
+    }
+
+    size_t frameBytes = (size_t) w * h * 4;
+    vector<unsigned char> gl( frameBytes );
+    double glMs = 0.0, cpuMs = 0.0;
+    uint64_t totalDiff = 0;
+    size_t differing = 0;
+    int maxDiff = 0;
+
+    SceneView stillLife = sceneView();
+
+    // the rasterizer draws everything in full, and without shadows: with
+    // none of the drawing options
+    RenderSettings full;
+
+    offscreen.bind();
+
+    // frame -1 is an untimed warm-up
+    for( int f = -1; f < frames; f++ ) {
+        setSceneView( benchPose( f, stillLife ) );
+
+        uint64_t start = monotonicNs();
+        display( full );
+        offscreen.readPixels( gl.data() );
+        if( f >= 0 ) {
+            glMs += elapsedMs( start );
+        }
+
+        start = monotonicNs();
+        displayCPU();
+        if( f >= 0 ) {
+            cpuMs += elapsedMs( start );
+        }
+
+        const unsigned char *cpu =
+            (const unsigned char *) P.rasterizer->pixels.data();
+        for( size_t i = 0; i < frameBytes; i += 4 ) {
+            int d = 0;
+            for( int c = 0; c < 3; c++ ) {
+                int e = abs( gl[i+c] - cpu[i+c] );
+                totalDiff += e;
+                d = max( d, e );
+            }
+            maxDiff = max( maxDiff, d );
+            differing += d > 8;
+        }
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( stillLife );
+
+    double pixels = (frames + 1.0) * w * h;
+    printf( "CPU rasterizer: %d frames at %dx%d, %d threads\n", frames, w, h,
+        P.cpuPool->size() );
+    printf( "OpenGL + read back:  %8.2f ms/frame  %8.1f frames/s\n",
+        glMs / frames, frames / (glMs / 1000.0) );
+    printf( "CPU rasterizer:      %8.2f ms/frame  %8.1f frames/s  (%.2fx)\n",
+        cpuMs / frames, frames / (cpuMs / 1000.0), glMs / cpuMs );
+    printf( "mean channel difference %.3f, max %d, %.3f%% of pixels differ"
+        " by more than 8\n", totalDiff / (3.0 * pixels), maxDiff,
+        100.0 * differing / pixels );
+}
@@ -0,0 +1,99 @@
+//
+//  CullBench.cpp
+//
+//  The view culling benchmark (-cullbench; see Benchmarks.h): every
+//  object drawn against leaving out those outside the view.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// cullBenchmark() - turn the objects through B.count poses, as the
+// animation does, and compare drawing every object with leaving out
+// those outside the view, from the still-life camera and from it
+// turned aside: objects drawn and culled, time per frame, and whether
+// the images differ
+///
+void cullBenchmark( const BenchSettings &B )
+{
+    int poses = B.count;
+    const SceneParts &P = sceneParts();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    SceneView stillLife = sceneView(), V = stillLife;
+    RenderSettings S;
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+    // every object's angles but the room's
+    size_t turned = sizeof(V.angles) / sizeof(*V.angles) - 3;
+    vector<unsigned char> images[2];
+    offscreen.bind();
+
+    for( int d = 0; d < 2; d++ ) {
+        float aside = d == 0 ? 0.0f : 2.0f;
+        V.lookAt[0] = stillLife.lookAt[0] + aside;
+        printf( "camera turned %.1f units aside\n", aside );
+        printf( "culling  visible  culled  triangles  ms/frame\n" );
+        for( int on = 0; on < 2; on++ ) {
+            S.culling = on;
+            long visible = 0, culled = 0, triangles = 0;
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int p = 0; p < poses; p++ ) {
+                for( size_t i = 0; i < turned; i++ ) {
+                    V.angles[i] = 360.0f * p / poses;
+                }
+                setSceneView( V );
+                display( S );
+                const SceneStats &drawn = sceneStats();
+                visible += drawn.visibleObjects;
+                culled += drawn.culledObjects;
+                triangles += drawn.drawnTriangles;
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / poses;
+            printf( "%7s  %7.2f  %6.2f  %9ld  %8.3f\n", on ? "on" : "off",
+                (double) visible / poses, (double) culled / poses,
+                triangles / poses, ms );
+        }
+
+        // the same frames, with and without
+        long differ = 0;
+        int posesDiffering = 0;
+        for( int p = 0; p < poses; p++ ) {
+            for( size_t i = 0; i < turned; i++ ) {
+                V.angles[i] = 360.0f * p / poses;
+            }
+            setSceneView( V );
+            for( int on = 0; on < 2; on++ ) {
+                S.culling = on;
+                display( S );
+                images[on].resize( frameBytes );
+                offscreen.readPixels( images[on].data() );
+            }
+            long pixels = 0;
+            for( size_t q = 0; q < frameBytes; q += 4 ) {
+                pixels += memcmp( &images[0][q], &images[1][q], 3 ) != 0;
+            }
+            differ += pixels;
+            posesDiffering += pixels > 0;
+        }
+        printf( "pixels that differ: %ld, in %d of %d poses\n", differ,
+            posesDiffering, poses );
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( stillLife );
+}
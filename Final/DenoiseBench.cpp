@@ -0,0 +1,111 @@
+//
+//  DenoiseBench.cpp
+//
+//  The denoiser benchmark (-denoisebench; see Benchmarks.h): path
+//  traced images of 1 to 64 samples per pixel, with and without the
+//  Denoiser, against a reference of many samples.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Denoiser.h"
+#include "PathTracer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+///
+// psnr(a,b,count) - peak signal to noise ratio in dB between two RGB
+// images, clamped to 0..1 as they would be displayed
+///
+static double psnr( const float *a, const float *b, size_t count )
+{
+    double error = 0.0;
+    for( size_t i = 0; i < 3 * count; i++ ) {
+        double d = min( max( a[i], 0.0f ), 1.0f ) -
+                   min( max( b[i], 0.0f ), 1.0f );
+        error += d * d;
+    }
+    error /= 3 * count;
+    return error > 0.0 ? 10.0 * log10( 1.0 / error ) : 99.0;
+}
+
+///
+// denoiseBenchmark() - path trace the still life at B.width x B.height
+// with B.samples samples per pixel as a reference (kept in B.checkpoint
+// if set), then compare 1, 2, 4 ... 64 sample images with and without
+// the Denoiser against it, and report how much tracing the denoiser
+// saves for the quality of the noisiest image.
+///
+void denoiseBenchmark( const BenchSettings &B )
+{
+    int w = B.width, h = B.height;
+    if( !initCPU() ) {
+        return;
+    }
+    ThreadPool &pool = *sceneParts().cpuPool;
+
+    // the reference draws on its own sample sequence, so its noise is
+    // independent of the test images'
+    PathTracer R( pool );
+    R.minSamples = R.maxSamples = B.samples;
+    R.sequence = 1;
+    if( !startPathTracer( R, B ) ) {
+        return;
+    }
+    printf( "reference: %dx%d at %d samples per pixel, %d threads\n", w, h,
+        B.samples, pool.size() );
+    double targetMs;
+    if( !refineUntilDone( R, B, &targetMs ) ) {
+        return;
+    }
+
+    size_t count = (size_t) w * h;
+    vector<float> reference( 3 * count ), noisy( 3 * count ),
+                  clean( 3 * count );
+    R.estimate( reference.data(), NULL );
+
+    PathTracer T( pool );
+    T.resize( w, h );
+    T.minSamples = T.maxSamples = min( 64, max( B.samples / 4, 1 ) );
+    queueScene( T );
+    Denoiser D( pool );
+
+    printf( "samples  trace ms  noisy PSNR  denoise ms  denoised PSNR\n" );
+    vector<double> traceMs, noisyDb, denoiseMs, denoisedDb;
+    for( int spp = 1; spp <= T.maxSamples; spp *= 2 ) {
+        while( T.passes < spp && T.refine() ) {
+        }
+        T.estimate( noisy.data(), NULL );
+        denoiseMs.push_back( denoise( T, D, clean.data() ) );
+        traceMs.push_back( T.renderMs );
+        noisyDb.push_back( psnr( noisy.data(), reference.data(), count ) );
+        denoisedDb.push_back( psnr( clean.data(), reference.data(), count ) );
+        printf( "%7d  %8.1f  %7.2f dB  %10.1f  %10.2f dB\n", spp,
+            traceMs.back(), noisyDb.back(), denoiseMs.back(),
+            denoisedDb.back() );
+    }
+
+    // what each denoised image is worth: the samples a noisy image of
+    // the same PSNR would need, interpolating between the noisy rows
+    // (PSNR is close to linear in log samples), and the time those
+    // would take at the measured rate
+    double msPerSample = traceMs.back() / T.maxSamples;
+    printf( "samples  denoised equals  time saved\n" );
+    for( size_t i = 0; i < denoisedDb.size(); i++ ) {
+        size_t k = 0;
+        while( k + 2 < noisyDb.size() && denoisedDb[i] > noisyDb[k + 1] ) {
+            k++;
+        }
+        double f = (denoisedDb[i] - noisyDb[k]) / (noisyDb[k + 1] - noisyDb[k]);
+        double equal = pow( 2.0, k + f );
+        printf( "%7d  %10.1f spp  %9.1fx%s\n", 1 << i, equal,
+            equal * msPerSample / (traceMs[i] + denoiseMs[i]),
+            equal > T.maxSamples ? "  (extrapolated)" : "" );
+    }
+}
@@ -0,0 +1,316 @@
+//
+//  Denoiser.cpp
+//
+//  A-trous wavelet denoiser implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "Denoiser.h"
+#include "Timing.h"
+
+using namespace std;
+
+// weights of R, G and B in a pixel's brightness
+static const float brightnessWeight[3] = { 0.2126f, 0.7152f, 0.0722f };
+
+// the B3-spline taps of one kernel row
+static const float kernel[5] = { 1.0f / 16, 1.0f / 4, 3.0f / 8, 1.0f / 4, 1.0f / 16 };
+
+// albedos darker than this are left out of the color; keeps the
+// background and black surfaces from dividing by zero
+#define DENOISE_MIN_ALBEDO  1e-3f
+
+static inline SimdFloat brightness( const SimdFloat *c )
+{
+    return dot( c[0], c[1], c[2], SimdFloat( brightnessWeight[0] ),
+                SimdFloat( brightnessWeight[1] ), SimdFloat( brightnessWeight[2] ) );
+}
+
+///
+// power(x,n) - x to the n >= 0, by squaring
+///
+static inline SimdFloat power( SimdFloat x, int n )
+{
+    SimdFloat r( 1.0f );
+    for( ; n > 0; n >>= 1 ) {
+        if( n & 1 ) {
+            r = r * x;
+        }
+        x = x * x;
+    }
+    return r;
+}
+
+///
+// Constructor
+///
+Denoiser::Denoiser( ThreadPool &threads ) :
+    iterations(5), sigmaDepth(4.0f), sigmaBrightness(4.0f),
+    normalPower(128), filterMs(0.0), pool(threads), width(0), height(0)
+{
+}
+
+///
+// guideRow(y,depth) - depth gradient of row y, from whichever side has
+//     a surface
+///
+void Denoiser::guideRow( int y, const float *z )
+{
+    for( int x = 0; x < width; x++ ) {
+        size_t p = (size_t) y * width + x;
+        float d[2] = { 0.0f, 0.0f };
+        int n[2] = { 0, 0 };
+
+        if( x > 0 && z[p - 1] > 0.0f ) {
+            d[0] += z[p] - z[p - 1];
+            n[0]++;
+        }
+        if( x + 1 < width && z[p + 1] > 0.0f ) {
+            d[0] += z[p + 1] - z[p];
+            n[0]++;
+        }
+        if( y > 0 && z[p - width] > 0.0f ) {
+            d[1] += z[p] - z[p - width];
+            n[1]++;
+        }
+        if( y + 1 < height && z[p + width] > 0.0f ) {
+            d[1] += z[p + width] - z[p];
+            n[1]++;
+        }
+
+        depth[p] = z[p];
+        depthDx[p] = z[p] > 0.0f && n[0] ? d[0] / n[0] : 0.0f;
+        depthDy[p] = z[p] > 0.0f && n[1] ? d[1] / n[1] : 0.0f;
+    }
+}
+
+///
+// blurRow(y,from) - 3x3 Gaussian of the variance, for the brightness
+//     test of the next pass
+///
+void Denoiser::blurRow( int y, int from )
+{
+    static const float g[2] = { 0.5f, 0.25f };
+    const float *v = variance[from].data();
+
+    for( int x = 0; x < width; x++ ) {
+        float sum = 0.0f, weight = 0.0f;
+        for( int j = -1; j <= 1; j++ ) {
+            int yq = y + j;
+            if( yq < 0 || yq >= height ) {
+                continue;
+            }
+            for( int i = -1; i <= 1; i++ ) {
+                int xq = x + i;
+                if( xq < 0 || xq >= width ) {
+                    continue;
+                }
+                float w = g[abs( i )] * g[abs( j )];
+                sum += w * v[(size_t) yq * width + xq];
+                weight += w;
+            }
+        }
+        blurred[(size_t) y * width + x] = sum / weight;
+    }
+}
+
+///
+// filterRow(y,step,from) - one a-trous pass over row y, with taps
+//     'step' pixels apart
+///
+void Denoiser::filterRow( int y, int step, int from )
+{
+    const float LOG2E = 1.44269504f;
+    int to = 1 - from;
+    SimdFloat zero( 0.0f );
+    SimdInt lanes = laneIndex();
+
+    for( int x = 0; x < width; x += SIMD_WIDTH ) {
+        size_t p = (size_t) y * width + x;
+        SimdInt xs = SimdInt( x ) + lanes;
+        SimdMask inside = SimdInt( width - 1 ) >= xs;
+
+        SimdFloat cz = loadFloat( &depth[p] );
+        SimdFloat cdx = loadFloat( &depthDx[p] ), cdy = loadFloat( &depthDy[p] );
+        SimdFloat cn[3], cc[3];
+        for( int c = 0; c < 3; c++ ) {
+            cn[c] = loadFloat( &normal[c][p] );
+            cc[c] = loadFloat( &color[from][c][p] );
+        }
+        SimdFloat cl = brightness( cc );
+        SimdFloat cv = loadFloat( &variance[from][p] );
+
+        // exponents are scaled to base 2 up front; a depth difference is
+        // measured against the one the center's gradient predicts
+        SimdFloat depthX = SimdFloat( sigmaDepth * step ) * cdx;
+        SimdFloat depthY = SimdFloat( sigmaDepth * step ) * cdy;
+        SimdFloat brightScale = SimdFloat( LOG2E ) /
+                                (SimdFloat( sigmaBrightness ) *
+                                 sqrt( max( loadFloat( &blurred[p] ), zero ) ) +
+                                 SimdFloat( 1e-4f ));
+
+        // the center tap
+        SimdFloat w0( kernel[2] * kernel[2] );
+        SimdFloat sumW = w0, sumV = w0 * w0 * cv, sumC[3];
+        for( int c = 0; c < 3; c++ ) {
+            sumC[c] = w0 * cc[c];
+        }
+
+        for( int j = -2; j <= 2; j++ ) {
+            int yq = y + j * step;
+            if( yq < 0 || yq >= height ) {
+                continue;
+            }
+            for( int i = -2; i <= 2; i++ ) {
+                if( i == 0 && j == 0 ) {
+                    continue;
+                }
+
+                // the taps: loaded whole inside the row, gathered (and
+                // masked) where they cross its ends
+                int dx = i * step;
+                SimdFloat qz, qn[3], qc[3], qv;
+                SimdMask valid = inside;
+                if( x + dx >= 0 && x + dx + SIMD_WIDTH <= width ) {
+                    size_t q = (size_t) yq * width + x + dx;
+                    qz = loadFloat( &depth[q] );
+                    qv = loadFloat( &variance[from][q] );
+                    for( int c = 0; c < 3; c++ ) {
+                        qn[c] = loadFloat( &normal[c][q] );
+                        qc[c] = loadFloat( &color[from][c][q] );
+                    }
+                } else {
+                    SimdInt xq = xs + SimdInt( dx );
+                    valid = valid & nonNegative( xq ) & (SimdInt( width - 1 ) >= xq);
+                    SimdInt at = SimdInt( yq * width ) +
+                                 min( max( xq, SimdInt( 0 ) ), SimdInt( width - 1 ) );
+                    qz = gather( depth.data(), at );
+                    qv = gather( variance[from].data(), at );
+                    for( int c = 0; c < 3; c++ ) {
+                        qn[c] = gather( normal[c].data(), at );
+                        qc[c] = gather( color[from][c].data(), at );
+                    }
+                }
+
+                SimdFloat nn = dot( cn[0], cn[1], cn[2], qn[0], qn[1], qn[2] );
+                SimdFloat expected = abs( fmadd( depthX, SimdFloat( (float) i ),
+                                                 depthY * SimdFloat( (float) j ) ) );
+                SimdFloat exponent =
+                    abs( cz - qz ) * SimdFloat( -LOG2E ) /
+                        (expected + SimdFloat( 1e-4f )) -
+                    abs( cl - brightness( qc ) ) * brightScale;
+                SimdFloat w = SimdFloat( kernel[i + 2] * kernel[j + 2] ) *
+                              power( nn, normalPower ) * exp2( exponent );
+                w = select( valid & (nn > zero), w, zero );
+
+                sumW = sumW + w;
+                sumV = fmadd( w * w, qv, sumV );
+                for( int c = 0; c < 3; c++ ) {
+                    sumC[c] = fmadd( w, qc[c], sumC[c] );
+                }
+            }
+        }
+
+        SimdFloat inverse = SimdFloat( 1.0f ) / sumW;
+        storeMasked( &variance[to][p], inside, sumV * inverse * inverse );
+        for( int c = 0; c < 3; c++ ) {
+            storeMasked( &color[to][c][p], inside, sumC[c] * inverse );
+        }
+    }
+}
+
+///
+// filter(w,h,rgb,var,albedo,normal,depth,out) - denoise an image
+///
+void Denoiser::filter( int w, int h, const float *rgb, const float *var,
+                       const float *albedo, const float *n,
+                       const float *z, float *out )
+{
+    uint64_t start = monotonicNs();
+
+    width = w;
+    height = h;
+    size_t size = (size_t) w * h + SIMD_WIDTH;
+    for( int k = 0; k < 2; k++ ) {
+        for( int c = 0; c < 3; c++ ) {
+            color[k][c].assign( size, 0.0f );
+        }
+        variance[k].assign( size, 0.0f );
+    }
+    for( int c = 0; c < 3; c++ ) {
+        normal[c].assign( size, 0.0f );
+    }
+    blurred.assign( size, 0.0f );
+    depth.assign( size, 0.0f );
+    depthDx.assign( size, 0.0f );
+    depthDy.assign( size, 0.0f );
+
+    // split the inputs into planes, dividing out the albedo
+    pool.parallelFor( h, [&]( int y, int ) {
+        for( int x = 0; x < w; x++ ) {
+            size_t p = (size_t) y * w + x;
+            float scale = 0.0f;
+            for( int c = 0; c < 3; c++ ) {
+                float a = max( albedo[3 * p + c], DENOISE_MIN_ALBEDO );
+                color[0][c][p] = rgb[3 * p + c] / a;
+                normal[c][p] = n[3 * p + c];
+                scale += brightnessWeight[c] * a;
+            }
+            if( var != NULL ) {
+                variance[0][p] = var[p] / (scale * scale);
+            }
+        }
+        guideRow( y, z );
+    } );
+
+    // no variances given: use the brightness variance of each pixel's
+    // 3x3 neighborhood
+    if( var == NULL ) {
+        pool.parallelFor( h, [&]( int y, int ) {
+            for( int x = 0; x < w; x++ ) {
+                float sum = 0.0f, sum2 = 0.0f;
+                int count = 0;
+                for( int j = max( y - 1, 0 ); j <= min( y + 1, h - 1 ); j++ ) {
+                    for( int i = max( x - 1, 0 ); i <= min( x + 1, w - 1 ); i++ ) {
+                        size_t q = (size_t) j * w + i;
+                        float l = 0.0f;
+                        for( int c = 0; c < 3; c++ ) {
+                            l += brightnessWeight[c] * color[0][c][q];
+                        }
+                        sum += l;
+                        sum2 += l * l;
+                        count++;
+                    }
+                }
+                float mean = sum / count;
+                variance[0][(size_t) y * w + x] = max( sum2 / count - mean * mean, 0.0f );
+            }
+        } );
+    }
+
+    int from = 0;
+    for( int i = 0; i < min( iterations, DENOISE_MAX_PASSES ); i++ ) {
+        pool.parallelFor( h, [&]( int y, int ) {
+            blurRow( y, from );
+        } );
+        pool.parallelFor( h, [&]( int y, int ) {
+            filterRow( y, 1 << i, from );
+        } );
+        from = 1 - from;
+    }
+
+    // put the albedo back
+    pool.parallelFor( h, [&]( int y, int ) {
+        for( int x = 0; x < w; x++ ) {
+            size_t p = (size_t) y * w + x;
+            for( int c = 0; c < 3; c++ ) {
+                out[3 * p + c] = color[from][c][p] *
+                                 max( albedo[3 * p + c], DENOISE_MIN_ALBEDO );
+            }
+        }
+    } );
+
+    filterMs = elapsedMs( start );
+}
@@ -0,0 +1,93 @@
+//
+//  Denoiser.h
+//
+//  Edge-avoiding a-trous wavelet filter (as in SVGF) for noisy renders
+//  of the scene, such as low-sample PathTracer images.
+//
+//  filter() divides the color by the albedo guide, so texture detail
+//  is not blurred, and then runs 'iterations' passes of a 5x5 B3-spline
+//  kernel whose taps spread out 1, 2, 4 ... pixels apart.  Each tap is
+//  weighted down where the depth, normal or brightness differs from
+//  the center's.  The brightness test is scaled by the pixel's
+//  standard deviation, so noise is smoothed while real edges are kept.
+//  The variance is filtered along with the color.
+//
+//  Every pass runs on a ThreadPool, one row at a time, SIMD_WIDTH
+//  neighboring pixels at once.
+//
+
+#ifndef _DENOISER_H_
+#define _DENOISER_H_
+
+#include <vector>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// filter passes; the kernel spans 4 << (DENOISE_MAX_PASSES - 1) pixels
+// at most
+#define DENOISE_MAX_PASSES  8
+
+// per-pixel variances from fewer samples than this are too rough to
+// use; pass NULL and let filter() estimate them
+#define DENOISE_MIN_SAMPLES 8
+
+class Denoiser {
+
+public:
+    // passes, and how strongly depth, normal and brightness differences
+    // stop the filter: larger sigmas blur more across depth and
+    // brightness edges, a larger power of the normals' dot product
+    // blurs less across creases
+    int iterations;
+    float sigmaDepth, sigmaBrightness;
+    int normalPower;
+
+    // time taken by the last filter()
+    double filterMs;
+
+private:
+    ThreadPool &pool;
+    int width, height;
+
+    // planes of width*height (+ SIMD_WIDTH, for loads that run past
+    // the end of the last row): the color divided by the albedo, its
+    // brightness variance (both ping-ponged between passes), the guides
+    // and the depth gradient
+    vector<float> color[2][3], variance[2], blurred;
+    vector<float> normal[3], depth, depthDx, depthDy;
+
+    void guideRow( int y, const float *depth );
+    void blurRow( int y, int from );
+    void filterRow( int y, int step, int from );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to filter with
+    ///
+    Denoiser( ThreadPool &threads );
+
+    ///
+    // filter(w,h,rgb,var,albedo,normal,depth,out) - denoise an image
+    //
+    // @param w, h   - image size
+    // @param rgb    - w*h RGB triples
+    // @param var    - w*h brightness variances of rgb's pixels, or NULL
+    //                 to estimate them from each pixel's neighbors
+    // @param albedo - w*h RGB diffuse colors
+    // @param normal - w*h unit normals (XYZ); 0 where nothing was hit
+    // @param depth  - w*h eye-space depths; 0 where nothing was hit
+    // @param out    - w*h RGB triples; may be rgb
+    ///
+    void filter( int w, int h, const float *rgb, const float *var,
+                 const float *albedo, const float *normal,
+                 const float *depth, float *out );
+
+};
+
+#endif
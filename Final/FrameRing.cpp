@@ -0,0 +1,325 @@
+//
+//  FrameRing.cpp
+//
+//  POSIX shared-memory ring buffer for handing rendered frames to
+//  another process.
+//
+//  The shared fields that change per frame are only touched through
+//  the GCC __atomic builtins, so the producer and any number of
+//  consumers can run in separate processes without further locking.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include "FrameRing.h"
+
+using namespace std;
+
+// round 'n' up to the next multiple of FRAMERING_ALIGN
+static uint64_t alignUp( uint64_t n )
+{
+    return (n + FRAMERING_ALIGN - 1) & ~((uint64_t) FRAMERING_ALIGN - 1);
+}
+
+// bytes reserved for the header and for each slot header
+static const uint64_t HEADER_BYTES = alignUp( sizeof(FrameRingHeader) );
+static const uint64_t SLOTHDR_BYTES = alignUp( sizeof(FrameSlot) );
+
+///
+// futex() - thin wrapper around the futex system call.  The word lives
+//     in a shared mapping, so the non-private operations are used.
+///
+static long futex( uint32_t *word, int op, uint32_t val,
+                   const struct timespec *timeout )
+{
+    return syscall( SYS_futex, word, op, val, timeout, NULL, 0 );
+}
+
+///
+// Constructor
+///
+FrameRing::FrameRing( void ) :
+    base(NULL), length(0), owner(false), nextFrame(1)
+{
+    name[0] = '\0';
+}
+
+///
+// Destructor
+///
+FrameRing::~FrameRing( void )
+{
+    close();
+}
+
+///
+// create(name,w,h,slots) - create a new ring as the producer
+///
+bool FrameRing::create( const char *nm, int w, int h, int slots )
+{
+    close();
+
+    if( w < 1 || h < 1 || slots < 2 ) {
+        cerr << "FrameRing: bad geometry " << w << "x" << h <<
+            " with " << slots << " slots" << endl;
+        return false;
+    }
+
+    uint64_t frameBytes = (uint64_t) w * h * 4;
+    uint64_t slotSize = SLOTHDR_BYTES + alignUp( frameBytes );
+    uint64_t total = HEADER_BYTES + slotSize * slots;
+
+    // start from a fresh segment so stale readers never see new geometry
+    shm_unlink( nm );
+    int fd = shm_open( nm, O_CREAT | O_EXCL | O_RDWR, 0600 );
+    if( fd < 0 ) {
+        perror( nm );
+        return false;
+    }
+    if( ftruncate( fd, total ) != 0 ) {
+        perror( "FrameRing: ftruncate" );
+        ::close( fd );
+        shm_unlink( nm );
+        return false;
+    }
+
+    void *p = mmap( NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( p == MAP_FAILED ) {
+        perror( "FrameRing: mmap" );
+        shm_unlink( nm );
+        return false;
+    }
+
+    base = p;
+    length = total;
+    owner = true;
+    nextFrame = 1;
+    strncpy( name, nm, sizeof(name) - 1 );
+    name[sizeof(name) - 1] = '\0';
+
+    // the segment is zero-filled, so every slot starts out with seq 0
+    FrameRingHeader *H = header();
+    H->version = FRAMERING_VERSION;
+    H->slotCount = slots;
+    H->width = w;
+    H->height = h;
+    H->channels = 4;
+    H->slotSize = slotSize;
+    H->frameBytes = frameBytes;
+    H->published = 0;
+    H->wakeups = 0;
+    H->producerPid = getpid();
+
+    // the magic number goes in last; attach() checks it
+    __atomic_store_n( &H->magic, FRAMERING_MAGIC, __ATOMIC_RELEASE );
+
+    return true;
+}
+
+///
+// attach(name) - map an existing ring as a consumer
+///
+bool FrameRing::attach( const char *nm )
+{
+    close();
+
+    int fd = shm_open( nm, O_RDWR, 0 );
+    if( fd < 0 ) {
+        perror( nm );
+        return false;
+    }
+
+    struct stat sb;
+    if( fstat( fd, &sb ) != 0 || (uint64_t) sb.st_size < HEADER_BYTES ) {
+        cerr << "FrameRing: " << nm << " is not a frame ring" << endl;
+        ::close( fd );
+        return false;
+    }
+
+    // consumers need write access only for the futex word
+    void *p = mmap( NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED,
+                    fd, 0 );
+    ::close( fd );
+    if( p == MAP_FAILED ) {
+        perror( "FrameRing: mmap" );
+        return false;
+    }
+
+    base = p;
+    length = sb.st_size;
+    owner = false;
+    strncpy( name, nm, sizeof(name) - 1 );
+    name[sizeof(name) - 1] = '\0';
+
+    FrameRingHeader *H = header();
+    if( __atomic_load_n( &H->magic, __ATOMIC_ACQUIRE ) != FRAMERING_MAGIC ||
+        H->version != FRAMERING_VERSION ||
+        HEADER_BYTES + H->slotSize * H->slotCount > length ) {
+        cerr << "FrameRing: " << nm << " has an unknown layout" << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+///
+// close() - unmap the segment (unlinking it if we own it)
+///
+void FrameRing::close( void )
+{
+    if( base ) {
+        munmap( base, length );
+        if( owner ) {
+            shm_unlink( name );
+        }
+    }
+    base = NULL;
+    length = 0;
+    owner = false;
+}
+
+///
+// header() - the shared header, or NULL if not mapped
+///
+FrameRingHeader *FrameRing::header( void ) const
+{
+    return (FrameRingHeader *) base;
+}
+
+///
+// slot(frame) - the slot that holds (or will hold) a frame
+///
+FrameSlot *FrameRing::slot( uint64_t frame ) const
+{
+    FrameRingHeader *H = header();
+    uint64_t index = (frame - 1) % H->slotCount;
+    return (FrameSlot *) ((char *) base + HEADER_BYTES + index * H->slotSize);
+}
+
+///
+// pixels(frame) - pixel data of the slot that holds a frame
+///
+unsigned char *FrameRing::pixels( uint64_t frame ) const
+{
+    return (unsigned char *) slot( frame ) + SLOTHDR_BYTES;
+}
+
+///
+// beginFrame() - claim the next slot for writing
+///
+unsigned char *FrameRing::beginFrame( void )
+{
+    FrameSlot *S = slot( nextFrame );
+
+    // odd sequence: readers of whatever was here will now fail readValid()
+    __atomic_store_n( &S->seq, 2 * nextFrame - 1, __ATOMIC_RELAXED );
+    __atomic_thread_fence( __ATOMIC_RELEASE );
+
+    return pixels( nextFrame );
+}
+
+///
+// publish() - mark the frame started by beginFrame() as complete
+///
+uint64_t FrameRing::publish( void )
+{
+    FrameRingHeader *H = header();
+    FrameSlot *S = slot( nextFrame );
+
+    S->frame = nextFrame;
+    S->width = H->width;
+    S->height = H->height;
+    S->timestampNs = monotonicNs();
+    __atomic_store_n( &S->seq, 2 * nextFrame, __ATOMIC_RELEASE );
+    __atomic_store_n( &H->published, nextFrame, __ATOMIC_RELEASE );
+
+    // only pay for the system call when someone is actually asleep
+    __atomic_add_fetch( &H->wakeups, 1, __ATOMIC_SEQ_CST );
+    if( __atomic_load_n( &H->waiters, __ATOMIC_SEQ_CST ) > 0 ) {
+        futex( &H->wakeups, FUTEX_WAKE, 0x7fffffff, NULL );
+    }
+
+    return nextFrame++;
+}
+
+///
+// latest() - number of the newest published frame (0 if none)
+///
+uint64_t FrameRing::latest( void ) const
+{
+    return __atomic_load_n( &header()->published, __ATOMIC_ACQUIRE );
+}
+
+///
+// waitFor(after,timeoutMs) - block until a frame newer than 'after'
+///
+uint64_t FrameRing::waitFor( uint64_t after, int timeoutMs )
+{
+    FrameRingHeader *H = header();
+    uint64_t deadline = timeoutMs < 0 ? 0 :
+        monotonicNs() + (uint64_t) timeoutMs * 1000000ull;
+
+    for( ;; ) {
+        // sample the futex word before re-checking, so a publish that
+        // lands in between makes FUTEX_WAIT return immediately
+        uint32_t w = __atomic_load_n( &H->wakeups, __ATOMIC_ACQUIRE );
+        uint64_t newest = latest();
+        if( newest > after ) {
+            return newest;
+        }
+
+        struct timespec ts, *tp = NULL;
+        if( timeoutMs >= 0 ) {
+            uint64_t now = monotonicNs();
+            if( now >= deadline ) {
+                return 0;
+            }
+            uint64_t left = deadline - now;
+            ts.tv_sec = left / 1000000000ull;
+            ts.tv_nsec = left % 1000000000ull;
+            tp = &ts;
+        }
+
+        // announce ourselves first; FUTEX_WAIT re-checks the word, so
+        // a publish between the two steps is never lost
+        __atomic_add_fetch( &H->waiters, 1, __ATOMIC_SEQ_CST );
+        long rc = futex( &H->wakeups, FUTEX_WAIT, w, tp );
+        int why = errno;
+        __atomic_sub_fetch( &H->waiters, 1, __ATOMIC_SEQ_CST );
+        if( rc != 0 && why != EAGAIN && why != EINTR && why != ETIMEDOUT ) {
+            errno = why;
+            perror( "FrameRing: futex" );
+            return 0;
+        }
+    }
+}
+
+///
+// readBegin(frame) - start an in-place read of a frame
+///
+uint64_t FrameRing::readBegin( uint64_t frame ) const
+{
+    uint64_t s = __atomic_load_n( &slot( frame )->seq, __ATOMIC_ACQUIRE );
+    return s == 2 * frame ? s : 0;
+}
+
+///
+// readValid(frame,stamp) - check that a frame was not overwritten
+///
+bool FrameRing::readValid( uint64_t frame, uint64_t stamp ) const
+{
+    __atomic_thread_fence( __ATOMIC_ACQUIRE );
+    return __atomic_load_n( &slot( frame )->seq, __ATOMIC_RELAXED ) == stamp;
+}
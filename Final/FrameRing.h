@@ -0,0 +1,182 @@
+//
+//  FrameRing.h
+//
+//  POSIX shared-memory ring buffer for handing rendered frames to
+//  another process.  The producer reads pixels straight into a ring
+//  slot and publishes it; consumers map the same segment and read the
+//  pixels in place, so no frame is ever copied between processes.
+//
+//  Each slot carries a sequence number that doubles as a seqlock: it
+//  is odd while the producer is writing the slot and even once the
+//  frame is complete.  Consumers sleep on a futex word in the header
+//  that the producer bumps after every publish.
+//
+//  Linux only (shm_open, mmap and futex).
+//
+
+#ifndef _FRAMERING_H_
+#define _FRAMERING_H_
+
+#include <stdint.h>
+
+#include "Timing.h"
+
+// "FRNG" and the current layout version
+#define FRAMERING_MAGIC     0x474e5246u
+#define FRAMERING_VERSION   1
+
+// pixel rows and slot starts are aligned to this many bytes
+#define FRAMERING_ALIGN     64
+
+///
+// Header at the start of the shared segment.  Written once by the
+// producer when the ring is created, except for 'published',
+// 'wakeups' and 'waiters', which change on every frame.
+///
+typedef struct FrameRingHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t slotCount;     // number of frame slots in the ring
+    uint32_t width;         // frame size in pixels
+    uint32_t height;
+    uint32_t channels;      // bytes per pixel (RGBA == 4)
+    uint64_t slotSize;      // bytes from one slot to the next
+    uint64_t frameBytes;    // bytes of pixel data in each slot
+    uint64_t published;     // sequence number of the newest frame (0: none)
+    uint32_t wakeups;       // futex word; incremented on each publish
+    uint32_t waiters;       // consumers currently sleeping on 'wakeups'
+    uint32_t producerPid;
+} FrameRingHeader;
+
+///
+// Per-slot header; the pixel data follows at FRAMERING_ALIGN.
+// Pixels are tightly packed RGBA rows, bottom row first (the order
+// glReadPixels() produces).
+///
+typedef struct FrameSlot {
+    uint64_t seq;           // 2*frame while readable, odd while writing
+    uint64_t frame;         // frame number (1-based)
+    uint64_t timestampNs;   // CLOCK_MONOTONIC time of publication
+    uint32_t width;
+    uint32_t height;
+} FrameSlot;
+
+///
+// One end of a shared-memory frame ring
+///
+
+class FrameRing {
+
+    // segment name, mapping and its length
+    char name[64];
+    void *base;
+    uint64_t length;
+
+    // true if we created the segment (and must unlink it)
+    bool owner;
+
+    // producer: number of the next frame to be published
+    uint64_t nextFrame;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    FrameRing( void );
+
+    ///
+    // Destructor - unmaps the segment, and unlinks it if we created it
+    ///
+    ~FrameRing( void );
+
+    ///
+    // create(name,w,h,slots) - create a new ring as the producer
+    //
+    // @param name  - shared memory object name (e.g. "/stilllife")
+    // @param w     - frame width in pixels
+    // @param h     - frame height in pixels
+    // @param slots - number of frames the ring holds
+    //
+    // @return true on success
+    ///
+    bool create( const char *name, int w, int h, int slots );
+
+    ///
+    // attach(name) - map an existing ring as a consumer
+    //
+    // @param name - shared memory object name
+    //
+    // @return true on success
+    ///
+    bool attach( const char *name );
+
+    ///
+    // close() - unmap the segment (unlinking it if we own it)
+    ///
+    void close( void );
+
+    ///
+    // header() - the shared header, or NULL if not mapped
+    ///
+    FrameRingHeader *header( void ) const;
+
+    ///
+    // slot(frame) - the slot that holds (or will hold) a frame
+    ///
+    FrameSlot *slot( uint64_t frame ) const;
+
+    ///
+    // pixels(frame) - pixel data of the slot that holds a frame
+    ///
+    unsigned char *pixels( uint64_t frame ) const;
+
+    ///
+    // beginFrame() - claim the next slot for writing
+    //
+    // @return a pointer to the slot's pixel storage; fill in exactly
+    //    width*height*channels bytes and then call publish()
+    ///
+    unsigned char *beginFrame( void );
+
+    ///
+    // publish() - mark the frame started by beginFrame() as complete
+    //     and wake any waiting consumers
+    //
+    // @return the frame number just published
+    ///
+    uint64_t publish( void );
+
+    ///
+    // latest() - number of the newest published frame (0 if none)
+    ///
+    uint64_t latest( void ) const;
+
+    ///
+    // waitFor(after,timeoutMs) - block until a frame newer than 'after'
+    //     has been published
+    //
+    // @param after     - the newest frame the caller has already seen
+    // @param timeoutMs - give up after this long (<0 waits forever)
+    //
+    // @return the newest frame number, or 0 on timeout
+    ///
+    uint64_t waitFor( uint64_t after, int timeoutMs );
+
+    ///
+    // readBegin(frame) - start an in-place read of a frame
+    //
+    // @return the slot's sequence stamp to pass to readValid(),
+    //    or 0 if the frame has already been overwritten
+    ///
+    uint64_t readBegin( uint64_t frame ) const;
+
+    ///
+    // readValid(frame,stamp) - check that a frame was not overwritten
+    //     while it was being read
+    ///
+    bool readValid( uint64_t frame, uint64_t stamp ) const;
+
+};
+
+#endif
@@ -0,0 +1,164 @@
+//
+//  Framebuffer.cpp
+//
+//  Offscreen render target implementation.
+//
+
+#include <iostream>
+
+#include "Framebuffer.h"
+
+using namespace std;
+
+///
+// Constructor
+///
+Framebuffer::Framebuffer( void ) :
+    fbo(0), color(0), depth(0), width(0), height(0), layers(0)
+{
+}
+
+///
+// layeredTexture(internal,format,type,w,h,n) - allocate an empty 2D array
+//     texture for use as a layered attachment
+///
+static GLuint layeredTexture( GLenum internal, GLenum format, GLenum type,
+                              int w, int h, int n )
+{
+    GLuint tex;
+
+    glGenTextures( 1, &tex );
+    glBindTexture( GL_TEXTURE_2D_ARRAY, tex );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glTexImage3D( GL_TEXTURE_2D_ARRAY, 0, internal, w, h, n, 0,
+                  format, type, NULL );
+    glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+
+    return tex;
+}
+
+///
+// resize(w,h,n) - (re)allocate the attachments
+///
+bool Framebuffer::resize( int w, int h, int n )
+{
+    if( fbo && w == width && h == height && n == layers ) {
+        return true;
+    }
+
+    release();
+
+    glGenFramebuffers( 1, &fbo );
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+
+    width = w;
+    height = h;
+    layers = n;
+
+    if( n > 1 ) {
+        color = layeredTexture( GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, w, h, n );
+        glFramebufferTexture( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, color, 0 );
+
+        depth = layeredTexture( GL_DEPTH_COMPONENT24, GL_DEPTH_COMPONENT,
+                                GL_UNSIGNED_INT, w, h, n );
+        glFramebufferTexture( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, depth, 0 );
+
+        return checkStatus();
+    }
+
+    glGenRenderbuffers( 1, &color );
+    glBindRenderbuffer( GL_RENDERBUFFER, color );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_RGBA8, w, h );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                               GL_RENDERBUFFER, color );
+
+    glGenRenderbuffers( 1, &depth );
+    glBindRenderbuffer( GL_RENDERBUFFER, depth );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_RENDERBUFFER, depth );
+
+    return checkStatus();
+}
+
+///
+// checkStatus() - verify the framebuffer just set up, releasing it if
+//     it is incomplete
+///
+bool Framebuffer::checkStatus( void )
+{
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    if( status != GL_FRAMEBUFFER_COMPLETE ) {
+        cerr << "*** Framebuffer: " << width << "x" << height << "x" <<
+            layers << " incomplete, status 0x" << hex << status << dec <<
+            endl;
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+///
+// bind() - direct rendering into this framebuffer
+///
+void Framebuffer::bind( void )
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+    glViewport( 0, 0, width, height );
+}
+
+///
+// unbind(w,h) - go back to the window
+///
+void Framebuffer::unbind( int w, int h )
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    glViewport( 0, 0, w, h );
+}
+
+///
+// readPixels(dst) - copy the color buffer into 'dst'
+///
+void Framebuffer::readPixels( void *dst )
+{
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+    if( layers > 1 ) {
+        glBindTexture( GL_TEXTURE_2D_ARRAY, color );
+        glGetTexImage( GL_TEXTURE_2D_ARRAY, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+                       dst );
+        glBindTexture( GL_TEXTURE_2D_ARRAY, 0 );
+        return;
+    }
+
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+    glReadBuffer( GL_COLOR_ATTACHMENT0 );
+    glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, dst );
+}
+
+///
+// release() - delete all GL objects
+///
+void Framebuffer::release( void )
+{
+    if( fbo ) {
+        glDeleteFramebuffers( 1, &fbo );
+    }
+    if( layers > 1 ) {
+        glDeleteTextures( 1, &color );
+        glDeleteTextures( 1, &depth );
+    } else {
+        if( color ) {
+            glDeleteRenderbuffers( 1, &color );
+        }
+        if( depth ) {
+            glDeleteRenderbuffers( 1, &depth );
+        }
+    }
+    fbo = color = depth = 0;
+    width = height = layers = 0;
+}
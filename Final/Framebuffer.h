@@ -0,0 +1,86 @@
+//
+//  Framebuffer.h
+//
+//  Offscreen render target management
+//
+
+#ifndef _FRAMEBUFFER_H_
+#define _FRAMEBUFFER_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+///
+// An offscreen framebuffer with an RGBA8 color buffer and a depth
+// buffer, used for rendering at sizes other than the window's.
+//
+// A layered framebuffer (layers > 1) uses 2D array textures instead
+// of renderbuffers, so a geometry shader can direct each primitive to
+// a layer with gl_Layer; see multiview.geom.
+///
+
+class Framebuffer {
+
+public:
+    // object handles
+    GLuint fbo, color, depth;
+
+    // current size in pixels, and number of layers
+    int width, height, layers;
+
+private:
+
+    bool checkStatus( void );
+
+public:
+
+    ///
+    // Constructor
+    ///
+    Framebuffer( void );
+
+    ///
+    // resize(w,h,n) - (re)allocate the attachments; a no-op if the
+    //     framebuffer already has this size
+    //
+    // @param w - width in pixels
+    // @param h - height in pixels
+    // @param n - number of layers
+    //
+    // @return true if the framebuffer is complete
+    ///
+    bool resize( int w, int h, int n = 1 );
+
+    ///
+    // bind() - direct rendering into this framebuffer and set the
+    //     viewport to cover it
+    ///
+    void bind( void );
+
+    ///
+    // unbind(w,h) - go back to the window, with a w x h viewport
+    ///
+    void unbind( int w, int h );
+
+    ///
+    // readPixels(dst) - copy the color buffer into 'dst' as tightly
+    //     packed RGBA bytes, bottom row first; a layered framebuffer
+    //     writes all of its layers, one after another
+    ///
+    void readPixels( void *dst );
+
+    ///
+    // release() - delete all GL objects
+    ///
+    void release( void );
+
+};
+
+#endif
@@ -0,0 +1,171 @@
+//
+//  GBuffer.cpp
+//
+//  Offscreen G-buffer implementation.
+//
+
+#include <iostream>
+
+#include "GBuffer.h"
+#include "ShaderSetup.h"
+
+using namespace std;
+
+// fragment shader outputs, in draw buffer order
+static const char *outputs[] = {
+    "finalColor", "fragDepth", "fragNormal", "fragObject"
+};
+
+static const GLenum drawBuffers[] = {
+    GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1,
+    GL_COLOR_ATTACHMENT2, GL_COLOR_ATTACHMENT3
+};
+
+///
+// Constructor
+///
+GBuffer::GBuffer( void ) :
+    fbo(0), color(0), eyeDepth(0), normal(0), object(0), depth(0),
+    width(0), height(0)
+{
+}
+
+///
+// bindOutputs(program) - assign fragment outputs and relink
+///
+bool GBuffer::bindOutputs( GLuint program )
+{
+    GLint flag;
+
+    for( int i = 0; i < 4; i++ ) {
+        glBindFragDataLocation( program, i, outputs[i] );
+    }
+    glLinkProgram( program );
+    glGetProgramiv( program, GL_LINK_STATUS, &flag );
+    printProgramInfoLog( program );
+
+    return flag == GL_TRUE;
+}
+
+///
+// attach(internal,slot,w,h) - add one renderbuffer to the bound
+//     framebuffer
+///
+static GLuint attach( GLenum internal, GLenum slot, int w, int h )
+{
+    GLuint rb;
+
+    glGenRenderbuffers( 1, &rb );
+    glBindRenderbuffer( GL_RENDERBUFFER, rb );
+    glRenderbufferStorage( GL_RENDERBUFFER, internal, w, h );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, slot, GL_RENDERBUFFER, rb );
+
+    return rb;
+}
+
+///
+// resize(w,h) - (re)allocate the attachments
+///
+bool GBuffer::resize( int w, int h )
+{
+    if( fbo && w == width && h == height ) {
+        return true;
+    }
+
+    release();
+
+    glGenFramebuffers( 1, &fbo );
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+
+    color = attach( GL_RGBA8, GL_COLOR_ATTACHMENT0, w, h );
+    eyeDepth = attach( GL_R32F, GL_COLOR_ATTACHMENT1, w, h );
+    normal = attach( GL_RGBA16F, GL_COLOR_ATTACHMENT2, w, h );
+    object = attach( GL_R8UI, GL_COLOR_ATTACHMENT3, w, h );
+    depth = attach( GL_DEPTH_COMPONENT24, GL_DEPTH_ATTACHMENT, w, h );
+
+    width = w;
+    height = h;
+
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+
+    if( status != GL_FRAMEBUFFER_COMPLETE ) {
+        cerr << "*** GBuffer: " << w << "x" << h <<
+            " incomplete, status 0x" << hex << status << dec << endl;
+        release();
+        return false;
+    }
+
+    return true;
+}
+
+///
+// bind() - direct rendering into all four targets
+///
+void GBuffer::bind( void )
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+    glDrawBuffers( 4, drawBuffers );
+    glViewport( 0, 0, width, height );
+}
+
+///
+// unbind(w,h) - go back to the window
+///
+void GBuffer::unbind( int w, int h )
+{
+    glBindFramebuffer( GL_FRAMEBUFFER, 0 );
+    glViewport( 0, 0, w, h );
+}
+
+///
+// clear() - reset every target
+///
+void GBuffer::clear( void )
+{
+    static const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static const GLuint none[4] = { 255, 255, 255, 255 };
+    static const GLfloat farDepth = 1.0f;
+
+    glClearBufferfv( GL_COLOR, 0, zero );
+    glClearBufferfv( GL_COLOR, 1, zero );
+    glClearBufferfv( GL_COLOR, 2, zero );
+    glClearBufferuiv( GL_COLOR, 3, none );
+    glClearBufferfv( GL_DEPTH, 0, &farDepth );
+}
+
+///
+// read(...) - copy the targets out
+///
+void GBuffer::read( unsigned char *rgba, float *depths, GLushort *normals,
+                    unsigned char *ids )
+{
+    glBindFramebuffer( GL_READ_FRAMEBUFFER, fbo );
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+
+    glReadBuffer( GL_COLOR_ATTACHMENT0 );
+    glReadPixels( 0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, rgba );
+    glReadBuffer( GL_COLOR_ATTACHMENT1 );
+    glReadPixels( 0, 0, width, height, GL_RED, GL_FLOAT, depths );
+    glReadBuffer( GL_COLOR_ATTACHMENT2 );
+    glReadPixels( 0, 0, width, height, GL_RGB, GL_HALF_FLOAT, normals );
+    glReadBuffer( GL_COLOR_ATTACHMENT3 );
+    glReadPixels( 0, 0, width, height, GL_RED_INTEGER, GL_UNSIGNED_BYTE, ids );
+
+    glReadBuffer( GL_COLOR_ATTACHMENT0 );
+}
+
+///
+// release() - delete all GL objects
+///
+void GBuffer::release( void )
+{
+    GLuint rbs[] = { color, eyeDepth, normal, object, depth };
+
+    if( fbo ) {
+        glDeleteFramebuffers( 1, &fbo );
+        glDeleteRenderbuffers( 5, rbs );
+    }
+    fbo = color = eyeDepth = normal = object = depth = 0;
+    width = height = 0;
+}
@@ -0,0 +1,99 @@
+//
+//  GBuffer.h
+//
+//  Offscreen G-buffer: a framebuffer with several color attachments
+//  that the gbuffer*.frag shaders fill in a single pass.
+//
+
+#ifndef _GBUFFER_H_
+#define _GBUFFER_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+///
+// Render targets, by draw buffer:
+//
+//      0  finalColor   RGBA8   shaded color
+//      1  fragDepth    R32F    eye-space depth (distance along the view axis)
+//      2  fragNormal   RGBA16F eye-space unit normal
+//      3  fragObject   R8UI    object ID (OBJ_SLAB ... OBJ_ROOM)
+//
+// plus an ordinary depth buffer for hidden surface removal.
+///
+
+class GBuffer {
+
+public:
+    // object handles
+    GLuint fbo, color, eyeDepth, normal, object, depth;
+
+    // current size in pixels
+    int width, height;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    GBuffer( void );
+
+    ///
+    // bindOutputs(program) - assign the fragment shader outputs of
+    //     'program' to the draw buffers above and relink it
+    //
+    // @return true if the program linked
+    ///
+    static bool bindOutputs( GLuint program );
+
+    ///
+    // resize(w,h) - (re)allocate the attachments; a no-op if the
+    //     G-buffer already has this size
+    //
+    // @return true if the framebuffer is complete
+    ///
+    bool resize( int w, int h );
+
+    ///
+    // bind() - direct rendering into all four targets and set the
+    //     viewport to cover them
+    ///
+    void bind( void );
+
+    ///
+    // unbind(w,h) - go back to the window, with a w x h viewport
+    ///
+    void unbind( int w, int h );
+
+    ///
+    // clear() - reset every target: black, zero depth and normal, no
+    //     object, and the depth buffer to the far plane
+    ///
+    void clear( void );
+
+    ///
+    // read(...) - copy the targets out, bottom row first, tightly packed
+    //
+    // @param rgba    - width*height*4 bytes
+    // @param depths  - width*height floats
+    // @param normals - width*height*3 half floats
+    // @param ids     - width*height bytes
+    ///
+    void read( unsigned char *rgba, float *depths, GLushort *normals,
+               unsigned char *ids );
+
+    ///
+    // release() - delete all GL objects
+    ///
+    void release( void );
+
+};
+
+#endif
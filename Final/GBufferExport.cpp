@@ -0,0 +1,136 @@
+//
+//  GBufferExport.cpp
+//
+//  The G-buffer export (-gbuffer; see Benchmarks.h): color, depth,
+//  normals and object IDs of the still life from a path of cameras,
+//  drawn straight into a mapped G-buffer file (GBufferFile.h).
+//
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include "Benchmarks.h"
+#include "GBuffer.h"
+#include "GBufferFile.h"
+#include "Instances.h"
+#include "Scene.h"
+#include "ShaderSetup.h"
+#include "ShadowMap.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+///
+// displayGBuffer() - draw the scene into every target of the G-buffer
+//
+// @param gbuffer - the G-buffer
+// @param phong   - the G-buffer program of the untextured objects
+// @param texture - the G-buffer program of the textured ones
+// @param R       - the drawing options; only R.shadows applies, as
+//                  every object is drawn in full
+///
+static void displayGBuffer( GBuffer &gbuffer, GLuint phong, GLuint texture,
+                            const RenderSettings &R )
+{
+    // the shadows, if anything has moved
+    if( R.shadows ) {
+        updateShadows();
+    }
+
+    gbuffer.clear();
+
+    setUpScene( phong, R );
+    setUpScene( texture, R );
+
+    drawScene( phong, texture, NULL );
+}
+
+///
+// gbufferExport() - render B.frames G-buffer frames straight into the
+// mapped G-buffer file B.path and report the throughput.  Frame 0 uses
+// the still-life camera; frame f > 0 uses orbit camera (f-1) % 16,
+// turning the objects 15 degrees every 16 frames.
+///
+void gbufferExport( const BenchSettings &B )
+{
+    const char *path = B.path;
+    int frames = B.frames;
+    const SceneParts &P = sceneParts();
+
+    ShaderError error;
+    GLuint phong = shaderSetupSharedVertex( "phong.vert",
+        INSTANCE_PLACEMENT, NULL, "gbuffer.frag", SHADOW_LOOKUP, &error );
+    GLuint texture = 0;
+    if( phong ) {
+        texture = shaderSetupShared( "texture.vert", NULL,
+            "gbufferTexture.frag", SHADOW_LOOKUP, &error );
+    }
+    if( !phong || !texture ) {
+        cerr << "Error setting up G-buffer shaders - " <<
+            errorString(error) << endl;
+        return;
+    }
+    // units after the outputs, whose relinking resets them
+    GBuffer gbuffer;
+    if( !GBuffer::bindOutputs( phong ) ||
+        !GBuffer::bindOutputs( texture ) ||
+        !gbuffer.resize( P.width, P.height ) ) {
+        return;
+    }
+    InstanceSet::bindUnits( phong );
+    ShadowMap::bindUnits( phong );
+    ShadowMap::bindUnits( texture );
+
+    float frustum[6];
+    getFrustum( frustum );
+
+    GBufferFile file;
+    if( !file.create( path, P.width, P.height, frames, frustum ) ) {
+        return;
+    }
+
+    SceneView saved = sceneView(), S = saved;
+
+    gbuffer.bind();
+    uint64_t start = monotonicNs();
+
+    for( int f = 0; f < frames; f++ ) {
+        if( f > 0 ) {
+            orbitCamera( (f - 1) % 16, S.eye );
+            for( int i = 0; i < 21; i++ ) {
+                S.angles[i] = 15.0f * ((f - 1) / 16);
+            }
+            setSceneView( S );
+        }
+
+        GBufferView *V = file.view( f );
+        memcpy( V->eye, S.eye, sizeof(V->eye) );
+        memcpy( V->lookAt, S.lookAt, sizeof(V->lookAt) );
+        memcpy( V->up, S.up, sizeof(V->up) );
+        memcpy( V->angles, S.angles, sizeof(V->angles) );
+
+        displayGBuffer( gbuffer, phong, texture, B.draw );
+        gbuffer.read( file.color( f ), file.depth( f ), file.normal( f ),
+                      file.objects( f ) );
+    }
+
+    double renderMs = elapsedMs( start );
+    uint64_t bytes = file.header()->frameStride * frames;
+    file.close();
+    double totalMs = elapsedMs( start );
+
+    gbuffer.unbind( P.width, P.height );
+    gbuffer.release();
+    glDeleteProgram( phong );
+    glDeleteProgram( texture );
+    setSceneView( saved );
+
+    printf( "G-buffer: %d frames at %dx%d into %s (%.1f MB)\n", frames,
+        P.width, P.height, path, bytes / 1048576.0 );
+    printf( "render + read back:  %8.2f ms/frame  %8.1f frames/s\n",
+        renderMs / frames, frames / (renderMs / 1000.0) );
+    printf( "including unmap:     %8.2f ms/frame  %8.1f MB/s\n",
+        totalMs / frames, bytes / 1048576.0 / (totalMs / 1000.0) );
+}
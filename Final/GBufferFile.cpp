@@ -0,0 +1,207 @@
+//
+//  GBufferFile.cpp
+//
+//  Memory-mappable file of G-buffer frames.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "GBufferFile.h"
+
+using namespace std;
+
+// round 'n' up to the next multiple of 'align' (a power of two)
+static uint64_t alignUp( uint64_t n, uint64_t align )
+{
+    return (n + align - 1) & ~(align - 1);
+}
+
+///
+// Constructor
+///
+GBufferFile::GBufferFile( void ) :
+    base(NULL), length(0)
+{
+}
+
+///
+// Destructor
+///
+GBufferFile::~GBufferFile( void )
+{
+    close();
+}
+
+///
+// create(path,w,h,frames,frustum) - create a file and map it for writing
+///
+bool GBufferFile::create( const char *path, int w, int h, int frames,
+                          const float *frustum )
+{
+    close();
+
+    if( w < 1 || h < 1 || frames < 1 ) {
+        cerr << "GBufferFile: bad geometry " << w << "x" << h <<
+            " with " << frames << " frames" << endl;
+        return false;
+    }
+
+    uint64_t pixels = (uint64_t) w * h;
+    uint64_t colorOffset = alignUp( sizeof(GBufferView), GBUFFER_ALIGN );
+    uint64_t depthOffset = alignUp( colorOffset + pixels * 4, GBUFFER_ALIGN );
+    uint64_t normalOffset = alignUp( depthOffset + pixels * 4, GBUFFER_ALIGN );
+    uint64_t objectOffset = alignUp( normalOffset + pixels * 6, GBUFFER_ALIGN );
+    uint64_t frameStride = alignUp( objectOffset + pixels, GBUFFER_PAGE );
+    uint64_t total = GBUFFER_PAGE + frameStride * frames;
+
+    int fd = ::open( path, O_CREAT | O_TRUNC | O_RDWR, 0644 );
+    if( fd < 0 ) {
+        perror( path );
+        return false;
+    }
+    if( ftruncate( fd, total ) != 0 ) {
+        perror( "GBufferFile: ftruncate" );
+        ::close( fd );
+        return false;
+    }
+
+    void *p = mmap( NULL, total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( p == MAP_FAILED ) {
+        perror( "GBufferFile: mmap" );
+        return false;
+    }
+
+    base = p;
+    length = total;
+
+    // the file is zero-filled, so only the header needs writing
+    GBufferHeader *H = header();
+    H->version = GBUFFER_VERSION;
+    H->width = w;
+    H->height = h;
+    H->frames = frames;
+    H->frameStride = frameStride;
+    H->colorOffset = colorOffset;
+    H->depthOffset = depthOffset;
+    H->normalOffset = normalOffset;
+    H->objectOffset = objectOffset;
+    memcpy( H->frustum, frustum, sizeof(H->frustum) );
+    for( int i = 0; i < frames; i++ ) {
+        view( i )->frame = i;
+    }
+
+    H->magic = GBUFFER_MAGIC;
+
+    return true;
+}
+
+///
+// open(path) - map an existing file for reading
+///
+bool GBufferFile::open( const char *path )
+{
+    close();
+
+    int fd = ::open( path, O_RDONLY );
+    if( fd < 0 ) {
+        perror( path );
+        return false;
+    }
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || (uint64_t) st.st_size < GBUFFER_PAGE ) {
+        cerr << "GBufferFile: " << path << " is too short" << endl;
+        ::close( fd );
+        return false;
+    }
+
+    void *p = mmap( NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+    ::close( fd );
+    if( p == MAP_FAILED ) {
+        perror( "GBufferFile: mmap" );
+        return false;
+    }
+
+    base = p;
+    length = st.st_size;
+
+    GBufferHeader *H = header();
+    if( H->magic != GBUFFER_MAGIC || H->version != GBUFFER_VERSION ||
+        GBUFFER_PAGE + H->frameStride * H->frames > length ) {
+        cerr << "GBufferFile: " << path << " is not a complete"
+            " version " << GBUFFER_VERSION << " G-buffer file" << endl;
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+///
+// close() - unmap the file
+///
+void GBufferFile::close( void )
+{
+    if( base != NULL ) {
+        munmap( base, length );
+    }
+    base = NULL;
+    length = 0;
+}
+
+///
+// header() - the file header
+///
+GBufferHeader *GBufferFile::header( void ) const
+{
+    return (GBufferHeader *) base;
+}
+
+///
+// view(frame) - the per-frame record
+///
+GBufferView *GBufferFile::view( int frame ) const
+{
+    return (GBufferView *) ((char *) base + GBUFFER_PAGE +
+                            header()->frameStride * frame);
+}
+
+///
+// color(frame) - RGBA plane
+///
+unsigned char *GBufferFile::color( int frame ) const
+{
+    return (unsigned char *) view( frame ) + header()->colorOffset;
+}
+
+///
+// depth(frame) - eye-space depth plane
+///
+float *GBufferFile::depth( int frame ) const
+{
+    return (float *) ((char *) view( frame ) + header()->depthOffset);
+}
+
+///
+// normal(frame) - eye-space normal plane (half floats)
+///
+uint16_t *GBufferFile::normal( int frame ) const
+{
+    return (uint16_t *) ((char *) view( frame ) + header()->normalOffset);
+}
+
+///
+// objects(frame) - object ID plane
+///
+unsigned char *GBufferFile::objects( int frame ) const
+{
+    return (unsigned char *) view( frame ) + header()->objectOffset;
+}
@@ -0,0 +1,140 @@
+//
+//  GBufferFile.h
+//
+//  Memory-mappable file of G-buffer frames: color, eye-space depth,
+//  eye-space normals and object IDs for every pixel, as written by
+//  "finalMain -gbuffer".
+//
+//  LAYOUT (native byte order):
+//
+//      offset 0            GBufferHeader, padded to GBUFFER_PAGE bytes
+//      GBUFFER_PAGE        frame 0
+//      + frameStride       frame 1, and so on
+//
+//  Every frame starts on a page boundary, so a single frame can be
+//  mapped by itself.  A frame is a GBufferView record followed by four
+//  planes at the offsets given in the header; all planes are stored
+//  bottom row first (the order glReadPixels() produces):
+//
+//      color   - RGBA, one byte per channel
+//      depth   - float: distance in front of the camera along its
+//                view axis, in scene units; 0 where nothing was drawn
+//      normal  - 3 x IEEE half float: unit normal in eye space
+//                (0,0,0 where nothing was drawn)
+//      object  - uint8: the OBJ_* constant (OBJ_SLAB ... OBJ_ROOM) of
+//                the object covering the pixel, GBUFFER_NO_OBJECT if none
+//
+//  This code uses no GL, so readers need only this file.
+//
+
+#ifndef _GBUFFERFILE_H_
+#define _GBUFFERFILE_H_
+
+#include <stdint.h>
+
+// "GBUF" and the current layout version
+#define GBUFFER_MAGIC       0x46554247u
+#define GBUFFER_VERSION     1
+
+// frames start on this boundary; planes on GBUFFER_ALIGN
+#define GBUFFER_PAGE        4096
+#define GBUFFER_ALIGN       64
+
+// object plane value for background pixels
+#define GBUFFER_NO_OBJECT   255
+
+///
+// File header.  'magic' is written last, so a file whose header has
+// the right magic number is complete.
+///
+typedef struct GBufferHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;         // frame size in pixels
+    uint32_t height;
+    uint32_t frames;
+    uint32_t pad;
+    uint64_t frameStride;   // bytes from one frame to the next
+    uint64_t colorOffset;   // plane offsets from the start of a frame
+    uint64_t depthOffset;
+    uint64_t normalOffset;
+    uint64_t objectOffset;
+    float frustum[6];       // left, right, top, bottom, near, far
+} GBufferHeader;
+
+///
+// Per-frame record: the camera and object rotations it was rendered with
+///
+typedef struct GBufferView {
+    uint32_t frame;
+    float eye[3];
+    float lookAt[3];
+    float up[3];
+    float angles[24];       // per-object x,y,z rotations (finalMain)
+} GBufferView;
+
+///
+// A G-buffer file, mapped into memory
+///
+
+class GBufferFile {
+
+    void *base;
+    uint64_t length;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    GBufferFile( void );
+
+    ///
+    // Destructor - unmaps the file
+    ///
+    ~GBufferFile( void );
+
+    ///
+    // create(path,w,h,frames,frustum) - create (or replace) a file with
+    //     room for 'frames' frames and map it for writing
+    //
+    // @param path    - file name
+    // @param w       - frame width in pixels
+    // @param h       - frame height in pixels
+    // @param frames  - number of frames
+    // @param frustum - left, right, top, bottom, near and far
+    //
+    // @return true on success
+    ///
+    bool create( const char *path, int w, int h, int frames,
+                 const float *frustum );
+
+    ///
+    // open(path) - map an existing file for reading
+    //
+    // @return true on success
+    ///
+    bool open( const char *path );
+
+    ///
+    // close() - unmap the file
+    ///
+    void close( void );
+
+    ///
+    // header() - the file header, or NULL if not mapped
+    ///
+    GBufferHeader *header( void ) const;
+
+    ///
+    // view(frame) etc. - the parts of one frame
+    ///
+    GBufferView *view( int frame ) const;
+    unsigned char *color( int frame ) const;
+    float *depth( int frame ) const;
+    uint16_t *normal( int frame ) const;
+    unsigned char *objects( int frame ) const;
+
+};
+
+#endif
@@ -0,0 +1,176 @@
+//
+//  HalfEdge.cpp
+//
+//  Half-edge mesh implementation.
+//
+
+#include <algorithm>
+
+#include "HalfEdge.h"
+#include "Timing.h"
+
+using namespace std;
+
+// half-edges per work item
+#define HE_CHUNK    16384
+
+///
+// sortKeys(pool,keys,edges,bits) - stable radix sort of the low 'bits'
+//     bits of keys[0], carrying edges[0] along, 8 bits per pass.  Each
+//     pass counts the digits of every chunk on its own, so the chunks
+//     can be scattered at once without sharing a counter.
+//
+// @return which of the two buffers holds the result
+///
+static int sortKeys( ThreadPool &pool, vector<uint64_t> *keys,
+                     vector<uint32_t> *edges, int bits )
+{
+    int n = (int) keys[0].size();
+    int chunks = (n + HE_CHUNK - 1) / HE_CHUNK;
+    vector<uint32_t> offsets( 256 * (size_t) chunks );
+
+    int from = 0;
+    for( int shift = 0; shift < bits; shift += 8 ) {
+        int to = 1 - from;
+        const uint64_t *K = keys[from].data();
+        const uint32_t *E = edges[from].data();
+
+        pool.parallelFor( chunks, [&]( int c, int ) {
+            uint32_t *count = &offsets[256 * (size_t) c];
+            fill( count, count + 256, 0u );
+            for( int i = c * HE_CHUNK; i < min( n, (c + 1) * HE_CHUNK ); i++ ) {
+                count[(K[i] >> shift) & 0xff]++;
+            }
+        } );
+
+        // digit by digit, chunk by chunk: where each chunk's share of
+        // each digit starts
+        uint32_t start = 0;
+        for( int d = 0; d < 256; d++ ) {
+            for( int c = 0; c < chunks; c++ ) {
+                uint32_t count = offsets[256 * (size_t) c + d];
+                offsets[256 * (size_t) c + d] = start;
+                start += count;
+            }
+        }
+
+        pool.parallelFor( chunks, [&]( int c, int ) {
+            uint32_t *at = &offsets[256 * (size_t) c];
+            for( int i = c * HE_CHUNK; i < min( n, (c + 1) * HE_CHUNK ); i++ ) {
+                uint32_t p = at[(K[i] >> shift) & 0xff]++;
+                keys[to][p] = K[i];
+                edges[to][p] = E[i];
+            }
+        } );
+
+        from = to;
+    }
+    return from;
+}
+
+///
+// Constructor
+///
+HalfEdgeMesh::HalfEdgeMesh( void ) :
+    boundaryEdges(0), nonManifoldEdges(0), buildMs(0.0)
+{
+}
+
+///
+// build(pool,positions,vertices,indices,faces) - connect a mesh
+///
+void HalfEdgeMesh::build( ThreadPool &pool, const float *positions,
+                          int vertices, const uint32_t *indices, int faces )
+{
+    uint64_t startNs = monotonicNs();
+
+    x.resize( vertices );
+    y.resize( vertices );
+    z.resize( vertices );
+    for( int v = 0; v < vertices; v++ ) {
+        x[v] = positions[3 * (size_t) v];
+        y[v] = positions[3 * (size_t) v + 1];
+        z[v] = positions[3 * (size_t) v + 2];
+    }
+
+    int n = 3 * faces;
+    int chunks = (n + HE_CHUNK - 1) / HE_CHUNK;
+    origin.resize( n );
+    twin.assign( n, HE_NONE );
+
+    // key of an edge: its smaller vertex above its larger one
+    int vertexBits = 1;
+    while( vertexBits < 32 && (1u << vertexBits) < (uint32_t) vertices ) {
+        vertexBits++;
+    }
+    vector<uint64_t> keys[2];
+    vector<uint32_t> edges[2];
+    for( int k = 0; k < 2; k++ ) {
+        keys[k].resize( n );
+        edges[k].resize( n );
+    }
+    pool.parallelFor( chunks, [&]( int c, int ) {
+        for( int h = c * HE_CHUNK; h < min( n, (c + 1) * HE_CHUNK ); h++ ) {
+            uint32_t a = indices[h], b = indices[next( h )];
+            origin[h] = a;
+            keys[0][h] = (uint64_t) min( a, b ) << vertexBits | max( a, b );
+            edges[0][h] = h;
+        }
+    } );
+
+    int sorted = sortKeys( pool, keys, edges, 2 * vertexBits );
+    const uint64_t *K = keys[sorted].data();
+    const uint32_t *E = edges[sorted].data();
+
+    // pair up the half-edges of every edge; a chunk takes the edges
+    // whose first half-edge it holds, so no two write the same twin
+    vector<int> boundary( chunks, 0 ), nonManifold( chunks, 0 );
+    pool.parallelFor( chunks, [&]( int c, int ) {
+        int i = c * HE_CHUNK, end = min( n, (c + 1) * HE_CHUNK );
+        while( i > 0 && i < end && K[i] == K[i - 1] ) {
+            i++;
+        }
+        while( i < end ) {
+            int j = i + 1;
+            while( j < n && K[j] == K[i] ) {
+                j++;
+            }
+            if( j - i == 1 ) {
+                boundary[c]++;
+            } else if( j - i == 2 && origin[E[i]] != origin[E[i + 1]] ) {
+                twin[E[i]] = E[i + 1];
+                twin[E[i + 1]] = E[i];
+            } else {
+                nonManifold[c]++;
+            }
+            i = j;
+        }
+    } );
+
+    boundaryEdges = nonManifoldEdges = 0;
+    for( int c = 0; c < chunks; c++ ) {
+        boundaryEdges += boundary[c];
+        nonManifoldEdges += nonManifold[c];
+    }
+
+    // one pass, as it is short next to the sort: every vertex leaves
+    // along the boundary if it can
+    vertexEdge.assign( vertices, HE_NONE );
+    for( int h = 0; h < n; h++ ) {
+        uint32_t &V = vertexEdge[origin[h]];
+        if( V == HE_NONE || twin[h] == HE_NONE ) {
+            V = h;
+        }
+    }
+
+    buildMs = elapsedMs( startNs );
+}
+
+///
+// memoryBytes() - bytes held by the connectivity and positions
+///
+size_t HalfEdgeMesh::memoryBytes( void ) const
+{
+    return (x.size() + y.size() + z.size()) * sizeof(float) +
+           (vertexEdge.size() + origin.size() + twin.size()) * sizeof(uint32_t);
+}
@@ -0,0 +1,136 @@
+//
+//  HalfEdge.h
+//
+//  Half-edge connectivity of a triangle mesh, for the passes that need
+//  to know which triangles and vertices touch: smoothing, normals and
+//  simplification.
+//
+//  Everything is kept in flat arrays of 32-bit indices.  Face f owns
+//  half-edges 3f, 3f+1 and 3f+2, in the order of its corners, so the
+//  next and previous half-edge and the face are arithmetic and only
+//  the origin vertex and the opposite ('twin') half-edge are stored.
+//  Positions are kept as separate X, Y and Z arrays.
+//
+//  build() finds the twins without a hash map: every half-edge gets a
+//  key made of its two vertices, smaller one first, the keys are radix
+//  sorted on a ThreadPool, and the half-edges of each edge end up next
+//  to each other.  An edge with one half-edge is on the boundary; one
+//  with more than two, or two running the same way, is non-manifold,
+//  and its half-edges are all left without twins.
+//
+//  A vertex's 'vertexEdge' leaves it along the boundary if it is on
+//  one, so walking around it from there (forEachNeighbor()) meets
+//  every triangle of its fan exactly once.
+//
+
+#ifndef _HALFEDGE_H_
+#define _HALFEDGE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+// no half-edge: the twin of a boundary half-edge, the vertexEdge of an
+// unused vertex
+#define HE_NONE     0xffffffffu
+
+class HalfEdgeMesh {
+
+public:
+    // per vertex
+    vector<float> x, y, z;
+    vector<uint32_t> vertexEdge;    // an outgoing half-edge
+
+    // per half-edge
+    vector<uint32_t> origin;        // the vertex it leaves
+    vector<uint32_t> twin;          // the opposite one, or HE_NONE
+
+    // statistics of the last build()
+    int boundaryEdges, nonManifoldEdges;
+    double buildMs;
+
+    ///
+    // Constructor
+    ///
+    HalfEdgeMesh( void );
+
+    ///
+    // build(pool,positions,vertices,indices,faces) - connect a mesh
+    //
+    // @param pool      - the workers to build with
+    // @param positions - x, y, z of every vertex
+    // @param vertices  - number of vertices
+    // @param indices   - three vertex indices per triangle, each less
+    //                    than 'vertices'
+    // @param faces     - number of triangles
+    ///
+    void build( ThreadPool &pool, const float *positions, int vertices,
+                const uint32_t *indices, int faces );
+
+    int vertexCount( void ) const { return (int) vertexEdge.size(); }
+    int faceCount( void ) const { return (int) origin.size() / 3; }
+
+    // the next and previous half-edge around h's face, and the face
+    static uint32_t next( uint32_t h ) { return h % 3 == 2 ? h - 2 : h + 1; }
+    static uint32_t prev( uint32_t h ) { return h % 3 == 0 ? h + 2 : h - 1; }
+    static uint32_t face( uint32_t h ) { return h / 3; }
+
+    // the vertex h points at
+    uint32_t target( uint32_t h ) const { return origin[next( h )]; }
+
+    bool isBoundary( uint32_t h ) const { return twin[h] == HE_NONE; }
+
+    bool isBoundaryVertex( uint32_t v ) const {
+        return vertexEdge[v] != HE_NONE && twin[vertexEdge[v]] == HE_NONE;
+    }
+
+    ///
+    // forEachOutgoing(v,fn) - call fn(h) for every half-edge leaving v
+    //     (and so every face around it), in order around the vertex.
+    //     Only one fan of a non-manifold vertex is visited.
+    ///
+    template <class F> void forEachOutgoing( uint32_t v, F fn ) const {
+        uint32_t h = vertexEdge[v];
+        if( h == HE_NONE ) {
+            return;
+        }
+        uint32_t start = h;
+        do {
+            fn( h );
+            h = twin[prev( h )];
+        } while( h != HE_NONE && h != start );
+    }
+
+    ///
+    // forEachNeighbor(v,fn) - call fn(w) for every vertex w that shares
+    //     an edge with v, in order around it
+    ///
+    template <class F> void forEachNeighbor( uint32_t v, F fn ) const {
+        uint32_t h = vertexEdge[v];
+        if( h == HE_NONE ) {
+            return;
+        }
+        uint32_t start = h;
+        do {
+            fn( target( h ) );
+            uint32_t p = prev( h );
+            if( twin[p] == HE_NONE ) {
+                // the far end of a boundary fan
+                fn( origin[p] );
+                return;
+            }
+            h = twin[p];
+        } while( h != start );
+    }
+
+    ///
+    // memoryBytes() - bytes held by the connectivity and positions
+    ///
+    size_t memoryBytes( void ) const;
+
+};
+
+#endif
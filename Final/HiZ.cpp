@@ -0,0 +1,427 @@
+//
+//  HiZ.cpp
+//
+//  Software occlusion culling against a hierarchical depth buffer.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "HiZ.h"
+#include "Simd.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+// the mask of a block whose every center is covered
+#define HIZ_FULL_MASK   ((1 << (HIZ_BLOCK * HIZ_BLOCK)) - 1)
+
+///
+// sameFrame(a,b) - do two frames have the same camera and objects?
+///
+bool sameFrame( const HiZFrame &a, const HiZFrame &b )
+{
+    if( a.width != b.width || a.height != b.height ||
+        memcmp( a.viewProjection, b.viewProjection,
+                sizeof(a.viewProjection) ) != 0 ||
+        a.objects.size() != b.objects.size() ) {
+        return false;
+    }
+    for( size_t i = 0; i < a.objects.size(); i++ ) {
+        const HiZObject &A = a.objects[i], &B = b.objects[i];
+        if( A.occluder != B.occluder ||
+            memcmp( A.model, B.model, sizeof(A.model) ) != 0 ||
+            memcmp( A.boxMin, B.boxMin, sizeof(A.boxMin) ) != 0 ||
+            memcmp( A.boxMax, B.boxMax, sizeof(A.boxMax) ) != 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+// transformPoint(r,M,p) - r = M * (p,1)
+///
+static inline void transformPoint( float *r, const float *M, const float *p )
+{
+    for( int k = 0; k < 4; k++ ) {
+        r[k] = M[k] * p[0] + M[4 + k] * p[1] + M[8 + k] * p[2] + M[12 + k];
+    }
+}
+
+///
+// Constructor
+///
+HiZCuller::HiZCuller( void ) :
+    triangles(0), rasterMs(0.0), testMs(0.0), stride(0), pending(false),
+    stopping(false)
+{
+}
+
+///
+// Destructor
+///
+HiZCuller::~HiZCuller( void )
+{
+    if( worker.joinable() ) {
+        {
+            unique_lock<mutex> guard( lock );
+            stopping = true;
+        }
+        wake.notify_one();
+        worker.join();
+    }
+}
+
+///
+// work() - body of the worker thread
+///
+void HiZCuller::work( void )
+{
+    for( ;; ) {
+        {
+            unique_lock<mutex> guard( lock );
+            while( !stopping && !pending ) {
+                wake.wait( guard );
+            }
+            if( stopping ) {
+                return;
+            }
+        }
+
+        cull();
+
+        unique_lock<mutex> guard( lock );
+        pending = false;
+        done.notify_one();
+    }
+}
+
+///
+// start() - cull 'frame' on the worker thread
+///
+void HiZCuller::start( void )
+{
+    if( !worker.joinable() ) {
+        worker = thread( &HiZCuller::work, this );
+    }
+    {
+        unique_lock<mutex> guard( lock );
+        pending = true;
+    }
+    wake.notify_one();
+}
+
+///
+// wait() - wait for the frame start() began
+///
+void HiZCuller::wait( void )
+{
+    unique_lock<mutex> guard( lock );
+    while( pending ) {
+        done.wait( guard );
+    }
+}
+
+///
+// clear() - size the buffers for the frame's viewport and empty them
+///
+void HiZCuller::clear( void )
+{
+    int blocksX = (frame.width + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    int blocksY = (frame.height + HIZ_BLOCK - 1) / HIZ_BLOCK;
+    stride = (blocksX + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    depth.assign( (size_t) stride * blocksY, 1.0f );
+    masks.assign( depth.size(), 0 );
+    partial.assign( depth.size(), 0.0f );
+
+    levelWidth.assign( 1, blocksX );
+    levelHeight.assign( 1, blocksY );
+    while( levelWidth.back() > 1 || levelHeight.back() > 1 ) {
+        levelWidth.push_back( (levelWidth.back() + 1) / 2 );
+        levelHeight.push_back( (levelHeight.back() + 1) / 2 );
+    }
+    levels.resize( levelWidth.size() );
+}
+
+///
+// triangle(v) - rasterize one triangle, given in pixels and window
+//     depth, into the blocks
+///
+void HiZCuller::triangle( const float (*v)[4] )
+{
+    // counterclockwise, for edge functions that are positive inside
+    float area = (v[1][0] - v[0][0]) * (v[2][1] - v[0][1]) -
+                 (v[2][0] - v[0][0]) * (v[1][1] - v[0][1]);
+    if( !(fabsf( area ) > 1e-12f) ) {
+        return;
+    }
+    const float *p[3] = { v[0], area > 0.0f ? v[1] : v[2],
+                          area > 0.0f ? v[2] : v[1] };
+
+    // edge i runs from p[i] to p[i+1]: e = a*x + b*y + c, less the
+    // margin, at pixel centers; clipped triangles can reach far off
+    // the screen, so the planes are set up in double precision and
+    // only the steps across a row of blocks are left to floats
+    double ea[3], eb[3], ec[3];
+    for( int i = 0; i < 3; i++ ) {
+        const float *from = p[i], *to = p[(i + 1) % 3];
+        ea[i] = (double) from[1] - to[1];
+        eb[i] = (double) to[0] - from[0];
+        ec[i] = -(ea[i] * from[0] + eb[i] * from[1]) -
+                HIZ_EDGE_MARGIN * sqrt( ea[i] * ea[i] + eb[i] * eb[i] );
+    }
+
+    // depth plane z = za*x + zb*y + zc, and the most it grows from a
+    // block's first center to its others
+    double dx1 = (double) p[1][0] - p[0][0], dy1 = (double) p[1][1] - p[0][1];
+    double dx2 = (double) p[2][0] - p[0][0], dy2 = (double) p[2][1] - p[0][1];
+    double dz1 = (double) p[1][2] - p[0][2], dz2 = (double) p[2][2] - p[0][2];
+    double det = dx1 * dy2 - dx2 * dy1;
+    double za = (dz1 * dy2 - dz2 * dy1) / det;
+    double zb = (dx1 * dz2 - dx2 * dz1) / det;
+    double zc = p[0][2] - za * p[0][0] - zb * p[0][1];
+    double zGrow = (HIZ_BLOCK - 1) * (max( za, 0.0 ) + max( zb, 0.0 ));
+
+    // the blocks its bounding box touches
+    float loX = min( p[0][0], min( p[1][0], p[2][0] ) );
+    float hiX = max( p[0][0], max( p[1][0], p[2][0] ) );
+    float loY = min( p[0][1], min( p[1][1], p[2][1] ) );
+    float hiY = max( p[0][1], max( p[1][1], p[2][1] ) );
+    if( hiX < 0.0f || hiY < 0.0f || loX > frame.width ||
+        loY > frame.height ) {
+        return;
+    }
+    int bx0 = max( (int) loX, 0 ) / HIZ_BLOCK;
+    int by0 = max( (int) loY, 0 ) / HIZ_BLOCK;
+    int bx1 = min( (int) hiX, frame.width - 1 ) / HIZ_BLOCK;
+    int by1 = min( (int) hiY, frame.height - 1 ) / HIZ_BLOCK;
+
+    // each center's offset from a block's first, along every edge
+    float offset[3][HIZ_BLOCK * HIZ_BLOCK];
+    for( int s = 0; s < HIZ_BLOCK * HIZ_BLOCK; s++ ) {
+        for( int i = 0; i < 3; i++ ) {
+            offset[i][s] = (float) -(ea[i] * (s % HIZ_BLOCK) +
+                                     eb[i] * (s / HIZ_BLOCK));
+        }
+    }
+
+    SimdInt lanes = laneIndex();
+    SimdFloat lane = toFloat( lanes );
+    for( int by = by0; by <= by1; by++ ) {
+        double y = by * HIZ_BLOCK + 0.5;
+        for( int bx = bx0 - bx0 % SIMD_WIDTH; bx <= bx1; bx += SIMD_WIDTH ) {
+            SimdInt block = lanes + SimdInt( bx );
+            SimdMask inside = (block >= SimdInt( bx0 )) &
+                              (SimdInt( bx1 ) >= block);
+            double x = bx * HIZ_BLOCK + 0.5;
+
+            SimdFloat e[3];
+            for( int i = 0; i < 3; i++ ) {
+                e[i] = fmadd( lane, SimdFloat( (float) (ea[i] * HIZ_BLOCK) ),
+                              SimdFloat( (float) (ea[i] * x + eb[i] * y +
+                                                  ec[i]) ) );
+            }
+            SimdInt covered( 0 );
+            for( int s = 0; s < HIZ_BLOCK * HIZ_BLOCK; s++ ) {
+                SimdMask in = (e[0] >= SimdFloat( offset[0][s] )) &
+                              (e[1] >= SimdFloat( offset[1][s] )) &
+                              (e[2] >= SimdFloat( offset[2][s] ));
+                covered = covered | (asInt( in ) & SimdInt( 1 << s ));
+            }
+            covered = covered & asInt( inside );
+
+            // the triangle's farthest depth over each block, which only
+            // helps where it is nearer than the depth taken already
+            size_t at = (size_t) by * stride + bx;
+            SimdFloat z = fmadd( lane, SimdFloat( (float) (za * HIZ_BLOCK) ),
+                                 SimdFloat( (float) (za * x + zb * y + zc +
+                                                     zGrow) ) );
+            SimdFloat taken = loadFloat( &depth[at] );
+            SimdMask use = (covered > SimdInt( 0 )) & (z < taken);
+            if( !any( use ) ) {
+                continue;
+            }
+
+            SimdInt mask = loadInt( &masks[at] );
+            SimdFloat farthest = loadFloat( &partial[at] );
+            mask = select( use, mask | covered, mask );
+            farthest = select( use, max( farthest, z ), farthest );
+            SimdMask full = mask >= SimdInt( HIZ_FULL_MASK );
+            storeFloat( &depth[at],
+                        select( full, min( taken, farthest ), taken ) );
+            storeInt( &masks[at], select( full, SimdInt( 0 ), mask ) );
+            storeFloat( &partial[at],
+                        select( full, SimdFloat( 0.0f ), farthest ) );
+        }
+    }
+}
+
+///
+// rasterize(O) - rasterize an occluder, clipping its triangles to the
+//     near plane
+///
+void HiZCuller::rasterize( const HiZObject &O )
+{
+    const BufferSet &B = *O.occluder;
+    float M[16];
+    multiplyMatrices( M, frame.viewProjection, O.model );
+
+    for( int t = 0; t + 2 < B.numElements; t += 3 ) {
+        float clip[3][4];
+        int behind = 0;
+        for( int j = 0; j < 3; j++ ) {
+            transformPoint( clip[j], M, &B.points[4 * (t + j)] );
+            behind += clip[j][2] < -clip[j][3];
+        }
+        if( behind == 3 ) {
+            continue;
+        }
+
+        // the part in front of the near plane (z >= -w), at most four
+        // corners
+        float poly[4][4];
+        int corners = 0;
+        for( int j = 0; j < 3; j++ ) {
+            const float *a = clip[j], *b = clip[(j + 1) % 3];
+            float da = a[2] + a[3], db = b[2] + b[3];
+            if( da >= 0.0f ) {
+                memcpy( poly[corners++], a, sizeof(poly[0]) );
+            }
+            if( (da >= 0.0f) != (db >= 0.0f) ) {
+                float f = da / (da - db);
+                for( int k = 0; k < 4; k++ ) {
+                    poly[corners][k] = a[k] + f * (b[k] - a[k]);
+                }
+                corners++;
+            }
+        }
+
+        // to pixels and window depth
+        float screen[4][4];
+        for( int j = 0; j < corners; j++ ) {
+            float w = poly[j][3];
+            screen[j][0] = (poly[j][0] / w * 0.5f + 0.5f) * frame.width;
+            screen[j][1] = (poly[j][1] / w * 0.5f + 0.5f) * frame.height;
+            screen[j][2] = poly[j][2] / w * 0.5f + 0.5f;
+            screen[j][3] = 1.0f;
+        }
+        triangle( screen );
+        if( corners == 4 ) {
+            const float fan[3][4] = {
+                { screen[0][0], screen[0][1], screen[0][2], 1.0f },
+                { screen[2][0], screen[2][1], screen[2][2], 1.0f },
+                { screen[3][0], screen[3][1], screen[3][2], 1.0f }
+            };
+            triangle( fan );
+        }
+        triangles++;
+    }
+}
+
+///
+// buildLevels() - copy the blocks' depths to level 0 and reduce each
+//     level to the next by the farthest of 2x2 texels
+///
+void HiZCuller::buildLevels( void )
+{
+    levels[0].resize( (size_t) levelWidth[0] * levelHeight[0] );
+    for( int y = 0; y < levelHeight[0]; y++ ) {
+        memcpy( &levels[0][(size_t) y * levelWidth[0]],
+                &depth[(size_t) y * stride], levelWidth[0] * sizeof(float) );
+    }
+
+    for( size_t l = 1; l < levels.size(); l++ ) {
+        const vector<float> &below = levels[l - 1];
+        int bw = levelWidth[l - 1], bh = levelHeight[l - 1];
+        int w = levelWidth[l], h = levelHeight[l];
+        levels[l].resize( (size_t) w * h );
+        for( int y = 0; y < h; y++ ) {
+            int y0 = 2 * y, y1 = min( 2 * y + 1, bh - 1 );
+            for( int x = 0; x < w; x++ ) {
+                int x0 = 2 * x, x1 = min( 2 * x + 1, bw - 1 );
+                levels[l][(size_t) y * w + x] = max(
+                    max( below[(size_t) y0 * bw + x0], below[(size_t) y0 * bw + x1] ),
+                    max( below[(size_t) y1 * bw + x0], below[(size_t) y1 * bw + x1] ) );
+            }
+        }
+    }
+}
+
+///
+// hidden(O) - is an occludee's box behind the occluders everywhere?
+///
+bool HiZCuller::hidden( const HiZObject &O ) const
+{
+    float M[16];
+    multiplyMatrices( M, frame.viewProjection, O.model );
+
+    // the box's screen rectangle and nearest depth; a corner in front
+    // of the near plane leaves neither bounded
+    float loX = HUGE_VALF, hiX = -HUGE_VALF, loY = HUGE_VALF, hiY = -HUGE_VALF;
+    float nearest = HUGE_VALF;
+    for( int c = 0; c < 8; c++ ) {
+        float p[3] = { c & 1 ? O.boxMax[0] : O.boxMin[0],
+                       c & 2 ? O.boxMax[1] : O.boxMin[1],
+                       c & 4 ? O.boxMax[2] : O.boxMin[2] };
+        float q[4];
+        transformPoint( q, M, p );
+        if( !(q[3] > 0.0f) || q[2] < -q[3] ) {
+            return false;
+        }
+        float x = (q[0] / q[3] * 0.5f + 0.5f) * frame.width;
+        float y = (q[1] / q[3] * 0.5f + 0.5f) * frame.height;
+        loX = min( loX, x ); hiX = max( hiX, x );
+        loY = min( loY, y ); hiY = max( hiY, y );
+        nearest = min( nearest, q[2] / q[3] * 0.5f + 0.5f );
+    }
+    if( hiX < 0.0f || hiY < 0.0f || loX > frame.width ||
+        loY > frame.height ) {
+        return false;
+    }
+
+    // the blocks it covers, at the level where they are 2x2 at most
+    int bx0 = max( (int) floorf( loX ), 0 ) / HIZ_BLOCK;
+    int by0 = max( (int) floorf( loY ), 0 ) / HIZ_BLOCK;
+    int bx1 = min( (int) hiX, frame.width - 1 ) / HIZ_BLOCK;
+    int by1 = min( (int) hiY, frame.height - 1 ) / HIZ_BLOCK;
+    size_t l = 0;
+    while( l + 1 < levels.size() &&
+           ((bx1 >> l) - (bx0 >> l) > 1 || (by1 >> l) - (by0 >> l) > 1) ) {
+        l++;
+    }
+    float farthest = 0.0f;
+    for( int y = by0 >> l; y <= by1 >> l; y++ ) {
+        for( int x = bx0 >> l; x <= bx1 >> l; x++ ) {
+            farthest = max( farthest,
+                            levels[l][(size_t) y * levelWidth[l] + x] );
+        }
+    }
+    return nearest > farthest + HIZ_DEPTH_BIAS;
+}
+
+///
+// cull() - cull 'frame' on the calling thread
+///
+void HiZCuller::cull( void )
+{
+    uint64_t start = monotonicNs();
+    clear();
+    triangles = 0;
+    for( size_t i = 0; i < frame.objects.size(); i++ ) {
+        if( frame.objects[i].occluder != NULL ) {
+            rasterize( frame.objects[i] );
+        }
+    }
+    buildLevels();
+    rasterMs = elapsedMs( start );
+
+    start = monotonicNs();
+    occluded.assign( frame.objects.size(), 0 );
+    for( size_t i = 0; i < frame.objects.size(); i++ ) {
+        if( frame.objects[i].occluder == NULL ) {
+            occluded[i] = hidden( frame.objects[i] );
+        }
+    }
+    testMs = elapsedMs( start );
+}
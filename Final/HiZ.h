@@ -0,0 +1,153 @@
+//
+//  HiZ.h
+//
+//  Software occlusion culling: a few large objects, the occluders, are
+//  rasterized on the CPU into a low-resolution depth buffer, and the
+//  bounding box of every other object is tested against a hierarchy of
+//  its farthest depths before the object is drawn.
+//
+//  The buffer has one depth per HIZ_BLOCK x HIZ_BLOCK block of the
+//  viewport's pixels.  That depth must be no nearer than the occluders
+//  at any of the block's pixel centers, where GL samples, or an object
+//  seen through a gap between them would be left out.  So, as in masked
+//  occlusion culling, each block keeps a mask of the centers covered so
+//  far and the farthest depth of the triangles that covered them, and
+//  only takes that depth once the mask is full.  A center counts as
+//  covered when it is HIZ_EDGE_MARGIN pixels inside all three edges,
+//  so that GL's snapping of the vertices cannot uncover it; triangles
+//  are rasterized SIMD_WIDTH blocks at a time.
+//
+//  Each level above the buffer keeps the farthest depth of 2x2 texels
+//  of the one below.  A box is tested at the lowest level where its
+//  screen rectangle spans at most 2x2 texels, against the depth of its
+//  nearest corner; boxes reaching in front of the near plane are never
+//  culled.
+//
+//  A frame to cull (HiZFrame) is a snapshot of the camera and objects,
+//  so the culler can work on its own thread while the caller goes on:
+//  start() hands it the frame in 'frame', and wait() returns once the
+//  results are in 'occluded'.  cull() does the same on the calling
+//  thread.  The occluders' BufferSets must keep their CPU copies and
+//  not change while a frame is being culled.
+//
+
+#ifndef _HIZ_H_
+#define _HIZ_H_
+
+#include <condition_variable>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "Buffers.h"
+
+using namespace std;
+
+// pixels per block side
+#define HIZ_BLOCK           4
+
+// how far inside a triangle's edges, in pixels, a pixel center must be
+// to count as covered
+#define HIZ_EDGE_MARGIN     (1.0f / 128.0f)
+
+// how much nearer than the occluders (in window depth) a box must come
+// to be drawn, for the difference between this and GL's arithmetic
+#define HIZ_DEPTH_BIAS      1e-5f
+
+///
+// one object of a frame: an occluder to rasterize or an occludee to
+// test, with its model matrix and model-space bounding box
+///
+struct HiZObject {
+    const BufferSet *occluder;  // NULL for an occludee
+    float model[16];
+    float boxMin[3], boxMax[3];
+};
+
+///
+// everything the culler needs of a frame
+///
+struct HiZFrame {
+    int width, height;          // the viewport, in pixels
+    float viewProjection[16];
+    vector<HiZObject> objects;
+};
+
+///
+// sameFrame(a,b) - do two frames have the same camera, viewport and
+//     objects (so the results of one hold for the other)?
+///
+bool sameFrame( const HiZFrame &a, const HiZFrame &b );
+
+class HiZCuller {
+
+public:
+    // the frame being culled or last culled, and whether each of its
+    // objects was found hidden (occluders never are)
+    HiZFrame frame;
+    vector<char> occluded;
+
+    // cost of the last frame: triangles rasterized, and time spent
+    // rasterizing and testing
+    long triangles;
+    double rasterMs, testMs;
+
+    // farthest depth per block, and of 2x2 texels of the level below
+    // above it; each level's width and height
+    vector< vector<float> > levels;
+    vector<int> levelWidth, levelHeight;
+
+private:
+    // blocks per row, padded to a multiple of SIMD_WIDTH; per block,
+    // the depth taken so far, and the centers covered since and the
+    // farthest depth of the triangles that covered them
+    int stride;
+    vector<float> depth;
+    vector<int32_t> masks;
+    vector<float> partial;
+
+    // the worker thread and its handshake
+    thread worker;
+    mutex lock;
+    condition_variable wake, done;
+    bool pending, stopping;
+
+    void work( void );
+    void clear( void );
+    void rasterize( const HiZObject &O );
+    void triangle( const float (*v)[4] );
+    void buildLevels( void );
+    bool hidden( const HiZObject &O ) const;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    HiZCuller( void );
+
+    ///
+    // Destructor - stops and joins the worker thread
+    ///
+    ~HiZCuller( void );
+
+    ///
+    // cull() - cull 'frame' on the calling thread
+    ///
+    void cull( void );
+
+    ///
+    // start() - cull 'frame' on the worker thread; neither may be
+    //     touched until wait() returns
+    ///
+    void start( void );
+
+    ///
+    // wait() - wait for the frame start() began, if any
+    ///
+    void wait( void );
+
+};
+
+#endif
@@ -0,0 +1,118 @@
+//
+//  HiZBench.cpp
+//
+//  The Hi-Z culling benchmark (-hizbench; see Benchmarks.h): every
+//  object drawn against leaving out those the Hi-Z culler finds hidden.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Scene.h"
+#include "Shapes.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// hizBenchmark() - compare drawing every object with leaving out
+// those the Hi-Z culler finds hidden, from B.count cameras around the
+// table (each frame new, so culled as it is drawn) and over B.count
+// frames of the animation (culled a frame ahead): objects drawn and
+// left out, the culler's cost, time per frame, and whether the images
+// differ
+///
+void hizBenchmark( const BenchSettings &B )
+{
+    int poses = B.count;
+    const SceneParts &P = sceneParts();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    SceneView stillLife = sceneView(), V = stillLife;
+    RenderSettings S;
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+    vector<unsigned char> images[2];
+    offscreen.bind();
+
+    printf( "frames        hiz  drawn  hidden  hidden %%  ready  late"
+        "  triangles  cull ms  ms/frame\n" );
+    for( int run = 0; run < 2; run++ ) {
+        // frame f of this run
+        auto pose = [&]( int f ) {
+            if( run == 0 ) {
+                orbitCamera( f % 16, V.eye );
+                for( int i = 0; i < OBJ_ROOM; i++ ) {
+                    V.angles[i] = 15.0f * (f / 16);
+                }
+            } else {
+                memcpy( V.eye, stillLife.eye, sizeof(V.eye) );
+                for( int i = 0; i < OBJ_ROOM; i++ ) {
+                    V.angles[i] = ANIMATION_STEP * (f + 1);
+                }
+            }
+            setSceneView( V );
+        };
+        V.animating = run == 1;
+
+        for( int on = 0; on < 2; on++ ) {
+            S.hiz = on;
+            long drawn = 0, hidden = 0, triangles = 0;
+            long ready = sceneStats().hizReady;
+            long late = sceneStats().hizLate;
+            double cullMs = 0.0;
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int f = 0; f < poses; f++ ) {
+                pose( f );
+                display( S );
+                const SceneStats &D = sceneStats();
+                drawn += D.visibleObjects;
+                hidden += D.occludedObjects;
+                if( on ) {
+                    cullMs += D.hizCullMs;
+                    triangles += D.hizTriangles;
+                }
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / poses;
+            const SceneStats &D = sceneStats();
+            printf( "%-12s  %3s  %5.2f  %6.2f  %8.1f  %5ld  %4ld  %9ld"
+                "  %7.3f  %8.3f\n", run == 0 ? "around table" : "animation",
+                on ? "on" : "off", (double) drawn / poses,
+                (double) hidden / poses, 100.0 * hidden / (drawn + hidden),
+                D.hizReady - ready, D.hizLate - late, triangles / poses,
+                cullMs / poses, ms );
+        }
+
+        // the same frames, with and without
+        long differ = 0;
+        int posesDiffering = 0;
+        for( int f = 0; f < poses; f++ ) {
+            pose( f );
+            for( int on = 0; on < 2; on++ ) {
+                S.hiz = on;
+                display( S );
+                images[on].resize( frameBytes );
+                offscreen.readPixels( images[on].data() );
+            }
+            long pixels = 0;
+            for( size_t q = 0; q < frameBytes; q += 4 ) {
+                pixels += memcmp( &images[0][q], &images[1][q], 3 ) != 0;
+            }
+            differ += pixels;
+            posesDiffering += pixels > 0;
+        }
+        printf( "pixels that differ: %ld, in %d of %d frames\n", differ,
+            posesDiffering, poses );
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( stillLife );
+}
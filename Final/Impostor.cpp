@@ -0,0 +1,333 @@
+//
+//  Impostor.cpp
+//
+//  Impostor atlas implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "Impostor.h"
+#include "ShaderSetup.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+// depth of the texels no surface was seen at; impostor.frag leaves out
+// any below -2
+#define IMPOSTOR_EMPTY      -4.0f
+
+// pixels per side of the atlas
+#define IMPOSTOR_SIZE       (IMPOSTOR_VIEWS * IMPOSTOR_TILE)
+
+// fragment shader outputs, in draw buffer order
+static const char *outputs[] = { "bakeNormal", "bakeDepth" };
+
+static const GLenum drawBuffers[] = {
+    GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1
+};
+
+///
+// viewBasis(view,right,up,dir) - the direction a view looks from, the
+// unfolded octahedron's point at its tile's center, and the axes of
+// its image
+///
+static void viewBasis( int view, float *right, float *up, float *dir )
+{
+    float u = ((view % IMPOSTOR_VIEWS) + 0.5f) / IMPOSTOR_VIEWS * 2.0f - 1.0f;
+    float v = ((view / IMPOSTOR_VIEWS) + 0.5f) / IMPOSTOR_VIEWS * 2.0f - 1.0f;
+    float d[3] = { u, v, 1.0f - fabsf( u ) - fabsf( v ) };
+    if( d[2] < 0.0f ) {
+        d[0] = (1.0f - fabsf( v )) * (u >= 0.0f ? 1.0f : -1.0f);
+        d[1] = (1.0f - fabsf( u )) * (v >= 0.0f ? 1.0f : -1.0f);
+    }
+    float length = sqrtf( d[0] * d[0] + d[1] * d[1] + d[2] * d[2] );
+    for( int k = 0; k < 3; k++ ) {
+        dir[k] = d[k] / length;
+    }
+
+    // up is +Y, or +Z for the views from near the poles
+    float above[3] = { 0.0f, 1.0f, 0.0f };
+    if( fabsf( dir[1] ) > 0.99f ) {
+        above[1] = 0.0f;
+        above[2] = 1.0f;
+    }
+    right[0] = above[1] * dir[2] - above[2] * dir[1];
+    right[1] = above[2] * dir[0] - above[0] * dir[2];
+    right[2] = above[0] * dir[1] - above[1] * dir[0];
+    length = sqrtf( right[0] * right[0] + right[1] * right[1] +
+                    right[2] * right[2] );
+    for( int k = 0; k < 3; k++ ) {
+        right[k] /= length;
+    }
+    up[0] = dir[1] * right[2] - dir[2] * right[1];
+    up[1] = dir[2] * right[0] - dir[0] * right[2];
+    up[2] = dir[0] * right[1] - dir[1] * right[0];
+}
+
+///
+// halfWidth(from) - half the width, in radii, of the square that a view
+// from 'from' radii away cuts from the plane through the sphere's
+// center: the tangents to the sphere reach out that far
+///
+static float halfWidth( float from )
+{
+    return from / sqrtf( from * from - 1.0f );
+}
+
+///
+// nearestView(d) - the view whose tile the direction d falls in
+///
+static int nearestView( const float *d )
+{
+    float sum = fabsf( d[0] ) + fabsf( d[1] ) + fabsf( d[2] );
+    if( !(sum > 0.0f) ) {
+        return 0;
+    }
+    float u = d[0] / sum, v = d[1] / sum;
+    if( d[2] < 0.0f ) {
+        float folded = (1.0f - fabsf( v )) * (u >= 0.0f ? 1.0f : -1.0f);
+        v = (1.0f - fabsf( u )) * (v >= 0.0f ? 1.0f : -1.0f);
+        u = folded;
+    }
+    int i = (int) ((u * 0.5f + 0.5f) * IMPOSTOR_VIEWS);
+    int j = (int) ((v * 0.5f + 0.5f) * IMPOSTOR_VIEWS);
+    i = min( max( i, 0 ), IMPOSTOR_VIEWS - 1 );
+    j = min( max( j, 0 ), IMPOSTOR_VIEWS - 1 );
+    return j * IMPOSTOR_VIEWS + i;
+}
+
+///
+// makeTexture(internal,format,type) - an atlas-sized texture, sampled
+//     from the nearest texel so that no view bleeds into another
+///
+static GLuint makeTexture( GLenum internal, GLenum format, GLenum type )
+{
+    GLuint texture;
+
+    glGenTextures( 1, &texture );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glTexImage2D( GL_TEXTURE_2D, 0, internal, IMPOSTOR_SIZE, IMPOSTOR_SIZE,
+                  0, format, type, NULL );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+
+    return texture;
+}
+
+///
+// Constructor
+///
+Impostor::Impostor( void ) :
+    normals(0), depths(0), radius(-1.0f), distance(0.0f), view(0),
+    pixels(0.0f), bakeMs(0.0)
+{
+    center[0] = center[1] = center[2] = 0.0f;
+}
+
+///
+// bindOutputs(program) - assign fragment outputs and relink
+///
+bool Impostor::bindOutputs( GLuint program )
+{
+    GLint flag;
+
+    for( int i = 0; i < 2; i++ ) {
+        glBindFragDataLocation( program, i, outputs[i] );
+    }
+    glLinkProgram( program );
+    glGetProgramiv( program, GL_LINK_STATUS, &flag );
+    printProgramInfoLog( program );
+
+    return flag == GL_TRUE;
+}
+
+///
+// bindUnits(program) - point a program at the atlas textures' units
+///
+void Impostor::bindUnits( GLuint program )
+{
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "impostorNormals" ),
+                 IMPOSTOR_NORMAL_UNIT );
+    glUniform1i( glGetUniformLocation( program, "impostorDepths" ),
+                 IMPOSTOR_DEPTH_UNIT );
+}
+
+///
+// bake(program,B,from) - draw every view of an object into a new atlas
+///
+bool Impostor::bake( GLuint program, const BufferSet &B, float from )
+{
+    uint64_t start = monotonicNs();
+    release();
+    if( B.radius < 0.0f || B.nSize == 0 ) {
+        return false;
+    }
+    for( int k = 0; k < 3; k++ ) {
+        center[k] = B.center[k];
+    }
+    radius = B.radius;
+    distance = max( from, IMPOSTOR_MIN_DISTANCE );
+
+    GLint viewport[4], framebuffer;
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &framebuffer );
+
+    normals = makeTexture( GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE );
+    depths = makeTexture( GL_R16F, GL_RED, GL_FLOAT );
+    GLuint fbo, depth;
+    glGenRenderbuffers( 1, &depth );
+    glBindRenderbuffer( GL_RENDERBUFFER, depth );
+    glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                           IMPOSTOR_SIZE, IMPOSTOR_SIZE );
+    glGenFramebuffers( 1, &fbo );
+    glBindFramebuffer( GL_FRAMEBUFFER, fbo );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_TEXTURE_2D, normals, 0 );
+    glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1,
+                            GL_TEXTURE_2D, depths, 0 );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_RENDERBUFFER, depth );
+
+    GLenum status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+    if( status == GL_FRAMEBUFFER_COMPLETE ) {
+        static const GLfloat none[4] = { 0.5f, 0.5f, 0.5f, 0.0f };
+        static const GLfloat empty[4] = { IMPOSTOR_EMPTY, 0.0f, 0.0f, 0.0f };
+        static const GLfloat farDepth = 1.0f;
+        glDrawBuffers( 2, drawBuffers );
+        glClearBufferfv( GL_COLOR, 0, none );
+        glClearBufferfv( GL_COLOR, 1, empty );
+        glClearBufferfv( GL_DEPTH, 0, &farDepth );
+
+        glUseProgram( program );
+        glUniform3fv( glGetUniformLocation( program, "impostorCenter" ), 1,
+                      center );
+        glUniform1f( glGetUniformLocation( program, "impostorRadius" ),
+                     radius );
+        glUniform1f( glGetUniformLocation( program, "impostorDistance" ),
+                     distance );
+        glUniform1f( glGetUniformLocation( program, "impostorHalfWidth" ),
+                     halfWidth( distance ) );
+        for( int v = 0; v < IMPOSTOR_VIEWS * IMPOSTOR_VIEWS; v++ ) {
+            float right[3], up[3], dir[3];
+            viewBasis( v, right, up, dir );
+            glUniform3fv( glGetUniformLocation( program, "impostorRight" ),
+                          1, right );
+            glUniform3fv( glGetUniformLocation( program, "impostorUp" ),
+                          1, up );
+            glUniform3fv( glGetUniformLocation( program, "impostorDir" ),
+                          1, dir );
+            glViewport( (v % IMPOSTOR_VIEWS) * IMPOSTOR_TILE,
+                        (v / IMPOSTOR_VIEWS) * IMPOSTOR_TILE,
+                        IMPOSTOR_TILE, IMPOSTOR_TILE );
+            glDrawElements( GL_TRIANGLES, B.numElements, GL_UNSIGNED_INT,
+                            (void *) 0 );
+        }
+    } else {
+        cerr << "*** Impostor: atlas incomplete, status 0x" << hex <<
+            status << dec << endl;
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+    glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+    glDeleteFramebuffers( 1, &fbo );
+    glDeleteRenderbuffers( 1, &depth );
+    if( status != GL_FRAMEBUFFER_COMPLETE ) {
+        release();
+        return false;
+    }
+    bakeMs = elapsedMs( start );
+    return true;
+}
+
+///
+// choose(model,eye,pixelsPerUnit) - decide whether to draw the impostor
+///
+bool Impostor::choose( const float *model, const float *eye,
+                       float pixelsPerUnit )
+{
+    if( normals == 0 ) {
+        return false;
+    }
+
+    float scale, w[3];
+    float distance = sphereFromEye( model, eye, center, &scale, w );
+    if( distance <= radius * scale ) {
+        pixels = HUGE_VALF;     // the camera is inside it
+        return false;
+    }
+    pixels = 2.0f * radius * scale * pixelsPerUnit / distance;
+    if( pixels >= IMPOSTOR_PIXELS ) {
+        return false;
+    }
+
+    // the camera's direction in model space; the model matrix's axes
+    // are at right angles, so each is its own inverse's row, over its
+    // length squared
+    float d[3];
+    for( int k = 0; k < 3; k++ ) {
+        const float *axis = &model[4 * k];
+        d[k] = (axis[0] * w[0] + axis[1] * w[1] + axis[2] * w[2]) /
+               (axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    }
+    view = nearestView( d );
+    return true;
+}
+
+///
+// draw(program) - draw the quad of the view choose() picked
+///
+void Impostor::draw( GLuint program ) const
+{
+    glActiveTexture( GL_TEXTURE0 + IMPOSTOR_NORMAL_UNIT );
+    glBindTexture( GL_TEXTURE_2D, normals );
+    glActiveTexture( GL_TEXTURE0 + IMPOSTOR_DEPTH_UNIT );
+    glBindTexture( GL_TEXTURE_2D, depths );
+    glActiveTexture( GL_TEXTURE0 );
+
+    float right[3], up[3], dir[3];
+    viewBasis( view, right, up, dir );
+    GLfloat tile[2] = {
+        (GLfloat) (view % IMPOSTOR_VIEWS) / IMPOSTOR_VIEWS,
+        (GLfloat) (view / IMPOSTOR_VIEWS) / IMPOSTOR_VIEWS
+    };
+    glUniform3fv( glGetUniformLocation( program, "impostorCenter" ), 1,
+                  center );
+    glUniform1f( glGetUniformLocation( program, "impostorRadius" ), radius );
+    glUniform1f( glGetUniformLocation( program, "impostorDistance" ),
+                 distance );
+    glUniform1f( glGetUniformLocation( program, "impostorHalfWidth" ),
+                 halfWidth( distance ) );
+    glUniform3fv( glGetUniformLocation( program, "impostorRight" ), 1, right );
+    glUniform3fv( glGetUniformLocation( program, "impostorUp" ), 1, up );
+    glUniform3fv( glGetUniformLocation( program, "impostorDir" ), 1, dir );
+    glUniform2fv( glGetUniformLocation( program, "impostorTile" ), 1, tile );
+    glUniform1f( glGetUniformLocation( program, "impostorTileSize" ),
+                 1.0f / IMPOSTOR_VIEWS );
+    glDrawArrays( GL_TRIANGLE_STRIP, 0, 4 );
+}
+
+///
+// gpuBytes() - bytes of texture the atlas takes
+///
+long Impostor::gpuBytes( void ) const
+{
+    return normals == 0 ? 0 : (long) IMPOSTOR_SIZE * IMPOSTOR_SIZE * (4 + 2);
+}
+
+///
+// release() - delete the atlas
+///
+void Impostor::release( void )
+{
+    if( normals ) {
+        glDeleteTextures( 1, &normals );
+        glDeleteTextures( 1, &depths );
+    }
+    normals = depths = 0;
+}
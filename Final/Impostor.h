@@ -0,0 +1,158 @@
+//
+//  Impostor.h
+//
+//  Impostors for small, distant objects: an object is drawn once from
+//  each of IMPOSTOR_VIEWS x IMPOSTOR_VIEWS directions into a small
+//  atlas, and once it covers fewer than IMPOSTOR_PIXELS pixels across
+//  on the screen, a single quad sampling the view nearest the camera's
+//  is drawn in its place.
+//
+//  The directions cover the sphere around the object by an octahedral
+//  map: the octahedron |x| + |y| + |z| = 1 is folded flat onto the unit
+//  square, and the direction of each tile's center is that of the
+//  octahedron's point there.  Each view looks at the object's bounding
+//  sphere from as far away as the camera usually is, so that its parts
+//  are seen from the same angles they would be; the quad is the square
+//  the view's frustum cuts from the plane through the sphere's center,
+//  and fills its tile exactly.  (Orthographic views, as if from far
+//  away, show an object six radii from the camera from up to ten
+//  degrees too high at its top.)
+//
+//  The atlas keeps the surface rather than its colors: every texel has
+//  the model-space normal and ambient occlusion of the surface seen
+//  there, and in a second texture, how far in front of the quad the
+//  surface is.  impostor.frag finds the surface along the view's ray
+//  through the quad, shades it as phong.frag shades the mesh and puts
+//  it at its own depth, so the impostor is lit by the light of the
+//  frame and meets the surfaces around it as the mesh would.  The
+//  atlas therefore holds whatever the material or the light, and the
+//  object turns by choosing another view; it is baked once, and again
+//  only if the object's shape changes.
+//
+
+#ifndef _IMPOSTOR_H_
+#define _IMPOSTOR_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include "Buffers.h"
+
+// views per side of the atlas, and pixels per side of a view
+#define IMPOSTOR_VIEWS      8
+#define IMPOSTOR_TILE       64
+
+// objects narrower than this on the screen, in pixels, are drawn as
+// impostors; any wider and the views would be magnified
+#define IMPOSTOR_PIXELS     ((float) IMPOSTOR_TILE)
+
+// least distance, in radii, a view may be baked from
+#define IMPOSTOR_MIN_DISTANCE   2.0f
+
+// texture units of the normals and the depths
+#define IMPOSTOR_NORMAL_UNIT    3
+#define IMPOSTOR_DEPTH_UNIT     4
+
+class Impostor {
+
+public:
+    // the atlas textures: normal (RGB) and occlusion (A), and depth in
+    // front of the quad, as a share of the radius; 0 until baked
+    GLuint normals, depths;
+
+    // model-space bounding sphere the views are of, and how far from
+    // its center they were baked, in radii
+    float center[3], radius;
+    float distance;
+
+    // the view choose() picked last, and the object's width on the
+    // screen then, in pixels
+    int view;
+    float pixels;
+
+    // time the last bake() took
+    double bakeMs;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    Impostor( void );
+
+    ///
+    // bindOutputs(program) - assign the fragment shader outputs of a
+    //     program linked with impostorBake.frag to the atlas textures
+    //     and relink it
+    //
+    // @return true if the program linked
+    ///
+    static bool bindOutputs( GLuint program );
+
+    ///
+    // bindUnits(program) - point a program linked with impostor.frag at
+    //     the atlas textures' units
+    ///
+    static void bindUnits( GLuint program );
+
+    ///
+    // bake(program,B,from) - draw every view of an object into a new
+    //     atlas; B's buffers must be bound to the program (see
+    //     selectBuffers()), which is left in use.  The viewport and
+    //     framebuffer are put back as they were.
+    //
+    // @param program - a program linked with impostorBake.vert and
+    //                  impostorBake.frag (see bindOutputs())
+    // @param B       - the object's buffers, with normals
+    // @param from    - how far from the object the views look from,
+    //                  in multiples of its radius (at least
+    //                  IMPOSTOR_MIN_DISTANCE)
+    //
+    // @return true on success
+    ///
+    bool bake( GLuint program, const BufferSet &B, float from );
+
+    ///
+    // choose(model,eye,pixelsPerUnit) - decide whether to draw the
+    //     impostor, and pick the view nearest the camera's if so
+    //
+    // @param model         - the object's model matrix (column-major)
+    // @param eye           - the camera location
+    // @param pixelsPerUnit - pixels covered by one unit at unit
+    //                        distance from the camera
+    //
+    // @return true if the object is baked, the camera is outside its
+    //         sphere, and it is narrower than IMPOSTOR_PIXELS
+    ///
+    bool choose( const float *model, const float *eye,
+                 float pixelsPerUnit );
+
+    ///
+    // draw(program) - draw the quad of the view choose() picked; the
+    //     object's material and transformations must be set up
+    //
+    // @param program - a program linked with impostor.vert and
+    //                  impostor.frag
+    ///
+    void draw( GLuint program ) const;
+
+    ///
+    // gpuBytes() - bytes of texture the atlas takes
+    ///
+    long gpuBytes( void ) const;
+
+    ///
+    // release() - delete the atlas
+    ///
+    void release( void );
+
+};
+
+#endif
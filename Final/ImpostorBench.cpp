@@ -0,0 +1,92 @@
+//
+//  ImpostorBench.cpp
+//
+//  The impostor benchmark (-impostorbench; see Benchmarks.h): frames
+//  with and without impostors, smaller and smaller.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Impostor.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// impostorBenchmark() - time B.count frames with and without
+// impostors, smaller and smaller, and compare their images
+///
+void impostorBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+    bakeImpostors();
+
+    Framebuffer offscreen;
+    RenderSettings S;
+    vector<unsigned char> images[2];
+
+    printf( "frame    impostors  triangles  ms/frame     off %%  max diff"
+        "  drawn as impostors\n" );
+    for( int shrink = 1; shrink <= 8; shrink *= 2 ) {
+        int w = P.width / shrink, h = P.height / shrink;
+        if( !offscreen.resize( w, h ) ) {
+            break;
+        }
+        offscreen.bind();
+        size_t frameBytes = (size_t) w * h * 4;
+        for( int on = 0; on < 2; on++ ) {
+            S.impostors = on;
+            for( int i = 0; i < P.objectCount; i++ ) {
+                P.lods[i].current = 0;
+            }
+            display( S );   // warm-up
+            images[on].resize( frameBytes );
+            offscreen.readPixels( images[on].data() );
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int f = 0; f < frames; f++ ) {
+                display( S );
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / frames;
+            const SceneStats &D = sceneStats();
+            printf( "%3dx%-3d  %3s %5d  %9ld  %8.3f", w, h, on ? "on" : "off",
+                D.impostorObjects, D.drawnTriangles, ms );
+            if( !on ) {
+                printf( "\n" );
+                continue;
+            }
+
+            // the same frame with meshes and with impostors; the views
+            // are resampled, so only pixels more than 16 levels off count
+            long differ = 0;
+            int maxDiff = 0;
+            for( size_t q = 0; q < frameBytes; q += 4 ) {
+                int diff = 0;
+                for( int c = 0; c < 3; c++ ) {
+                    diff = max( diff,
+                                abs( images[0][q+c] - images[1][q+c] ) );
+                }
+                differ += diff > 16;
+                maxDiff = max( maxDiff, diff );
+            }
+            printf( "  %8.2f  %8d ", 100.0 * differ / (w * h), maxDiff );
+            for( int i = 0; i < P.objectCount; i++ ) {
+                const Impostor &I = P.impostors[i];
+                if( I.normals != 0 && I.pixels < IMPOSTOR_PIXELS ) {
+                    printf( " %s (%.0f px)", P.objects[i].name, I.pixels );
+                }
+            }
+            printf( "\n" );
+        }
+        offscreen.unbind( P.width, P.height );
+    }
+    offscreen.release();
+}
@@ -0,0 +1,113 @@
+//
+//  InstanceBench.cpp
+//
+//  The instancing benchmark (-instancebench; see Benchmarks.h): the
+//  objects made of copies drawn instanced and as one mesh.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Buffers.h"
+#include "Canvas.h"
+#include "Framebuffer.h"
+#include "Instances.h"
+#include "Scene.h"
+#include "Timing.h"
+#include "Vertex.h"
+
+using namespace std;
+
+///
+// instanceBenchmark() - compare drawing the objects made of copies
+// instanced with drawing them as one mesh: buffer memory, time per
+// draw over B.count draws, and whether the images differ
+///
+void instanceBenchmark( const BenchSettings &B )
+{
+    int draws = B.count;
+    const SceneParts &P = sceneParts();
+    Canvas &canvas = *P.canvas;
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+    vector<unsigned char> images[2];
+    setUpScene( P.phong, RenderSettings() );
+    offscreen.bind();
+
+    printf( "object  copies  triangles  error     one mesh KB  instanced KB"
+        "  ms/draw: one mesh  instanced  pixels differ  largest\n" );
+    for( int i = 0; i < P.objectCount; i++ ) {
+        const SceneObject &S = P.objects[i];
+        InstanceSet &I = P.instances[i];
+        if( I.instances == 0 ) {
+            continue;
+        }
+
+        // the object as one mesh again, as it was before build()
+        BufferSet &M = *S.buffers, full;
+        canvas.clear();
+        for( int c = 0; c < M.numElements; c += 3 ) {
+            Vertex p[3];
+            Normal n[3];
+            for( int k = 0; k < 3; k++ ) {
+                const float *q = &M.points[4 * (c + k)];
+                const float *m = &M.normals[3 * (c + k)];
+                p[k].x = q[0]; p[k].y = q[1]; p[k].z = q[2];
+                n[k].x = m[0]; n[k].y = m[1]; n[k].z = m[2];
+            }
+            canvas.addTriangleWithNorms( p[0], n[0], p[1], n[1], p[2],
+                                         n[2] );
+        }
+        full.createBuffers( canvas );
+        canvas.clear();
+        if( !M.occlusion.empty() ) {
+            full.addOcclusion( M.occlusion.data() );
+        }
+        long fullBytes = full.vSize + full.cSize + full.nSize + full.oSize +
+                         full.eSize;
+
+        double ms[2];
+        for( int instanced = 0; instanced < 2; instanced++ ) {
+            InstanceSet *set = instanced ? &I : NULL;
+            glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+            drawObject( P.phong, S.material, full, S.obj, NULL, set );
+            images[instanced].resize( frameBytes );
+            offscreen.readPixels( images[instanced].data() );
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int d = 0; d < draws; d++ ) {
+                drawObject( P.phong, S.material, full, S.obj, NULL, set );
+            }
+            glFinish();
+            ms[instanced] = elapsedMs( start ) / draws;
+        }
+        long differ = 0;
+        int largest = 0;
+        for( size_t p = 0; p < frameBytes; p += 4 ) {
+            int most = 0;
+            for( int k = 0; k < 3; k++ ) {
+                most = max( most,
+                            abs( images[0][p + k] - images[1][p + k] ) );
+            }
+            differ += most > 0;
+            largest = max( largest, most );
+        }
+        printf( "%-6s  %6d  %9d  %.1e  %11.1f  %12.1f  %17.3f  %9.3f"
+            "  %13ld  %7d\n", S.name, I.instances,
+            I.prototype.numElements / 3, I.error, fullBytes / 1024.0,
+            I.gpuBytes() / 1024.0, ms[0], ms[1], differ, largest );
+
+        glDeleteBuffers( 1, &full.vbuffer );
+        glDeleteBuffers( 1, &full.ebuffer );
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+}
@@ -0,0 +1,336 @@
+//
+//  Instances.cpp
+//
+//  Instanced drawing implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Instances.h"
+#include "Timing.h"
+
+using namespace std;
+
+// no corner yet
+#define INSTANCE_NONE   0xffffffffu
+
+///
+// root(parent,v) - the piece v is in, halving the path to it
+///
+static uint32_t root( vector<uint32_t> &parent, uint32_t v )
+{
+    while( parent[v] != v ) {
+        parent[v] = parent[parent[v]];
+        v = parent[v];
+    }
+    return v;
+}
+
+///
+// invert3(m,r) - invert a 3x3 matrix (row by row)
+//
+// @return false if it is singular
+///
+static bool invert3( const double *m, double *r )
+{
+    r[0] = m[4] * m[8] - m[5] * m[7];
+    r[1] = m[2] * m[7] - m[1] * m[8];
+    r[2] = m[1] * m[5] - m[2] * m[4];
+    r[3] = m[5] * m[6] - m[3] * m[8];
+    r[4] = m[0] * m[8] - m[2] * m[6];
+    r[5] = m[2] * m[3] - m[0] * m[5];
+    r[6] = m[3] * m[7] - m[4] * m[6];
+    r[7] = m[1] * m[6] - m[0] * m[7];
+    r[8] = m[0] * m[4] - m[1] * m[3];
+    double det = m[0] * r[0] + m[1] * r[3] + m[2] * r[6];
+    if( fabs( det ) < 1e-300 ) {
+        return false;
+    }
+    for( int i = 0; i < 9; i++ ) {
+        r[i] /= det;
+    }
+    return true;
+}
+
+///
+// Constructor
+///
+InstanceSet::InstanceSet( void ) :
+    instances(0), transformBuffer(0), transformTexture(0),
+    occlusionBuffer(0), occlusionTexture(0), error(0.0f), buildMs(0.0)
+{
+}
+
+///
+// build(vertexOf,B,C) - find the copies in an object and make the
+// buffers to draw them with
+///
+bool InstanceSet::build( const vector<unsigned int> &vertexOf,
+                         const BufferSet &B, Canvas &C )
+{
+    uint64_t start = monotonicNs();
+    instances = 0;
+    transforms.clear();
+    occlusion.clear();
+    error = 0.0f;
+    int corners = B.numElements;
+    if( corners < 3 || (int) vertexOf.size() != corners ||
+        B.normals.empty() || !B.uv.empty() ) {
+        buildMs = elapsedMs( start );
+        return false;
+    }
+
+    // join the vertices of every triangle; every vertex's first corner
+    uint32_t vertices = 1 + *max_element( vertexOf.begin(), vertexOf.end() );
+    vector<uint32_t> parent( vertices ), cornerOf( vertices, INSTANCE_NONE );
+    for( uint32_t v = 0; v < vertices; v++ ) {
+        parent[v] = v;
+    }
+    for( int c = 0; c < corners; c++ ) {
+        uint32_t v = vertexOf[c];
+        if( cornerOf[v] == INSTANCE_NONE ) {
+            cornerOf[v] = c;
+        }
+        if( c % 3 != 0 ) {
+            parent[root( parent, v )] = root( parent, vertexOf[c - c % 3] );
+        }
+    }
+
+    // the vertices of every piece, in order, and its place in its piece
+    // of every vertex; pieces numbered by their first vertex
+    vector<int> pieceOf( vertices, -1 );
+    vector<uint32_t> place( vertices );
+    vector< vector<uint32_t> > pieces;
+    for( uint32_t v = 0; v < vertices; v++ ) {
+        if( cornerOf[v] == INSTANCE_NONE ) {
+            continue;       // used by no triangle
+        }
+        uint32_t r = root( parent, v );
+        if( pieceOf[r] < 0 ) {
+            pieceOf[r] = (int) pieces.size();
+            pieces.push_back( vector<uint32_t>() );
+        }
+        vector<uint32_t> &piece = pieces[pieceOf[r]];
+        place[v] = (uint32_t) piece.size();
+        piece.push_back( v );
+    }
+    if( pieces.size() < 2 ) {
+        buildMs = elapsedMs( start );
+        return false;
+    }
+    const vector<uint32_t> &first = pieces[0];
+    size_t count = first.size();
+
+    // the prototype, centered for the fits, and its size
+    double center[3] = { 0.0, 0.0, 0.0 }, S[9] = { 0.0 }, Sinv[9];
+    for( size_t k = 0; k < count; k++ ) {
+        const float *p = &B.points[4 * cornerOf[first[k]]];
+        for( int j = 0; j < 3; j++ ) {
+            center[j] += p[j] / count;
+        }
+    }
+    double size = 0.0;
+    for( size_t k = 0; k < count; k++ ) {
+        const float *p = &B.points[4 * cornerOf[first[k]]];
+        double d[3] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+        for( int a = 0; a < 3; a++ ) {
+            for( int b = 0; b < 3; b++ ) {
+                S[3 * a + b] += d[a] * d[b];
+            }
+        }
+        size = max( size, sqrt( d[0] * d[0] + d[1] * d[1] + d[2] * d[2] ) );
+    }
+    if( !invert3( S, Sinv ) ) {
+        buildMs = elapsedMs( start );
+        return false;   // flat: no one transformation fits
+    }
+
+    // fit every piece, vertex k to the prototype's vertex k: A = R S^-1
+    // for R the sum of q p^T, both centered
+    vector<float> texels;
+    vector<double> fits;
+    for( size_t i = 0; i < pieces.size(); i++ ) {
+        const vector<uint32_t> &piece = pieces[i];
+        if( piece.size() != count ) {
+            buildMs = elapsedMs( start );
+            return false;
+        }
+        double q0[3] = { 0.0, 0.0, 0.0 }, R[9] = { 0.0 };
+        for( size_t k = 0; k < count; k++ ) {
+            const float *q = &B.points[4 * cornerOf[piece[k]]];
+            for( int j = 0; j < 3; j++ ) {
+                q0[j] += q[j] / count;
+            }
+        }
+        for( size_t k = 0; k < count; k++ ) {
+            const float *p = &B.points[4 * cornerOf[first[k]]];
+            const float *q = &B.points[4 * cornerOf[piece[k]]];
+            for( int a = 0; a < 3; a++ ) {
+                for( int b = 0; b < 3; b++ ) {
+                    R[3 * a + b] += (q[a] - q0[a]) * (p[b] - center[b]);
+                }
+            }
+        }
+        double A[9], Ainv[9], offset[3];
+        for( int a = 0; a < 3; a++ ) {
+            for( int b = 0; b < 3; b++ ) {
+                A[3 * a + b] = R[3 * a] * Sinv[b] + R[3 * a + 1] * Sinv[3 + b] +
+                               R[3 * a + 2] * Sinv[6 + b];
+            }
+        }
+        if( !invert3( A, Ainv ) ) {
+            buildMs = elapsedMs( start );
+            return false;
+        }
+        for( int a = 0; a < 3; a++ ) {
+            offset[a] = q0[a] - (A[3 * a] * center[0] + A[3 * a + 1] * center[1] +
+                                 A[3 * a + 2] * center[2]);
+        }
+
+        // rows of A and the offset, then rows of A^-T
+        for( int a = 0; a < 3; a++ ) {
+            texels.push_back( (float) A[3 * a] );
+            texels.push_back( (float) A[3 * a + 1] );
+            texels.push_back( (float) A[3 * a + 2] );
+            texels.push_back( (float) offset[a] );
+        }
+        for( int a = 0; a < 3; a++ ) {
+            texels.push_back( (float) Ainv[a] );
+            texels.push_back( (float) Ainv[3 + a] );
+            texels.push_back( (float) Ainv[6 + a] );
+            texels.push_back( 0.0f );
+        }
+        fits.insert( fits.end(), A, A + 9 );
+        fits.insert( fits.end(), Ainv, Ainv + 9 );
+        fits.insert( fits.end(), offset, offset + 3 );
+    }
+
+    // every corner must be where the fit of its piece puts the
+    // prototype's vertex, with its normal turned the same way
+    for( int c = 0; c < corners; c++ ) {
+        uint32_t v = vertexOf[c];
+        const double *A = &fits[21 * pieceOf[root( parent, v )]];
+        const double *Ainv = A + 9, *offset = A + 18;
+        uint32_t pc = cornerOf[first[place[v]]];
+        const float *p = &B.points[4 * pc], *q = &B.points[4 * c];
+        const float *n = &B.normals[3 * pc], *m = &B.normals[3 * c];
+        double far = 0.0, turned[3], length = 0.0, along = 0.0;
+        for( int a = 0; a < 3; a++ ) {
+            double d = A[3 * a] * p[0] + A[3 * a + 1] * p[1] +
+                       A[3 * a + 2] * p[2] + offset[a] - q[a];
+            far += d * d;
+            turned[a] = Ainv[a] * n[0] + Ainv[3 + a] * n[1] +
+                        Ainv[6 + a] * n[2];
+            length += turned[a] * turned[a];
+            along += turned[a] * m[a];
+        }
+        along /= sqrt( length * (m[0] * m[0] + m[1] * m[1] + m[2] * m[2]) );
+        far = sqrt( far );
+        if( far > INSTANCE_TOLERANCE * size ||
+            !(along >= INSTANCE_NORMAL_COSINE) ) {
+            buildMs = elapsedMs( start );
+            return false;
+        }
+        error = max( error, (float) far );
+    }
+    instances = (int) pieces.size();
+    transforms.swap( texels );
+
+    // the prototype is the first piece's triangles as they are; every
+    // copy's occlusion in the prototype's corner order, taken from its
+    // vertices' first corners (the prototype's own exactly)
+    C.clear();
+    vector<uint32_t> own;
+    for( int c = 0; c < corners; c += 3 ) {
+        if( pieceOf[root( parent, vertexOf[c] )] != 0 ) {
+            continue;
+        }
+        Vertex p[3];
+        Normal n[3];
+        for( int k = 0; k < 3; k++ ) {
+            const float *q = &B.points[4 * (c + k)];
+            const float *m = &B.normals[3 * (c + k)];
+            p[k].x = q[0]; p[k].y = q[1]; p[k].z = q[2];
+            n[k].x = m[0]; n[k].y = m[1]; n[k].z = m[2];
+            own.push_back( c + k );
+        }
+        C.addTriangleWithNorms( p[0], n[0], p[1], n[1], p[2], n[2] );
+    }
+    prototype.createBuffers( C );
+    C.clear();
+    occlusion.resize( own.size() * instances );
+    for( int i = 0; i < instances; i++ ) {
+        for( size_t j = 0; j < own.size(); j++ ) {
+            uint32_t c = i == 0 ? own[j] :
+                         cornerOf[pieces[i][place[vertexOf[own[j]]]]];
+            float value = B.occlusion.empty() ? 1.0f : B.occlusion[c];
+            occlusion[i * own.size() + j] =
+                (unsigned char) (min( max( value, 0.0f ), 1.0f ) * 255.0f + 0.5f);
+        }
+    }
+
+    // the texture buffers
+    if( transformBuffer == 0 ) {
+        glGenBuffers( 1, &transformBuffer );
+        glGenBuffers( 1, &occlusionBuffer );
+        glGenTextures( 1, &transformTexture );
+        glGenTextures( 1, &occlusionTexture );
+    }
+    glBindBuffer( GL_TEXTURE_BUFFER, transformBuffer );
+    glBufferData( GL_TEXTURE_BUFFER, transforms.size() * sizeof(float),
+                  transforms.data(), GL_STATIC_DRAW );
+    glBindBuffer( GL_TEXTURE_BUFFER, occlusionBuffer );
+    glBufferData( GL_TEXTURE_BUFFER, occlusion.size(), occlusion.data(),
+                  GL_STATIC_DRAW );
+    glBindBuffer( GL_TEXTURE_BUFFER, 0 );
+    glBindTexture( GL_TEXTURE_BUFFER, transformTexture );
+    glTexBuffer( GL_TEXTURE_BUFFER, GL_RGBA32F, transformBuffer );
+    glBindTexture( GL_TEXTURE_BUFFER, occlusionTexture );
+    glTexBuffer( GL_TEXTURE_BUFFER, GL_R8, occlusionBuffer );
+    glBindTexture( GL_TEXTURE_BUFFER, 0 );
+
+    buildMs = elapsedMs( start );
+    return true;
+}
+
+///
+// gpuBytes() - bytes of buffers drawing the copies takes
+///
+long InstanceSet::gpuBytes( void ) const
+{
+    return prototype.vSize + prototype.cSize + prototype.nSize +
+           prototype.eSize + (long) (transforms.size() * sizeof(float)) +
+           (long) occlusion.size();
+}
+
+///
+// draw(program) - draw every copy
+///
+void InstanceSet::draw( GLuint program ) const
+{
+    glActiveTexture( GL_TEXTURE0 + INSTANCE_TRANSFORM_UNIT );
+    glBindTexture( GL_TEXTURE_BUFFER, transformTexture );
+    glActiveTexture( GL_TEXTURE0 + INSTANCE_OCCLUSION_UNIT );
+    glBindTexture( GL_TEXTURE_BUFFER, occlusionTexture );
+    glActiveTexture( GL_TEXTURE0 );
+
+    GLint cornersLoc = glGetUniformLocation( program, "instanceCorners" );
+    glUniform1i( cornersLoc, prototype.numElements );
+    glDrawElementsInstanced( GL_TRIANGLES, prototype.numElements,
+                             GL_UNSIGNED_INT, (void *) 0, instances );
+    glUniform1i( cornersLoc, 0 );
+}
+
+///
+// bindUnits(program) - point a program's copy samplers at their units
+///
+void InstanceSet::bindUnits( GLuint program )
+{
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "instanceTransforms" ),
+                 INSTANCE_TRANSFORM_UNIT );
+    glUniform1i( glGetUniformLocation( program, "instanceOcclusion" ),
+                 INSTANCE_OCCLUSION_UNIT );
+}
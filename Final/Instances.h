@@ -0,0 +1,129 @@
+//
+//  Instances.h
+//
+//  Instanced drawing of objects made of copies of one part, such as the
+//  grapes: the part is kept once, as a prototype, and drawn once per
+//  copy with glDrawElementsInstanced() and the copy's transformation.
+//
+//  build() splits an object into its connected pieces by the vertex
+//  numbers of the .obj file it was read from, and takes the first
+//  piece as the prototype.  Every other piece must have as many
+//  vertices, and each of its corners must be, to within
+//  INSTANCE_TOLERANCE, where an affine transformation puts the
+//  prototype's vertex of the same rank, with close to the normal that
+//  transformation's inverse transpose gives.  The transformation is
+//  fitted by least squares to all the vertices, so copies that were
+//  scaled or sheared as well as moved are found too, as the grapes
+//  were.  The pieces' triangles need not match: the grapes' quads
+//  were split along different diagonals, and are all drawn as the
+//  prototype's are.
+//
+//  The copies' transformations, and the inverse transposes for their
+//  normals, are kept in a texture buffer that the vertex shaders read
+//  by gl_InstanceID; so is the ambient occlusion of every copy's
+//  corners, which differs from copy to copy and so cannot be part of
+//  the prototype.  The vertex shaders' uniform 'instanceCorners' says
+//  how many corners a copy has, 0 when not drawing instances; they are
+//  linked with INSTANCE_PLACEMENT, whose placeCopy() reads all three.
+//  The object's own BufferSet keeps its CPU copies, for everything that
+//  works on the whole object, but need not keep its vertex buffer.
+//
+
+#ifndef _INSTANCES_H_
+#define _INSTANCES_H_
+
+#include <vector>
+
+#include "Buffers.h"
+#include "Canvas.h"
+
+using namespace std;
+
+// how far a corner may be from its place, as a share of the
+// prototype's size, and the least cosine of the angle between its
+// normal and the one turned from the prototype (the grapes' own normals
+// were made again after each copy was shaped, and are up to 1.6
+// degrees off)
+#define INSTANCE_TOLERANCE          1e-4f
+#define INSTANCE_NORMAL_COSINE      0.999f
+
+// RGBA texels per copy: the transformation's three rows, and those of
+// its inverse transpose
+#define INSTANCE_TEXELS             6
+
+// texture units of the transformations and the occlusion
+#define INSTANCE_TRANSFORM_UNIT     1
+#define INSTANCE_OCCLUSION_UNIT     2
+
+// vertex shader with placeCopy(), linked into every vertex shader that
+// draws copies (see shaderSetupSharedVertex())
+#define INSTANCE_PLACEMENT          "instancePlacement.vert"
+
+class InstanceSet {
+
+public:
+    // number of copies; 0 if the object is not made of them
+    int instances;
+
+    // the part, and every copy's texels and occlusion (one byte per
+    // prototype corner, copy by copy)
+    BufferSet prototype;
+    vector<float> transforms;
+    vector<unsigned char> occlusion;
+
+    // texture buffers holding them
+    GLuint transformBuffer, transformTexture;
+    GLuint occlusionBuffer, occlusionTexture;
+
+    // farthest any corner is from its place, in model units, and the
+    // time build() took
+    float error;
+    double buildMs;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    InstanceSet( void );
+
+    ///
+    // build(vertexOf,B,C) - find the copies in an object and make the
+    //     buffers to draw them with
+    //
+    // @param vertexOf - the .obj file's vertex number of every corner
+    //                   of B (see loadMeshData())
+    // @param B        - the object's buffers, with normals and without
+    //                   texture coordinates, and with its occlusion if
+    //                   any
+    // @param C        - a Canvas to build the prototype's buffers with
+    //
+    // @return true if the object is made of copies
+    ///
+    bool build( const vector<unsigned int> &vertexOf, const BufferSet &B,
+                Canvas &C );
+
+    ///
+    // gpuBytes() - bytes of buffers drawing the copies takes
+    ///
+    long gpuBytes( void ) const;
+
+    ///
+    // draw(program) - draw every copy; the prototype's buffers must be
+    //     bound (see selectBuffers()), and the program's units set up
+    //     (see bindUnits())
+    ///
+    void draw( GLuint program ) const;
+
+    ///
+    // bindUnits(program) - point a program's copy samplers at their
+    //     texture units; left at unit 0 they would clash with a 2D
+    //     texture there, and no draw would work
+    //
+    // @param program - a program linked with INSTANCE_PLACEMENT
+    ///
+    static void bindUnits( GLuint program );
+
+};
+
+#endif
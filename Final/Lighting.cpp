@@ -30,6 +30,134 @@ float lightSourceColor[4] = { 0.0, 0.0, 0.0, 1.0 };
 float lightSourcePosition[4] = { 0.0, 0.0, 0.0, 1.0 };
 float sceneAmbLightColor[4] = { 0.0, 0.0, 0.0, 1.0 };
 
+///
+// Object materials, in OBJ_* order (OBJ_SLAB is 0, OBJ_CHEESE 3, ...).
+//
+// format:	ambient, diffuse and specular colors;
+//			ambient, diffuse and specular coefficients, specular
+//			exponent, mirror coefficient; textured
+///
+static const Material materials[8] = {
+	// Slab
+	{ { 0.9, 0.6, 0.22, 0.1 },
+	  { 0.9, 0.6, 0.22, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.9, 0.8, 0.2, 1.0, 0.0, 0 },
+	// Cheese
+	{ { 0.855, 0.650, 0.125, 1.0 },
+	  { 1.000, 0.871, 0.650, 1.0 },
+	  { 1, 1, 1, 1.0 },
+	  0.5, 0.7, 0.1, 1.0, 0.0, 0 },
+	// Grapes
+	{ { 0.596078, 0.603922, 0.196078, 1.0 },
+	  { 0.603922, 0.503922, 0.196078, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.7, 0.9, 0.12, 9.0, 0.0, 0 },
+	// Glass
+	{ { 1, 0.980392, 0.980392, 1.0 },
+	  { 1, 0.980392, 0.980392, 1.0 },
+	  { 1.000, 1.000, 1.000, 1.0 },
+	  0.2, 0.8, 0.9, 7.0, 0.25, 0 },
+	// Bottle
+	{ { 0.2, 0.0, 0.0, 1.0 },
+	  { 0.2, 0.0, 0.0, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.4, 0.2, 5.0, 20.0, 0.35, 0 },
+	// Mug
+	{ { 0.496, 0.884, 0.996, 1.0 },
+	  { 0.796, 0.784, 0.696, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.30, 1.0, 1.0, 15.0, 0.0, 0 },
+	// Bottom (table cloth; colors come from the texture)
+	{ { 1.0, 1.0, 1.0, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.5, 0.2, 0.5, 9.0, 0.0, 1 },
+	// Room
+	{ { 0.855, 0.647, 0.125, 1.0 },
+	  { 0.055, 0.047, 0.025, 1.0 },
+	  { 1.0, 1.0, 1.0, 1.0 },
+	  0.2, 0.3, 0.8, 16.0, 0.0, 0 }
+};
+
+///
+// This function returns the material of an object.
+//
+// @param obj - one of the OBJ_* constants from Shapes.h
+///
+const Material *getMaterial( int obj )
+{
+	return &materials[obj / 3];
+}
+
+///
+// This function sends a material to a shader program.  The textured
+// material has no colors to send; its shader samples the cloth.
+//
+// @param program - The ID of an OpenGL (GLSL) shader program to which
+//    parameter values are to be sent
+// @param M - the material
+///
+void setUpMaterial( GLuint program, const Material *M )
+{
+	if( !M->textured ) {
+		glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, M->ambMatColor);
+		glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, M->diffMatColor);
+		glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, M->specMatColor);
+	}
+	
+	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), M->ambRefCoeff);
+	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), M->diffRefCoeff);
+	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), M->specRefCoeff);
+	glUniform1f(glGetUniformLocation(program, "specExponent"), M->specExponent);
+}
+
+///
+// This function combines a material with the light the way the shaders
+// do, for the CPU renderers.
+//
+// @param M - the material
+// @param lightColor - RGBA color of the light source
+// @param ambColor - RGBA color of the ambient light
+// @param ambient, diffuse, specular - receive the three RGBA terms
+///
+void shadingTerms( const Material *M, const float *lightColor,
+								const float *ambColor, float *ambient,
+								float *diffuse, float *specular )
+{
+	int c;
+
+	for( c = 0; c < 4; c++ ) {
+		float amb = M->textured ? 1.0f : M->ambMatColor[c];
+		float dif = M->textured ? 1.0f : M->diffMatColor[c];
+		float spec = M->textured ? 1.0f : M->specMatColor[c];
+		ambient[c] = amb * M->ambRefCoeff * ambColor[c];
+		diffuse[c] = dif * M->diffRefCoeff * lightColor[c];
+		specular[c] = spec * M->specRefCoeff * lightColor[c];
+	}
+}
+
+///
+// This function tells whether a material's specular term is too faint
+// to show under a light: whether even at the center of a highlight it
+// adds less than NEGLIGIBLE_SPECULAR to every channel.
+//
+// @param M - the material
+// @param lightColor - RGB color of the light source
+///
+int negligibleSpecular( const Material *M, const float *lightColor )
+{
+	int c;
+
+	for( c = 0; c < 3; c++ ) {
+		float spec = M->textured ? 1.0f : M->specMatColor[c];
+		if( spec * M->specRefCoeff * lightColor[c] >= NEGLIGIBLE_SPECULAR ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
 ///
 // This function sets up the light parameters.
 //
@@ -63,26 +191,7 @@ void setUpLight( GLuint program, float colorR, float colorG, float colorB,
 ///
 void setUpCheese( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.855, 0.650, 0.125, 1.0 };
-	float diffMatColor[] = { 1.000, 0.871, 0.650, 1.0 };
-	float specMatColor[] = {  1, 1, 1, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.5;
-	float diffRefCoeff = 0.7;
-	float specRefCoeff = 0.1;
-	float specExponent = 1.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[1] );
 }
 
 ///
@@ -94,26 +203,7 @@ void setUpCheese( GLuint program )
 ///
 void setUpSlab( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.9, 0.6, 0.22, 0.1 };
-	float diffMatColor[] = { 0.9, 0.6, 0.22, 1.0 };
-	float specMatColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.9;
-	float diffRefCoeff = 0.8;
-	float specRefCoeff = 0.2;
-	float specExponent = 1.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[0] );
 }
 
 ///
@@ -125,26 +215,7 @@ void setUpSlab( GLuint program )
 ///
 void setUpGrapes( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.596078, 0.603922, 0.196078, 1.0 };
-	float diffMatColor[] = { 0.603922, 0.503922, 0.196078, 1.0 };
-	float specMatColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.7;
-	float diffRefCoeff = 0.9;
-	float specRefCoeff = 0.12;
-	float specExponent = 9.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[2] );
 }
 
 ///
@@ -156,26 +227,7 @@ void setUpGrapes( GLuint program )
 ///
 void setUpGlass( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 1, 0.980392, 0.980392, 1.0 };
-	float diffMatColor[] = { 1, 0.980392, 0.980392, 1.0 };
-	float specMatColor[] = { 1.000, 1.000, 1.000, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.2;
-	float diffRefCoeff = 0.8;
-	float specRefCoeff = 0.9;
-	float specExponent = 7.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[3] );
 }
 
 ///
@@ -187,26 +239,7 @@ void setUpGlass( GLuint program )
 ///
 void setUpBottle( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.2, 0.0, 0.0, 1.0 };
-	float diffMatColor[] = { 0.2, 0.0, 0.0, 1.0 };
-	float specMatColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.4;
-	float diffRefCoeff = 0.2;
-	float specRefCoeff = 5.0;
-	float specExponent = 20.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[4] );
 }
 
 ///
@@ -218,26 +251,7 @@ void setUpBottle( GLuint program )
 ///
 void setUpMug( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.496, 0.884, 0.996, 1.0 };
-	float diffMatColor[] = { 0.796, 0.784, 0.696, 1.0 };
-	float specMatColor[] = { 1.0, 1.0, 1.0, 1.0 };
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.30;
-	float diffRefCoeff = 1.0;
-	float specRefCoeff = 1.0;
-	float specExponent = 15.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[5] );
 }
 
 ///
@@ -248,24 +262,20 @@ void setUpMug( GLuint program )
 //    parameter values are to be sent
 ///
 void setUpBottom( GLuint program )
-{	
-	//coefficients for lighting
-	float ambRefCoeff = 0.5;
-	float diffRefCoeff = 0.2;
-	float specRefCoeff = 0.5;
-	float specExponent = 9.0;
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
-	
-	GLuint cloth = SOIL_load_OGL_texture (
-        "newred.jpg", 
-         SOIL_LOAD_AUTO, 
-         SOIL_CREATE_NEW_ID, 
-         SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y |
-         SOIL_FLAG_TEXTURE_REPEATS); 
+{
+	setUpMaterial( program, &materials[6] );
+
+	// Load the cloth image only once; it used to be decoded and
+	// uploaded again (and leaked) every time the table was drawn.
+	static GLuint cloth = 0;
+	if( cloth == 0 ) {
+		cloth = SOIL_load_OGL_texture (
+			CLOTH_TEXTURE, 
+			 SOIL_LOAD_AUTO, 
+			 SOIL_CREATE_NEW_ID, 
+			 SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y |
+			 SOIL_FLAG_TEXTURE_REPEATS); 
+	}
     
     //Use and Bind cloth image    
 	glActiveTexture(GL_TEXTURE0);
@@ -283,24 +293,5 @@ void setUpBottom( GLuint program )
 ///
 void setUpRoom( GLuint program )
 {
-	//Object material colors for lighting
-	float ambMatColor[] = { 0.855, 0.647, 0.125, 1.0 };
-	float diffMatColor[] = { 0.055, 0.047, 0.025, 1.0 };
-	float specMatColor[] = { 1.0, 1.0, 1.0, 1.0};
-	
-	//coefficients for lighting
-	float ambRefCoeff = 0.2;
-	float diffRefCoeff = 0.3;
-	float specRefCoeff = 0.8;
-	float specExponent = 16.0;
-	
-	//Send values to Shaders
-	glUniform4fv(glGetUniformLocation(program, "ambMatColor"), 1, ambMatColor);
-	glUniform4fv(glGetUniformLocation(program, "diffMatColor"), 1, diffMatColor);
-	glUniform4fv(glGetUniformLocation(program, "specMatColor"), 1, specMatColor);
-	
-	glUniform1f(glGetUniformLocation(program, "ambRefCoeff"), ambRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "diffRefCoeff"), diffRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specRefCoeff"), specRefCoeff);
-	glUniform1f(glGetUniformLocation(program, "specExponent"), specExponent);
+	setUpMaterial( program, &materials[7] );
 }
@@ -23,6 +23,73 @@
 
 #include <GLFW/glfw3.h>
 
+// image file holding the table cloth texture
+#define CLOTH_TEXTURE "newred.jpg"
+
+// largest specular term that cannot change an 8-bit color channel
+#define NEGLIGIBLE_SPECULAR	(0.5f / 255.0f)
+
+///
+// Material colors and shading coefficients of one object.  The setUp*()
+// functions below send these to the shaders; the CPU renderers read
+// them through getMaterial().  A textured material (the table) takes
+// its colors from the cloth texture and ignores the three colors here.
+// Only the ray tracer uses mirrorCoeff, the fraction of the light from
+// the mirror direction that the surface reflects.
+///
+typedef struct Material {
+	float ambMatColor[4];
+	float diffMatColor[4];
+	float specMatColor[4];
+	float ambRefCoeff;
+	float diffRefCoeff;
+	float specRefCoeff;
+	float specExponent;
+	float mirrorCoeff;
+	int textured;
+} Material;
+
+///
+// This function returns the material of an object.
+//
+// @param obj - one of the OBJ_* constants from Shapes.h
+///
+const Material *getMaterial( int obj );
+
+///
+// This function sends a material to a shader program.
+//
+// @param program - The ID of an OpenGL (GLSL) shader program to which
+//    parameter values are to be sent
+// @param M - the material
+///
+void setUpMaterial( GLuint program, const Material *M );
+
+///
+// This function combines a material with the light the way the shaders
+// do, for the CPU renderers: a pixel's color is
+// ambient + diffuse * max(0,N.L) + specular * pow(max(0,V.R),exponent),
+// times the texture color for the textured material.
+//
+// @param M - the material
+// @param lightColor - RGBA color of the light source
+// @param ambColor - RGBA color of the ambient light
+// @param ambient, diffuse, specular - receive the three RGBA terms
+///
+void shadingTerms( const Material *M, const float *lightColor,
+								const float *ambColor, float *ambient,
+								float *diffuse, float *specular );
+
+///
+// This function tells whether a material's specular term is too faint
+// to show under a light: whether even at the center of a highlight it
+// adds less than NEGLIGIBLE_SPECULAR to every channel.
+//
+// @param M - the material
+// @param lightColor - RGB color of the light source
+///
+int negligibleSpecular( const Material *M, const float *lightColor );
+
 void setUpLight( GLuint program, float colorR, float colorG, float colorB,
 								float posX, float posY, float posZ,
 								float ambR, float ambG, float ambB);
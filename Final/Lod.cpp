@@ -0,0 +1,138 @@
+//
+//  Lod.cpp
+//
+//  Level of detail chain implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "Lod.h"
+#include "Simplify.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+///
+// Constructor
+///
+LodChain::LodChain( void ) :
+    levels(0), radius(0.0f), current(0), buildMs(0.0)
+{
+    for( int i = 0; i < LOD_LEVELS; i++ ) {
+        buffers[i] = NULL;
+        triangles[i] = 0;
+        error[i] = 0.0f;
+    }
+    center[0] = center[1] = center[2] = 0.0f;
+}
+
+///
+// build(full,fractions,count,C) - make the coarser levels of an object
+///
+void LodChain::build( BufferSet &full, const float *fractions, int count,
+                      Canvas &C )
+{
+    uint64_t start = monotonicNs();
+    int faces = full.numElements / 3;
+    levels = 1;
+    buffers[0] = &full;
+    triangles[0] = faces;
+    error[0] = 0.0f;
+    current = 0;
+
+    // the sphere around the middle of the box
+    float lo[3] = { 0.0f, 0.0f, 0.0f }, hi[3] = { 0.0f, 0.0f, 0.0f };
+    for( int i = 0; i < full.numElements; i++ ) {
+        const float *p = &full.points[4 * i];
+        for( int k = 0; k < 3; k++ ) {
+            lo[k] = i == 0 ? p[k] : min( lo[k], p[k] );
+            hi[k] = i == 0 ? p[k] : max( hi[k], p[k] );
+        }
+    }
+    float r2 = 0.0f;
+    for( int k = 0; k < 3; k++ ) {
+        center[k] = 0.5f * (lo[k] + hi[k]);
+    }
+    for( int i = 0; i < full.numElements; i++ ) {
+        const float *p = &full.points[4 * i];
+        float d[3] = { p[0] - center[0], p[1] - center[1], p[2] - center[2] };
+        r2 = max( r2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2] );
+    }
+    radius = sqrtf( r2 );
+
+    if( faces < LOD_MIN_TRIANGLES || full.normals.empty() || full.tSize ) {
+        buildMs = elapsedMs( start );
+        return;
+    }
+
+    MeshSimplifier S;
+    S.load( full.points.data(), 4, full.numElements );
+    vector<uint32_t> corners;
+    vector<float> positions;
+    for( int l = 0; l < count && levels < LOD_LEVELS; l++ ) {
+        int target = (int) (fractions[l] * faces);
+        if( S.simplify( target, LOD_MAX_ERROR * radius ) >=
+            triangles[levels - 1] ) {
+            break;      // nothing more comes off
+        }
+        S.result( corners, positions );
+
+        C.clear();
+        for( size_t c = 0; c < corners.size(); c += 3 ) {
+            Vertex p[3];
+            Normal n[3];
+            for( int k = 0; k < 3; k++ ) {
+                const float *q = &positions[3 * (c + k)];
+                const float *m = &full.normals[3 * (size_t) corners[c + k]];
+                p[k].x = q[0]; p[k].y = q[1]; p[k].z = q[2];
+                n[k].x = m[0]; n[k].y = m[1]; n[k].z = m[2];
+            }
+            C.addTriangleWithNorms( p[0], n[0], p[1], n[1], p[2], n[2] );
+        }
+        BufferSet &B = coarse[levels - 1];
+        B.createBuffers( C );
+        if( !full.occlusion.empty() ) {
+            vector<float> values( corners.size() );
+            for( size_t c = 0; c < corners.size(); c++ ) {
+                values[c] = full.occlusion[corners[c]];
+            }
+            B.addOcclusion( values.data() );
+        }
+
+        buffers[levels] = &B;
+        triangles[levels] = (int) corners.size() / 3;
+        error[levels] = (float) S.error;
+        levels++;
+    }
+    C.clear();
+    buildMs = elapsedMs( start );
+}
+
+///
+// select(model,eye,pixelsPerUnit) - choose the level to draw
+///
+int LodChain::select( const float *model, const float *eye,
+                      float pixelsPerUnit )
+{
+    float scale;
+    float distance = sphereFromEye( model, eye, center, &scale, NULL ) -
+                     radius * scale;
+    if( distance <= 0.0f ) {
+        current = 0;    // the camera is inside it
+        return current;
+    }
+
+    // pixels the surface of level l may be off by, at its nearest point
+    float pixels = scale * pixelsPerUnit / distance;
+    current = min( current, levels - 1 );
+    while( current > 0 && error[current] * pixels > LOD_PIXEL_ERROR ) {
+        current--;
+    }
+    while( current + 1 < levels &&
+           error[current + 1] * pixels <= LOD_PIXEL_ERROR * LOD_HYSTERESIS ) {
+        current++;
+    }
+    return current;
+}
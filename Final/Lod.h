@@ -0,0 +1,102 @@
+//
+//  Lod.h
+//
+//  Levels of detail for the scene's objects, and the choice between
+//  them at draw time.
+//
+//  build() makes a chain of coarser copies of an object's BufferSet
+//  with the MeshSimplifier (Simplify.h): each level goes on from the
+//  one before, down to a fraction of the full triangle count.  The
+//  corners of a coarse triangle keep the normal and occlusion of the
+//  corners they came from, so shading carries over.  Every level
+//  remembers how far the simplifier let the surface move.
+//
+//  select() projects that distance onto the screen, from the object's
+//  bounding sphere and the camera, and picks the coarsest level whose
+//  error stays under LOD_PIXEL_ERROR pixels.  To keep an object from
+//  flickering between two levels, it steps to a finer level as soon as
+//  its own is too coarse, but to a coarser one only once that one is
+//  well under the limit (LOD_HYSTERESIS).
+//
+
+#ifndef _LOD_H_
+#define _LOD_H_
+
+#include "Buffers.h"
+#include "Canvas.h"
+
+// most levels in a chain, the full object included
+#define LOD_LEVELS          4
+
+// objects with fewer triangles get no coarser levels
+#define LOD_MIN_TRIANGLES   500
+
+// most error of any level, as a share of the object's bounding radius
+#define LOD_MAX_ERROR       0.05f
+
+// most screen-space error, in pixels, of the level drawn
+#define LOD_PIXEL_ERROR     1.0f
+
+// how far under LOD_PIXEL_ERROR a coarser level must be to switch to it
+#define LOD_HYSTERESIS      0.75f
+
+class LodChain {
+
+public:
+    // number of levels (1 if there are no coarser ones), each level's
+    // buffers ([0] is the object's own), triangles and model-space error
+    int levels;
+    BufferSet *buffers[LOD_LEVELS];
+    int triangles[LOD_LEVELS];
+    float error[LOD_LEVELS];
+
+    // model-space bounding sphere
+    float center[3], radius;
+
+    // the level select() chose last
+    int current;
+
+    // time taken by the last build()
+    double buildMs;
+
+private:
+    BufferSet coarse[LOD_LEVELS - 1];
+
+public:
+
+    ///
+    // Constructor
+    ///
+    LodChain( void );
+
+    ///
+    // build(full,fractions,count,C) - make the coarser levels of an
+    //     object; textured objects and those with fewer than
+    //     LOD_MIN_TRIANGLES triangles get none, and a level stops
+    //     short of its fraction rather than err by more than
+    //     LOD_MAX_ERROR
+    //
+    // @param full      - the object's buffers, with normals
+    // @param fractions - the share of full's triangles each level keeps,
+    //                    largest first
+    // @param count     - number of fractions (at most LOD_LEVELS - 1)
+    // @param C         - a Canvas to build the levels' buffers with
+    ///
+    void build( BufferSet &full, const float *fractions, int count,
+                Canvas &C );
+
+    ///
+    // select(model,eye,pixelsPerUnit) - choose the level to draw
+    //
+    // @param model         - the object's model matrix (column-major)
+    // @param eye           - the camera location
+    // @param pixelsPerUnit - pixels covered by one unit at unit
+    //                        distance from the camera
+    //
+    // @return the level, also left in 'current'
+    ///
+    int select( const float *model, const float *eye, float pixelsPerUnit );
+
+};
+
+#endif
@@ -0,0 +1,84 @@
+//
+//  LodBench.cpp
+//
+//  The level of detail benchmark (-lodbench; see Benchmarks.h): frames
+//  with and without the levels of detail, with the camera further and
+//  further away.
+//
+
+#include <cstdio>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Lod.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// lodBenchmark() - time B.count frames with and without the levels of
+// detail, with the camera further and further away
+///
+void lodBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    printf( "levels of detail, built in" );
+    double buildMs = 0.0;
+    for( int i = 0; i < P.objectCount; i++ ) {
+        buildMs += P.lods[i].buildMs;
+    }
+    printf( " %.1f ms:\n", buildMs );
+    for( int i = 0; i < P.objectCount; i++ ) {
+        const LodChain &L = P.lods[i];
+        printf( "  %-6s", P.objects[i].name );
+        for( int l = 0; l < L.levels; l++ ) {
+            printf( "  %6d (%.1e)", L.triangles[l], L.error[l] );
+        }
+        printf( "\n" );
+    }
+
+    SceneView stillLife = sceneView(), V = stillLife;
+    RenderSettings S;
+    offscreen.bind();
+
+    printf( "distance  lod  triangles  ms/frame  Mtriangles/s  levels\n" );
+    for( int d = 1; d <= 8; d *= 2 ) {
+        for( int k = 0; k < 3; k++ ) {
+            V.eye[k] = V.lookAt[k] + d * (stillLife.eye[k] - V.lookAt[k]);
+        }
+        setSceneView( V );
+        for( int on = 0; on < 2; on++ ) {
+            S.lod = on;
+            for( int i = 0; i < P.objectCount; i++ ) {
+                P.lods[i].current = 0;
+            }
+            display( S );   // warm-up
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int f = 0; f < frames; f++ ) {
+                display( S );
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / frames;
+            long triangles = sceneStats().drawnTriangles;
+
+            printf( "%7dx  %3s  %9ld  %8.3f  %12.1f ", d, on ? "on" : "off",
+                triangles, ms, triangles / (ms * 1000.0) );
+            for( int i = 0; i < P.objectCount; i++ ) {
+                printf( " %d", on ? P.lods[i].current : 0 );
+            }
+            printf( "\n" );
+        }
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( stillLife );
+}
@@ -0,0 +1,105 @@
+//
+//  MeshBench.cpp
+//
+//  The half-edge benchmark (-meshbench; see Benchmarks.h): building the
+//  connectivity of a mesh, and one-ring queries with it.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "HalfEdge.h"
+#include "Scene.h"
+#include "Shapes.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "Vertex.h"
+
+using namespace std;
+
+///
+// meshBenchmark() - build the half-edge connectivity of the .obj file
+// B.path and report its cost, and the speed of one-ring queries with it
+// and by scanning the triangle list
+///
+void meshBenchmark( const BenchSettings &B )
+{
+    const char *path = B.path;
+    vector<float> positions;
+    vector<unsigned int> indices;
+    uint64_t start = monotonicNs();
+    if( !loadMeshData( path, positions, indices ) ) {
+        return;
+    }
+    double loadMs = elapsedMs( start );
+    int vertices = (int) positions.size() / 3;
+    int faces = (int) indices.size() / 3;
+    for( size_t i = 0; i < indices.size(); i++ ) {
+        if( indices[i] >= (unsigned int) vertices ) {
+            cerr << path << ": vertex index out of range" << endl;
+            return;
+        }
+    }
+
+    ThreadPool pool( sceneParts().cpuThreads );
+    HalfEdgeMesh M;
+    // the first build is a warm-up
+    M.build( pool, positions.data(), vertices, indices.data(), faces );
+    M.build( pool, positions.data(), vertices, indices.data(), faces );
+
+    // the loader's own arrays: a Vertex per position, one index each
+    // for a triangle corner's position and normal
+    size_t flatBytes = vertices * sizeof(Vertex) + 2 * indices.size() *
+                       sizeof(unsigned int);
+
+    printf( "%s: %d vertices, %d triangles, read in %.1f ms\n", path,
+        vertices, faces, loadMs );
+    printf( "half-edges built in %.2f ms on %d threads, %.1f KB"
+        " (loader arrays %.1f KB)\n", M.buildMs, pool.size(),
+        M.memoryBytes() / 1024.0, flatBytes / 1024.0 );
+    printf( "%d boundary edges, %d non-manifold edges\n", M.boundaryEdges,
+        M.nonManifoldEdges );
+
+    // every vertex's one-ring
+    long neighbors = 0;
+    int boundaryVertices = 0;
+    start = monotonicNs();
+    for( int v = 0; v < vertices; v++ ) {
+        M.forEachNeighbor( v, [&]( uint32_t ) { neighbors++; } );
+        boundaryVertices += M.isBoundaryVertex( v );
+    }
+    double ringMs = elapsedMs( start );
+
+    // the same for a few vertices, scanning all the triangles
+    int sample = min( vertices, 64 );
+    long scanned = 0;
+    start = monotonicNs();
+    for( int s = 0; s < sample; s++ ) {
+        unsigned int v = (unsigned int) ((long) s * vertices / sample);
+        vector<unsigned int> ring;
+        for( int f = 0; f < faces; f++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                if( indices[3 * f + k] != v ) {
+                    continue;
+                }
+                for( int j = 1; j < 3; j++ ) {
+                    unsigned int w = indices[3 * f + (k + j) % 3];
+                    if( find( ring.begin(), ring.end(), w ) == ring.end() ) {
+                        ring.push_back( w );
+                    }
+                }
+            }
+        }
+        scanned += ring.size();
+    }
+    double scanMs = elapsedMs( start );
+
+    printf( "one-ring: %.2f neighbors on average, %d boundary vertices;"
+        " %.0f ns per vertex (%.1f us scanning the triangles)\n",
+        (double) neighbors / max( vertices, 1 ), boundaryVertices,
+        1.0e6 * ringMs / max( vertices, 1 ),
+        1000.0 * scanMs / max( sample, 1 ) );
+}
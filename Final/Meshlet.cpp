@@ -0,0 +1,527 @@
+//
+//  Meshlet.cpp
+//
+//  Meshlet implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "Meshlet.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+// how much a candidate triangle's bend away from the cluster's normals
+// counts against it, in new vertices
+#define MESHLET_CONE_WEIGHT 4.0f
+
+///
+// spread(v) - spread the low ten bits of v three bits apart
+///
+static uint32_t spread( uint32_t v )
+{
+    v &= 0x3ff;
+    v = (v | (v << 16)) & 0x030000ff;
+    v = (v | (v << 8))  & 0x0300f00f;
+    v = (v | (v << 4))  & 0x030c30c3;
+    v = (v | (v << 2))  & 0x09249249;
+    return v;
+}
+
+///
+// weld(key,width,vertexOf) - number the runs of equal keys, in sorted
+// order
+//
+// @param key      - 'width' floats per item
+// @param vertexOf - receives every item's number
+//
+// @return the first item of every run
+///
+static vector<uint32_t> weld( const vector<float> &key, int width,
+                              vector<uint32_t> &vertexOf )
+{
+    int count = (int) (key.size() / width);
+    size_t bytes = width * sizeof(float);
+    vector<uint32_t> order( count ), first;
+    for( int i = 0; i < count; i++ ) {
+        order[i] = i;
+    }
+    sort( order.begin(), order.end(),
+          [&]( uint32_t a, uint32_t b ) {
+              int d = memcmp( &key[(size_t) a * width], &key[(size_t) b * width],
+                              bytes );
+              return d != 0 ? d < 0 : a < b;
+          } );
+    vertexOf.resize( count );
+    for( int i = 0; i < count; i++ ) {
+        uint32_t c = order[i];
+        if( i == 0 || memcmp( &key[(size_t) order[i - 1] * width],
+                              &key[(size_t) c * width], bytes ) != 0 ) {
+            first.push_back( c );
+        }
+        vertexOf[c] = (uint32_t) first.size() - 1;
+    }
+    return first;
+}
+
+///
+// cutsNear(a,b,c,frustum) - does the near plane cut a triangle (in eye
+// space) inside the view?
+///
+static bool cutsNear( const float *a, const float *b, const float *c,
+                      const float *frustum )
+{
+    const float *p[3] = { a, b, c };
+    float n = frustum[4], s[3];
+    for( int k = 0; k < 3; k++ ) {
+        s[k] = -p[k][2] - n;
+    }
+    if( (s[0] >= 0.0f && s[1] >= 0.0f && s[2] >= 0.0f) ||
+        (s[0] < 0.0f && s[1] < 0.0f && s[2] < 0.0f) ) {
+        return false;
+    }
+
+    // the segment the plane cuts out of it...
+    float x[2], y[2];
+    int found = 0;
+    for( int k = 0; k < 3 && found < 2; k++ ) {
+        int j = (k + 1) % 3;
+        if( (s[k] < 0.0f) != (s[j] < 0.0f) ) {
+            float t = s[k] / (s[k] - s[j]);
+            x[found] = p[k][0] + t * (p[j][0] - p[k][0]);
+            y[found] = p[k][1] + t * (p[j][1] - p[k][1]);
+            found++;
+        }
+    }
+
+    // ...clipped to the near plane's rectangle (Liang-Barsky)
+    float dx = x[1] - x[0], dy = y[1] - y[0];
+    float edge[4][2] = {
+        { -dx, x[0] - frustum[0] }, { dx, frustum[1] - x[0] },
+        { -dy, y[0] - frustum[3] }, { dy, frustum[2] - y[0] }
+    };
+    float t0 = 0.0f, t1 = 1.0f;
+    for( int k = 0; k < 4; k++ ) {
+        float q = edge[k][0], r = edge[k][1];
+        if( q == 0.0f ) {
+            if( r < 0.0f ) {
+                return false;
+            }
+        } else if( q < 0.0f ) {
+            t0 = max( t0, r / q );
+        } else {
+            t1 = min( t1, r / q );
+        }
+    }
+    return t0 <= t1;
+}
+
+///
+// Constructor
+///
+MeshletSet::MeshletSet( void ) :
+    ebuffer(0), uniqueVertices(0), closed(false), buildMs(0.0),
+    frustumCulled(0), coneCulled(0), drawnTriangles(0), source(NULL)
+{
+}
+
+///
+// build(B) - cluster the triangles of a BufferSet and make the element
+// buffer
+///
+void MeshletSet::build( const BufferSet &B )
+{
+    uint64_t start = monotonicNs();
+    int corners = B.numElements;
+    int faces = corners / 3;
+    meshlets.clear();
+    indices.clear();
+    source = &B;
+
+    // weld the corners whose attributes all match, for the vertex
+    // cache, and those at the same position, to tell if it is closed
+    vector<float> key;
+    int width = 4 + (B.normals.empty() ? 0 : 3) + (B.uv.empty() ? 0 : 2) +
+                (B.occlusion.empty() ? 0 : 1);
+    key.reserve( (size_t) corners * width );
+    for( int c = 0; c < corners; c++ ) {
+        key.insert( key.end(), &B.points[4 * c], &B.points[4 * c + 4] );
+        if( !B.normals.empty() ) {
+            key.insert( key.end(), &B.normals[3 * c], &B.normals[3 * c + 3] );
+        }
+        if( !B.uv.empty() ) {
+            key.insert( key.end(), &B.uv[2 * c], &B.uv[2 * c + 2] );
+        }
+        if( !B.occlusion.empty() ) {
+            key.push_back( B.occlusion[c] );
+        }
+    }
+    vector<uint32_t> vertexOf, positionOf;
+    vector<uint32_t> cornerOf = weld( key, width, vertexOf );
+    uniqueVertices = (int) cornerOf.size();
+    key.clear();
+    for( int c = 0; c < corners; c++ ) {
+        key.insert( key.end(), &B.points[4 * c], &B.points[4 * c + 3] );
+    }
+    weld( key, 3, positionOf );
+    vector<float>().swap( key );
+
+    // every triangle's facing, and its edges, turned with it
+    vector<float> facing( 3 * (size_t) faces, 0.0f );
+    vector<uint64_t> edges;
+    for( int t = 0; t < faces; t++ ) {
+        const float *p0 = &B.points[12 * t];
+        const float *p1 = p0 + 4, *p2 = p0 + 8;
+        float e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+        float e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+        float *n = &facing[3 * t];
+        n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+        n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+        n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+        float length = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        if( length == 0.0f ) {
+            continue;   // degenerate: it faces nowhere
+        }
+        if( !B.normals.empty() ) {
+            const float *m = &B.normals[9 * t];
+            float agree = n[0] * (m[0] + m[3] + m[6]) +
+                          n[1] * (m[1] + m[4] + m[7]) +
+                          n[2] * (m[2] + m[5] + m[8]);
+            if( agree < 0.0f ) {
+                length = -length;
+            }
+        }
+        n[0] /= length; n[1] /= length; n[2] /= length;
+
+        const uint32_t *v = &positionOf[3 * t];
+        if( v[0] == v[1] || v[1] == v[2] || v[2] == v[0] ) {
+            continue;
+        }
+        for( int k = 0; k < 3; k++ ) {
+            uint64_t a = v[k], b = v[(k + 1) % 3];
+            edges.push_back( length > 0.0f ? (a << 32) | b : (b << 32) | a );
+        }
+    }
+
+    // closed, with every edge between two triangles that turn the same
+    // way: then any triangle facing away from a camera is behind one
+    // facing it, if the camera is on the side the normals face
+    sort( edges.begin(), edges.end() );
+    closed = !edges.empty();
+    for( size_t i = 0; i < edges.size() && closed; i++ ) {
+        uint64_t reverse = (edges[i] << 32) | (edges[i] >> 32);
+        closed = (i + 1 == edges.size() || edges[i + 1] != edges[i]) &&
+                 binary_search( edges.begin(), edges.end(), reverse );
+    }
+
+    // the triangles around every vertex
+    vector<uint32_t> firstAround( uniqueVertices + 1, 0 ), around( corners );
+    for( int c = 0; c < corners; c++ ) {
+        firstAround[vertexOf[c] + 1]++;
+    }
+    for( int v = 0; v < uniqueVertices; v++ ) {
+        firstAround[v + 1] += firstAround[v];
+    }
+    vector<uint32_t> fill( firstAround.begin(), firstAround.end() - 1 );
+    for( int c = 0; c < corners; c++ ) {
+        around[fill[vertexOf[c]]++] = c / 3;
+    }
+
+    // seeds in Morton order of the triangles' centroids, so each new
+    // cluster starts next to the ones before it
+    float lo[3], hi[3];
+    for( int k = 0; k < 3; k++ ) {
+        lo[k] = hi[k] = corners > 0 ? B.points[k] : 0.0f;
+    }
+    for( int c = 0; c < corners; c++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            lo[k] = min( lo[k], B.points[4 * c + k] );
+            hi[k] = max( hi[k], B.points[4 * c + k] );
+        }
+    }
+    vector<uint64_t> seeds( faces );
+    for( int t = 0; t < faces; t++ ) {
+        uint32_t code = 0;
+        for( int k = 0; k < 3; k++ ) {
+            const float *p = &B.points[12 * t + k];
+            float mid = (p[0] + p[4] + p[8]) / 3.0f;
+            float extent = hi[k] - lo[k];
+            uint32_t cell = extent > 0.0f ?
+                            (uint32_t) ((mid - lo[k]) / extent * 1023.0f) : 0;
+            code |= spread( cell ) << k;
+        }
+        seeds[t] = ((uint64_t) code << 32) | (uint32_t) t;
+    }
+    sort( seeds.begin(), seeds.end() );
+
+    // grow the clusters; stamps tell which vertices and candidates
+    // belong to the one being grown
+    vector<bool> used( faces, false );
+    vector<int> vertexStamp( uniqueVertices, -1 ), faceStamp( faces, -1 );
+    vector<uint32_t> members, candidates;
+    for( int s = 0; s < faces; s++ ) {
+        uint32_t seed = (uint32_t) seeds[s];
+        if( used[seed] ) {
+            continue;
+        }
+        int id = (int) meshlets.size();
+        Meshlet M;
+        M.firstIndex = (uint32_t) indices.size();
+        M.triangles = M.vertices = 0;
+        float sum[3] = { 0.0f, 0.0f, 0.0f };
+        members.clear();
+        candidates.clear();
+
+        uint32_t next = seed;
+        while( true ) {
+            // take it
+            used[next] = true;
+            members.push_back( next );
+            M.triangles++;
+            const float *n = &facing[3 * next];
+            sum[0] += n[0]; sum[1] += n[1]; sum[2] += n[2];
+            for( int k = 0; k < 3; k++ ) {
+                uint32_t v = vertexOf[3 * next + k];
+                if( vertexStamp[v] != id ) {
+                    vertexStamp[v] = id;
+                    M.vertices++;
+                }
+                for( uint32_t a = firstAround[v]; a < firstAround[v + 1]; a++ ) {
+                    uint32_t t = around[a];
+                    if( !used[t] && faceStamp[t] != id ) {
+                        faceStamp[t] = id;
+                        candidates.push_back( t );
+                    }
+                }
+            }
+            if( M.triangles == MESHLET_TRIANGLES ) {
+                break;
+            }
+
+            // the neighbor that adds the fewest vertices and bends least
+            float length = sqrtf( sum[0] * sum[0] + sum[1] * sum[1] +
+                                  sum[2] * sum[2] );
+            float axis[3] = { 0.0f, 0.0f, 0.0f };
+            if( length > 0.0f ) {
+                axis[0] = sum[0] / length;
+                axis[1] = sum[1] / length;
+                axis[2] = sum[2] / length;
+            }
+            int best = -1;
+            float bestScore = 0.0f;
+            size_t kept = 0;
+            for( size_t i = 0; i < candidates.size(); i++ ) {
+                uint32_t t = candidates[i];
+                if( used[t] ) {
+                    continue;
+                }
+                candidates[kept++] = t;
+                int added = 0;
+                for( int k = 0; k < 3; k++ ) {
+                    added += vertexStamp[vertexOf[3 * t + k]] != id;
+                }
+                if( M.vertices + added > MESHLET_VERTICES ) {
+                    continue;
+                }
+                const float *m = &facing[3 * t];
+                float score = added + MESHLET_CONE_WEIGHT *
+                    (1.0f - (axis[0] * m[0] + axis[1] * m[1] + axis[2] * m[2]));
+                if( best < 0 || score < bestScore ) {
+                    best = (int) t;
+                    bestScore = score;
+                }
+            }
+            candidates.resize( kept );
+            if( best < 0 ) {
+                break;
+            }
+            next = (uint32_t) best;
+        }
+
+        // its indices and bounds: the sphere around the middle of its box,
+        // and the cone of its normals
+        float mlo[3], mhi[3];
+        for( size_t i = 0; i < members.size(); i++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                uint32_t c = 3 * members[i] + k;
+                indices.push_back( cornerOf[vertexOf[c]] );
+                const float *p = &B.points[4 * c];
+                for( int j = 0; j < 3; j++ ) {
+                    mlo[j] = i + k == 0 ? p[j] : min( mlo[j], p[j] );
+                    mhi[j] = i + k == 0 ? p[j] : max( mhi[j], p[j] );
+                }
+            }
+        }
+        float r2 = 0.0f;
+        for( int j = 0; j < 3; j++ ) {
+            M.center[j] = 0.5f * (mlo[j] + mhi[j]);
+        }
+        for( uint32_t i = M.firstIndex; i < indices.size(); i++ ) {
+            const float *p = &B.points[4 * indices[i]];
+            float d[3] = { p[0] - M.center[0], p[1] - M.center[1],
+                           p[2] - M.center[2] };
+            r2 = max( r2, d[0] * d[0] + d[1] * d[1] + d[2] * d[2] );
+        }
+        M.radius = sqrtf( r2 );
+
+        float length = sqrtf( sum[0] * sum[0] + sum[1] * sum[1] +
+                              sum[2] * sum[2] );
+        M.coneCos = -1.0f;
+        M.coneSin = 0.0f;
+        M.axis[0] = M.axis[1] = M.axis[2] = 0.0f;
+        if( length > 0.0f ) {
+            float least = 1.0f;
+            for( int j = 0; j < 3; j++ ) {
+                M.axis[j] = sum[j] / length;
+            }
+            for( size_t i = 0; i < members.size(); i++ ) {
+                const float *n = &facing[3 * members[i]];
+                if( n[0] == 0.0f && n[1] == 0.0f && n[2] == 0.0f ) {
+                    continue;
+                }
+                least = min( least, M.axis[0] * n[0] + M.axis[1] * n[1] +
+                                    M.axis[2] * n[2] );
+            }
+            if( least > 0.0f ) {
+                M.coneCos = least;
+                M.coneSin = sqrtf( 1.0f - least * least );
+            }
+        }
+        meshlets.push_back( M );
+    }
+
+    if( ebuffer != 0 ) {
+        glDeleteBuffers( 1, &ebuffer );
+    }
+    glGenBuffers( 1, &ebuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(uint32_t),
+                  indices.data(), GL_STATIC_DRAW );
+
+    frustumCulled = coneCulled = 0;
+    drawnTriangles = faces;
+    counts.assign( 1, (GLsizei) indices.size() );
+    offsets.assign( 1, (const GLvoid *) 0 );
+    buildMs = elapsedMs( start );
+}
+
+///
+// cull(model,view,frustum,eye) - choose the meshlets to draw
+///
+int MeshletSet::cull( const float *model, const float *view,
+                      const float *frustum, const float *eye )
+{
+    // model to eye space, and the model matrix's scale
+    float modelView[16];
+    multiplyMatrices( modelView, view, model );
+    float scale = sqrtf( model[0] * model[0] + model[1] * model[1] +
+                         model[2] * model[2] );
+
+    // the frustum's planes in eye space, pointing in
+    float planes[6][4];
+    frustumPlanes( &planes[0][0], frustum );
+    float n = frustum[4];
+
+    // where the near plane cuts a closed object open in the view, the
+    // inside shows, which faces away; the triangles of the meshlets it
+    // passes through tell
+    bool cones = closed;
+    for( size_t i = 0; i < meshlets.size() && cones; i++ ) {
+        const Meshlet &M = meshlets[i];
+        float z = modelView[2] * M.center[0] + modelView[6] * M.center[1] +
+                  modelView[10] * M.center[2] + modelView[14];
+        if( fabsf( -z - n ) >= M.radius * scale ) {
+            continue;
+        }
+        for( uint32_t c = M.firstIndex;
+             c < M.firstIndex + 3 * M.triangles && cones; c += 3 ) {
+            float e[3][3];
+            for( int j = 0; j < 3; j++ ) {
+                const float *p = &source->points[4 * indices[c + j]];
+                for( int k = 0; k < 3; k++ ) {
+                    e[j][k] = modelView[k] * p[0] + modelView[4 + k] * p[1] +
+                              modelView[8 + k] * p[2] + modelView[12 + k];
+                }
+            }
+            cones = !cutsNear( e[0], e[1], e[2], frustum );
+        }
+    }
+
+    frustumCulled = coneCulled = drawnTriangles = 0;
+    counts.clear();
+    offsets.clear();
+    for( size_t i = 0; i < meshlets.size(); i++ ) {
+        const Meshlet &M = meshlets[i];
+        float radius = M.radius * scale;
+
+        float e[3];
+        for( int k = 0; k < 3; k++ ) {
+            e[k] = modelView[k] * M.center[0] + modelView[4 + k] * M.center[1] +
+                   modelView[8 + k] * M.center[2] + modelView[12 + k];
+        }
+        bool outside = false;
+        for( int p = 0; p < 6 && !outside; p++ ) {
+            outside = planes[p][0] * e[0] + planes[p][1] * e[1] +
+                      planes[p][2] * e[2] + planes[p][3] < -radius;
+        }
+        if( outside ) {
+            frustumCulled++;
+            continue;
+        }
+
+        // it faces away if the direction from the eye to every point of
+        // its sphere is within 90 degrees less the cone's angle of the
+        // axis: cos(angle to the center) >= sin(cone + sphere's angle)
+        if( cones && M.coneCos > 0.0f ) {
+            float w[3], a[3];
+            for( int k = 0; k < 3; k++ ) {
+                w[k] = model[k] * M.center[0] + model[4 + k] * M.center[1] +
+                       model[8 + k] * M.center[2] + model[12 + k] - eye[k];
+                a[k] = model[k] * M.axis[0] + model[4 + k] * M.axis[1] +
+                       model[8 + k] * M.axis[2];
+            }
+            float d = sqrtf( w[0] * w[0] + w[1] * w[1] + w[2] * w[2] );
+            if( d > radius ) {
+                float sinS = radius / d, cosS = sqrtf( 1.0f - sinS * sinS );
+                float along = (w[0] * a[0] + w[1] * a[1] + w[2] * a[2]) /
+                              (d * scale);
+                if( M.coneCos * cosS - M.coneSin * sinS > 0.0f &&
+                    along >= M.coneSin * cosS + M.coneCos * sinS ) {
+                    coneCulled++;
+                    continue;
+                }
+            }
+        }
+
+        // visible: extend the run, or start one
+        GLsizei count = (GLsizei) (3 * M.triangles);
+        const GLvoid *offset = (const GLvoid *)
+                               (M.firstIndex * sizeof(uint32_t));
+        if( !counts.empty() &&
+            (const char *) offsets.back() + counts.back() * sizeof(uint32_t) ==
+            (const char *) offset ) {
+            counts.back() += count;
+        } else {
+            counts.push_back( count );
+            offsets.push_back( offset );
+        }
+        drawnTriangles += M.triangles;
+    }
+    return drawnTriangles;
+}
+
+///
+// draw() - draw what cull() left
+///
+void MeshletSet::draw( void ) const
+{
+    if( counts.empty() ) {
+        return;
+    }
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, ebuffer );
+    glMultiDrawElements( GL_TRIANGLES, counts.data(), GL_UNSIGNED_INT,
+                         offsets.data(), (GLsizei) counts.size() );
+}
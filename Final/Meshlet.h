@@ -0,0 +1,122 @@
+//
+//  Meshlet.h
+//
+//  Meshlets: an object's triangles cut into small clusters, each with
+//  a bounding sphere and a cone around its triangles' normals, so the
+//  clusters that are off the screen or face away from the camera can
+//  be left out before any of their vertices are shaded.
+//
+//  build() first welds the corners of a BufferSet whose attributes
+//  are all equal, so the clusters index shared vertices and the GPU's
+//  vertex cache sees the reuse the triangle soup hides.  Clusters are
+//  then grown greedily from seeds taken in Morton order, adding the
+//  neighboring triangle that brings the fewest new vertices and bends
+//  the cluster's normals least, up to MESHLET_VERTICES vertices and
+//  MESHLET_TRIANGLES triangles.
+//
+//  A triangle's facing is that of its winding, turned to agree with
+//  its shading normals where they point the other way (the scene does
+//  not cull back faces, and some objects are wound inside out).  A
+//  cluster faces away from a camera when every triangle in its normal
+//  cone does so for every point of its sphere.  Only a closed object
+//  hides what faces away behind what faces the camera: through the top
+//  of the glass or the mug the inside of the far wall shows, facing
+//  away, so the cones are used only for objects with no open edges,
+//  and not while the near plane cuts one open inside the view.
+//
+//  cull() tests every cluster against the view frustum and its cone
+//  and lists the runs of visible ones, which draw() sends with one
+//  glMultiDrawElements() call, using the BufferSet's vertex buffer and
+//  the meshlets' own element buffer.  The model matrix must scale
+//  uniformly, as the scene's does.
+//
+
+#ifndef _MESHLET_H_
+#define _MESHLET_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Buffers.h"
+
+using namespace std;
+
+// most vertices and triangles in one meshlet
+#define MESHLET_VERTICES    64
+#define MESHLET_TRIANGLES   124
+
+///
+// one cluster: its indices, the distinct vertices they use, and its
+// model-space bounds; a coneCos of -1 means its normals spread too
+// far for it to face away as a whole
+///
+struct Meshlet {
+    uint32_t firstIndex, triangles, vertices;
+    float center[3], radius;
+    float axis[3], coneCos, coneSin;
+};
+
+class MeshletSet {
+
+public:
+    vector<Meshlet> meshlets;
+
+    // corner numbers of the BufferSet, three per triangle, meshlet by
+    // meshlet; the element buffer holding them
+    vector<uint32_t> indices;
+    GLuint ebuffer;
+
+    // distinct vertices of the BufferSet's corners, whether it is
+    // closed (and the cones are used), and build() time
+    int uniqueVertices;
+    bool closed;
+    double buildMs;
+
+    // the last cull(): meshlets left out by the frustum and by their
+    // cones, and the triangles and indices left to draw
+    int frustumCulled, coneCulled;
+    int drawnTriangles;
+
+private:
+    // the BufferSet built from, and the runs of visible meshlets for
+    // draw()
+    const BufferSet *source;
+    vector<GLsizei> counts;
+    vector<const GLvoid *> offsets;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    MeshletSet( void );
+
+    ///
+    // build(B) - cluster the triangles of a BufferSet and make the
+    //     element buffer
+    ///
+    void build( const BufferSet &B );
+
+    ///
+    // cull(model,view,frustum,eye) - choose the meshlets to draw
+    //
+    // @param model   - the object's model matrix (column-major)
+    // @param view    - the camera's view matrix
+    // @param frustum - left, right, top, bottom, near and far, as
+    //                  getFrustum() gives them
+    // @param eye     - the camera location
+    //
+    // @return the number of triangles left to draw
+    ///
+    int cull( const float *model, const float *view, const float *frustum,
+              const float *eye );
+
+    ///
+    // draw() - draw what cull() left; the BufferSet's vertex buffer
+    //     must be bound (see selectBuffers())
+    ///
+    void draw( void ) const;
+
+};
+
+#endif
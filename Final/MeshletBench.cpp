@@ -0,0 +1,119 @@
+//
+//  MeshletBench.cpp
+//
+//  The meshlet benchmark (-meshletbench; see Benchmarks.h): every
+//  triangle drawn against the meshlets left after culling.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Buffers.h"
+#include "Framebuffer.h"
+#include "Meshlet.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// meshletBenchmark() - compare drawing every triangle with
+// drawing the meshlets left after culling, from the still-life camera
+// and from half as far: triangles and vertices sent, fragments made,
+// time per frame over B.count frames, and whether the images differ
+///
+void meshletBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    printf( "object  triangles  vertices  meshlets  vertices/meshlet"
+        "  triangles/meshlet  closed  build ms\n" );
+    for( int i = 0; i < P.objectCount; i++ ) {
+        const MeshletSet &M = P.meshlets[i][0];
+        size_t count = M.meshlets.size();
+        long vertices = 0;
+        for( size_t m = 0; m < count; m++ ) {
+            vertices += M.meshlets[m].vertices;
+        }
+        printf( "%-6s  %9d  %8d  %8zu  %16.1f  %17.1f  %6s  %8.1f\n",
+            P.objects[i].name, P.objects[i].buffers->numElements / 3,
+            M.uniqueVertices, count, (double) vertices / count,
+            P.objects[i].buffers->numElements / 3.0 / count,
+            M.closed ? "yes" : "no", M.buildMs );
+    }
+
+    SceneView stillLife = sceneView(), V = stillLife;
+    RenderSettings S;
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+    vector<unsigned char> images[2];
+    GLuint query;
+    glGenQueries( 1, &query );
+    offscreen.bind();
+
+    for( int d = 0; d < 2; d++ ) {
+        float scale = d == 0 ? 1.0f : 0.5f;
+        for( int k = 0; k < 3; k++ ) {
+            V.eye[k] = V.lookAt[k] +
+                       scale * (stillLife.eye[k] - V.lookAt[k]);
+        }
+        setSceneView( V );
+        printf( "camera at %.1fx its distance\n", scale );
+        printf( "culling  triangles  frustum  cone  fragments  ms/frame"
+            "  (triangles per object)\n" );
+        for( int on = 0; on < 2; on++ ) {
+            S.meshlets = on;
+
+            // every fragment made, with none hidden by the depth test
+            glDisable( GL_DEPTH_TEST );
+            glBeginQuery( GL_SAMPLES_PASSED, query );
+            display( S );
+            glEndQuery( GL_SAMPLES_PASSED );
+            glEnable( GL_DEPTH_TEST );
+            GLuint fragments = 0;
+            glGetQueryObjectuiv( query, GL_QUERY_RESULT, &fragments );
+
+            display( S );
+            images[on].resize( frameBytes );
+            offscreen.readPixels( images[on].data() );
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int f = 0; f < frames; f++ ) {
+                display( S );
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / frames;
+            long triangles = sceneStats().drawnTriangles;
+
+            int frustumCulled = 0, coneCulled = 0;
+            for( int i = 0; i < P.objectCount; i++ ) {
+                frustumCulled += on ? P.meshlets[i][0].frustumCulled : 0;
+                coneCulled += on ? P.meshlets[i][0].coneCulled : 0;
+            }
+            printf( "%7s  %9ld  %7d  %4d  %9u  %8.3f ", on ? "on" : "off",
+                triangles, frustumCulled, coneCulled, fragments, ms );
+            for( int i = 0; i < P.objectCount; i++ ) {
+                printf( " %s %d", P.objects[i].name,
+                    on ? P.meshlets[i][0].drawnTriangles :
+                         P.objects[i].buffers->numElements / 3 );
+            }
+            printf( "\n" );
+        }
+        long differ = 0;
+        for( size_t p = 0; p < frameBytes; p += 4 ) {
+            differ += memcmp( &images[0][p], &images[1][p], 3 ) != 0;
+        }
+        printf( "pixels that differ: %ld\n", differ );
+    }
+
+    glDeleteQueries( 1, &query );
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( stillLife );
+}
@@ -0,0 +1,165 @@
+//
+//  MultiViewBench.cpp
+//
+//  The multi-view benchmark (-multiview; see Benchmarks.h): the still
+//  life from up to MAX_VIEWS cameras at once, drawn as separate passes
+//  and as one layered pass.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Instances.h"
+#include "Scene.h"
+#include "ShaderSetup.h"
+#include "ShadowMap.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+///
+// displayViews() - draw the scene from 'count' cameras in one pass,
+// camera i into layer i of the current (layered) framebuffer.  Each
+// object's material and transformations are sent once for all views.
+//
+// @param phong   - the layered program of the untextured objects
+// @param texture - the layered program of the textured ones
+// @param count   - number of cameras, at most MAX_VIEWS
+// @param eyes    - camera locations, as x,y,z triples
+// @param lookAts - lookat points, as x,y,z triples
+// @param ups     - up vectors, as x,y,z triples
+///
+static void displayViews( GLuint phong, GLuint texture, int count,
+                          const float *eyes, const float *lookAts,
+                          const float *ups )
+{
+    // clears every layer
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+    setUpLightAndFrustum( phong );
+    setUpCameras( phong, count, eyes, lookAts, ups );
+    setUpLightAndFrustum( texture );
+    setUpCameras( texture, count, eyes, lookAts, ups );
+
+    drawScene( phong, texture, NULL );
+}
+
+///
+// multiViewBenchmark() - render B.count cameras per pose, once as
+// separate display() passes and once as a single layered pass, and
+// report the throughput of each (read-back included, as a dataset
+// generator would need it) and how far the two results differ.
+///
+void multiViewBenchmark( const BenchSettings &B )
+{
+    int views = B.count, poses = B.poses;
+    const SceneParts &P = sceneParts();
+
+    ShaderError error;
+    GLuint phong = shaderSetupSharedVertex( "multiview.vert",
+        INSTANCE_PLACEMENT, "multiview.geom", "phong.frag", SHADOW_LOOKUP,
+        &error );
+    GLuint texture = 0;
+    if( phong ) {
+        texture = shaderSetupSharedVertex( "multiview.vert",
+            INSTANCE_PLACEMENT, "multiview.geom", "texture.frag",
+            SHADOW_LOOKUP, &error );
+    }
+    if( !phong || !texture ) {
+        cerr << "Error setting up multi-view shaders - " <<
+            errorString(error) << endl;
+        return;
+    }
+    InstanceSet::bindUnits( phong );
+    InstanceSet::bindUnits( texture );
+    ShadowMap::bindUnits( phong );
+    ShadowMap::bindUnits( texture );
+
+    Framebuffer offscreen, layered;
+    if( !offscreen.resize( P.width, P.height ) ||
+        !layered.resize( P.width, P.height, views ) ) {
+        return;
+    }
+
+    SceneView saved = sceneView(), V = saved;
+    vector<float> eyes( 3 * views ), lookAts( 3 * views ), ups( 3 * views );
+    for( int k = 0; k < views; k++ ) {
+        orbitCamera( k, &eyes[3*k] );
+        memcpy( &lookAts[3*k], V.lookAt, sizeof(V.lookAt) );
+        memcpy( &ups[3*k], V.up, sizeof(V.up) );
+    }
+
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+    vector<unsigned char> separate( frameBytes * views );
+    vector<unsigned char> single( frameBytes * views );
+    double separateMs = 0.0, singleMs = 0.0;
+    size_t differing = 0;
+    int maxDiff = 0;
+
+    // the layered pass draws everything in full, so the separate ones
+    // must too: with none of the drawing options
+    RenderSettings full;
+
+    // pose -1 is an untimed warm-up
+    for( int p = -1; p < poses; p++ ) {
+        // turn the objects (but not the room) between poses
+        for( int i = 0; i < 21; i++ ) {
+            V.angles[i] = 15.0f * (p + 1);
+        }
+
+        uint64_t start = monotonicNs();
+        offscreen.bind();
+        for( int k = 0; k < views; k++ ) {
+            memcpy( V.eye, &eyes[3*k], sizeof(V.eye) );
+            setSceneView( V );
+            display( full );
+            offscreen.readPixels( &separate[k * frameBytes] );
+        }
+        if( p >= 0 ) {
+            separateMs += elapsedMs( start );
+        }
+
+        start = monotonicNs();
+        layered.bind();
+        displayViews( phong, texture, views, eyes.data(), lookAts.data(),
+                      ups.data() );
+        layered.readPixels( single.data() );
+        if( p >= 0 ) {
+            singleMs += elapsedMs( start );
+        }
+
+        for( size_t i = 0; i < single.size(); i += 4 ) {
+            int d = 0;
+            for( int c = 0; c < 3; c++ ) {
+                d = max( d, abs( single[i+c] - separate[i+c] ) );
+            }
+            maxDiff = max( maxDiff, d );
+            differing += d > 0;
+        }
+    }
+
+    layered.unbind( P.width, P.height );
+    layered.release();
+    offscreen.release();
+    glDeleteProgram( phong );
+    glDeleteProgram( texture );
+    setSceneView( saved );
+
+    printf( "multi-view: %d views x %d poses at %dx%d\n", views, poses,
+        P.width, P.height );
+    printf( "separate passes:  %8.2f ms/pose  %8.1f views/s\n",
+        separateMs / poses, views * poses / (separateMs / 1000.0) );
+    printf( "layered pass:     %8.2f ms/pose  %8.1f views/s  (%.2fx)\n",
+        singleMs / poses, views * poses / (singleMs / 1000.0),
+        separateMs / singleMs );
+    printf( "max channel difference %d, %.3f%% of pixels differ\n",
+        maxDiff, 100.0 * differing / ((poses + 1.0) * views * P.width *
+        P.height) );
+}
@@ -0,0 +1,112 @@
+//
+//  NormalBench.cpp
+//
+//  The normal generation benchmark (-normalbench; see Benchmarks.h):
+//  smooth normals for a mesh on more and more threads, and how far each
+//  weighting strays from the file's own.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Normals.h"
+#include "Scene.h"
+#include "Shapes.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+///
+// normalBenchmark() - time smooth normal generation for the .obj file
+// B.path on more and more threads, and compare the normals of each
+// weighting with the file's own
+///
+void normalBenchmark( const BenchSettings &B )
+{
+    const char *path = B.path;
+    vector<float> positions, given;
+    vector<unsigned int> indices;
+    if( !loadMeshData( path, positions, indices, &given ) ) {
+        return;
+    }
+    int vertices = (int) positions.size() / 3;
+    int faces = (int) indices.size() / 3;
+    for( size_t i = 0; i < indices.size(); i++ ) {
+        if( indices[i] >= (unsigned int) vertices ) {
+            cerr << path << ": vertex index out of range" << endl;
+            return;
+        }
+    }
+    vector<float> normals( 3 * indices.size() );
+
+    ThreadPool all( sceneParts().cpuThreads );
+    vector<int> counts;
+    for( int n = 1; n < all.size(); n *= 2 ) {
+        counts.push_back( n );
+    }
+    counts.push_back( all.size() );
+
+    const int REPEATS = 10;
+    printf( "%s: %d vertices, %d triangles, %d repeats\n", path, vertices,
+        faces, REPEATS );
+    printf( "threads  ms/mesh  Mcorners/s  speedup\n" );
+    double baseMs = 0.0;
+    for( size_t c = 0; c < counts.size(); c++ ) {
+        ThreadPool *pool = counts[c] == all.size() ? &all :
+                           new ThreadPool( counts[c] );
+        NormalGenerator G( *pool );
+        G.generate( positions.data(), vertices, indices.data(), faces,
+                    normals.data() );     // warm-up
+        double ms = 0.0;
+        for( int r = 0; r < REPEATS; r++ ) {
+            G.generate( positions.data(), vertices, indices.data(), faces,
+                        normals.data() );
+            ms += G.generateMs;
+        }
+        ms /= REPEATS;
+        if( c == 0 ) {
+            baseMs = ms;
+        }
+        printf( "%7d  %7.2f  %10.1f  %6.2fx\n", counts[c], ms,
+            3.0 * faces / (ms * 1000.0), baseMs / ms );
+        if( pool != &all ) {
+            delete pool;
+        }
+    }
+
+    if( given.empty() ) {
+        printf( "the file has no normals to compare with\n" );
+        return;
+    }
+
+    // the angle between each generated normal and the file's
+    static const struct { int weighting; const char *name; } modes[] = {
+        { NORMALS_AREA, "area" },
+        { NORMALS_ANGLE, "angle" },
+        { NORMALS_AREA | NORMALS_ANGLE, "area and angle" }
+    };
+    NormalGenerator G( all );
+    printf( "crease %.0f degrees; difference from the file's normals:\n",
+        G.creaseAngle );
+    for( size_t m = 0; m < sizeof(modes) / sizeof(*modes); m++ ) {
+        G.weighting = modes[m].weighting;
+        G.generate( positions.data(), vertices, indices.data(), faces,
+                    normals.data() );
+        double sum = 0.0, worst = 0.0;
+        for( size_t i = 0; i < indices.size(); i++ ) {
+            const float *a = &normals[3 * i], *b = &given[3 * i];
+            double length = sqrt( (double) b[0] * b[0] + b[1] * b[1] +
+                                  b[2] * b[2] );
+            double d = (a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / length;
+            double angle = acos( max( -1.0, min( 1.0, d ) ) ) * 180.0 / M_PI;
+            sum += angle;
+            worst = max( worst, angle );
+        }
+        printf( "  %-14s  mean %6.2f, worst %6.2f degrees\n", modes[m].name,
+            sum / indices.size(), worst );
+    }
+}
@@ -0,0 +1,424 @@
+//
+//  NormalMap.cpp
+//
+//  Normal map baking implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "NormalMap.h"
+#include "Timing.h"
+
+using namespace std;
+
+// How to calculate an offset into the vertex buffer
+#define BUFFER_OFFSET(i) ((char *)NULL + (i))
+
+///
+// corners(h,S,uv) - where the corners of a cell's triangle go, in
+//     texels from the cell's lower left corner
+//
+// @param h  - 0 for the lower left half, 1 for the upper right
+// @param S  - texels per side of the cell
+// @param uv - receives the three corners' u and v
+///
+static void corners( int h, int S, float *uv )
+{
+    float lo = 1.0f, hi = S - 3.0f;
+    if( h == 1 ) {
+        lo = S - 1.0f;
+        hi = 3.0f;
+    }
+    uv[0] = lo;  uv[1] = lo;
+    uv[2] = hi;  uv[3] = lo;
+    uv[4] = lo;  uv[5] = hi;
+}
+
+///
+// nearestPoint(uv,x,y,b) - barycentric coordinates of the point of a
+//     triangle nearest to (x,y)
+///
+static void nearestPoint( const float *uv, float x, float y, float *b )
+{
+    float e1[2] = { uv[2] - uv[0], uv[3] - uv[1] };
+    float e2[2] = { uv[4] - uv[0], uv[5] - uv[1] };
+    float d[2] = { x - uv[0], y - uv[1] };
+    float det = e1[0] * e2[1] - e1[1] * e2[0];
+    b[1] = (d[0] * e2[1] - d[1] * e2[0]) / det;
+    b[2] = (e1[0] * d[1] - e1[1] * d[0]) / det;
+    b[0] = 1.0f - b[1] - b[2];
+    if( b[0] >= 0.0f && b[1] >= 0.0f && b[2] >= 0.0f ) {
+        return;
+    }
+
+    // outside: the nearest point of the nearest edge
+    float best = HUGE_VALF;
+    for( int i = 0; i < 3; i++ ) {
+        int j = (i + 1) % 3;
+        const float *p = &uv[2 * i], *q = &uv[2 * j];
+        float ex = q[0] - p[0], ey = q[1] - p[1];
+        float t = ((x - p[0]) * ex + (y - p[1]) * ey) / (ex * ex + ey * ey);
+        t = min( max( t, 0.0f ), 1.0f );
+        float dx = p[0] + t * ex - x, dy = p[1] + t * ey - y;
+        float distance = dx * dx + dy * dy;
+        if( distance < best ) {
+            best = distance;
+            b[0] = b[1] = b[2] = 0.0f;
+            b[i] = 1.0f - t;
+            b[j] = t;
+        }
+    }
+}
+
+///
+// normalize(v) - make v unit length
+//
+// @return false if it has none
+///
+static bool normalize( float *v )
+{
+    float length = sqrtf( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+    if( !(length > 0.0f) ) {
+        return false;
+    }
+    for( int k = 0; k < 3; k++ ) {
+        v[k] /= length;
+    }
+    return true;
+}
+
+static float dot( const float *a, const float *b )
+{
+    return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+static void cross( const float *a, const float *b, float *c )
+{
+    c[0] = a[1] * b[2] - a[2] * b[1];
+    c[1] = a[2] * b[0] - a[0] * b[2];
+    c[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+///
+// Constructor
+///
+NormalMap::NormalMap( void ) :
+    texture(0), buffer(0), size(0), cell(0), baked(0), hits(0), crossed(0),
+    bakeMs(0.0), proxy(NULL)
+{
+}
+
+///
+// bindUnits(program) - point a program at the normal maps' unit
+///
+void NormalMap::bindUnits( GLuint program )
+{
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "normalMap" ), NMAP_UNIT );
+}
+
+///
+// layOut() - give every corner of the proxy its atlas coordinates, and
+//     every triangle its tangent
+///
+void NormalMap::layOut( void )
+{
+    int triangles = proxy->numElements / 3;
+    int perSide = (int) ceil( sqrt( (triangles + 1) / 2.0 ) );
+    uv.resize( 2 * proxy->numElements );
+    tangents.resize( 4 * proxy->numElements );
+
+    for( int t = 0; t < triangles; t++ ) {
+        int c = t / 2;
+        float corner[6];
+        corners( t % 2, cell, corner );
+        for( int i = 0; i < 3; i++ ) {
+            uv[6 * t + 2 * i] =
+                ((c % perSide) * cell + corner[2 * i]) / size;
+            uv[6 * t + 2 * i + 1] =
+                ((c / perSide) * cell + corner[2 * i + 1]) / size;
+        }
+
+        // the direction u grows in on the surface, and which side of
+        // it v grows on
+        const float *p = &proxy->points[12 * t];
+        float e1[3], e2[3], face[3], tangent[3], bitangent[3], side[3];
+        for( int k = 0; k < 3; k++ ) {
+            e1[k] = p[4 + k] - p[k];
+            e2[k] = p[8 + k] - p[k];
+        }
+        float du1 = corner[2] - corner[0], dv1 = corner[3] - corner[1];
+        float du2 = corner[4] - corner[0], dv2 = corner[5] - corner[1];
+        for( int k = 0; k < 3; k++ ) {
+            tangent[k] = e1[k] * dv2 - e2[k] * dv1;
+            bitangent[k] = e2[k] * du1 - e1[k] * du2;
+        }
+        float r = du1 * dv2 - du2 * dv1;
+        for( int k = 0; k < 3; k++ ) {
+            tangent[k] /= r;
+            bitangent[k] /= r;
+        }
+        if( !normalize( tangent ) ) {
+            tangent[0] = 1.0f;
+        }
+        cross( e1, e2, face );
+        cross( face, tangent, side );
+        float sign = dot( side, bitangent ) < 0.0f ? -1.0f : 1.0f;
+        for( int i = 0; i < 3; i++ ) {
+            float *T = &tangents[12 * t + 4 * i];
+            memcpy( T, tangent, sizeof(tangent) );
+            T[3] = sign;
+        }
+    }
+}
+
+///
+// bakeCell(c,bvh,full,search,cellBaked,cellHits) - bake the texels of
+//     one cell, adding to the counts of texels baked and hits
+///
+void NormalMap::bakeCell( int c, const Bvh &bvh, const BufferSet &full,
+                          float search, long &cellBaked, long &cellHits,
+                          long &cellCrossed )
+{
+    int triangles = proxy->numElements / 3;
+    int perSide = size / cell;
+    int x0 = (c % perSide) * cell, y0 = (c / perSide) * cell;
+
+    for( int ty = 0; ty < cell; ty++ ) {
+        for( int tx = 0; tx < cell; tx++ ) {
+            // the half, and so the triangle, the texel belongs to
+            int h = tx + ty + 1 < cell ? 0 : 1;
+            int t = 2 * c + h;
+            if( t >= triangles ) {
+                continue;
+            }
+            float corner[6], b[3];
+            corners( h, cell, corner );
+            nearestPoint( corner, tx + 0.5f, ty + 0.5f, b );
+
+            // the proxy's surface there, its tangent frame, and the
+            // face's normal, turned the way its corners' point
+            const float *P = &proxy->points[12 * t];
+            const float *N = &proxy->normals[9 * t];
+            const float *T = &tangents[12 * t];
+            float p[3], n[3], tangent[3], bitangent[3], face[3];
+            float e1[3], e2[3], sum[3];
+            for( int k = 0; k < 3; k++ ) {
+                e1[k] = P[4 + k] - P[k];
+                e2[k] = P[8 + k] - P[k];
+                sum[k] = N[k] + N[3 + k] + N[6 + k];
+            }
+            cross( e1, e2, face );
+            if( !normalize( face ) ) {
+                continue;
+            }
+            if( dot( face, sum ) < 0.0f ) {
+                for( int k = 0; k < 3; k++ ) {
+                    face[k] = -face[k];
+                }
+            }
+            for( int k = 0; k < 3; k++ ) {
+                p[k] = b[0] * P[k] + b[1] * P[4 + k] + b[2] * P[8 + k];
+                n[k] = b[0] * N[k] + b[1] * N[3 + k] + b[2] * N[6 + k];
+            }
+            if( !normalize( n ) ) {
+                continue;
+            }
+            float along = dot( n, T );
+            for( int k = 0; k < 3; k++ ) {
+                tangent[k] = T[k] - along * n[k];
+            }
+            if( !normalize( tangent ) ) {
+                continue;
+            }
+            cross( n, tangent, bitangent );
+            for( int k = 0; k < 3; k++ ) {
+                bitangent[k] *= T[3];
+            }
+
+            // the nearest point of the full mesh, either way along the
+            // face's normal, that faces the same way; where there is
+            // none, the proxy's own normal and occlusion
+            float found[3] = { n[0], n[1], n[2] }, nearest = HUGE_VALF;
+            float across = HUGE_VALF;
+            float occlusion = 1.0f;
+            if( !proxy->occlusion.empty() ) {
+                const float *O = &proxy->occlusion[3 * t];
+                occlusion = b[0] * O[0] + b[1] * O[1] + b[2] * O[2];
+            }
+            for( int way = -1; way <= 1; way += 2 ) {
+                float direction[3] = {
+                    way * face[0], way * face[1], way * face[2]
+                };
+                RayHit H;
+                if( !bvh.intersect( p, direction, 0.0f, search, H ) ) {
+                    continue;
+                }
+                const float *M = &full.normals[9 * H.triangle];
+                float w = 1.0f - H.u - H.v, m[3];
+                for( int k = 0; k < 3; k++ ) {
+                    m[k] = w * M[k] + H.u * M[3 + k] + H.v * M[6 + k];
+                }
+                if( !normalize( m ) || dot( m, face ) <= 0.0f ) {
+                    across = min( across, H.t );
+                } else if( H.t < nearest ) {
+                    memcpy( found, m, sizeof(found) );
+                    nearest = H.t;
+                    if( !full.occlusion.empty() ) {
+                        const float *O = &full.occlusion[3 * H.triangle];
+                        occlusion = w * O[0] + H.u * O[1] + H.v * O[2];
+                    }
+                }
+            }
+            cellBaked++;
+            cellHits += nearest < HUGE_VALF;
+            cellCrossed += across < nearest;
+
+            float local[4] = {
+                dot( found, tangent ) * 0.5f + 0.5f,
+                dot( found, bitangent ) * 0.5f + 0.5f,
+                dot( found, n ) * 0.5f + 0.5f,
+                occlusion
+            };
+            unsigned char *texel = &texels[4 * ((y0 + ty) * size + x0 + tx)];
+            for( int k = 0; k < 4; k++ ) {
+                float v = min( max( local[k], 0.0f ), 1.0f );
+                texel[k] = (unsigned char) (v * 255.0f + 0.5f);
+            }
+        }
+    }
+}
+
+///
+// bake(full,proxy,pool) - lay out the proxy's atlas and bake its map
+///
+bool NormalMap::bake( const BufferSet &full, const BufferSet &proxy,
+                      ThreadPool &pool )
+{
+    uint64_t start = monotonicNs();
+    release();
+    if( full.normals.empty() || proxy.normals.empty() ||
+        full.radius < 0.0f ) {
+        return false;
+    }
+    int triangles = proxy.numElements / 3;
+    int cells = (triangles + 1) / 2;
+    int perSide = (int) ceil( sqrt( (double) cells ) );
+    cell = NMAP_SIZE / max( perSide, 1 );
+    if( cell < NMAP_MIN_CELL ) {
+        return false;
+    }
+    size = perSide * cell;
+    this->proxy = &proxy;
+    layOut();
+
+    // the full mesh's triangles
+    vector<float> positions;
+    positions.reserve( 3 * full.numElements );
+    for( int v = 0; v < full.numElements; v++ ) {
+        positions.insert( positions.end(), &full.points[4 * v],
+                          &full.points[4 * v + 3] );
+    }
+    Bvh bvh;
+    bvh.build( positions.data(), full.numElements / 3 );
+
+    // texels of no triangle, as if they kept the proxy's normal
+    texels.resize( 4 * size * size );
+    for( size_t i = 0; i < texels.size(); i += 4 ) {
+        texels[i] = texels[i + 1] = 128;
+        texels[i + 2] = texels[i + 3] = 255;
+    }
+
+    // each cell's texels are its own, so cells are baked at once; the
+    // counts are kept per worker
+    vector<long> workerBaked( pool.size() ), workerHits( pool.size() );
+    vector<long> workerCrossed( pool.size() );
+    float search = NMAP_SEARCH * full.radius;
+    pool.parallelFor( cells, [&]( int c, int worker ) {
+        bakeCell( c, bvh, full, search, workerBaked[worker],
+                  workerHits[worker], workerCrossed[worker] );
+    } );
+    baked = hits = crossed = 0;
+    for( int w = 0; w < pool.size(); w++ ) {
+        baked += workerBaked[w];
+        hits += workerHits[w];
+        crossed += workerCrossed[w];
+    }
+
+    glGenTextures( 1, &texture );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA,
+                  GL_UNSIGNED_BYTE, texels.data() );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE );
+    glBindTexture( GL_TEXTURE_2D, 0 );
+
+    // the corners' coordinates, then their tangents
+    long uvBytes = uv.size() * sizeof(float);
+    long tangentBytes = tangents.size() * sizeof(float);
+    glGenBuffers( 1, &buffer );
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    glBufferData( GL_ARRAY_BUFFER, uvBytes + tangentBytes, NULL,
+                  GL_STATIC_DRAW );
+    glBufferSubData( GL_ARRAY_BUFFER, 0, uvBytes, uv.data() );
+    glBufferSubData( GL_ARRAY_BUFFER, uvBytes, tangentBytes,
+                     tangents.data() );
+
+    bakeMs = elapsedMs( start );
+    return true;
+}
+
+///
+// draw(program) - draw the proxy with the normal map
+///
+void NormalMap::draw( GLuint program ) const
+{
+    glActiveTexture( GL_TEXTURE0 + NMAP_UNIT );
+    glBindTexture( GL_TEXTURE_2D, texture );
+    glActiveTexture( GL_TEXTURE0 );
+
+    glBindBuffer( GL_ARRAY_BUFFER, buffer );
+    GLint vTexCoord = glGetAttribLocation( program, "vTexCoord" );
+    GLint vTangent = glGetAttribLocation( program, "vTangent" );
+    glEnableVertexAttribArray( vTexCoord );
+    glVertexAttribPointer( vTexCoord, 2, GL_FLOAT, GL_FALSE, 0,
+                           BUFFER_OFFSET(0) );
+    glEnableVertexAttribArray( vTangent );
+    glVertexAttribPointer( vTangent, 4, GL_FLOAT, GL_FALSE, 0,
+                           BUFFER_OFFSET(uv.size() * sizeof(float)) );
+
+    glDrawElements( GL_TRIANGLES, proxy->numElements, GL_UNSIGNED_INT,
+                    (void *) 0 );
+
+    // don't leave them enabled for programs that don't read them
+    glDisableVertexAttribArray( vTexCoord );
+    glDisableVertexAttribArray( vTangent );
+}
+
+///
+// gpuBytes() - bytes of texture and buffer the map adds to the proxy
+///
+long NormalMap::gpuBytes( void ) const
+{
+    if( texture == 0 ) {
+        return 0;
+    }
+    return (long) size * size * 4 +
+           (long) (uv.size() + tangents.size()) * sizeof(float);
+}
+
+///
+// release() - delete the texture and buffer
+///
+void NormalMap::release( void )
+{
+    if( texture ) {
+        glDeleteTextures( 1, &texture );
+        glDeleteBuffers( 1, &buffer );
+    }
+    texture = buffer = 0;
+}
@@ -0,0 +1,161 @@
+//
+//  NormalMap.h
+//
+//  Normal maps baked from an object's full mesh onto a coarse copy of
+//  it (a proxy, such as the coarsest of its levels of detail), so the
+//  proxy can be drawn with far fewer vertices and still be shaded with
+//  the full mesh's normals.
+//
+//  bake() first lays the proxy's triangles out in an atlas, two to a
+//  square cell: one in the cell's lower left half and one, turned
+//  about, in its upper right, each a texel in from the cell's edges
+//  and two, along either axis, from the diagonal between them.  Every
+//  texel of a half belongs to its triangle, including those in the
+//  margins, which take the nearest point of the triangle; so linear
+//  filtering anywhere inside a triangle only reads texels of that
+//  triangle, and the charts need no dilation afterwards.
+//
+//  For every texel it then finds the proxy's surface there, and casts
+//  rays from it along the triangle's normal, forward and back, for up
+//  to NMAP_SEARCH of the object's radius, into a BVH of the full mesh.
+//  (Not along the interpolated normal: a coarse corner keeps the normal
+//  of the corner it came from, which on the mug's rim may point across
+//  the whole triangle.)  The nearest hit whose surface faces the same
+//  way gives the full mesh's normal there, which is stored in the
+//  texel in the proxy's tangent space: its tangent along the atlas's u
+//  axis, its interpolated normal, and their cross product.  The full
+//  mesh's ambient occlusion there goes in the texel's alpha, since the
+//  coarse corners' own is spread over long, thin triangles.  Texels
+//  whose rays find nothing keep the proxy's own normal and occlusion.
+//  Cells are baked in parallel on the ThreadPool.
+//
+//  A proxy may be too coarse for a thin wall, such as the glass's: its
+//  inner side then pokes out through the outer one, and the map cannot
+//  help, since the wrong side's normals are the right ones for it.
+//  bake() counts the texels where the nearest surface either way faces
+//  the other way, as it does on the far side of a wall; a caller can
+//  try a finer proxy when there are more than NMAP_MAX_CROSSED of them.
+//
+//  Every corner of the proxy gets its atlas coordinates and its
+//  triangle's tangent, with the sign of the cross product in w, in a
+//  vertex buffer of its own; normalMap.vert reads them alongside the
+//  proxy's BufferSet.  normalMap.frag builds the tangent frame from
+//  the interpolated normal as bake() did, so the two agree.
+//
+
+#ifndef _NORMALMAP_H_
+#define _NORMALMAP_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+#include <vector>
+
+#include "Buffers.h"
+#include "Bvh.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// most texels per side of an atlas, and fewest per side of a cell
+#define NMAP_SIZE           1024
+#define NMAP_MIN_CELL       8
+
+// how far from the proxy the full mesh is looked for, as a share of
+// the object's radius (twice as far as a level of detail may stray;
+// see LOD_MAX_ERROR)
+#define NMAP_SEARCH         0.1f
+
+// share of a proxy's texels that may lie across a wall from their
+// surface (see above)
+#define NMAP_MAX_CROSSED    0.05f
+
+// texture unit of the normal maps
+#define NMAP_UNIT           5
+
+class NormalMap {
+
+public:
+    // the texture, and the buffer of every proxy corner's atlas
+    // coordinates (UV) and tangent (XYZW); 0 until baked
+    GLuint texture, buffer;
+
+    // texels per side of the atlas, and per side of a cell
+    int size, cell;
+
+    // the texels (normal in RGB, occlusion in A), and the proxy's
+    // corners' UV and XYZW
+    vector<unsigned char> texels;
+    vector<float> uv, tangents;
+
+    // texels baked, how many found the full mesh, how many lay across a
+    // wall from it, and the time the last bake() took
+    long baked, hits, crossed;
+    double bakeMs;
+
+private:
+    // the proxy the map was baked for
+    const BufferSet *proxy;
+
+    void layOut( void );
+    void bakeCell( int c, const Bvh &bvh, const BufferSet &full,
+                   float search, long &cellBaked, long &cellHits,
+                   long &cellCrossed );
+
+public:
+
+    ///
+    // Constructor
+    ///
+    NormalMap( void );
+
+    ///
+    // bindUnits(program) - point a program linked with normalMap.frag
+    //     at the normal maps' unit
+    ///
+    static void bindUnits( GLuint program );
+
+    ///
+    // bake(full,proxy,pool) - lay out the proxy's atlas and bake its
+    //     normal map from the full mesh
+    //
+    // @param full  - the object's buffers, with normals
+    // @param proxy - a coarse copy of it, with normals; it must stay as
+    //                long as the map is drawn
+    // @param pool  - the workers to bake with
+    //
+    // @return true on success; false if either has no normals or the
+    //         proxy has too many triangles to lay out
+    ///
+    bool bake( const BufferSet &full, const BufferSet &proxy,
+               ThreadPool &pool );
+
+    ///
+    // draw(program) - draw the proxy with the normal map; the object's
+    //     material and transformations must be set up and the proxy's
+    //     buffers bound to the program (see selectBuffers())
+    //
+    // @param program - a program linked with normalMap.vert and
+    //                  normalMap.frag
+    ///
+    void draw( GLuint program ) const;
+
+    ///
+    // gpuBytes() - bytes of texture and buffer the map adds to the proxy
+    ///
+    long gpuBytes( void ) const;
+
+    ///
+    // release() - delete the texture and buffer
+    ///
+    void release( void );
+
+};
+
+#endif
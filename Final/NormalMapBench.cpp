@@ -0,0 +1,97 @@
+//
+//  NormalMapBench.cpp
+//
+//  The normal map benchmark (-normalmapbench; see Benchmarks.h): frames
+//  with the full meshes, with the coarse levels the normal maps are
+//  baked onto, and with those levels normal-mapped.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "NormalMap.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// normalMapBenchmark() - bake the normal maps if not yet baked, then
+// time B.count frames with the full meshes, with the levels the normal
+// maps were baked onto, and with those levels normal-mapped, and
+// compare their images
+///
+void normalMapBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+    static const char *kinds[] = { "full", "coarse", "normal-mapped" };
+    RenderSettings S;
+    vector<unsigned char> images[3];
+
+    bakeNormalMaps();
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    offscreen.bind();
+    size_t frameBytes = (size_t) P.width * P.height * 4;
+
+    printf( "meshes          triangles  ms/frame     off %%  max diff\n" );
+    for( int kind = 0; kind < 3; kind++ ) {
+        vector<int> levels( P.objectCount );
+        for( int i = 0; i < P.objectCount; i++ ) {
+            levels[i] = kind > 0 && P.normalMaps[i].texture != 0 ?
+                        P.normalMapLevels[i] : 0;
+        }
+        S.normalMaps = kind == 2;
+
+        double ms = 0.0;
+        for( int f = -1; f < frames; f++ ) {     // frame -1 is a warm-up
+            glFinish();
+            uint64_t start = monotonicNs();
+            glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+            setUpScene( P.phong, S );
+            setUpScene( P.texture, S );
+            setUpScene( P.normalMap, S );
+            drawScene( P.phong, P.texture, levels.data(), S );
+            glFinish();
+            if( f < 0 ) {
+                images[kind].resize( frameBytes );
+                offscreen.readPixels( images[kind].data() );
+            } else {
+                ms += elapsedMs( start );
+            }
+        }
+        printf( "%-14s  %9ld  %8.3f", kinds[kind],
+            sceneStats().drawnTriangles, ms / frames );
+        if( kind == 0 ) {
+            printf( "\n" );
+            continue;
+        }
+
+        // against the full meshes, counting only pixels more than 16
+        // levels off
+        long differ = 0;
+        int maxDiff = 0;
+        for( size_t q = 0; q < frameBytes; q += 4 ) {
+            int diff = 0;
+            for( int c = 0; c < 3; c++ ) {
+                diff = max( diff,
+                            abs( images[0][q+c] - images[kind][q+c] ) );
+            }
+            differ += diff > 16;
+            maxDiff = max( maxDiff, diff );
+        }
+        printf( "  %8.2f  %8d\n", 100.0 * differ / (P.width * P.height),
+            maxDiff );
+    }
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+}
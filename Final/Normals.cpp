@@ -0,0 +1,148 @@
+//
+//  Normals.cpp
+//
+//  Smooth normal generation implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+
+#include "Normals.h"
+#include "Timing.h"
+
+using namespace std;
+
+// triangles per work item
+#define NORMALS_CHUNK   4096
+
+///
+// Constructor
+///
+NormalGenerator::NormalGenerator( ThreadPool &threads ) :
+    creaseAngle(60.0f), weighting(NORMALS_AREA | NORMALS_ANGLE),
+    generateMs(0.0), pool(threads)
+{
+}
+
+///
+// generate(positions,vertices,indices,faces,normals) - corner normals
+///
+void NormalGenerator::generate( const float *positions, int vertices,
+                                const uint32_t *indices, int faces,
+                                float *normals )
+{
+    uint64_t start = monotonicNs();
+
+    int chunks = (faces + NORMALS_CHUNK - 1) / NORMALS_CHUNK;
+    faceNormals.resize( 3 * (size_t) faces );
+    areas.resize( faces );
+    weights.resize( 3 * (size_t) faces );
+
+    // every triangle's normal and area, and the weight of its corners
+    pool.parallelFor( chunks, [&]( int c, int ) {
+        for( int f = c * NORMALS_CHUNK; f < min( faces, (c + 1) * NORMALS_CHUNK ); f++ ) {
+            const float *p[3];
+            for( int k = 0; k < 3; k++ ) {
+                p[k] = &positions[3 * (size_t) indices[3 * f + k]];
+            }
+
+            float e[3][3];      // edge k runs from corner k to k+1
+            for( int k = 0; k < 3; k++ ) {
+                for( int j = 0; j < 3; j++ ) {
+                    e[k][j] = p[(k + 1) % 3][j] - p[k][j];
+                }
+            }
+            // (p1 - p0) x (p2 - p0), as e[2] runs from p2 back to p0
+            float n[3] = { e[2][1] * e[0][2] - e[2][2] * e[0][1],
+                           e[2][2] * e[0][0] - e[2][0] * e[0][2],
+                           e[2][0] * e[0][1] - e[2][1] * e[0][0] };
+            float length = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+            float scale = length > 0.0f ? 1.0f / length : 0.0f;
+            for( int j = 0; j < 3; j++ ) {
+                faceNormals[3 * (size_t) f + j] = n[j] * scale;
+            }
+            areas[f] = 0.5f * length;
+
+            for( int k = 0; k < 3; k++ ) {
+                // the angle between the edges leaving corner k
+                const float *a = e[k], *b = e[(k + 2) % 3];
+                float la = sqrtf( a[0] * a[0] + a[1] * a[1] + a[2] * a[2] );
+                float lb = sqrtf( b[0] * b[0] + b[1] * b[1] + b[2] * b[2] );
+                float angle = 0.0f;
+                if( la > 0.0f && lb > 0.0f ) {
+                    float d = -(a[0] * b[0] + a[1] * b[1] + a[2] * b[2]) / (la * lb);
+                    angle = acosf( max( -1.0f, min( 1.0f, d ) ) );
+                }
+                float w = 1.0f;
+                if( weighting & NORMALS_AREA ) {
+                    w *= areas[f];
+                }
+                if( weighting & NORMALS_ANGLE ) {
+                    w *= angle;
+                }
+                weights[3 * (size_t) f + k] = w;
+            }
+        }
+    } );
+
+    // the corners of each vertex, by a counting sort
+    int count = 3 * faces;
+    first.assign( vertices + 1, 0 );
+    for( int i = 0; i < count; i++ ) {
+        first[indices[i] + 1]++;
+    }
+    for( int v = 0; v < vertices; v++ ) {
+        first[v + 1] += first[v];
+    }
+    corners.resize( count );
+    {
+        vector<uint32_t> at( first.begin(), first.end() - 1 );
+        for( int i = 0; i < count; i++ ) {
+            corners[at[indices[i]]++] = i;
+        }
+    }
+
+    // each corner sums the triangles around its vertex that are within
+    // the crease angle of its own
+    float limit = cosf( creaseAngle * (float) M_PI / 180.0f );
+    pool.parallelFor( chunks, [&]( int c, int ) {
+        for( int i = 3 * c * NORMALS_CHUNK; i < min( count, 3 * (c + 1) * NORMALS_CHUNK ); i++ ) {
+            const float *own = &faceNormals[3 * (size_t) (i / 3)];
+            bool degenerate = own[0] == 0.0f && own[1] == 0.0f && own[2] == 0.0f;
+            uint32_t v = indices[i];
+
+            float sum[3] = { 0.0f, 0.0f, 0.0f };
+            for( uint32_t j = first[v]; j < first[v + 1]; j++ ) {
+                uint32_t other = corners[j];
+                const float *n = &faceNormals[3 * (size_t) (other / 3)];
+                if( !degenerate &&
+                    own[0] * n[0] + own[1] * n[1] + own[2] * n[2] < limit ) {
+                    continue;
+                }
+                float w = weights[other];
+                sum[0] += w * n[0];
+                sum[1] += w * n[1];
+                sum[2] += w * n[2];
+            }
+
+            float length = sqrtf( sum[0] * sum[0] + sum[1] * sum[1] +
+                                  sum[2] * sum[2] );
+            float *out = &normals[3 * (size_t) i];
+            if( length > 0.0f ) {
+                for( int k = 0; k < 3; k++ ) {
+                    out[k] = sum[k] / length;
+                }
+            } else if( !degenerate ) {
+                for( int k = 0; k < 3; k++ ) {
+                    out[k] = own[k];
+                }
+            } else {
+                // nothing to go by
+                out[0] = out[1] = 0.0f;
+                out[2] = 1.0f;
+            }
+        }
+    } );
+
+    generateMs = elapsedMs( start );
+}
@@ -0,0 +1,83 @@
+//
+//  Normals.h
+//
+//  Smooth vertex normals for meshes that come without them, or with
+//  normals that cannot be used.
+//
+//  Every triangle corner gets its own normal: the weighted sum of the
+//  normals of the triangles around its vertex, leaving out those that
+//  meet the corner's triangle at more than 'creaseAngle', so hard
+//  edges stay hard.  A triangle counts by its area, by its angle at
+//  the vertex (which keeps a fan of thin slivers from outweighing one
+//  large triangle), or by both.
+//
+//  The work runs on a ThreadPool in two passes over the triangles.
+//  The first finds each triangle's normal, area and corner angles.
+//  The second gathers rather than scatters: the corners are sorted by
+//  vertex up front, so each corner reads the corners that share its
+//  vertex and writes only its own normal, and no two workers ever
+//  touch the same sum.
+//
+
+#ifndef _NORMALS_H_
+#define _NORMALS_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "ThreadPool.h"
+
+using namespace std;
+
+// how the triangles around a vertex are weighted
+#define NORMALS_AREA        1
+#define NORMALS_ANGLE       2
+
+class NormalGenerator {
+
+public:
+    // largest angle, in degrees, between triangles whose normals are
+    // averaged, and NORMALS_AREA, NORMALS_ANGLE or both
+    float creaseAngle;
+    int weighting;
+
+    // time taken by the last generate()
+    double generateMs;
+
+private:
+    ThreadPool &pool;
+
+    // per triangle: unit normal, and area; per corner: weight
+    vector<float> faceNormals, areas, weights;
+
+    // corners sorted by vertex: those of vertex v are
+    // corners[first[v] .. first[v+1]-1]
+    vector<uint32_t> first, corners;
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to generate with
+    ///
+    NormalGenerator( ThreadPool &threads );
+
+    ///
+    // generate(positions,vertices,indices,faces,normals) - normals of
+    //     every triangle corner
+    //
+    // @param positions - x, y, z of every vertex
+    // @param vertices  - number of vertices
+    // @param indices   - three vertex indices per triangle, each less
+    //                    than 'vertices'
+    // @param faces     - number of triangles
+    // @param normals   - receives a unit normal (XYZ) per corner, in
+    //                    the order of 'indices'
+    ///
+    void generate( const float *positions, int vertices,
+                   const uint32_t *indices, int faces, float *normals );
+
+};
+
+#endif
@@ -0,0 +1,347 @@
+//
+//  ObjBench.cpp
+//
+//  The .obj reader benchmark (-objbench; see Benchmarks.h): the reader
+//  timed against the old fscanf() one, and checked on every face form
+//  it takes and on some polygons.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Benchmarks.h"
+#include "Shapes.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// legacyObjRead(path,positions,indices) - the loader's old reader, kept
+// to time the new one against: fscanf(), and v//vn triangles only
+///
+static bool legacyObjRead( const char *path, vector<float> &positions,
+                           vector<unsigned int> &indices )
+{
+    FILE *file = fopen( path, "r" );
+    if( file == NULL ) {
+        perror( path );
+        return false;
+    }
+    positions.clear();
+    indices.clear();
+    vector<float> normals;
+    vector<unsigned int> normalIndices;
+    char word[128];
+    while( fscanf( file, "%127s", word ) != EOF ) {
+        float x, y, z;
+        unsigned int v[3], n[3];
+        if( strcmp( word, "v" ) == 0 &&
+            fscanf( file, "%f %f %f\n", &x, &y, &z ) == 3 ) {
+            positions.push_back( x );
+            positions.push_back( y );
+            positions.push_back( z );
+        } else if( strcmp( word, "vn" ) == 0 &&
+                   fscanf( file, "%f %f %f\n", &x, &y, &z ) == 3 ) {
+            normals.push_back( x );
+            normals.push_back( y );
+            normals.push_back( z );
+        } else if( strcmp( word, "f" ) == 0 &&
+                   fscanf( file, "%u//%u %u//%u %u//%u\n", &v[0], &n[0],
+                           &v[1], &n[1], &v[2], &n[2] ) == 6 ) {
+            for( int k = 0; k < 3; k++ ) {
+                indices.push_back( v[k] - 1 );
+                normalIndices.push_back( n[k] - 1 );
+            }
+        }
+    }
+    fclose( file );
+    return true;
+}
+
+///
+// polygonCheck(dir,name,text,normal,triangles,area) - read a made-up
+// .obj file of polygons, and check what they were cut into: the number
+// of triangles, their total area, and that each faces along 'normal'
+///
+static bool polygonCheck( const string &dir, const char *name,
+                          const string &text, const float *normal,
+                          int triangles, double area )
+{
+    string path = dir + "/" + name + ".obj";
+    FILE *file = fopen( path.c_str(), "wb" );
+    if( file == NULL ) {
+        perror( path.c_str() );
+        return false;
+    }
+    fwrite( text.data(), 1, text.size(), file );
+    fclose( file );
+
+    vector<float> positions;
+    vector<unsigned int> indices;
+    if( !loadMeshData( path.c_str(), positions, indices ) ) {
+        printf( "  %-22s cannot be read\n", name );
+        return false;
+    }
+    int found = (int) indices.size() / 3, flipped = 0;
+    double sum = 0.0;
+    for( int f = 0; f < found; f++ ) {
+        const float *a = &positions[3 * indices[3 * f]];
+        const float *b = &positions[3 * indices[3 * f + 1]];
+        const float *c = &positions[3 * indices[3 * f + 2]];
+        double e[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double g[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        double n[3] = { e[1] * g[2] - e[2] * g[1], e[2] * g[0] - e[0] * g[2],
+                        e[0] * g[1] - e[1] * g[0] };
+        sum += 0.5 * sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        flipped += n[0] * normal[0] + n[1] * normal[1] +
+                   n[2] * normal[2] <= 0.0;
+    }
+    bool ok = found == triangles && fabs( sum - area ) < 1.0e-4 * area &&
+              flipped == 0;
+    printf( "  %-22s %4d triangles (%d), area %.4f (%.4f), %d facing away:"
+        " %s\n", name, found, triangles, sum, area, flipped,
+        ok ? "ok" : "FAILED" );
+    return ok;
+}
+
+///
+// objBenchmark() - time the .obj reader against the old one on the file
+// B.path, then write that mesh out in every face format the reader
+// takes, and some polygons, and check that it reads them all back the
+// same
+///
+void objBenchmark( const BenchSettings &B )
+{
+    const char *path = B.path;
+
+    // reading speed, best of a few runs
+    vector<float> positions, normals;
+    vector<unsigned int> indices;
+    const int RUNS = 5;
+    double legacyMs = 1.0e30, fastMs = 1.0e30;
+    for( int r = 0; r < RUNS; r++ ) {
+        uint64_t start = monotonicNs();
+        if( !legacyObjRead( path, positions, indices ) ) {
+            return;
+        }
+        legacyMs = min( legacyMs, elapsedMs( start ) );
+        start = monotonicNs();
+        if( !loadMeshData( path, positions, indices, &normals ) ) {
+            return;
+        }
+        fastMs = min( fastMs, elapsedMs( start ) );
+    }
+    FILE *file = fopen( path, "rb" );
+    fseek( file, 0, SEEK_END );
+    double megabytes = ftell( file ) / 1.0e6;
+    fclose( file );
+
+    int vertices = (int) positions.size() / 3;
+    int faces = (int) indices.size() / 3;
+    printf( "%s: %d vertices, %d triangles, %.2f MB\n", path, vertices,
+        faces, megabytes );
+    printf( "fscanf reader %.2f ms (%.1f MB/s), tokenizer %.2f ms"
+        " (%.1f MB/s): %.1fx\n", legacyMs, megabytes * 1000.0 / legacyMs,
+        fastMs, megabytes * 1000.0 / fastMs, legacyMs / fastMs );
+
+    char dir[] = "/tmp/objbenchXXXXXX";
+    if( mkdtemp( dir ) == NULL ) {
+        perror( "mkdtemp" );
+        return;
+    }
+    vector<string> written;
+    int failed = 0;
+
+    // the mesh in each form: every corner must read back the same
+    // position, and normal where the form has them
+    static const char *forms[] = {
+        "v//vn", "v/vt/vn", "v/vt", "v", "negative v/vt/vn",
+        "groups, CRLF, comments"
+    };
+    printf( "face forms:\n" );
+    for( int form = 0; form < 6; form++ ) {
+        bool hasNormals = form == 0 || form == 1 || form == 4 || form == 5;
+        const char *eol = form == 5 ? "\r\n" : "\n";
+        char name[64];
+        snprintf( name, sizeof(name), "%s/form%d.obj", dir, form );
+        written.push_back( name );
+        FILE *out = fopen( name, "wb" );
+        if( out == NULL ) {
+            perror( name );
+            break;
+        }
+
+        if( form == 5 ) {
+            fprintf( out, "# made by -objbench%smtllib none.mtl%s", eol, eol );
+        }
+        for( int v = 0; v < vertices; v++ ) {
+            const float *p = &positions[3 * v];
+            if( form == 5 ) {
+                fprintf( out, "v\t%.9g %.9g\t%.9g  # %d%s", p[0], p[1], p[2],
+                         v, eol );
+            } else {
+                fprintf( out, "v %.9g %.9g %.9g%s", p[0], p[1], p[2], eol );
+            }
+            if( form == 1 || form == 2 || form == 4 ) {
+                fprintf( out, "vt %.9g %.9g%s", p[0], p[2], eol );
+            }
+        }
+        for( size_t c = 0; hasNormals && c < indices.size(); c++ ) {
+            const float *n = normals.empty() ? &positions[3 * indices[c]] :
+                             &normals[3 * c];
+            fprintf( out, "vn %.9g %.9g %.9g%s", n[0], n[1], n[2], eol );
+        }
+        int groupCount = 0;
+        for( int f = 0; f < faces; f++ ) {
+            if( form == 5 && f % 1000 == 0 ) {
+                fprintf( out, "o part%d%s", f / 1000, eol );
+                fprintf( out, "usemtl m%d%s", f / 1000 % 3, eol );
+                fprintf( out, "s 1%s", eol );
+                groupCount++;
+            }
+            fprintf( out, "f" );
+            for( int k = 0; k < 3; k++ ) {
+                long v = indices[3 * f + k] + 1, n = 3 * f + k + 1;
+                if( form == 4 ) {
+                    // counted back from the last ones written
+                    v -= vertices + 1;
+                    n -= 3 * faces + 1;
+                }
+                if( form == 0 || form == 5 ) {
+                    fprintf( out, " %ld//%ld", v, n );
+                } else if( form == 1 || form == 4 ) {
+                    fprintf( out, " %ld/%ld/%ld", v, v, n );
+                } else if( form == 2 ) {
+                    fprintf( out, " %ld/%ld", v, v );
+                } else {
+                    fprintf( out, " %ld", v );
+                }
+                if( form == 5 && k == 1 ) {
+                    fprintf( out, " \\%s", eol );
+                }
+            }
+            fprintf( out, "%s", eol );
+        }
+        fclose( out );
+
+        vector<float> p2, n2;
+        vector<unsigned int> i2;
+        vector<ObjGroup> groups;
+        bool ok = loadMeshData( name, p2, i2, &n2, &groups ) &&
+                  i2.size() == indices.size() &&
+                  n2.size() == (hasNormals ? 3 * indices.size() : 0) &&
+                  (form != 5 || (int) groups.size() == groupCount);
+        double worst = 0.0;
+        for( size_t c = 0; ok && c < indices.size(); c++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                double a = positions[3 * indices[c] + k];
+                double b = p2[3 * i2[c] + k];
+                worst = max( worst, fabs( a - b ) / max( fabs( a ), 1.0 ) );
+                if( hasNormals ) {
+                    a = normals.empty() ? positions[3 * indices[c] + k] :
+                        normals[3 * c + k];
+                    worst = max( worst, fabs( a - n2[3 * c + k] ) /
+                                        max( fabs( a ), 1.0 ) );
+                }
+            }
+        }
+        ok = ok && worst <= 1.0e-6;
+        failed += !ok;
+        printf( "  %-22s %zu triangles, %zu groups, worst difference %.1e:"
+            " %s\n", forms[form], i2.size() / 3, groups.size(), worst,
+            ok ? "ok" : "FAILED" );
+    }
+
+    // polygons: a grid of quads, a comb that only ear clipping gets
+    // right, and a tilted 12-gon
+    printf( "polygons:\n" );
+    string text;
+    char line[128];
+    const int GRID = 10;
+    for( int z = 0; z <= GRID; z++ ) {
+        for( int x = 0; x <= GRID; x++ ) {
+            snprintf( line, sizeof(line), "v %d 0 %d\n", x, z );
+            text += line;
+        }
+    }
+    for( int z = 0; z < GRID; z++ ) {
+        for( int x = 0; x < GRID; x++ ) {
+            int a = z * (GRID + 1) + x + 1;
+            snprintf( line, sizeof(line), "f %d %d %d %d\n", a, a + GRID + 1,
+                      a + GRID + 2, a + 1 );
+            text += line;
+        }
+    }
+    static const float up[3] = { 0.0f, 1.0f, 0.0f };
+    failed += !polygonCheck( dir, "quad grid", text, up, 2 * GRID * GRID,
+                             GRID * GRID );
+    written.push_back( string( dir ) + "/quad grid.obj" );
+
+    // teeth 1 wide and 2 tall, 1 apart, on a base 1 tall
+    const int TEETH = 6, WIDTH = 2 * TEETH - 1;
+    vector<float> comb;
+    comb.push_back( 0.0f );  comb.push_back( 0.0f );
+    comb.push_back( WIDTH ); comb.push_back( 0.0f );
+    for( int t = TEETH - 1; t >= 0; t-- ) {
+        float right = 2 * t + 1, left = 2 * t;
+        if( t < TEETH - 1 ) {
+            comb.push_back( right ); comb.push_back( 1.0f );
+        }
+        comb.push_back( right ); comb.push_back( 3.0f );
+        comb.push_back( left );  comb.push_back( 3.0f );
+        if( t > 0 ) {
+            comb.push_back( left ); comb.push_back( 1.0f );
+        }
+    }
+    int corners = (int) comb.size() / 2;
+    text = "";
+    for( int i = 0; i < corners; i++ ) {
+        snprintf( line, sizeof(line), "v %g %g 0\n", comb[2 * i],
+                  comb[2 * i + 1] );
+        text += line;
+    }
+    text += "f";
+    for( int i = 0; i < corners; i++ ) {
+        snprintf( line, sizeof(line), " %d", i - corners );
+        text += line;
+    }
+    text += "\n";
+    static const float front[3] = { 0.0f, 0.0f, 1.0f };
+    failed += !polygonCheck( dir, "comb", text, front, corners - 2,
+                             WIDTH + 2.0 * TEETH );
+    written.push_back( string( dir ) + "/comb.obj" );
+
+    // a unit circle's 12-gon, turned about x by 30 degrees
+    const int SIDES = 12;
+    float c30 = cosf( (float) M_PI / 6.0f ), s30 = sinf( (float) M_PI / 6.0f );
+    text = "";
+    for( int i = 0; i < SIDES; i++ ) {
+        float a = 2.0f * (float) M_PI * i / SIDES;
+        snprintf( line, sizeof(line), "v %.9g %.9g %.9g\n", cosf( a ),
+                  sinf( a ) * c30, sinf( a ) * s30 );
+        text += line;
+    }
+    text += "f";
+    for( int i = 0; i < SIDES; i++ ) {
+        snprintf( line, sizeof(line), " %d/%d", i + 1, i + 1 );
+        text += line;
+    }
+    text += "\n";
+    float tilted[3] = { 0.0f, -s30, c30 };
+    failed += !polygonCheck( dir, "12-gon", text, tilted, SIDES - 2,
+                             0.5 * SIDES * sin( 2.0 * M_PI / SIDES ) );
+    written.push_back( string( dir ) + "/12-gon.obj" );
+
+    for( size_t i = 0; i < written.size(); i++ ) {
+        remove( written[i].c_str() );
+    }
+    rmdir( dir );
+    printf( "%s\n", failed == 0 ? "all read back correctly" :
+                                  "SOME FAILED" );
+}
@@ -0,0 +1,487 @@
+//
+//  Occlusion.cpp
+//
+//  Ambient occlusion baker implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "Occlusion.h"
+#include "Simd.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// vertexSeed(v) - random rotation of vertex v's rays, in [0,1)
+///
+static float vertexSeed( uint32_t v )
+{
+    uint32_t x = v * 0x9e3779b9u;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return (x >> 8) * (1.0f / 16777216.0f);
+}
+
+///
+// faceNormal(p,g) - unit normal of the triangle with XYZW corners
+//     p[0..11]; 0 if it has no area
+///
+static void faceNormal( const float *p, float *g )
+{
+    float e1[3], e2[3];
+    for( int k = 0; k < 3; k++ ) {
+        e1[k] = p[4 + k] - p[k];
+        e2[k] = p[8 + k] - p[k];
+    }
+    g[0] = e1[1] * e2[2] - e1[2] * e2[1];
+    g[1] = e1[2] * e2[0] - e1[0] * e2[2];
+    g[2] = e1[0] * e2[1] - e1[1] * e2[0];
+    float len = sqrtf( g[0] * g[0] + g[1] * g[1] + g[2] * g[2] );
+    for( int k = 0; k < 3; k++ ) {
+        g[k] = len > 0.0f ? g[k] / len : 0.0f;
+    }
+}
+
+///
+// triangleBounds(p,grow,lo,hi) - box around the triangle with XYZW
+//     corners p[0..11], grown by 'grow' on every side
+///
+static void triangleBounds( const float *p, float grow, float *lo, float *hi )
+{
+    for( int k = 0; k < 3; k++ ) {
+        lo[k] = min( p[k], min( p[4 + k], p[8 + k] ) ) - grow;
+        hi[k] = max( p[k], max( p[4 + k], p[8 + k] ) ) + grow;
+    }
+}
+
+///
+// Constructor
+///
+OcclusionBaker::OcclusionBaker( ThreadPool &threads ) :
+    rays(256), distance(0.1f), maxEdge(0.05f), buildMs(0.0),
+    pool(threads)
+{
+}
+
+///
+// refine(B,others,count,C) - split an object's triangles if it needs
+//     more vertices
+///
+int OcclusionBaker::refine( BufferSet &B, BufferSet *const *others,
+                            int count, Canvas &C ) const
+{
+    int triangles = B.numElements / 3;
+    float longest = 0.0f;
+    for( int t = 0; t < triangles; t++ ) {
+        const float *p = &B.points[12 * t];
+        for( int i = 0; i < 3; i++ ) {
+            const float *a = &p[4 * i], *b = &p[4 * ((i + 1) % 3)];
+            float d[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+            longest = max( longest, sqrtf( d[0] * d[0] + d[1] * d[1] + d[2] * d[2] ) );
+        }
+    }
+
+    int splits = 0;
+    while( splits < OCC_MAX_SPLITS && longest / (1 << splits) > maxEdge ) {
+        splits++;
+    }
+    if( splits == 0 || (long) triangles << (2 * splits) > OCC_MAX_TRIANGLES ) {
+        return 0;
+    }
+
+    // is any other object's triangle within 'distance' of one of ours?
+    bool near = false;
+    for( int t = 0; t < triangles && !near; t++ ) {
+        float lo[3], hi[3];
+        triangleBounds( &B.points[12 * t], distance, lo, hi );
+        for( int o = 0; o < count && !near; o++ ) {
+            if( others[o] == &B ) {
+                continue;
+            }
+            const BufferSet &O = *others[o];
+            for( int u = 0; u < O.numElements / 3 && !near; u++ ) {
+                float olo[3], ohi[3];
+                triangleBounds( &O.points[12 * u], 0.0f, olo, ohi );
+                near = olo[0] <= hi[0] && ohi[0] >= lo[0] &&
+                       olo[1] <= hi[1] && ohi[1] >= lo[1] &&
+                       olo[2] <= hi[2] && ohi[2] >= lo[2];
+            }
+        }
+    }
+    if( !near ) {
+        return 0;
+    }
+
+    // every triangle becomes a grid of 4^splits, with the corners'
+    // attributes interpolated across it; all edges are cut alike, so
+    // neighboring triangles still meet at every vertex.  A Canvas
+    // gives textured triangles their face normals, so their normals
+    // need no interpolating.
+    int k = 1 << splits;
+    C.clear();
+    for( int t = 0; t < triangles; t++ ) {
+        auto corner = [&]( int i, int j, Vertex &p, Vertex &a ) {
+            float b[3] = { 1.0f - (float) (i + j) / k, (float) i / k, (float) j / k };
+            float v[3][3] = { { 0.0f } };
+            for( int c = 0; c < 3; c++ ) {
+                int s = 3 * t + c;
+                for( int m = 0; m < 3; m++ ) {
+                    v[0][m] += b[c] * B.points[4 * s + m];
+                    if( !B.normals.empty() ) {
+                        v[1][m] += b[c] * B.normals[3 * s + m];
+                    }
+                }
+                if( !B.uv.empty() ) {
+                    v[2][0] += b[c] * B.uv[2 * s];
+                    v[2][1] += b[c] * B.uv[2 * s + 1];
+                }
+            }
+            p.x = v[0][0];
+            p.y = v[0][1];
+            p.z = v[0][2];
+            int attribute = B.uv.empty() ? 1 : 2;
+            a.x = v[attribute][0];
+            a.y = v[attribute][1];
+            a.z = v[attribute][2];
+        };
+        auto add = [&]( int i0, int j0, int i1, int j1, int i2, int j2 ) {
+            Vertex p[3], a[3];
+            corner( i0, j0, p[0], a[0] );
+            corner( i1, j1, p[1], a[1] );
+            corner( i2, j2, p[2], a[2] );
+            if( !B.uv.empty() ) {
+                C.addTriangleWithUV( p[0], a[0], p[1], a[1], p[2], a[2] );
+            } else if( !B.normals.empty() ) {
+                C.addTriangleWithNorms( p[0], a[0], p[1], a[1], p[2], a[2] );
+            } else {
+                C.addTriangle( p[0], p[1], p[2] );
+            }
+        };
+        for( int i = 0; i < k; i++ ) {
+            for( int j = 0; i + j < k; j++ ) {
+                add( i, j, i + 1, j, i, j + 1 );
+                if( i + j + 1 < k ) {
+                    add( i + 1, j, i + 1, j + 1, i, j + 1 );
+                }
+            }
+        }
+    }
+    B.createBuffers( C );
+
+    return splits;
+}
+
+///
+// build(sets,count) - collect the triangles of every object
+///
+void OcclusionBaker::build( BufferSet *const *sets, int count )
+{
+    uint64_t start = monotonicNs();
+
+    objects.assign( sets, sets + count );
+    vector<float> positions;
+    for( int o = 0; o < count; o++ ) {
+        const BufferSet &B = *sets[o];
+        for( int v = 0; v < B.numElements; v++ ) {
+            positions.insert( positions.end(), &B.points[4 * v], &B.points[4 * v + 3] );
+        }
+    }
+    bvh.build( positions.data(), positions.size() / 9 );
+
+    // Hammersley points (i / n, and i with its bits reversed), cosine
+    // distributed over the hemisphere
+    int n = (max( rays, 1 ) + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+    for( int k = 0; k < 3; k++ ) {
+        directions[k].resize( n );
+    }
+    for( int i = 0; i < n; i++ ) {
+        uint32_t r = i;
+        r = (r << 16) | (r >> 16);
+        r = ((r & 0x55555555u) << 1) | ((r & 0xaaaaaaaau) >> 1);
+        r = ((r & 0x33333333u) << 2) | ((r & 0xccccccccu) >> 2);
+        r = ((r & 0x0f0f0f0fu) << 4) | ((r & 0xf0f0f0f0u) >> 4);
+        r = ((r & 0x00ff00ffu) << 8) | ((r & 0xff00ff00u) >> 8);
+        float u = (i + 0.5f) / n, phi = 6.2831853f * r * 2.3283064e-10f;
+        float radius = sqrtf( u );
+        directions[0][i] = radius * cosf( phi );
+        directions[1][i] = radius * sinf( phi );
+        directions[2][i] = sqrtf( 1.0f - u );
+    }
+
+    buildMs = elapsedMs( start );
+}
+
+///
+// vertexOcclusion(p,n,seed) - fraction of the rays from point p around
+//     normal n that escape
+///
+float OcclusionBaker::vertexOcclusion( const float *p, const float *n,
+                                       uint32_t seed ) const
+{
+    float len = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+    if( len == 0.0f ) {
+        return 1.0f;
+    }
+    float nx = n[0] / len, ny = n[1] / len, nz = n[2] / len;
+
+    // Duff et al.'s basis around the normal, turned by a random angle
+    // so neighboring vertices don't share their gaps between rays
+    float sign = copysignf( 1.0f, nz );
+    float a = -1.0f / (sign + nz);
+    float b = nx * ny * a;
+    float t[3] = { 1.0f + sign * nx * nx * a, sign * b, -sign * nx };
+    float s[3] = { b, sign + ny * ny * a, -ny };
+    float angle = 6.2831853f * vertexSeed( seed );
+    float c = cosf( angle ), d = sinf( angle );
+    SimdFloat tx( c * t[0] + d * s[0] ), ty( c * t[1] + d * s[1] ), tz( c * t[2] + d * s[2] );
+    SimdFloat sx( c * s[0] - d * t[0] ), sy( c * s[1] - d * t[1] ), sz( c * s[2] - d * t[2] );
+
+    RayPacket R;
+    R.ox = SimdFloat( p[0] + OCC_OFFSET * nx );
+    R.oy = SimdFloat( p[1] + OCC_OFFSET * ny );
+    R.oz = SimdFloat( p[2] + OCC_OFFSET * nz );
+    R.tMin = SimdFloat( 0.0f );
+    R.tMax = SimdFloat( distance );
+    R.active = nonNegative( laneIndex() );
+
+    int hits = 0, total = directions[0].size();
+    for( int i = 0; i < total; i += SIMD_WIDTH ) {
+        SimdFloat u = loadFloat( &directions[0][i] );
+        SimdFloat v = loadFloat( &directions[1][i] );
+        SimdFloat w = loadFloat( &directions[2][i] );
+        R.dx = fmadd( u, tx, fmadd( v, sx, w * SimdFloat( nx ) ) );
+        R.dy = fmadd( u, ty, fmadd( v, sy, w * SimdFloat( ny ) ) );
+        R.dz = fmadd( u, tz, fmadd( v, sz, w * SimdFloat( nz ) ) );
+        hits += __builtin_popcount( bits( bvh.occluded( R ) ) );
+    }
+
+    return 1.0f - (float) hits / total;
+}
+
+///
+// bake(object,values) - occlusion of every vertex of one object
+///
+double OcclusionBaker::bake( int object, vector<float> &values ) const
+{
+    uint64_t start = monotonicNs();
+    const BufferSet &B = *objects[object];
+    int n = B.numElements;
+
+    // which way is out: textured shapes are lit on both sides, and
+    // closed ones wound inside out (with a negative volume, like the
+    // slab) have their normals pointing in
+    bool twoSided = !B.uv.empty();
+    double volume = 0.0;
+    for( int t = 0; t < n / 3; t++ ) {
+        const float *a = &B.points[12 * t], *b = a + 4, *c = a + 8;
+        volume += a[0] * (b[1] * c[2] - b[2] * c[1]) +
+                  a[1] * (b[2] * c[0] - b[0] * c[2]) +
+                  a[2] * (b[0] * c[1] - b[1] * c[0]);
+    }
+    float out = !twoSided && volume < 0.0 ? -1.0f : 1.0f;
+
+    // every corner's position and unit outward normal; the face's if
+    // the shape has none, or if the corner's points into the face
+    vector<float> keys( 6 * n );
+    for( int t = 0; t < n / 3; t++ ) {
+        float g[3];
+        faceNormal( &B.points[12 * t], g );
+        for( int i = 0; i < 3; i++ ) {
+            int c = 3 * t + i;
+            float *k = &keys[6 * c];
+            memcpy( k, &B.points[4 * c], 3 * sizeof(float) );
+            memcpy( k + 3, g, 3 * sizeof(float) );
+            if( !B.normals.empty() ) {
+                const float *v = &B.normals[3 * c];
+                float len = sqrtf( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+                if( len > 0.0f && v[0] * g[0] + v[1] * g[1] + v[2] * g[2] > 0.0f ) {
+                    for( int m = 0; m < 3; m++ ) {
+                        k[3 + m] = v[m] / len;
+                    }
+                }
+            }
+            for( int m = 3; m < 6; m++ ) {
+                k[m] *= out;
+            }
+        }
+    }
+
+    // one vertex per distinct key
+    vector<int> order( n ), first, vertexOf( n );
+    for( int c = 0; c < n; c++ ) {
+        order[c] = c;
+    }
+    sort( order.begin(), order.end(), [&]( int x, int y ) {
+        return lexicographical_compare( &keys[6 * x], &keys[6 * x + 6],
+                                        &keys[6 * y], &keys[6 * y + 6] );
+    } );
+    for( int i = 0; i < n; i++ ) {
+        int c = order[i];
+        if( first.empty() ||
+            memcmp( &keys[6 * c], &keys[6 * first.back()], 6 * sizeof(float) ) != 0 ) {
+            first.push_back( c );
+        }
+        vertexOf[c] = first.size() - 1;
+    }
+
+    vector<float> shared( first.size() );
+    pool.parallelFor( first.size(), [&]( int v, int ) {
+        const float *k = &keys[6 * first[v]];
+        float value = vertexOcclusion( k, k + 3, v );
+        if( twoSided ) {
+            float back[3] = { -k[3], -k[4], -k[5] };
+            value = min( value, vertexOcclusion( k, back, v ) );
+        }
+        shared[v] = value;
+    } );
+
+    values.resize( n );
+    for( int c = 0; c < n; c++ ) {
+        values[c] = shared[vertexOf[c]];
+    }
+
+    return elapsedMs( start );
+}
+
+///
+// sceneKey() - hash of everything the values depend on
+///
+uint64_t OcclusionBaker::sceneKey( void ) const
+{
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&]( const void *p, size_t n ) {
+        for( size_t i = 0; i < n; i++ ) {
+            h = (h ^ ((const unsigned char *) p)[i]) * 0x100000001b3ull;
+        }
+    };
+
+    int header[2] = { (int) directions[0].size(), (int) objects.size() };
+    add( header, sizeof(header) );
+    add( &distance, sizeof(distance) );
+
+    for( size_t o = 0; o < objects.size(); o++ ) {
+        const BufferSet &B = *objects[o];
+        int32_t shape[2] = { B.numElements, (int32_t) B.normals.size() };
+        add( shape, sizeof(shape) );
+        add( B.points.data(), B.points.size() * sizeof(float) );
+        add( B.normals.data(), B.normals.size() * sizeof(float) );
+    }
+
+    return h;
+}
+
+///
+// load(path,values) - the values of every object, from a cache file
+///
+bool OcclusionBaker::load( const char *path,
+                           vector< vector<float> > &values ) const
+{
+    FILE *fp = fopen( path, "rb" );
+    if( fp == NULL ) {
+        perror( path );
+        return false;
+    }
+
+    size_t vertices = 0;
+    for( size_t o = 0; o < objects.size(); o++ ) {
+        vertices += objects[o]->numElements;
+    }
+
+    OcclusionCache H;
+    if( fread( &H, sizeof(H), 1, fp ) != 1 || H.magic != OCC_MAGIC ||
+        H.version != OCC_VERSION ) {
+        cerr << "OcclusionBaker: " << path << " is not a version " <<
+            OCC_VERSION << " cache" << endl;
+        fclose( fp );
+        return false;
+    }
+    if( H.objects != objects.size() || H.vertices != vertices ||
+        H.sceneKey != sceneKey() ) {
+        cerr << "OcclusionBaker: " << path << " is for another scene" << endl;
+        fclose( fp );
+        return false;
+    }
+
+    vector< vector<float> > loaded( objects.size() );
+    for( size_t o = 0; o < objects.size(); o++ ) {
+        loaded[o].resize( objects[o]->numElements );
+        if( fread( loaded[o].data(), sizeof(float), loaded[o].size(), fp ) !=
+            loaded[o].size() ) {
+            cerr << "OcclusionBaker: " << path << " is too short" << endl;
+            fclose( fp );
+            return false;
+        }
+    }
+    fclose( fp );
+
+    values.swap( loaded );
+    return true;
+}
+
+///
+// save(path,values) - write the values of every object to a cache file,
+// through a uniquely named file beside it that is then renamed over it,
+// so concurrent savers never write the same file
+///
+bool OcclusionBaker::save( const char *path,
+                           const vector< vector<float> > &values ) const
+{
+    string temporary = string( path ) + ".XXXXXX";
+    int fd = mkstemp( &temporary[0] );
+    if( fd < 0 ) {
+        perror( path );
+        return false;
+    }
+    FILE *fp = fdopen( fd, "wb" );
+    if( fp == NULL || fchmod( fd, 0644 ) != 0 ) {
+        perror( temporary.c_str() );
+        if( fp != NULL ) {
+            fclose( fp );
+        } else {
+            close( fd );
+        }
+        unlink( temporary.c_str() );
+        return false;
+    }
+
+    OcclusionCache H;
+    memset( &H, 0, sizeof(H) );
+    H.magic = OCC_MAGIC;
+    H.version = OCC_VERSION;
+    H.objects = values.size();
+    for( size_t o = 0; o < values.size(); o++ ) {
+        H.vertices += values[o].size();
+    }
+    H.sceneKey = sceneKey();
+
+    bool ok = fwrite( &H, sizeof(H), 1, fp ) == 1;
+    for( size_t o = 0; o < values.size() && ok; o++ ) {
+        ok = fwrite( values[o].data(), sizeof(float), values[o].size(), fp ) ==
+             values[o].size();
+    }
+    ok = ok && fflush( fp ) == 0 && fsync( fileno( fp ) ) == 0;
+    if( fclose( fp ) != 0 ) {
+        ok = false;
+    }
+    if( !ok || rename( temporary.c_str(), path ) != 0 ) {
+        perror( path );
+        unlink( temporary.c_str() );
+        return false;
+    }
+
+    return true;
+}
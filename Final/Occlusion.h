@@ -0,0 +1,155 @@
+//
+//  Occlusion.h
+//
+//  Per-vertex ambient occlusion of the scene, baked on the CPU.
+//
+//  build() puts the triangles of every object, in model space, into
+//  one BVH.  bake() then casts 'rays' cosine-distributed rays over the
+//  hemisphere above each vertex of an object, SIMD_WIDTH at a time on
+//  the ThreadPool, and keeps the fraction that travel 'distance'
+//  without hitting anything: the share of uniform ambient light that
+//  reaches the vertex.  The shaders scale the ambient term by it.
+//  Corners of different triangles at the same position with the same
+//  normal are one vertex, so they get the same value and the shading
+//  has no seams.  Textured shapes are lit on both sides (texture.frag),
+//  so their vertices get the darker of their two sides; closed shapes
+//  whose triangles face inward, like the slab, are baked from outside.
+//
+//  Per-vertex values can only show contact shadows where there are
+//  vertices, and the table cloth, slab and cheese are a handful of
+//  large triangles.  refine() splits every triangle of such an object
+//  into four, as often as it takes to make none longer than 'maxEdge'
+//  (at most OCC_MAX_SPLITS times), if one of them comes within
+//  'distance' of another object and the result has no more than
+//  OCC_MAX_TRIANGLES; the surface itself does not change.
+//
+//  The objects must keep their relative placement for the result to
+//  hold.  All but the room turn together, so only occlusion between
+//  the room and the rest is off once they are rotated; an object
+//  selected and turned on its own loses its contact shadows.
+//
+//  CACHE FILE (native byte order): an OcclusionCache header, then the
+//  values of every object given to build(), in order.
+//
+
+#ifndef _OCCLUSION_H_
+#define _OCCLUSION_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Buffers.h"
+#include "Bvh.h"
+#include "Canvas.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// "AOCK" and the current layout version
+#define OCC_MAGIC           0x4b434f41u
+#define OCC_VERSION         1
+
+// most times refine() splits an object's triangles, and the most
+// triangles it leaves the object with
+#define OCC_MAX_SPLITS      5
+#define OCC_MAX_TRIANGLES   16384
+
+// how far off the surface the rays start, in model units
+#define OCC_OFFSET          1e-4f
+
+///
+// Cache file header
+///
+typedef struct OcclusionCache {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t objects;
+    uint32_t vertices;      // total over all objects
+    uint64_t sceneKey;      // OcclusionBaker::sceneKey() of the values
+} OcclusionCache;
+
+class OcclusionBaker {
+
+public:
+    // rays per vertex (rounded up to a multiple of SIMD_WIDTH), how far
+    // an occluder can be, and how long refine() leaves triangles; both
+    // lengths are in model units
+    int rays;
+    float distance;
+    float maxEdge;
+
+    // time taken by the last build()
+    double buildMs;
+
+private:
+    ThreadPool &pool;
+    vector<const BufferSet *> objects;
+    Bvh bvh;
+
+    // the rays' directions around +Z
+    vector<float> directions[3];
+
+    uint64_t sceneKey( void ) const;
+    float vertexOcclusion( const float *p, const float *n, uint32_t seed ) const;
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to bake with
+    ///
+    OcclusionBaker( ThreadPool &threads );
+
+    ///
+    // refine(B,others,count,C) - split an object's triangles if it needs
+    //     more vertices to show the occlusion of other objects
+    //
+    // @param B      - the object; its buffers are made again if split
+    // @param others - every object in the scene (B may be among them)
+    // @param count  - number of objects
+    // @param C      - a Canvas to build the split shape in
+    //
+    // @return the number of times the triangles were split
+    ///
+    int refine( BufferSet &B, BufferSet *const *others, int count,
+                Canvas &C ) const;
+
+    ///
+    // build(sets,count) - collect the triangles of every object
+    //
+    // @param sets  - the objects
+    // @param count - number of objects
+    ///
+    void build( BufferSet *const *sets, int count );
+
+    ///
+    // bake(object,values) - occlusion of every vertex of one object
+    //
+    // @param object - its index in the sets given to build()
+    // @param values - filled with one value per vertex, from 0 (no
+    //                 ambient light) to 1
+    //
+    // @return milliseconds taken
+    ///
+    double bake( int object, vector<float> &values ) const;
+
+    ///
+    // load(path,values) - the values of every object, from a cache
+    //     file written for the same objects and settings
+    //
+    // @return true on success
+    ///
+    bool load( const char *path, vector< vector<float> > &values ) const;
+
+    ///
+    // save(path,values) - write the values of every object to a cache
+    //     file
+    //
+    // @return true on success
+    ///
+    bool save( const char *path, const vector< vector<float> > &values ) const;
+
+};
+
+#endif
@@ -0,0 +1,211 @@
+//
+//  PathTraceRun.cpp
+//
+//  The path traced still (-pathtrace; see Benchmarks.h), and the steps
+//  of a path-traced render that the denoiser benchmark shares: starting
+//  or continuing one, refining it until done and denoising it.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <vector>
+
+#include <unistd.h>
+
+#include "Benchmarks.h"
+#include "Denoiser.h"
+#include "PathTracer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+
+using namespace std;
+
+// set by SIGINT/SIGTERM to end a path-traced render early
+static volatile bool traceStop = false;
+
+///
+// stopTracing() - SIGINT/SIGTERM handler of the path-traced renders
+///
+static void stopTracing( int )
+{
+    traceStop = true;
+}
+
+///
+// writeImage(path,pixels,w,h) - save a frame (bottom row first) as a
+// binary PPM
+///
+static bool writeImage( const char *path, const uint32_t *pixels, int w,
+                        int h )
+{
+    FILE *fp = fopen( path, "wb" );
+    if( fp == NULL ) {
+        perror( path );
+        return false;
+    }
+    fprintf( fp, "P6\n%d %d\n255\n", w, h );
+    for( int y = h - 1; y >= 0; y-- ) {
+        for( int x = 0; x < w; x++ ) {
+            fwrite( &pixels[(size_t) y * w + x], 1, 3, fp );
+        }
+    }
+    return fclose( fp ) == 0;
+}
+
+///
+// refineUntilDone(T,B,targetMs) - run a path tracer until every pixel
+// has enough samples or a signal stops it, reporting progress every few
+// seconds and saving to B.checkpoint (if set) every B.every seconds and
+// at the end
+//
+// @param targetMs - set to the tracing time (as in T.renderMs) at which
+//                   the mean noise first fell to T.targetNoise, or -1 if
+//                   it never did
+// @return false if a signal stopped it
+///
+bool refineUntilDone( PathTracer &T, const BenchSettings &B,
+                      double *targetMs )
+{
+    *targetMs = -1.0;
+    uint64_t lastReport = monotonicNs(), lastSave = monotonicNs();
+    while( !traceStop && T.refine() ) {
+        if( *targetMs < 0.0 && T.noise <= T.targetNoise ) {
+            *targetMs = T.renderMs;
+        }
+        if( elapsedMs( lastReport ) >= 5000.0 ) {
+            printf( "pass %5d  %6.1f s  %8.1f samples/pixel  noise %.4f"
+                "  %d pixels sampling\n", T.passes, T.renderMs / 1000.0,
+                (double) T.samples / T.sums.size(), T.noise,
+                T.activePixels );
+            fflush( stdout );
+            lastReport = monotonicNs();
+        }
+        if( B.checkpoint != NULL &&
+            elapsedMs( lastSave ) >= B.every * 1000.0 ) {
+            T.save( B.checkpoint );
+            lastSave = monotonicNs();
+        }
+    }
+
+    if( B.checkpoint != NULL && T.save( B.checkpoint ) ) {
+        printf( "checkpoint saved to %s\n", B.checkpoint );
+    }
+    if( traceStop ) {
+        printf( "stopped after pass %d\n", T.passes );
+        return false;
+    }
+    return true;
+}
+
+///
+// startPathTracer(T,B) - size a path tracer to B.width x B.height,
+// continue from B.checkpoint if that exists, and give it the scene
+//
+// @return false on error
+///
+bool startPathTracer( PathTracer &T, const BenchSettings &B )
+{
+    if( !T.resize( B.width, B.height ) ) {
+        return false;
+    }
+    if( B.checkpoint != NULL && access( B.checkpoint, F_OK ) == 0 ) {
+        if( !T.load( B.checkpoint ) ) {
+            return false;
+        }
+        printf( "continuing %s: %d passes, %.0f s of tracing\n",
+            B.checkpoint, T.passes, T.renderMs / 1000.0 );
+    }
+
+    queueScene( T );
+    signal( SIGINT, stopTracing );
+    signal( SIGTERM, stopTracing );
+    return true;
+}
+
+///
+// denoise(T,D,out) - filter a path tracer's image so far with a
+// Denoiser, guided by the scene's first hits
+//
+// @param T   - the path tracer
+// @param D   - the denoiser
+// @param out - w*h RGB triples
+// @return milliseconds taken, guides included
+///
+double denoise( PathTracer &T, Denoiser &D, float *out )
+{
+    size_t count = (size_t) T.width * T.height;
+    vector<float> rgb( 3 * count ), variance( count );
+    vector<float> albedo( 3 * count ), normal( 3 * count ), depth( count );
+
+    T.estimate( rgb.data(), variance.data() );
+
+    uint64_t start = monotonicNs();
+    T.renderGuides( albedo.data(), normal.data(), depth.data() );
+    bool rough = T.samples < DENOISE_MIN_SAMPLES * count;
+    D.filter( T.width, T.height, rgb.data(), rough ? NULL : variance.data(),
+              albedo.data(), normal.data(), depth.data(), out );
+    return elapsedMs( start );
+}
+
+///
+// pathTrace() - path trace the still life at B.width x B.height into
+// the PPM image B.path, denoised if B.denoise is set, and report the
+// sampling rate and how long the image took to reach the target noise.
+///
+void pathTrace( const BenchSettings &B )
+{
+    int w = B.width, h = B.height;
+    if( !initCPU() ) {
+        return;
+    }
+    const SceneParts &P = sceneParts();
+
+    PathTracer T( *P.cpuPool );
+    T.maxSamples = B.samples;
+    T.minSamples = min( T.minSamples, B.samples );
+    T.targetNoise = B.noise;
+    if( !startPathTracer( T, B ) ) {
+        return;
+    }
+
+    printf( "path tracer: %dx%d, %d threads, %d to %d samples per pixel,"
+        " target noise %.3f\n", w, h, P.cpuPool->size(), T.minSamples,
+        T.maxSamples, T.targetNoise );
+
+    double targetMs;
+    refineUntilDone( T, B, &targetMs );
+
+    if( B.denoise ) {
+        Denoiser D( *P.cpuPool );
+        vector<float> rgb( 3 * (size_t) w * h );
+        double ms = denoise( T, D, rgb.data() );
+        for( size_t p = 0; p < T.pixels.size(); p++ ) {
+            uint32_t packed = 0xff000000u;
+            for( int c = 0; c < 3; c++ ) {
+                packed |= (uint32_t) lrintf( min( max( rgb[3 * p + c], 0.0f ),
+                                                  1.0f ) * 255.0f ) << (8 * c);
+            }
+            T.pixels[p] = packed;
+        }
+        printf( "denoised in %.1f ms, %.1f ms of it filtering\n", ms,
+            D.filterMs );
+    }
+    if( !writeImage( B.path, T.pixels.data(), w, h ) ) {
+        return;
+    }
+
+    double seconds = T.renderMs / 1000.0;
+    printf( "%d passes, %.1f samples/pixel in %.1f s; %s written\n",
+        T.passes, (double) T.samples / ((double) w * h), seconds, B.path );
+    printf( "%.0f samples/s per core, mean noise %.4f\n",
+        T.samples / seconds / P.cpuPool->size(), T.noise );
+    if( targetMs >= 0.0 ) {
+        printf( "time to target noise %.3f: %.1f s\n", B.noise,
+            targetMs / 1000.0 );
+    } else {
+        printf( "target noise %.3f not reached\n", B.noise );
+    }
+}
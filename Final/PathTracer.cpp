@@ -0,0 +1,528 @@
+//
+//  PathTracer.cpp
+//
+//  Progressive path tracer implementation.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+
+#include "PathTracer.h"
+#include "Simd.h"
+#include "Timing.h"
+
+using namespace std;
+
+// weights of R, G and B in a pixel's brightness
+static const float brightnessWeight[3] = { 0.2126f, 0.7152f, 0.0722f };
+
+///
+// seed(pixel,sample,sequence) - random number state for one sample of
+//     a pixel
+///
+static uint32_t seed( uint32_t pixel, uint32_t sample, uint32_t sequence )
+{
+    uint32_t x = pixel * 0x9e3779b9u ^ sample * 0x85ebca6bu ^
+                 sequence * 0xc2b2ae35u;
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+///
+// uniform(state) - next number in [0,1) of a PCG generator
+///
+static float uniform( uint32_t &state )
+{
+    state = state * 747796405u + 2891336453u;
+    uint32_t word = ((state >> ((state >> 28) + 4)) ^ state) * 277803737u;
+    return (((word >> 22) ^ word) >> 8) * (1.0f / 16777216.0f);
+}
+
+///
+// Constructor
+///
+PathTracer::PathTracer( ThreadPool &threads ) :
+    RayTracer( threads ), minSamples(16), maxSamples(1024),
+    targetNoise(0.02f), maxDepth(6), sequence(0), passes(0), samples(0),
+    activePixels(0), noise(1.0), renderMs(0.0), sumsKey(0),
+    sampleCount(0)
+{
+}
+
+///
+// sceneKey() - hash of everything the samples depend on
+///
+uint64_t PathTracer::sceneKey( void ) const
+{
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto add = [&]( const void *p, size_t n ) {
+        for( size_t i = 0; i < n; i++ ) {
+            h = (h ^ ((const unsigned char *) p)[i]) * 0x100000001b3ull;
+        }
+    };
+
+    int header[5] = { width, height, maxDepth, shadows, (int) sequence };
+    add( header, sizeof(header) );
+    add( eyePoint, sizeof(eyePoint) );
+    add( camera, sizeof(camera) );
+    add( frustum, sizeof(frustum) );
+    add( light, sizeof(light) );
+    add( lightColor, sizeof(lightColor) );
+
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        const Draw &D = draws[d];
+        int32_t shape[3] = { D.buffers->numElements,
+                             D.texture ? D.texture->width[0] : 0,
+                             D.texture ? D.texture->height[0] : 0 };
+        add( shape, sizeof(shape) );
+        add( D.material, sizeof(*D.material) );
+        add( D.model, sizeof(D.model) );
+    }
+
+    return h;
+}
+
+///
+// pixelNoise(P) - standard error of a pixel's brightness relative to
+//     the brightness; 1 until it has two samples
+///
+float PathTracer::pixelNoise( const PixelSum &P ) const
+{
+    if( P.samples < 2 ) {
+        return 1.0f;
+    }
+
+    float n = P.samples;
+    float mean = 0.0f;
+    for( int c = 0; c < 3; c++ ) {
+        mean += brightnessWeight[c] * P.color[c];
+    }
+    mean /= n;
+
+    float variance = max( P.brightness2 / n - mean * mean, 0.0f ) *
+                     n / (n - 1.0f);
+    return sqrtf( variance / n ) / max( mean, PT_DARK );
+}
+
+///
+// reset() - discard the samples so far
+///
+void PathTracer::reset( void )
+{
+    PixelSum empty = { { 0.0f, 0.0f, 0.0f }, 0.0f, 0 };
+    sums.assign( (size_t) width * height, empty );
+    passes = 0;
+    samples = 0;
+    renderMs = 0.0;
+}
+
+///
+// countActive() - find the pixels that need more samples, order the
+//     tiles with any busiest first, and show the current estimate
+///
+void PathTracer::countActive( void )
+{
+    tileActive.assign( tilesX * tilesY, 0 );
+    tileNoise.assign( tilesX * tilesY, 0.0 );
+
+    pool.parallelFor( tilesX * tilesY, [&]( int tile, int ) {
+        int tx0 = (tile % tilesX) * RT_TILE;
+        int ty0 = (tile / tilesX) * RT_TILE;
+        int tx1 = min( tx0 + RT_TILE, width );
+        int ty1 = min( ty0 + RT_TILE, height );
+
+        for( int y = ty0; y < ty1; y++ ) {
+            for( int x = tx0; x < tx1; x++ ) {
+                size_t p = (size_t) y * width + x;
+                const PixelSum &P = sums[p];
+                float error = min( pixelNoise( P ), 1.0f );
+                tileNoise[tile] += error;
+                if( (int) P.samples < minSamples ||
+                    ((int) P.samples < maxSamples && error > targetNoise) ) {
+                    tileActive[tile]++;
+                }
+
+                uint32_t packed = 0xff000000u;
+                for( int c = 0; c < 3; c++ ) {
+                    float v = P.samples ? P.color[c] / P.samples : 0.0f;
+                    packed |= (uint32_t) lrintf( min( max( v, 0.0f ), 1.0f ) *
+                                                 255.0f ) << (8 * c);
+                }
+                pixels[p] = packed;
+            }
+        }
+    } );
+
+    activePixels = 0;
+    noise = 0.0;
+    tileOrder.clear();
+    for( int t = 0; t < tilesX * tilesY; t++ ) {
+        activePixels += tileActive[t];
+        noise += tileNoise[t];
+        if( tileActive[t] > 0 ) {
+            tileOrder.push_back( t );
+        }
+    }
+    noise /= (double) width * height;
+
+    stable_sort( tileOrder.begin(), tileOrder.end(), [&]( int a, int b ) {
+        return tileActive[a] > tileActive[b];
+    } );
+}
+
+///
+// tracePaths(tile) - one path for each pixel of a tile that needs one
+///
+void PathTracer::tracePaths( int tile )
+{
+    int tx0 = (tile % tilesX) * RT_TILE;
+    int ty0 = (tile / tilesX) * RT_TILE;
+    int tx1 = min( tx0 + RT_TILE, width );
+    int ty1 = min( ty0 + RT_TILE, height );
+
+    uint64_t traced = 0, shadowRays = 0;
+    SimdFloat zero( 0.0f ), one( 1.0f );
+
+    for( int y = ty0; y < ty1; y += 2 ) {
+        for( int x = tx0; x < tx1; x += 4 ) {
+
+            // the pixels of the 4x2 block at (x,y) that need a sample,
+            // each through a random point of the pixel
+            int32_t need[SIMD_WIDTH];
+            size_t pixel[SIMD_WIDTH];
+            uint32_t rng[SIMD_WIDTH];
+            float sx[SIMD_WIDTH], sy[SIMD_WIDTH];
+            int count = 0;
+            for( int i = 0; i < SIMD_WIDTH; i++ ) {
+                int px = x + (i & 3), py = y + (i >> 2);
+                need[i] = 0;
+                pixel[i] = 0;
+                sx[i] = sy[i] = 0.5f;
+                if( px >= tx1 || py >= ty1 ) {
+                    continue;
+                }
+                pixel[i] = (size_t) py * width + px;
+                const PixelSum &P = sums[pixel[i]];
+                if( (int) P.samples < minSamples ||
+                    ((int) P.samples < maxSamples &&
+                     pixelNoise( P ) > targetNoise) ) {
+                    need[i] = 1;
+                    count++;
+                    rng[i] = seed( pixel[i], P.samples, sequence );
+                    sx[i] = px + uniform( rng[i] );
+                    sy[i] = py + uniform( rng[i] );
+                }
+            }
+            if( count == 0 ) {
+                continue;
+            }
+
+            RayPacket R;
+            primaryPacket( loadFloat( sx ), loadFloat( sy ), R );
+            R.active = loadInt( need ) > SimdInt( 0 );
+
+            SimdFloat weight[3] = { one, one, one };
+            SimdFloat radiance[3] = { zero, zero, zero };
+            SimdFloat travelled = zero;
+
+            for( int depth = 0; depth < maxDepth && any( R.active ); depth++ ) {
+                PacketHit H;
+                bvh.intersect( R, H );
+                if( !any( H.hit ) ) {
+                    break;
+                }
+
+                Surface S;
+                findSurface( R, H, S );
+
+                // every surface is two-sided: turn the normals to face
+                // the ray
+                SimdMask back = S.facing > zero;
+                S.nx = select( back, -S.nx, S.nx );
+                S.ny = select( back, -S.ny, S.ny );
+                S.nz = select( back, -S.nz, S.nz );
+                S.gx = select( back, -S.gx, S.gx );
+                S.gy = select( back, -S.gy, S.gy );
+                S.gz = select( back, -S.gz, S.gz );
+
+                // the light reaching the hit straight from the source
+                SimdFloat local[4], tex[4];
+                directLight( S, unshadowed( S, shadowRays ), local );
+                SimdFloat distance = fmadd( H.t, S.length, travelled );
+                textureColor( S, distance, tex );
+                for( int c = 0; c < 3; c++ ) {
+                    radiance[c] = select( H.hit,
+                        fmadd( weight[c], local[c] * tex[c], radiance[c] ),
+                        radiance[c] );
+                }
+                if( depth + 1 == maxDepth ) {
+                    break;
+                }
+
+                // continue in the mirror direction with probability
+                // mirrorCoeff, and otherwise in a cosine-distributed
+                // diffuse direction, weighted by the surface's albedo
+                float nx[SIMD_WIDTH], ny[SIMD_WIDTH], nz[SIMD_WIDTH];
+                float gx[SIMD_WIDTH], gy[SIMD_WIDTH], gz[SIMD_WIDTH];
+                float dx[SIMD_WIDTH], dy[SIMD_WIDTH], dz[SIMD_WIDTH];
+                float mirror[SIMD_WIDTH], w[3][SIMD_WIDTH], albedo[3][SIMD_WIDTH];
+                int32_t alive[SIMD_WIDTH];
+
+                SimdFloat twoVN = SimdFloat( -2.0f ) *
+                                  dot( S.vx, S.vy, S.vz, S.nx, S.ny, S.nz );
+                storeFloat( dx, fmadd( twoVN, S.nx, S.vx ) );
+                storeFloat( dy, fmadd( twoVN, S.ny, S.vy ) );
+                storeFloat( dz, fmadd( twoVN, S.nz, S.vz ) );
+                storeFloat( nx, S.nx );
+                storeFloat( ny, S.ny );
+                storeFloat( nz, S.nz );
+                storeFloat( gx, S.gx );
+                storeFloat( gy, S.gy );
+                storeFloat( gz, S.gz );
+                storeFloat( mirror, gather( shading.data(), S.row + SimdInt( S_MIRROR ) ) );
+                for( int c = 0; c < 3; c++ ) {
+                    storeFloat( w[c], weight[c] );
+                    storeFloat( albedo[c], tex[c] *
+                        gather( shading.data(), S.row + SimdInt( S_DIFFUSE + c ) ) );
+                }
+
+                int hitBits = bits( H.hit );
+                for( int i = 0; i < SIMD_WIDTH; i++ ) {
+                    alive[i] = 0;
+                    if( !(hitBits & (1 << i)) ) {
+                        continue;
+                    }
+
+                    if( uniform( rng[i] ) >= mirror[i] ) {
+                        // Duff et al.'s basis around the normal
+                        float sign = copysignf( 1.0f, nz[i] );
+                        float a = -1.0f / (sign + nz[i]);
+                        float b = nx[i] * ny[i] * a;
+                        float t[3] = { 1.0f + sign * nx[i] * nx[i] * a,
+                                       sign * b, -sign * nx[i] };
+                        float s[3] = { b, sign + ny[i] * ny[i] * a, -ny[i] };
+
+                        float r = sqrtf( uniform( rng[i] ) );
+                        float phi = 6.2831853f * uniform( rng[i] );
+                        float u = r * cosf( phi ), v = r * sinf( phi );
+                        float h = sqrtf( max( 1.0f - r * r, 0.0f ) );
+                        dx[i] = u * t[0] + v * s[0] + h * nx[i];
+                        dy[i] = u * t[1] + v * s[1] + h * ny[i];
+                        dz[i] = u * t[2] + v * s[2] + h * nz[i];
+
+                        // below the surface itself: absorbed
+                        if( dx[i] * gx[i] + dy[i] * gy[i] + dz[i] * gz[i] <= 0.0f ) {
+                            continue;
+                        }
+                        for( int c = 0; c < 3; c++ ) {
+                            w[c][i] *= albedo[c][i] / (1.0f - mirror[i]);
+                        }
+                    }
+
+                    if( depth + 1 >= PT_ROULETTE ) {
+                        float keep = min( max( w[0][i], max( w[1][i], w[2][i] ) ),
+                                          0.95f );
+                        if( uniform( rng[i] ) >= keep ) {
+                            continue;
+                        }
+                        for( int c = 0; c < 3; c++ ) {
+                            w[c][i] /= keep;
+                        }
+                    }
+                    alive[i] = 1;
+                }
+
+                // both kinds leave from just off the side the ray hit
+                SimdFloat offset( RT_OFFSET );
+                R.ox = fmadd( offset, S.gx, S.px );
+                R.oy = fmadd( offset, S.gy, S.py );
+                R.oz = fmadd( offset, S.gz, S.pz );
+                R.dx = loadFloat( dx );
+                R.dy = loadFloat( dy );
+                R.dz = loadFloat( dz );
+                R.tMin = zero;
+                R.tMax = SimdFloat( FLT_MAX );
+                R.active = loadInt( alive ) > SimdInt( 0 );
+                for( int c = 0; c < 3; c++ ) {
+                    weight[c] = loadFloat( w[c] );
+                }
+                travelled = distance;
+            }
+
+            float color[3][SIMD_WIDTH];
+            for( int c = 0; c < 3; c++ ) {
+                storeFloat( color[c], radiance[c] );
+            }
+            for( int i = 0; i < SIMD_WIDTH; i++ ) {
+                if( !need[i] ) {
+                    continue;
+                }
+                PixelSum &P = sums[pixel[i]];
+                float brightness = 0.0f;
+                for( int c = 0; c < 3; c++ ) {
+                    P.color[c] += color[c][i];
+                    brightness += brightnessWeight[c] * color[c][i];
+                }
+                P.brightness2 += brightness * brightness;
+                P.samples++;
+            }
+            traced += count;
+        }
+    }
+
+    sampleCount += traced;
+}
+
+///
+// refine() - one more sample for every pixel that needs one
+///
+bool PathTracer::refine( void )
+{
+    if( width == 0 ) {
+        return false;
+    }
+
+    prepare();
+    uint64_t key = sceneKey();
+    if( key != sumsKey || sums.size() != (size_t) width * height ) {
+        if( samples > 0 ) {
+            cerr << "PathTracer: the scene changed; discarding " <<
+                samples << " samples" << endl;
+        }
+        reset();
+        sumsKey = key;
+    }
+
+    countActive();
+    if( activePixels == 0 ) {
+        return false;
+    }
+
+    uint64_t start = monotonicNs();
+    sampleCount = 0;
+    pool.parallelFor( tileOrder.size(), [&]( int item, int ) {
+        tracePaths( tileOrder[item] );
+    } );
+    renderMs += elapsedMs( start );
+    samples += sampleCount;
+    passes++;
+
+    countActive();
+    return true;
+}
+
+///
+// estimate(rgb,variance) - the image so far
+///
+void PathTracer::estimate( float *rgb, float *variance ) const
+{
+    for( size_t p = 0; p < sums.size(); p++ ) {
+        const PixelSum &P = sums[p];
+        float n = P.samples;
+        float mean = 0.0f;
+        for( int c = 0; c < 3; c++ ) {
+            rgb[3 * p + c] = n > 0.0f ? P.color[c] / n : 0.0f;
+            mean += brightnessWeight[c] * rgb[3 * p + c];
+        }
+        if( variance != NULL ) {
+            variance[p] = n < 2.0f ? 0.0f :
+                max( P.brightness2 / n - mean * mean, 0.0f ) / (n - 1.0f);
+        }
+    }
+}
+
+///
+// save(path) - write a checkpoint file
+///
+bool PathTracer::save( const char *path ) const
+{
+    string temporary = string( path ) + ".tmp";
+    FILE *fp = fopen( temporary.c_str(), "wb" );
+    if( fp == NULL ) {
+        perror( temporary.c_str() );
+        return false;
+    }
+
+    PathCheckpoint H;
+    memset( &H, 0, sizeof(H) );
+    H.magic = PT_MAGIC;
+    H.version = PT_VERSION;
+    H.width = width;
+    H.height = height;
+    H.passes = passes;
+    H.sceneKey = sumsKey;
+    H.samples = samples;
+    H.renderMs = renderMs;
+
+    // on disk before the rename, or a crash could leave neither file
+    bool ok = fwrite( &H, sizeof(H), 1, fp ) == 1 &&
+              fwrite( sums.data(), sizeof(PixelSum), sums.size(), fp ) ==
+                  sums.size() &&
+              fflush( fp ) == 0 && fsync( fileno( fp ) ) == 0;
+    if( fclose( fp ) != 0 ) {
+        ok = false;
+    }
+    if( !ok || rename( temporary.c_str(), path ) != 0 ) {
+        perror( path );
+        unlink( temporary.c_str() );
+        return false;
+    }
+
+    return true;
+}
+
+///
+// load(path) - continue from a checkpoint file
+///
+bool PathTracer::load( const char *path )
+{
+    FILE *fp = fopen( path, "rb" );
+    if( fp == NULL ) {
+        perror( path );
+        return false;
+    }
+
+    PathCheckpoint H;
+    if( fread( &H, sizeof(H), 1, fp ) != 1 || H.magic != PT_MAGIC ||
+        H.version != PT_VERSION ) {
+        cerr << "PathTracer: " << path << " is not a version " <<
+            PT_VERSION << " checkpoint" << endl;
+        fclose( fp );
+        return false;
+    }
+    if( (int) H.width != width || (int) H.height != height ) {
+        cerr << "PathTracer: " << path << " is " << H.width << "x" <<
+            H.height << ", not " << width << "x" << height << endl;
+        fclose( fp );
+        return false;
+    }
+
+    vector<PixelSum> loaded( (size_t) width * height );
+    if( fread( loaded.data(), sizeof(PixelSum), loaded.size(), fp ) !=
+        loaded.size() ) {
+        cerr << "PathTracer: " << path << " is too short" << endl;
+        fclose( fp );
+        return false;
+    }
+    fclose( fp );
+
+    sums.swap( loaded );
+    sumsKey = H.sceneKey;
+    passes = H.passes;
+    samples = H.samples;
+    renderMs = H.renderMs;
+
+    return true;
+}
@@ -0,0 +1,153 @@
+//
+//  PathTracer.h
+//
+//  Progressive Monte Carlo path tracer for stills of the scene: the
+//  ray tracer's scene, camera and light, with the indirect light of
+//  diffuse bounces in place of the ambient term.
+//
+//  Every refine() adds one sample to each pixel that still needs one.
+//  A pixel gets at least minSamples and at most maxSamples; in between
+//  it stops once the standard error of its brightness falls to
+//  targetNoise of the brightness itself (or of PT_DARK in dark pixels),
+//  so the samples go where the image is noisy.  A pass hands its tiles
+//  to the ThreadPool busiest first, and idle workers keep taking the
+//  next, so no worker waits long on another's expensive tile.
+//
+//  Paths are generated from a hash of the pixel, its sample number and
+//  'sequence', so a render resumed from a checkpoint (save() and load())
+//  produces the same image as one that was never interrupted.
+//
+//  CHECKPOINT FILE (native byte order): a PathCheckpoint header, then
+//  one PixelSum per pixel, bottom row first.  save() writes a new file
+//  and renames it over the old one, so a render killed while saving
+//  still has its previous checkpoint.
+//
+
+#ifndef _PATHTRACER_H_
+#define _PATHTRACER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "RayTracer.h"
+
+using namespace std;
+
+// "PTCK" and the current layout version
+#define PT_MAGIC        0x4b435450u
+#define PT_VERSION      1
+
+// brightness below which noise is measured against this instead
+#define PT_DARK         0.05f
+
+// paths may be cut short by Russian roulette after this many bounces
+#define PT_ROULETTE     3
+
+///
+// Checkpoint file header
+///
+typedef struct PathCheckpoint {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t passes;
+    uint32_t pad;
+    uint64_t sceneKey;      // PathTracer::sceneKey() of the render
+    uint64_t samples;       // total so far
+    double renderMs;        // time spent tracing so far
+} PathCheckpoint;
+
+class PathTracer : public RayTracer {
+
+public:
+    // sampling limits (see above), and the longest path traced
+    int minSamples, maxSamples;
+    float targetNoise;
+    int maxDepth;
+
+    // which of many independent sample sequences to draw from
+    uint32_t sequence;
+
+    // the running sums of a pixel's samples: RGB, squared brightness
+    struct PixelSum {
+        float color[3];
+        float brightness2;
+        uint32_t samples;
+    };
+    vector<PixelSum> sums;
+
+    // progress: passes and samples so far, pixels still sampling, the
+    // mean relative error of all pixels, and time spent tracing
+    int passes;
+    uint64_t samples;
+    int activePixels;
+    double noise;
+    double renderMs;
+
+private:
+    uint64_t sumsKey;               // sceneKey() of 'sums'
+    vector<int> tileActive;         // pixels still sampling, per tile
+    vector<double> tileNoise;       // sum of its pixels' errors
+    vector<int> tileOrder;
+    atomic<uint64_t> sampleCount;
+
+    uint64_t sceneKey( void ) const;
+    float pixelNoise( const PixelSum &P ) const;
+    void tracePaths( int tile );
+    void countActive( void );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to render with
+    ///
+    PathTracer( ThreadPool &threads );
+
+    ///
+    // reset() - discard the samples taken so far
+    ///
+    void reset( void );
+
+    ///
+    // refine() - add one sample to every pixel that needs one, and
+    //     update 'pixels' with the new estimate.  The samples so far are
+    //     discarded first if the frame size, camera, light or any
+    //     object changed since they were taken.
+    //
+    // @return false once no pixel needs more samples
+    ///
+    bool refine( void );
+
+    ///
+    // estimate(rgb,variance) - the image so far, unclamped, and the
+    //     variance of each pixel's brightness in it as an estimate of
+    //     the true one (0 for pixels with fewer than two samples);
+    //     bottom row first
+    //
+    // @param rgb      - w*h RGB triples
+    // @param variance - w*h values, or NULL
+    ///
+    void estimate( float *rgb, float *variance ) const;
+
+    ///
+    // save(path) - write the samples so far to a checkpoint file
+    //
+    // @return true on success
+    ///
+    bool save( const char *path ) const;
+
+    ///
+    // load(path) - continue from a checkpoint file; the frame must have
+    //     the size it was saved with.  Samples of another scene are
+    //     discarded by the next refine().
+    //
+    // @return true on success
+    ///
+    bool load( const char *path );
+
+};
+
+#endif
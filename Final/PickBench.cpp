@@ -0,0 +1,76 @@
+//
+//  PickBench.cpp
+//
+//  The picking benchmark (-pickbench; see Benchmarks.h): mouse picks
+//  through the objects' BVHs against testing every triangle.
+//
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Picker.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// pickBenchmark() - time B.count picks spread over the window, with
+// the per-object trees and by testing every triangle, check that the
+// two agree, and report
+///
+void pickBenchmark( const BenchSettings &B )
+{
+    int count = B.count;
+    Picker &picker = *sceneParts().picker;
+
+    uint64_t start = monotonicNs();
+    updatePicker();
+    double setupMs = elapsedMs( start );
+
+    int triangles = 0;
+    for( size_t i = 0; i < picker.objects.size(); i++ ) {
+        triangles += (int) picker.objects[i].bvh.triangles.size();
+    }
+    printf( "picking: %d objects, %d triangles; trees built in %.2f ms\n",
+        (int) picker.objects.size(), triangles, setupMs );
+
+    // window positions on a square grid
+    int side = (int) ceil( sqrt( (double) count ) );
+    vector<PickHit> fast( count ), slow( count );
+
+    start = monotonicNs();
+    int hits = 0;
+    for( int i = 0; i < count; i++ ) {
+        hits += picker.pick( (i % side + 0.5f) / side,
+                             (i / side + 0.5f) / side, fast[i] );
+    }
+    double fastMs = elapsedMs( start );
+
+    start = monotonicNs();
+    for( int i = 0; i < count; i++ ) {
+        float origin[3], direction[3], tMin, tMax;
+        picker.ray( (i % side + 0.5f) / side, (i / side + 0.5f) / side,
+                    origin, direction, tMin, tMax );
+        picker.traceAll( origin, direction, tMin, tMax, slow[i] );
+    }
+    double slowMs = elapsedMs( start );
+
+    // a ray through a shared edge may take either triangle
+    int agree = 0;
+    for( int i = 0; i < count; i++ ) {
+        agree += fast[i].object == slow[i].object &&
+                 fabsf( fast[i].t - slow[i].t ) <= 1e-4f * slow[i].t;
+    }
+
+    printf( "%d picks, %d hits\n", count, hits );
+    printf( "           us/pick   picks/s\n" );
+    printf( "BVH      %9.2f %9.0f\n", 1000.0 * fastMs / count,
+        count / (fastMs / 1000.0) );
+    printf( "all tris %9.2f %9.0f\n", 1000.0 * slowMs / count,
+        count / (slowMs / 1000.0) );
+    printf( "speedup %.0fx; %d of %d picks agree\n", slowMs / fastMs,
+        agree, count );
+}
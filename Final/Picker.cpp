@@ -0,0 +1,265 @@
+//
+//  Picker.cpp
+//
+//  Mouse picking implementation.
+//
+
+#include <cfloat>
+#include <cstring>
+
+#include "Picker.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+///
+// invertAffine(m,r) - inverse of a column-major matrix whose last row
+//     is 0 0 0 1; r may not be m
+///
+static void invertAffine( const float *m, float *r )
+{
+    // cofactors of the upper 3x3 block, transposed
+    float c[9] = {
+        m[5] * m[10] - m[9] * m[6],
+        m[9] * m[2]  - m[1] * m[10],
+        m[1] * m[6]  - m[5] * m[2],
+        m[8] * m[6]  - m[4] * m[10],
+        m[0] * m[10] - m[8] * m[2],
+        m[4] * m[2]  - m[0] * m[6],
+        m[4] * m[9]  - m[8] * m[5],
+        m[8] * m[1]  - m[0] * m[9],
+        m[0] * m[5]  - m[4] * m[1]
+    };
+    float det = m[0] * c[0] + m[4] * c[1] + m[8] * c[2];
+    float inv = det != 0.0f ? 1.0f / det : 0.0f;
+
+    for( int col = 0; col < 3; col++ ) {
+        for( int row = 0; row < 3; row++ ) {
+            r[4 * col + row] = c[3 * col + row] * inv;
+        }
+        r[4 * col + 3] = 0.0f;
+    }
+    for( int row = 0; row < 3; row++ ) {
+        r[12 + row] = -(r[row] * m[12] + r[4 + row] * m[13] +
+                        r[8 + row] * m[14]);
+    }
+    r[15] = 1.0f;
+}
+
+// M p, for a point (w = 1) or a direction (w = 0)
+static inline void transform( const float *M, const float *p, float w,
+                              float *r )
+{
+    for( int k = 0; k < 3; k++ ) {
+        r[k] = M[k] * p[0] + M[4 + k] * p[1] + M[8 + k] * p[2] +
+               M[12 + k] * w;
+    }
+}
+
+///
+// Constructor
+///
+Picker::Picker( void ) :
+    buildMs(0.0)
+{
+    for( int i = 0; i < 3; i++ ) {
+        eyePoint[i] = 0.0f;
+        for( int k = 0; k < 3; k++ ) {
+            camera[i][k] = i == k ? 1.0f : 0.0f;
+        }
+    }
+    memset( frustum, 0, sizeof(frustum) );
+}
+
+///
+// find(id) - the object added as 'id', or NULL
+///
+Picker::Object *Picker::find( int id )
+{
+    for( size_t i = 0; i < objects.size(); i++ ) {
+        if( objects[i].id == id ) {
+            return &objects[i];
+        }
+    }
+    return NULL;
+}
+
+///
+// add(id,B) - make an object pickable
+///
+void Picker::add( int id, const BufferSet &B )
+{
+    Object *O = find( id );
+    if( O != NULL && O->buffers == &B && O->elements == B.numElements ) {
+        return;
+    }
+    if( O == NULL ) {
+        objects.push_back( Object() );
+        O = &objects.back();
+        O->id = id;
+        float one[3] = { 1.0f, 1.0f, 1.0f }, zero[3] = { 0.0f, 0.0f, 0.0f };
+        modelMatrix( O->model, one, zero, zero );
+        invertAffine( O->model, O->inverse );
+    }
+    O->buffers = &B;
+    O->elements = B.numElements;
+
+    uint64_t start = monotonicNs();
+
+    int count = B.numElements / 3;
+    vector<float> vertices( 9 * (size_t) count );
+    for( size_t i = 0; i < 3 * (size_t) count; i++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            vertices[3 * i + k] = B.points[4 * i + k];
+        }
+    }
+    O->bvh.build( vertices.data(), count );
+
+    buildMs += elapsedMs( start );
+}
+
+///
+// place(id,scale,rotate,translate) - the object's model transform
+///
+void Picker::place( int id, const float *scale, const float *rotate,
+                    const float *translate )
+{
+    Object *O = find( id );
+    if( O == NULL ) {
+        return;
+    }
+    modelMatrix( O->model, scale, rotate, translate );
+    invertAffine( O->model, O->inverse );
+}
+
+///
+// setCamera(eye,lookAt,up) - the camera the window is drawn with
+///
+void Picker::setCamera( const float *eye, const float *lookAt,
+                        const float *up )
+{
+    float view[16];
+    viewMatrix( view, eye, lookAt, up );
+
+    for( int i = 0; i < 3; i++ ) {
+        eyePoint[i] = eye[i];
+        for( int k = 0; k < 3; k++ ) {
+            camera[i][k] = view[4 * k + i];
+        }
+    }
+    getFrustum( frustum );
+}
+
+///
+// ray(x,y,origin,direction,tMin,tMax) - the ray through (x,y)
+///
+void Picker::ray( float x, float y, float *origin, float *direction,
+                  float &tMin, float &tMax ) const
+{
+    // eye-space position on the near plane, as RayTracer::primaryPacket()
+    float e[3] = { frustum[0] + x * (frustum[1] - frustum[0]),
+                   frustum[3] + y * (frustum[2] - frustum[3]),
+                   -frustum[4] };
+
+    for( int k = 0; k < 3; k++ ) {
+        origin[k] = eyePoint[k];
+        direction[k] = e[0] * camera[0][k] + e[1] * camera[1][k] +
+                       e[2] * camera[2][k];
+    }
+
+    // t = 1 is the near plane
+    tMin = 1.0f;
+    tMax = frustum[4] > 0.0f ? frustum[5] / frustum[4] : FLT_MAX;
+}
+
+///
+// pick(x,y,H) - the nearest object at a window position
+///
+bool Picker::pick( float x, float y, PickHit &H ) const
+{
+    float origin[3], direction[3], tMin, tMax;
+    ray( x, y, origin, direction, tMin, tMax );
+    return trace( origin, direction, tMin, tMax, H );
+}
+
+///
+// trace(origin,direction,tMin,tMax,H) - the nearest object along a ray
+///
+bool Picker::trace( const float *origin, const float *direction,
+                    float tMin, float tMax, PickHit &H ) const
+{
+    H.object = H.triangle = -1;
+    H.t = tMax;
+
+    for( size_t i = 0; i < objects.size(); i++ ) {
+        const Object &O = objects[i];
+        float o[3], d[3];
+        transform( O.inverse, origin, 1.0f, o );
+        transform( O.inverse, direction, 0.0f, d );
+
+        RayHit R;
+        if( O.bvh.intersect( o, d, tMin, H.t, R ) ) {
+            H.object = O.id;
+            H.triangle = R.triangle;
+            H.t = R.t;
+        }
+    }
+
+    for( int k = 0; k < 3; k++ ) {
+        H.point[k] = origin[k] + H.t * direction[k];
+    }
+    return H.object >= 0;
+}
+
+///
+// traceAll(origin,direction,tMin,tMax,H) - trace() without the trees
+///
+bool Picker::traceAll( const float *origin, const float *direction,
+                       float tMin, float tMax, PickHit &H ) const
+{
+    H.object = H.triangle = -1;
+    H.t = tMax;
+
+    for( size_t i = 0; i < objects.size(); i++ ) {
+        const Object &O = objects[i];
+        float o[3], d[3];
+        transform( O.inverse, origin, 1.0f, o );
+        transform( O.inverse, direction, 0.0f, d );
+
+        for( int t = 0; t < O.elements / 3; t++ ) {
+            const float *v0 = &O.buffers->points[12 * (size_t) t];
+            float e1[3], e2[3], s[3], p[3], q[3];
+            for( int k = 0; k < 3; k++ ) {
+                e1[k] = v0[4 + k] - v0[k];
+                e2[k] = v0[8 + k] - v0[k];
+                s[k] = o[k] - v0[k];
+            }
+
+            // Moller-Trumbore, as in Bvh
+            p[0] = d[1] * e2[2] - d[2] * e2[1];
+            p[1] = d[2] * e2[0] - d[0] * e2[2];
+            p[2] = d[0] * e2[1] - d[1] * e2[0];
+            float inv = 1.0f / (e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2]);
+            float u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * inv;
+
+            q[0] = s[1] * e1[2] - s[2] * e1[1];
+            q[1] = s[2] * e1[0] - s[0] * e1[2];
+            q[2] = s[0] * e1[1] - s[1] * e1[0];
+            float v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * inv;
+            float dist = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * inv;
+
+            if( u >= 0.0f && v >= 0.0f && u + v <= 1.0f &&
+                dist > tMin && dist < H.t ) {
+                H.object = O.id;
+                H.triangle = t;
+                H.t = dist;
+            }
+        }
+    }
+
+    for( int k = 0; k < 3; k++ ) {
+        H.point[k] = origin[k] + H.t * direction[k];
+    }
+    return H.object >= 0;
+}
@@ -0,0 +1,130 @@
+//
+//  Picker.h
+//
+//  Mouse picking: which object, triangle and world-space point lie
+//  under a window position, found by casting one ray on the CPU.
+//
+//  Every object keeps its own BVH over its triangles in model space,
+//  built once by add() and kept for as long as the object's buffers
+//  have the same triangles, so turning an object costs nothing but a
+//  new matrix.  pick() makes the ray through the window position the
+//  way RayTracer makes its primary rays, moves it into each object's
+//  space with the inverse of the model matrix the shaders are given
+//  (setUpTransforms()), and keeps the nearest hit.  The direction is
+//  transformed without being normalized, so distances along the ray
+//  compare between objects as they are.
+//
+
+#ifndef _PICKER_H_
+#define _PICKER_H_
+
+#include <vector>
+
+#include "Buffers.h"
+#include "Bvh.h"
+
+using namespace std;
+
+///
+// what a pick found: the object (the id given to add(), -1 for none),
+// the triangle (its index in the object's buffers, three elements per
+// triangle), the point hit and the ray distance to it
+///
+struct PickHit {
+    int object;
+    int triangle;
+    float point[3];
+    float t;
+};
+
+class Picker {
+
+public:
+    // one pickable object
+    struct Object {
+        int id;
+        const BufferSet *buffers;
+        int elements;           // numElements the tree was built for
+        Bvh bvh;                // model space
+        float model[16];
+        float inverse[16];
+    };
+
+    vector<Object> objects;
+
+    // time taken by the trees built so far
+    double buildMs;
+
+private:
+    float eyePoint[3];
+    float camera[3][3];         // the camera's axes, as in RayTracer
+    float frustum[6];
+
+    Object *find( int id );
+
+public:
+
+    ///
+    // Constructor
+    ///
+    Picker( void );
+
+    ///
+    // add(id,B) - make an object pickable, or rebuild its tree if its
+    //     buffers changed since; its placement starts as the identity
+    //
+    // @param id - returned in PickHit::object
+    // @param B  - the object's buffers; must outlive the Picker
+    ///
+    void add( int id, const BufferSet &B );
+
+    ///
+    // place(id,scale,rotate,translate) - the object's model transform,
+    //     with the parameters of setUpTransforms()
+    ///
+    void place( int id, const float *scale, const float *rotate,
+                const float *translate );
+
+    ///
+    // setCamera(eye,lookAt,up) - the camera the window is drawn with;
+    //     the view volume is the one setUpFrustum() sends
+    ///
+    void setCamera( const float *eye, const float *lookAt, const float *up );
+
+    ///
+    // pick(x,y,H) - the nearest object at a window position
+    //
+    // @param x, y - position in the window, 0 to 1 from the lower left
+    // @param H    - receives the hit
+    //
+    // @return true if anything was hit
+    ///
+    bool pick( float x, float y, PickHit &H ) const;
+
+    ///
+    // trace(origin,direction,tMin,tMax,H) - the nearest object along a
+    //     world-space ray, in (tMin,tMax)
+    //
+    // @return true if anything was hit
+    ///
+    bool trace( const float *origin, const float *direction,
+                float tMin, float tMax, PickHit &H ) const;
+
+    ///
+    // traceAll(origin,direction,tMin,tMax,H) - as trace(), testing
+    //     every triangle of every object without the trees; for checking
+    //     trace() against
+    ///
+    bool traceAll( const float *origin, const float *direction,
+                   float tMin, float tMax, PickHit &H ) const;
+
+    ///
+    // ray(x,y,origin,direction,tMin,tMax) - the world-space ray pick()
+    //     casts through window position (x,y)
+    ///
+    void ray( float x, float y, float *origin, float *direction,
+              float &tMin, float &tMax ) const;
+
+};
+
+#endif
@@ -0,0 +1,304 @@
+//
+//  Progressive.cpp
+//
+//  Progressive mesh implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <climits>
+
+#include "Progressive.h"
+#include "Simplify.h"
+#include "Timing.h"
+
+using namespace std;
+
+// not numbered yet
+#define PM_NONE     0xffffffffu
+
+///
+// Constructor
+///
+ProgressiveMesh::ProgressiveMesh( void ) :
+    baseVertices(0), baseFaces(0), applied(0), drawnFaces(0), buildMs(0.0),
+    dirtyVertexLo(INT_MAX), dirtyVertexHi(-1), dirtyIndexLo(INT_MAX),
+    dirtyIndexHi(-1)
+{
+}
+
+///
+// build(positions,indices,faces) - encode a mesh
+///
+void ProgressiveMesh::build( const float *positions, const uint32_t *indices,
+                             int faces )
+{
+    uint64_t start = monotonicNs();
+
+    // the simplifier takes a triangle soup, and welds it again
+    vector<float> soup( 9 * (size_t) faces );
+    for( size_t c = 0; c < 3 * (size_t) faces; c++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            soup[3 * c + k] = positions[3 * (size_t) indices[c] + k];
+        }
+    }
+    MeshSimplifier S;
+    S.recordHistory = true;
+    S.load( soup.data(), 3, 3 * faces );
+
+    // smooth normals of the full mesh, by area
+    vector<double> smooth( 3 * (size_t) S.vertices, 0.0 );
+    for( int t = 0; t < S.inputTriangles(); t++ ) {
+        if( !S.triangleLeft( t ) ) {
+            continue;
+        }
+        const uint32_t *v = S.triangleVertices( t );
+        const double *a = S.vertexPosition( v[0] );
+        const double *b = S.vertexPosition( v[1] );
+        const double *c = S.vertexPosition( v[2] );
+        double e[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+        double f[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+        double n[3] = { e[1] * f[2] - e[2] * f[1], e[2] * f[0] - e[0] * f[2],
+                        e[0] * f[1] - e[1] * f[0] };
+        for( int k = 0; k < 3; k++ ) {
+            for( int j = 0; j < 3; j++ ) {
+                smooth[3 * v[k] + j] += n[j];
+            }
+        }
+    }
+
+    S.simplify( 0, HUGE_VAL );
+
+    // vertices: the base ones, then one per split, which is the log
+    // read backwards
+    int H = S.history.size();
+    vector<uint32_t> vertexId( S.vertices, PM_NONE );
+    uint32_t next = 0;
+    for( int v = 0; v < S.vertices; v++ ) {
+        if( S.vertexLeft( v ) ) {
+            vertexId[v] = next++;
+        }
+    }
+    baseVertices = next;
+    for( int h = H - 1; h >= 0; h-- ) {
+        vertexId[S.history[h].v] = next++;
+    }
+
+    // triangles: the base ones, then each split's
+    vector<uint32_t> faceId( S.inputTriangles(), PM_NONE );
+    next = 0;
+    for( int t = 0; t < S.inputTriangles(); t++ ) {
+        if( S.triangleLeft( t ) ) {
+            faceId[t] = next++;
+        }
+    }
+    baseFaces = next;
+    for( int h = H - 1; h >= 0; h-- ) {
+        const MeshSimplifier::Record &R = S.history[h];
+        for( uint32_t i = 0; i < R.dead; i++ ) {
+            faceId[S.deadTriangles[R.firstDead + i]] = next++;
+        }
+    }
+
+    // each triangle as it is when it appears: the base ones as they
+    // are now, the others as they were when they were collapsed away
+    this->faces.assign( 3 * (size_t) next, 0 );
+    for( int t = 0; t < S.inputTriangles(); t++ ) {
+        if( faceId[t] == PM_NONE ) {
+            continue;   // degenerate from the start
+        }
+        const uint32_t *v = S.triangleVertices( t );
+        for( int k = 0; k < 3; k++ ) {
+            this->faces[3 * faceId[t] + k] = vertexId[v[k]];
+        }
+    }
+
+    basePositions.resize( 3 * (size_t) baseVertices );
+    normals.resize( 3 * (size_t) S.vertices );
+    for( int v = 0; v < S.vertices; v++ ) {
+        const double *n = &smooth[3 * v];
+        double length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        for( int k = 0; k < 3; k++ ) {
+            normals[3 * vertexId[v] + k] = length > 0.0 ? n[k] / length :
+                                           (k == 2 ? 1.0f : 0.0f);
+            if( S.vertexLeft( v ) ) {
+                basePositions[3 * vertexId[v] + k] = S.vertexPosition( v )[k];
+            }
+        }
+    }
+
+    splits.resize( H );
+    moves.clear();
+    uint32_t added = baseFaces;
+    for( int i = 0; i < H; i++ ) {
+        const MeshSimplifier::Record &R = S.history[H - 1 - i];
+        VertexSplit &V = splits[i];
+        V.u = vertexId[R.u];
+        for( int k = 0; k < 3; k++ ) {
+            V.from[k] = R.from[k];
+            V.position[k] = R.at[k];
+        }
+        V.firstFace = added;
+        V.faces = R.dead;
+        added += R.dead;
+        V.firstMove = moves.size();
+        V.moves = R.moved;
+        for( uint32_t m = 0; m < R.moved; m++ ) {
+            uint32_t c = S.movedCorners[R.firstMoved + m];
+            moves.push_back( 3 * faceId[c / 3] + c % 3 );
+        }
+    }
+
+    applied = 0;
+    drawnFaces = baseFaces;
+    buildMs = elapsedMs( start );
+}
+
+///
+// memoryBytes() - bytes held by the encoding
+///
+size_t ProgressiveMesh::memoryBytes( void ) const
+{
+    return basePositions.size() * sizeof(float) +
+           splits.size() * sizeof(VertexSplit) +
+           moves.size() * sizeof(uint32_t) +
+           normals.size() * sizeof(float) +
+           faces.size() * sizeof(uint32_t);
+}
+
+void ProgressiveMesh::touchVertex( int v )
+{
+    dirtyVertexLo = min( dirtyVertexLo, v );
+    dirtyVertexHi = max( dirtyVertexHi, v );
+}
+
+void ProgressiveMesh::touchIndex( int i )
+{
+    dirtyIndexLo = min( dirtyIndexLo, i );
+    dirtyIndexHi = max( dirtyIndexHi, i );
+}
+
+///
+// flush(B) - send the vertices and indices changed since the last
+// flush to B
+///
+void ProgressiveMesh::flush( BufferSet &B )
+{
+    if( dirtyVertexHi >= dirtyVertexLo ) {
+        int count = dirtyVertexHi - dirtyVertexLo + 1;
+        glBindBuffer( GL_ARRAY_BUFFER, B.vbuffer );
+        glBufferSubData( GL_ARRAY_BUFFER, dirtyVertexLo * 4 * sizeof(float),
+                         count * 4 * sizeof(float), &points[4 * dirtyVertexLo] );
+        glBufferSubData( GL_ARRAY_BUFFER,
+                         B.vSize + dirtyVertexLo * 3 * sizeof(float),
+                         count * 3 * sizeof(float), &normals[3 * dirtyVertexLo] );
+    }
+    if( dirtyIndexHi >= dirtyIndexLo ) {
+        int count = dirtyIndexHi - dirtyIndexLo + 1;
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, B.ebuffer );
+        glBufferSubData( GL_ELEMENT_ARRAY_BUFFER,
+                         dirtyIndexLo * sizeof(uint32_t),
+                         count * sizeof(uint32_t), &indices[dirtyIndexLo] );
+    }
+    dirtyVertexLo = dirtyIndexLo = INT_MAX;
+    dirtyVertexHi = dirtyIndexHi = -1;
+    B.numElements = 3 * drawnFaces;
+}
+
+///
+// upload(B) - make B's buffers and send the base mesh to them
+///
+void ProgressiveMesh::upload( BufferSet &B )
+{
+    if( B.bufferInit ) {
+        glDeleteBuffers( 1, &B.vbuffer );
+        glDeleteBuffers( 1, &B.ebuffer );
+    }
+    B.initBuffer();
+
+    // positions (XYZW) then normals, as createBuffers() lays them out,
+    // for every vertex the splits will add
+    int N = vertexCount();
+    points.assign( 4 * (size_t) N, 1.0f );
+    for( int v = 0; v < baseVertices; v++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            points[4 * v + k] = basePositions[3 * v + k];
+        }
+    }
+    indices = faces;
+    B.vSize = N * 4 * sizeof(float);
+    B.nSize = N * 3 * sizeof(float);
+    B.eSize = indices.size() * sizeof(uint32_t);
+    B.vbuffer = B.makeBuffer( GL_ARRAY_BUFFER, NULL, B.vSize + B.nSize );
+    B.ebuffer = B.makeBuffer( GL_ELEMENT_ARRAY_BUFFER, NULL, B.eSize );
+    B.bufferInit = true;
+
+    applied = 0;
+    drawnFaces = baseFaces;
+    dirtyVertexLo = dirtyIndexLo = INT_MAX;
+    dirtyVertexHi = dirtyIndexHi = -1;
+    if( baseVertices > 0 ) {
+        touchVertex( 0 );
+        touchVertex( baseVertices - 1 );
+    }
+    if( baseFaces > 0 ) {
+        touchIndex( 0 );
+        touchIndex( 3 * baseFaces - 1 );
+    }
+    flush( B );
+}
+
+///
+// refine(B,budgetMs) - apply splits for up to 'budgetMs' milliseconds
+///
+int ProgressiveMesh::refine( BufferSet &B, double budgetMs )
+{
+    uint64_t start = monotonicNs();
+    int done = 0;
+    while( !complete() ) {
+        const VertexSplit &V = splits[applied];
+        int u = V.u, n = baseVertices + applied;
+        for( int k = 0; k < 3; k++ ) {
+            points[4 * u + k] = V.from[k];
+            points[4 * n + k] = V.position[k];
+        }
+        touchVertex( u );
+        touchVertex( n );
+
+        // the new triangles are already in place past the drawn ones
+        if( V.faces > 0 ) {
+            touchIndex( 3 * V.firstFace );
+            touchIndex( 3 * (V.firstFace + V.faces) - 1 );
+            drawnFaces = V.firstFace + V.faces;
+        }
+        for( uint32_t m = 0; m < V.moves; m++ ) {
+            uint32_t c = moves[V.firstMove + m];
+            indices[c] = n;
+            touchIndex( c );
+        }
+
+        applied++;
+        done++;
+        if( done % PM_CHECK_EVERY == 0 && elapsedMs( start ) >= budgetMs ) {
+            break;
+        }
+    }
+    flush( B );
+    return done;
+}
+
+///
+// current(triangles,positions) - the mesh as refined so far
+///
+void ProgressiveMesh::current( vector<uint32_t> &triangles,
+                               vector<float> &positions ) const
+{
+    triangles.assign( indices.begin(), indices.begin() + 3 * drawnFaces );
+    int N = baseVertices + applied;
+    positions.resize( 3 * (size_t) N );
+    for( int v = 0; v < N; v++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            positions[3 * v + k] = points[4 * v + k];
+        }
+    }
+}
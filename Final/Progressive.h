@@ -0,0 +1,130 @@
+//
+//  Progressive.h
+//
+//  Progressive meshes (Hoppe, "Progressive Meshes", SIGGRAPH 1996):
+//  a coarse base mesh and a stream of vertex splits that refine it,
+//  one vertex and a triangle or two at a time, back to the full mesh,
+//  so a large object can be drawn at once and sharpen over the next
+//  frames.
+//
+//  build() simplifies the mesh as far as it goes with a
+//  MeshSimplifier, logging every edge collapse, and reads the log
+//  backwards: each collapse undone is a split.  Vertices are numbered
+//  so the base ones come first and every split adds the next one, and
+//  triangles so the base ones come first and every split appends its
+//  own; a split also moves some corners of the triangles already
+//  there from the vertex it splits to the new one.
+//
+//  The buffers are laid out for the whole mesh up front, with the
+//  triangles in that order, so upload() sends the base mesh and
+//  refine() only ever writes the new vertices and triangles past the
+//  end of what is drawn, and the few corners that move, in place; the
+//  BufferSet's numElements grows as it goes.  Every vertex gets the
+//  smooth normal of the full mesh.
+//
+
+#ifndef _PROGRESSIVE_H_
+#define _PROGRESSIVE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Buffers.h"
+
+using namespace std;
+
+// splits between checks of refine()'s time budget
+#define PM_CHECK_EVERY  64
+
+///
+// one vertex split: vertex 'u' goes back to where it was and vertex
+// baseVertices + its number appears at 'position', the triangles from
+// 'firstFace' on are added, and the corners moves[firstMove ..] turn
+// from u to the new vertex
+///
+struct VertexSplit {
+    uint32_t u;
+    float from[3], position[3];
+    uint32_t firstFace, faces;
+    uint32_t firstMove, moves;
+};
+
+class ProgressiveMesh {
+
+public:
+    // the encoding: base mesh size, splits, a normal (XYZ) per vertex,
+    // and the triangles, as each one is when it is added
+    int baseVertices, baseFaces;
+    vector<float> basePositions;
+    vector<VertexSplit> splits;
+    vector<uint32_t> moves;
+    vector<float> normals;
+    vector<uint32_t> faces;
+
+    // splits applied and triangles drawn so far, and the time build()
+    // took
+    int applied, drawnFaces;
+    double buildMs;
+
+private:
+    // what the buffers hold: XYZW per vertex, and three indices per
+    // triangle; the parts changed since the last upload
+    vector<float> points;
+    vector<uint32_t> indices;
+    int dirtyVertexLo, dirtyVertexHi, dirtyIndexLo, dirtyIndexHi;
+
+    void touchVertex( int v );
+    void touchIndex( int i );
+    void flush( BufferSet &B );
+
+public:
+
+    ///
+    // Constructor
+    ///
+    ProgressiveMesh( void );
+
+    ///
+    // build(positions,indices,faces) - encode a mesh
+    //
+    // @param positions - x, y, z of every vertex
+    // @param indices   - three vertex indices per triangle
+    // @param faces     - number of triangles
+    ///
+    void build( const float *positions, const uint32_t *indices,
+                int faces );
+
+    int vertexCount( void ) const { return baseVertices + (int) splits.size(); }
+    int faceCount( void ) const { return (int) faces.size() / 3; }
+    bool complete( void ) const { return applied == (int) splits.size(); }
+
+    ///
+    // memoryBytes() - bytes held by the encoding
+    ///
+    size_t memoryBytes( void ) const;
+
+    ///
+    // upload(B) - make B's buffers, big enough for the full mesh, and
+    //     send the base mesh to them
+    ///
+    void upload( BufferSet &B );
+
+    ///
+    // refine(B,budgetMs) - apply splits for up to 'budgetMs'
+    //     milliseconds and send the changes to B
+    //
+    // @return the number of splits applied
+    ///
+    int refine( BufferSet &B, double budgetMs );
+
+    ///
+    // current(triangles,positions) - the mesh as refined so far
+    //
+    // @param triangles - receives three vertex numbers per triangle
+    // @param positions - receives x, y, z of every vertex
+    ///
+    void current( vector<uint32_t> &triangles, vector<float> &positions ) const;
+
+};
+
+#endif
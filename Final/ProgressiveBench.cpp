@@ -0,0 +1,146 @@
+//
+//  ProgressiveBench.cpp
+//
+//  The progressive mesh benchmark (-pmbench; see Benchmarks.h): a mesh
+//  streamed from its base mesh up a few milliseconds of splits per
+//  frame, against sending it whole.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Buffers.h"
+#include "Framebuffer.h"
+#include "Progressive.h"
+#include "Scene.h"
+#include "Shapes.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// progressiveBenchmark() - stream the .obj file B.path as a progressive
+// mesh, a time budget of splits per frame, and compare the time to its
+// first frame and to full detail with sending it whole
+///
+void progressiveBenchmark( const BenchSettings &B )
+{
+    const char *path = B.path;
+    const SceneParts &P = sceneParts();
+    vector<float> positions;
+    vector<unsigned int> indices;
+    uint64_t start = monotonicNs();
+    if( !loadMeshData( path, positions, indices ) ) {
+        return;
+    }
+    double loadMs = elapsedMs( start );
+    int faces = (int) indices.size() / 3;
+
+    ProgressiveMesh PM;
+    PM.build( positions.data(), indices.data(), faces );
+    printf( "%s: %d triangles, read in %.1f ms\n", path, faces, loadMs );
+    printf( "encoded in %.1f ms: base mesh of %d vertices and %d triangles,"
+        " %zu splits, %.1f KB\n", PM.buildMs, PM.baseVertices, PM.baseFaces,
+        PM.splits.size(), PM.memoryBytes() / 1024.0 );
+
+    // drawn as the grapes
+    const SceneObject *grapes = P.objects;
+    while( grapes->obj != OBJ_GRAPES ) {
+        grapes++;
+    }
+
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    offscreen.bind();
+    BufferSet mesh;
+    auto frame = [&]( void ) {
+        glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+        setUpScene( P.phong, RenderSettings() );
+        drawObject( P.phong, grapes->material, mesh, OBJ_GRAPES );
+        glFinish();
+    };
+
+    // all of it before the first frame; the second time is timed
+    double wholeMs = 0.0;
+    for( int r = 0; r < 2; r++ ) {
+        start = monotonicNs();
+        PM.upload( mesh );
+        PM.refine( mesh, HUGE_VAL );
+        frame();
+        wholeMs = elapsedMs( start );
+    }
+
+    // the base mesh first, then PM_BUDGET_MS of splits per frame
+    const double PM_BUDGET_MS = 2.0;
+    start = monotonicNs();
+    PM.upload( mesh );
+    frame();
+    double firstMs = elapsedMs( start );
+    int firstFaces = PM.drawnFaces, frames = 1;
+    double refineMs = 0.0;
+    while( !PM.complete() ) {
+        uint64_t refineStart = monotonicNs();
+        PM.refine( mesh, PM_BUDGET_MS );
+        refineMs += elapsedMs( refineStart );
+        frame();
+        frames++;
+    }
+    double fullMs = elapsedMs( start );
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+
+    printf( "whole:       first frame, full detail, after %.2f ms\n", wholeMs );
+    printf( "progressive: first frame (%d triangles) after %.2f ms, full"
+        " detail (%d triangles) after %.2f ms and %d frames at %.1f ms of"
+        " splits each\n", firstFaces, firstMs, PM.drawnFaces, fullMs, frames,
+        PM_BUDGET_MS );
+    printf( "splits applied and sent at %.0f per ms\n",
+        PM.splits.size() / max( refineMs, 1.0e-3 ) );
+
+    // the refined mesh must be the input again: compare the triangles
+    // by their corners' positions, each started at its least corner
+    vector<uint32_t> refined;
+    vector<float> at;
+    PM.current( refined, at );
+    typedef vector<float> Corners;
+    auto corners = [&]( const float *p, const uint32_t *t, int f ) {
+        vector<Corners> out( f, Corners( 9 ) );
+        for( int i = 0; i < f; i++ ) {
+            int first = 0;
+            for( int k = 1; k < 3; k++ ) {
+                if( lexicographical_compare( &p[3 * t[3 * i + k]],
+                        &p[3 * t[3 * i + k]] + 3, &p[3 * t[3 * i + first]],
+                        &p[3 * t[3 * i + first]] + 3 ) ) {
+                    first = k;
+                }
+            }
+            for( int k = 0; k < 3; k++ ) {
+                const float *q = &p[3 * t[3 * i + (first + k) % 3]];
+                copy( q, q + 3, &out[i][3 * k] );
+            }
+        }
+        sort( out.begin(), out.end() );
+        return out;
+    };
+    vector<Corners> input = corners( positions.data(), indices.data(), faces );
+    vector<Corners> output = corners( at.data(), refined.data(),
+                                      (int) refined.size() / 3 );
+    vector<Corners> missing;
+    set_difference( input.begin(), input.end(), output.begin(), output.end(),
+                    back_inserter( missing ) );
+    int degenerate = 0;
+    for( size_t i = 0; i < missing.size(); i++ ) {
+        const float *c = missing[i].data();
+        degenerate += equal( c, c + 3, c + 3 ) ||
+                      equal( c + 3, c + 6, c + 6 ) || equal( c, c + 3, c + 6 );
+    }
+    printf( "refined mesh: %zu of %d input triangles missing (%d of them"
+        " degenerate, which are left out), %zu triangles in all\n",
+        missing.size(), faces, degenerate, output.size() );
+}
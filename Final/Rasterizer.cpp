@@ -0,0 +1,681 @@
+//
+//  Rasterizer.cpp
+//
+//  Tile-based software rasterizer implementation.
+//
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "Rasterizer.h"
+#include "Simd.h"
+#include "Viewing.h"
+
+using namespace std;
+
+// vertex positions are snapped to 1/16 pixel
+#define SUBPIXEL_BITS   4
+#define SUBPIXEL        (1 << SUBPIXEL_BITS)
+
+// work units of the vertex and setup stages
+#define VERTEX_BATCH    4096
+#define SETUP_BATCH     1024
+
+// edge function values are clamped to this at each tile's corner; the
+// change across a tile is far smaller, so the sign is still right
+// everywhere in the tile and int32 arithmetic cannot overflow
+#define EDGE_CLAMP      (1 << 29)
+
+// r = M * (x,y,z,w), M column-major
+static inline void transformVector( float *r, const float *M, const float *v,
+                                    int n )
+{
+    for( int i = 0; i < n; i++ ) {
+        r[i] = M[i] * v[0] + M[4+i] * v[1] + M[8+i] * v[2] + M[12+i] * v[3];
+    }
+}
+
+///
+// Constructor
+///
+Rasterizer::Rasterizer( ThreadPool &threads ) :
+    width(0), height(0), pool(threads), vertices(0), tilesX(0), tilesY(0)
+{
+    static const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    static const float white[3] = { 1.0f, 1.0f, 1.0f };
+    static const float z[3] = { 0.0f, 0.0f, -1.0f };
+    static const float y[3] = { 0.0f, 1.0f, 0.0f };
+
+    setCamera( origin, z, y );
+    setLight( white, origin, white );
+}
+
+///
+// resize(w,h) - set the frame size; a no-op if it is unchanged
+///
+bool Rasterizer::resize( int w, int h )
+{
+    if( w < 1 || h < 1 || w > RASTER_MAX_DIM || h > RASTER_MAX_DIM ) {
+        cerr << "Rasterizer: unsupported size " << w << "x" << h << endl;
+        return false;
+    }
+    if( w == width && h == height ) {
+        return true;
+    }
+
+    width = w;
+    height = h;
+    pixels.assign( (size_t) w * h, 0 );
+    tilesX = (w + RASTER_TILE - 1) / RASTER_TILE;
+    tilesY = (h + RASTER_TILE - 1) / RASTER_TILE;
+
+    return true;
+}
+
+///
+// setCamera(eye,lookAt,up) - camera for the next frame
+///
+void Rasterizer::setCamera( const float *eyePoint, const float *lookAt,
+                            const float *up )
+{
+    viewMatrix( view, eyePoint, lookAt, up );
+    projectionMatrix( projection );
+}
+
+///
+// setLight(color,position,ambient) - light for the next frame
+///
+void Rasterizer::setLight( const float *color, const float *position,
+                           const float *ambient )
+{
+    for( int i = 0; i < 3; i++ ) {
+        lightColor[i] = color[i];
+        light[i] = position[i];
+        ambientColor[i] = ambient[i];
+    }
+    lightColor[3] = ambientColor[3] = 1.0f;
+}
+
+///
+// begin() - start a new frame
+///
+void Rasterizer::begin( void )
+{
+    draws.clear();
+    vertices = 0;
+}
+
+///
+// draw(B,M,T,scale,rotate,translate) - queue an object
+///
+void Rasterizer::draw( const BufferSet &B, const Material *M,
+                       const Texture *T, const float *scale,
+                       const float *rotate, const float *translate )
+{
+    Draw D;
+
+    D.buffers = &B;
+    D.material = M;
+    D.texture = M->textured ? T : NULL;
+    D.firstVertex = vertices;
+    modelMatrix( D.model, scale, rotate, translate );
+
+    draws.push_back( D );
+    vertices += B.numElements;
+}
+
+///
+// transform(draw,first,count) - vertex stage for part of one draw
+///
+void Rasterizer::transform( int d, int first, int count )
+{
+    const Draw &D = draws[d];
+    const BufferSet &B = *D.buffers;
+    float modelView[16], mvp[16];
+
+    multiplyMatrices( modelView, view, D.model );
+    multiplyMatrices( mvp, projection, modelView );
+
+    for( int i = first; i < first + count; i++ ) {
+        size_t out = D.firstVertex + i;
+        const float *p = &B.points[4 * i];
+
+        transformVector( &clip[4 * out], mvp, p, 4 );
+        transformVector( &eye[3 * out], modelView, p, 3 );
+
+        float *n = &normal[3 * out];
+        if( B.normals.empty() ) {
+            n[0] = n[1] = n[2] = 0.0f;
+        } else {
+            const float *src = &B.normals[3 * i];
+            float v[4] = { src[0], src[1], src[2], 0.0f };
+            transformVector( n, modelView, v, 3 );
+            float len = sqrtf( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+            if( len > 0.0f ) {
+                n[0] /= len;
+                n[1] /= len;
+                n[2] /= len;
+            }
+        }
+
+        float *t = &texCoord[2 * out];
+        if( B.uv.empty() ) {
+            t[0] = t[1] = 0.0f;
+        } else {
+            t[0] = B.uv[2 * i];
+            t[1] = B.uv[2 * i + 1];
+        }
+
+        occlusion[out] = B.occlusion.empty() ? 1.0f : B.occlusion[i];
+    }
+}
+
+// view volume planes as clip-space distances, positive inside
+static inline float planeDistance( const float *v, int plane )
+{
+    switch( plane ) {
+        case 0:  return v[3] + v[0];
+        case 1:  return v[3] - v[0];
+        case 2:  return v[3] + v[1];
+        case 3:  return v[3] - v[1];
+        case 4:  return v[3] + v[2];
+        default: return v[3] - v[2];
+    }
+}
+
+// bit 'plane' set for every plane 'v' is outside of
+static inline int outcode( const float *v )
+{
+    int code = 0;
+    for( int plane = 0; plane < 6; plane++ ) {
+        if( planeDistance( v, plane ) < 0.0f ) {
+            code |= 1 << plane;
+        }
+    }
+    return code;
+}
+
+// a / b rounded toward minus infinity, b > 0
+static inline int64_t floorDiv( int64_t a, int64_t b )
+{
+    return a >= 0 ? a / b : -((-a + b - 1) / b);
+}
+
+///
+// addTriangle(C,v,planes) - set up one screen triangle with
+//     vertices in 1/16 pixel units (x,y in v[i][0..1]) and bin it
+///
+void Rasterizer::addTriangle( Chunk &C, const float (*v)[4], int planes )
+{
+    int64_t x[3], y[3];
+
+    for( int i = 0; i < 3; i++ ) {
+        x[i] = llrintf( v[i][0] );
+        y[i] = llrintf( v[i][1] );
+    }
+
+    // counter-clockwise (in GL window coordinates, y up) from here on
+    int64_t area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+    if( area == 0 ) {
+        return;
+    }
+    if( area < 0 ) {
+        swap( x[1], x[2] );
+        swap( y[1], y[2] );
+    }
+
+    Triangle T;
+    int64_t lowX = min( x[0], min( x[1], x[2] ) ), highX = max( x[0], max( x[1], x[2] ) );
+    int64_t lowY = min( y[0], min( y[1], y[2] ) ), highY = max( y[0], max( y[1], y[2] ) );
+
+    // pixels whose centers (16x+8) can be inside
+    T.minX = max( (int64_t) 0, floorDiv( lowX - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL ) );
+    T.maxX = min( (int64_t) width - 1, floorDiv( highX - SUBPIXEL / 2, SUBPIXEL ) );
+    T.minY = max( (int64_t) 0, floorDiv( lowY - SUBPIXEL / 2 + SUBPIXEL - 1, SUBPIXEL ) );
+    T.maxY = min( (int64_t) height - 1, floorDiv( highY - SUBPIXEL / 2, SUBPIXEL ) );
+    if( T.minX > T.maxX || T.minY > T.maxY ) {
+        return;
+    }
+
+    // E(p) = A px + B py + C is positive to the left of edge i -> j;
+    // at pixel (x,y) p is (16x+8, 16y+8)
+    for( int i = 0; i < 3; i++ ) {
+        int j = i == 2 ? 0 : i + 1;
+        int64_t A = y[i] - y[j];
+        int64_t B = x[j] - x[i];
+        int64_t c = -(A * x[i] + B * y[i]) + (A + B) * (SUBPIXEL / 2);
+
+        // top-left rule: pixels exactly on an edge belong to the
+        // triangle only if it is a left edge or a top edge
+        bool topLeft = A > 0 || (A == 0 && B < 0);
+        if( !topLeft ) {
+            c -= 1;
+        }
+
+        T.a[i] = A * SUBPIXEL;
+        T.b[i] = B * SUBPIXEL;
+        T.c[i] = c;
+    }
+    T.planes = planes;
+
+    uint32_t index = C.triangles.size();
+    C.triangles.push_back( T );
+
+    for( int ty = T.minY / RASTER_TILE; ty <= T.maxY / RASTER_TILE; ty++ ) {
+        for( int tx = T.minX / RASTER_TILE; tx <= T.maxX / RASTER_TILE; tx++ ) {
+            C.bins[ty * tilesX + tx].push_back( index );
+        }
+    }
+}
+
+///
+// setUp(chunk,draw,first,count) - setup stage for part of one draw
+///
+void Rasterizer::setUp( int chunk, int d, int first, int count )
+{
+    Chunk &C = chunks[chunk];
+    const Draw &D = draws[d];
+
+    C.triangles.clear();
+    C.planes.clear();
+    C.bins.resize( tilesX * tilesY );
+    for( size_t i = 0; i < C.bins.size(); i++ ) {
+        C.bins[i].clear();
+    }
+
+    for( int t = first; t < first + count; t++ ) {
+        int base = D.firstVertex + 3 * t;
+        const float *c[3];
+        int codes[3];
+
+        for( int i = 0; i < 3; i++ ) {
+            c[i] = &clip[4 * (base + i)];
+            codes[i] = outcode( c[i] );
+        }
+
+        // entirely outside one plane
+        if( codes[0] & codes[1] & codes[2] ) {
+            continue;
+        }
+
+        // Interpolation.  With M the matrix whose columns are the
+        // vertices' (x,y,w), lambda = M^-1 (X,Y,1) at NDC point (X,Y)
+        // gives each vertex's barycentric weight divided by w there, so
+        // sum(lambda) is 1/w and sum(a_i lambda_i) is a/w: both linear
+        // in X and Y.  This holds on the whole plane of the triangle,
+        // so the planes need no clipping.
+        double r[3][3];
+        double col[3][3];
+        for( int i = 0; i < 3; i++ ) {
+            col[i][0] = c[i][0];
+            col[i][1] = c[i][1];
+            col[i][2] = c[i][3];
+        }
+        for( int i = 0; i < 3; i++ ) {
+            const double *p = col[(i + 1) % 3], *q = col[(i + 2) % 3];
+            r[i][0] = p[1] * q[2] - p[2] * q[1];
+            r[i][1] = p[2] * q[0] - p[0] * q[2];
+            r[i][2] = p[0] * q[1] - p[1] * q[0];
+        }
+        double det = col[0][0] * r[0][0] + col[0][1] * r[0][1] +
+                     col[0][2] * r[0][2];
+        if( det == 0.0 || !std::isfinite( det ) ) {
+            continue;   // seen edge-on
+        }
+
+        Planes P;
+        P.draw = d;
+
+        double sx = 2.0 / width, sy = 2.0 / height;
+        for( int k = 0; k < PLANES; k++ ) {
+            double value[3];
+            for( int i = 0; i < 3; i++ ) {
+                int v = base + i;
+                switch( k ) {
+                    case P_Z:  value[i] = clip[4 * v + 2]; break;
+                    case P_Q:  value[i] = 1.0; break;
+                    case P_NX: case P_NY: case P_NZ:
+                        value[i] = normal[3 * v + k - P_NX]; break;
+                    case P_EX: case P_EY: case P_EZ:
+                        value[i] = eye[3 * v + k - P_EX]; break;
+                    case P_U: case P_V:
+                        value[i] = texCoord[2 * v + k - P_U]; break;
+                    default:
+                        value[i] = occlusion[v]; break;
+                }
+            }
+            double pX = 0.0, pY = 0.0, p1 = 0.0;
+            for( int i = 0; i < 3; i++ ) {
+                pX += value[i] * r[i][0] / det;
+                pY += value[i] * r[i][1] / det;
+                p1 += value[i] * r[i][2] / det;
+            }
+            // pixel (x,y) has its center at NDC (x+0.5) sx - 1, ...
+            P.p[k][0] = pX * sx;
+            P.p[k][1] = pY * sy;
+            P.p[k][2] = p1 + pX * (0.5 * sx - 1.0) + pY * (0.5 * sy - 1.0);
+        }
+
+        // Coverage.  Clip to the view volume if need be (this only
+        // shapes the screen area), then fan into screen triangles.
+        float poly[2][9][4];
+        int n = 3, cur = 0;
+        for( int i = 0; i < 3; i++ ) {
+            memcpy( poly[0][i], c[i], sizeof(poly[0][i]) );
+        }
+        int crossed = codes[0] | codes[1] | codes[2];
+        for( int plane = 0; plane < 6 && n > 0; plane++ ) {
+            if( !(crossed & (1 << plane)) ) {
+                continue;
+            }
+            float (*in)[4] = poly[cur], (*out)[4] = poly[1 - cur];
+            int m = 0;
+            for( int i = 0; i < n; i++ ) {
+                const float *a = in[i], *b = in[(i + 1) % n];
+                float da = planeDistance( a, plane ), db = planeDistance( b, plane );
+                if( da >= 0.0f ) {
+                    memcpy( out[m++], a, sizeof(out[0]) );
+                }
+                if( (da >= 0.0f) != (db >= 0.0f) ) {
+                    float s = da / (da - db);
+                    for( int k = 0; k < 4; k++ ) {
+                        out[m][k] = a[k] + s * (b[k] - a[k]);
+                    }
+                    m++;
+                }
+            }
+            n = m;
+            cur = 1 - cur;
+        }
+        if( n < 3 ) {
+            continue;
+        }
+
+        // to 1/16 pixel window coordinates
+        float (*v)[4] = poly[cur];
+        for( int i = 0; i < n; i++ ) {
+            float w = v[i][3];
+            v[i][0] = (v[i][0] / w + 1.0f) * (width * SUBPIXEL / 2);
+            v[i][1] = (v[i][1] / w + 1.0f) * (height * SUBPIXEL / 2);
+        }
+
+        // GL_CCW front faces
+        double area = 0.0;
+        for( int i = 0; i < n; i++ ) {
+            const float *a = v[i], *b = v[(i + 1) % n];
+            area += (double) a[0] * b[1] - (double) b[0] * a[1];
+        }
+        if( area == 0.0 ) {
+            continue;
+        }
+        P.backFacing = area < 0.0;
+
+        int planes = C.planes.size();
+        C.planes.push_back( P );
+        for( int i = 1; i + 1 < n; i++ ) {
+            float fan[3][4];
+            memcpy( fan[0], v[0], sizeof(fan[0]) );
+            memcpy( fan[1], v[i], sizeof(fan[1]) );
+            memcpy( fan[2], v[i + 1], sizeof(fan[2]) );
+            addTriangle( C, fan, planes );
+        }
+    }
+}
+
+///
+// Per-span helpers for the tile stage.  A span is SIMD_WIDTH pixels of
+// one row, starting at pixel x.
+///
+
+// plane value at pixels x+0 .. x+7 of row y
+static inline SimdFloat planeAt( const float *p, SimdFloat x, float y )
+{
+    return fmadd( SimdFloat( p[0] ), x, SimdFloat( p[1] * y + p[2] ) );
+}
+
+// edge function values at the corner of the clipped bounding box
+static inline int32_t edgeStart( const Rasterizer::Triangle &T, int k,
+                                 int x, int y )
+{
+    int64_t e = (int64_t) T.a[k] * x + (int64_t) T.b[k] * y + T.c[k];
+    if( e > EDGE_CLAMP ) {
+        e = EDGE_CLAMP;
+    } else if( e < -EDGE_CLAMP ) {
+        e = -EDGE_CLAMP;
+    }
+    return (int32_t) e;
+}
+
+///
+// shadeSpan(...) - run the Phong model of phong.frag / texture.frag for
+//     the pixels of one span selected by 'mask' and store them
+///
+static void shadeSpan( const Rasterizer::Draw &D,
+                       const Rasterizer::Planes &P, const float *light,
+                       SimdFloat x, float y, SimdMask mask, uint32_t *out )
+{
+    SimdFloat q = planeAt( P.p[Rasterizer::P_Q], x, y );
+    SimdFloat w = SimdFloat( 1.0f ) / q;
+
+    // the normal's length doesn't matter, so there's no need to divide
+    SimdFloat nx = planeAt( P.p[Rasterizer::P_NX], x, y );
+    SimdFloat ny = planeAt( P.p[Rasterizer::P_NY], x, y );
+    SimdFloat nz = planeAt( P.p[Rasterizer::P_NZ], x, y );
+    normalize( nx, ny, nz );
+    if( D.texture != NULL && P.backFacing ) {
+        nx = -nx;
+        ny = -ny;
+        nz = -nz;
+    }
+
+    SimdFloat ex = planeAt( P.p[Rasterizer::P_EX], x, y ) * w;
+    SimdFloat ey = planeAt( P.p[Rasterizer::P_EY], x, y ) * w;
+    SimdFloat ez = planeAt( P.p[Rasterizer::P_EZ], x, y ) * w;
+
+    SimdFloat lx = SimdFloat( light[0] ) - ex;
+    SimdFloat ly = SimdFloat( light[1] ) - ey;
+    SimdFloat lz = SimdFloat( light[2] ) - ez;
+    normalize( lx, ly, lz );
+    normalize( ex, ey, ez );
+
+    // R = reflect(L,N); V.R
+    SimdFloat nl = dot( nx, ny, nz, lx, ly, lz );
+    SimdFloat twoNL = nl + nl;
+    SimdFloat rx = lx - twoNL * nx;
+    SimdFloat ry = ly - twoNL * ny;
+    SimdFloat rz = lz - twoNL * nz;
+    SimdFloat vr = max( dot( ex, ey, ez, rx, ry, rz ), SimdFloat( 0.0f ) );
+
+    SimdFloat diffuse = max( nl, SimdFloat( 0.0f ) );
+    SimdFloat specular = pow( vr, SimdFloat( D.exponent ) );
+    SimdFloat occlusion = planeAt( P.p[Rasterizer::P_AO], x, y ) * w;
+
+    SimdFloat color[4];
+    for( int c = 0; c < 4; c++ ) {
+        color[c] = fmadd( SimdFloat( D.diffuse[c] ), diffuse,
+                   fmadd( SimdFloat( D.specular[c] ), specular,
+                          SimdFloat( D.ambient[c] ) * occlusion ) );
+    }
+
+    if( D.texture != NULL ) {
+        SimdFloat us = planeAt( P.p[Rasterizer::P_U], x, y );
+        SimdFloat vs = planeAt( P.p[Rasterizer::P_V], x, y );
+        SimdFloat u = us * w, v = vs * w;
+
+        // d(U/Q)/dx = (U_x - u Q_x) / Q, and likewise for y and v
+        SimdFloat qa( P.p[Rasterizer::P_Q][0] ), qb( P.p[Rasterizer::P_Q][1] );
+        SimdFloat dudx = (SimdFloat( P.p[Rasterizer::P_U][0] ) - u * qa) * w;
+        SimdFloat dudy = (SimdFloat( P.p[Rasterizer::P_U][1] ) - u * qb) * w;
+        SimdFloat dvdx = (SimdFloat( P.p[Rasterizer::P_V][0] ) - v * qa) * w;
+        SimdFloat dvdy = (SimdFloat( P.p[Rasterizer::P_V][1] ) - v * qb) * w;
+
+        SimdFloat tex[4];
+        D.texture->sample( u, v, D.texture->lod( dudx, dvdx, dudy, dvdy ), tex );
+        for( int c = 0; c < 4; c++ ) {
+            color[c] = color[c] * tex[c];
+        }
+    }
+
+    SimdInt packed( 0 );
+    for( int c = 0; c < 4; c++ ) {
+        SimdInt byte = roundToInt( clamp( color[c], 0.0f, 1.0f ) *
+                                   SimdFloat( 255.0f ) );
+        packed = packed | (byte << (8 * c));
+    }
+    storeMasked( (int32_t *) out, mask, packed );
+}
+
+///
+// shadeTile(tile) - rasterize and shade one tile
+///
+void Rasterizer::shadeTile( int tile )
+{
+    int tx0 = (tile % tilesX) * RASTER_TILE;
+    int ty0 = (tile / tilesX) * RASTER_TILE;
+    int tx1 = min( tx0 + RASTER_TILE, width ) - 1;
+    int ty1 = min( ty0 + RASTER_TILE, height ) - 1;
+
+    // NDC depth; padded so a span that runs off the last row stays
+    // inside the array
+    float depth[RASTER_TILE * RASTER_TILE + SIMD_WIDTH];
+    for( int i = 0; i < RASTER_TILE * RASTER_TILE + SIMD_WIDTH; i++ ) {
+        depth[i] = 1.0f;
+    }
+
+    for( int y = ty0; y <= ty1; y++ ) {
+        memset( &pixels[(size_t) y * width + tx0], 0,
+                (tx1 - tx0 + 1) * sizeof(uint32_t) );
+    }
+
+    SimdInt lanes = laneIndex();
+
+    // pass 0 finds the nearest depth at every pixel; pass 1 shades the
+    // pixels where each triangle matches it
+    for( int pass = 0; pass < 2; pass++ ) {
+        for( size_t ci = 0; ci < chunks.size(); ci++ ) {
+            const Chunk &C = chunks[ci];
+            const vector<uint32_t> &bin = C.bins[tile];
+
+            for( size_t bi = 0; bi < bin.size(); bi++ ) {
+                const Triangle &T = C.triangles[bin[bi]];
+                const Planes &P = C.planes[T.planes];
+                const Draw &D = draws[P.draw];
+
+                int x0 = max( T.minX, tx0 ), x1 = min( T.maxX, tx1 );
+                int y0 = max( T.minY, ty0 ), y1 = min( T.maxY, ty1 );
+                if( x0 > x1 || y0 > y1 ) {
+                    continue;
+                }
+
+                int32_t e[3];
+                SimdInt step[3];
+                for( int k = 0; k < 3; k++ ) {
+                    e[k] = edgeStart( T, k, x0, y0 );
+                    step[k] = lanes * SimdInt( T.a[k] );
+                }
+
+                for( int y = y0; y <= y1; y++ ) {
+                    float fy = y;
+                    float *drow = &depth[(y - ty0) * RASTER_TILE - tx0];
+                    uint32_t *prow = &pixels[(size_t) y * width];
+                    int32_t e0 = e[0], e1 = e[1], e2 = e[2];
+
+                    for( int x = x0; x <= x1; x += SIMD_WIDTH ) {
+                        SimdInt inside = (SimdInt( e0 ) + step[0]) |
+                                         (SimdInt( e1 ) + step[1]) |
+                                         (SimdInt( e2 ) + step[2]);
+                        SimdMask cover = nonNegative( inside ) &
+                                         (SimdInt( x1 - x ) >= lanes);
+                        e0 += T.a[0] * SIMD_WIDTH;
+                        e1 += T.a[1] * SIMD_WIDTH;
+                        e2 += T.a[2] * SIMD_WIDTH;
+                        if( !any( cover ) ) {
+                            continue;
+                        }
+
+                        SimdFloat fx = toFloat( SimdInt( x ) + lanes );
+                        SimdFloat z = planeAt( P.p[P_Z], fx, fy );
+                        SimdFloat d = loadFloat( drow + x );
+
+                        if( pass == 0 ) {
+                            SimdMask nearer = cover & (z <= d);
+                            storeMasked( drow + x, nearer, z );
+                        } else {
+                            SimdMask visible = cover & (z == d);
+                            if( any( visible ) ) {
+                                shadeSpan( D, P, eyeLight, fx, fy, visible,
+                                           prow + x );
+                            }
+                        }
+                    }
+
+                    for( int k = 0; k < 3; k++ ) {
+                        e[k] += T.b[k];
+                    }
+                }
+            }
+        }
+    }
+}
+
+///
+// render() - draw the queued objects into 'pixels'
+///
+void Rasterizer::render( void )
+{
+    if( width == 0 ) {
+        return;
+    }
+
+    // per-frame light and material terms, as the shaders combine them
+    float worldLight[4] = { light[0], light[1], light[2], 1.0f };
+    transformVector( eyeLight, view, worldLight, 3 );
+
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        Draw &D = draws[d];
+        shadingTerms( D.material, lightColor, ambientColor, D.ambient,
+                      D.diffuse, D.specular );
+        D.exponent = D.material->specExponent;
+    }
+
+    // vertex stage
+    clip.resize( 4 * (size_t) vertices );
+    eye.resize( 3 * (size_t) vertices );
+    normal.resize( 3 * (size_t) vertices );
+    texCoord.resize( 2 * (size_t) vertices );
+    occlusion.resize( vertices );
+
+    vector<int> work;       // draw, first, count
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        int n = draws[d].buffers->numElements;
+        for( int first = 0; first < n; first += VERTEX_BATCH ) {
+            work.push_back( d );
+            work.push_back( first );
+            work.push_back( min( VERTEX_BATCH, n - first ) );
+        }
+    }
+    pool.parallelFor( work.size() / 3, [&]( int i, int ) {
+        transform( work[3*i], work[3*i+1], work[3*i+2] );
+    } );
+
+    // setup stage, in chunks that never span two draws
+    work.clear();
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        int n = draws[d].buffers->numElements / 3;
+        for( int first = 0; first < n; first += SETUP_BATCH ) {
+            work.push_back( d );
+            work.push_back( first );
+            work.push_back( min( SETUP_BATCH, n - first ) );
+        }
+    }
+    chunks.resize( work.size() / 3 );
+    pool.parallelFor( chunks.size(), [&]( int i, int ) {
+        setUp( i, work[3*i], work[3*i+1], work[3*i+2] );
+    } );
+
+    // tile stage
+    pool.parallelFor( tilesX * tilesY, [&]( int tile, int ) {
+        shadeTile( tile );
+    } );
+}
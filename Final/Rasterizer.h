@@ -0,0 +1,175 @@
+//
+//  Rasterizer.h
+//
+//  Tile-based software rasterizer: draws BufferSets with the shading of
+//  phong.vert/phong.frag and texture.vert/texture.frag on the CPU, for
+//  machines without a GPU.
+//
+//  A frame runs in three parallel stages on a ThreadPool:
+//
+//      vertex  - transform every vertex to clip and eye space
+//      setup   - clip each triangle to the view volume, snap it to a
+//                1/16 pixel grid, compute its edge functions and
+//                interpolation planes, and bin it into the screen tiles
+//                it touches (one bin list per chunk of triangles, so
+//                binning needs no locks and keeps submission order)
+//      tiles   - each tile (RASTER_TILE pixels square) is rasterized by
+//                one worker: a depth-only pass over its triangles, then
+//                a shading pass that runs the Phong model eight pixels
+//                at a time for the pixels whose depth won, so every
+//                pixel is shaded once
+//
+//  Coverage uses integer half-space edge functions with a top-left fill
+//  rule; depth is GL_LEQUAL against a cleared far plane.  The result
+//  matches the GL path up to rasterization and rounding details.
+//
+
+#ifndef _RASTERIZER_H_
+#define _RASTERIZER_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Buffers.h"
+#include "Lighting.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// tile size in pixels (a power of two)
+#define RASTER_TILE     64
+
+// largest target the integer edge functions handle
+#define RASTER_MAX_DIM  8192
+
+class Rasterizer {
+
+public:
+    // the frame: width*height RGBA pixels, bottom row first (the order
+    // glReadPixels() produces)
+    int width, height;
+    vector<uint32_t> pixels;
+
+    // per-draw shading inputs
+    struct Draw {
+        const BufferSet *buffers;
+        const Material *material;
+        const Texture *texture;     // NULL unless the material is textured
+        int firstVertex;            // in the vertex stage output
+        float model[16];
+        float ambient[4];           // material * light, set by render()
+        float diffuse[4];
+        float specular[4];
+        float exponent;
+    };
+
+    // one screen-space triangle (part of a clipped one, perhaps)
+    struct Triangle {
+        int32_t a[3], b[3];         // edge function steps per pixel
+        int64_t c[3];               // edge functions at pixel (0,0)
+        int minX, minY, maxX, maxY; // pixel bounds
+        int planes;                 // index of its Planes record
+    };
+
+    // interpolation planes v = a*x + b*y + c over pixel centers
+    enum { P_Z, P_Q, P_NX, P_NY, P_NZ, P_EX, P_EY, P_EZ, P_U, P_V, P_AO,
+           PLANES };
+    struct Planes {
+        float p[PLANES][3];
+        int draw;
+        bool backFacing;
+    };
+
+    // setup output for a run of triangles
+    struct Chunk {
+        vector<Triangle> triangles;
+        vector<Planes> planes;
+        vector< vector<uint32_t> > bins;   // per tile: indices into triangles
+    };
+
+private:
+    ThreadPool &pool;
+
+    float view[16], projection[16];
+    float light[3];             // world space
+    float eyeLight[3];          // eye space, set by render()
+    float lightColor[4], ambientColor[4];
+
+    vector<Draw> draws;
+    int vertices;
+
+    // vertex stage output, one entry per vertex
+    vector<float> clip;         // XYZW
+    vector<float> eye;          // XYZ
+    vector<float> normal;       // XYZ, unit length
+    vector<float> texCoord;     // UV
+    vector<float> occlusion;    // ambient occlusion
+
+    int tilesX, tilesY;
+    vector<Chunk> chunks;
+
+    void transform( int draw, int first, int count );
+    void setUp( int chunk, int draw, int first, int count );
+    void addTriangle( Chunk &C, const float (*v)[4], int planes );
+    void shadeTile( int tile );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to render with
+    ///
+    Rasterizer( ThreadPool &threads );
+
+    ///
+    // resize(w,h) - set the frame size
+    //
+    // @return true if the size is supported
+    ///
+    bool resize( int w, int h );
+
+    ///
+    // setCamera(eye,lookAt,up) - camera for the next frame; the view
+    //     volume is the one setUpFrustum() sends
+    ///
+    void setCamera( const float *eyePoint, const float *lookAt,
+                    const float *up );
+
+    ///
+    // setLight(color,position,ambient) - the arguments of setUpLight()
+    //     as RGB triples and a world-space position
+    ///
+    void setLight( const float *color, const float *position,
+                   const float *ambient );
+
+    ///
+    // begin() - start a new frame with no draws
+    ///
+    void begin( void );
+
+    ///
+    // draw(B,M,T,scale,rotate,translate) - queue an object, transformed
+    //     as setUpTransforms() would
+    //
+    // @param B         - its vertex data (points, normals, uv)
+    // @param M         - its material
+    // @param T         - the texture for a textured material
+    // @param scale     - x, y and z scale factors
+    // @param rotate    - x, y and z rotations in degrees
+    // @param translate - x, y and z translations
+    ///
+    void draw( const BufferSet &B, const Material *M, const Texture *T,
+               const float *scale, const float *rotate,
+               const float *translate );
+
+    ///
+    // render() - draw the queued objects into 'pixels', clearing it to
+    //     black first
+    ///
+    void render( void );
+
+};
+
+#endif
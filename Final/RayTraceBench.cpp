@@ -0,0 +1,98 @@
+//
+//  RayTraceBench.cpp
+//
+//  The ray tracer benchmark (-rtbench; see Benchmarks.h): the CPU
+//  benchmarks' frames ray traced with 1, 2, 4 ... threads.
+//
+
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "RayTracer.h"
+#include "Scene.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// rtBenchmark() - ray trace B.frames frames at B.width x B.height along
+// cpuBenchmark()'s camera path with 1, 2, 4 ... threads, up to the
+// size of the CPU renderers' pool, and report the BVH build time and
+// the ray throughput of each thread count.
+///
+void rtBenchmark( const BenchSettings &B )
+{
+    int w = B.width, h = B.height, frames = B.frames;
+    if( !initCPU() ) {
+        return;
+    }
+    const SceneParts &P = sceneParts();
+    if( !P.rayTracer->resize( w, h ) ) {
+        return;
+    }
+
+    SceneView stillLife = sceneView();
+
+    vector<int> counts;
+    for( int n = 1; n < P.cpuPool->size(); n *= 2 ) {
+        counts.push_back( n );
+    }
+    counts.push_back( P.cpuPool->size() );
+
+    printf( "ray tracer: %d frames at %dx%d, %d mirror bounces\n", frames,
+        w, h, P.rayTracer->bounces );
+
+    double baseMs = 0.0;
+    for( size_t c = 0; c < counts.size(); c++ ) {
+        ThreadPool *pool = counts[c] == P.cpuPool->size() ? P.cpuPool :
+                           new ThreadPool( counts[c] );
+        RayTracer T( *pool );
+        T.resize( w, h );
+
+        double traceMs = 0.0, buildMs = 0.0;
+        int builds = 0;
+        uint64_t primary = 0, shadow = 0, mirror = 0;
+
+        // frame -1 is an untimed warm-up
+        for( int f = -1; f < frames; f++ ) {
+            setSceneView( benchPose( f, stillLife ) );
+
+            uint64_t start = monotonicNs();
+            displayRayTraced( T );
+            double ms = elapsedMs( start );
+
+            if( T.buildMs > 0.0 ) {
+                buildMs += T.buildMs;
+                builds++;
+            }
+            if( f >= 0 ) {
+                traceMs += ms;
+                primary += T.primaryRays;
+                shadow += T.shadowRays;
+                mirror += T.mirrorRays;
+            }
+        }
+
+        if( c == 0 ) {
+            printf( "scene: %d triangles, %d BVH nodes\n",
+                (int) T.bvh.triangles.size(), (int) T.bvh.nodes.size() );
+            printf( "per frame: %.0f primary, %.0f shadow, %.0f mirror rays\n",
+                (double) primary / frames, (double) shadow / frames,
+                (double) mirror / frames );
+            printf( "threads  BVH build  ms/frame   Mrays/s  speedup\n" );
+            baseMs = traceMs;
+        }
+        printf( "%7d  %6.2f ms  %8.2f  %8.2f  %6.2fx\n", counts[c],
+            buildMs / builds, traceMs / frames,
+            (primary + shadow + mirror) / (traceMs * 1000.0),
+            baseMs / traceMs );
+
+        if( pool != P.cpuPool ) {
+            delete pool;
+        }
+    }
+
+    setSceneView( stillLife );
+}
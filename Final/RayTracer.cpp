@@ -0,0 +1,661 @@
+//
+//  RayTracer.cpp
+//
+//  CPU ray tracer implementation.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "RayTracer.h"
+#include "Simd.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+// rayCount[] slots
+enum { PRIMARY, SHADOW, MIRROR };
+
+///
+// Constructor
+///
+RayTracer::RayTracer( ThreadPool &threads ) :
+    width(0), height(0), shadows(true), bounces(2), buildMs(0.0),
+    primaryRays(0), shadowRays(0), mirrorRays(0), pool(threads),
+    tilesX(0), tilesY(0)
+{
+    static const float origin[3] = { 0.0f, 0.0f, 0.0f };
+    static const float white[3] = { 1.0f, 1.0f, 1.0f };
+    static const float z[3] = { 0.0f, 0.0f, -1.0f };
+    static const float y[3] = { 0.0f, 1.0f, 0.0f };
+
+    setCamera( origin, z, y );
+    setLight( white, origin, white );
+}
+
+///
+// resize(w,h) - set the frame size; a no-op if it is unchanged
+///
+bool RayTracer::resize( int w, int h )
+{
+    if( w < 1 || h < 1 || w > RT_MAX_DIM || h > RT_MAX_DIM ) {
+        cerr << "RayTracer: unsupported size " << w << "x" << h << endl;
+        return false;
+    }
+    if( w == width && h == height ) {
+        return true;
+    }
+
+    width = w;
+    height = h;
+    pixels.assign( (size_t) w * h, 0 );
+    tilesX = (w + RT_TILE - 1) / RT_TILE;
+    tilesY = (h + RT_TILE - 1) / RT_TILE;
+
+    return true;
+}
+
+///
+// setCamera(eye,lookAt,up) - camera for the next frame
+///
+void RayTracer::setCamera( const float *eye, const float *lookAt,
+                           const float *up )
+{
+    float view[16];
+    viewMatrix( view, eye, lookAt, up );
+
+    // the rows of the view rotation are the camera's axes
+    for( int i = 0; i < 3; i++ ) {
+        eyePoint[i] = eye[i];
+        for( int k = 0; k < 3; k++ ) {
+            camera[i][k] = view[4 * k + i];
+        }
+    }
+    getFrustum( frustum );
+}
+
+///
+// setLight(color,position,ambient) - light for the next frame
+///
+void RayTracer::setLight( const float *color, const float *position,
+                          const float *ambient )
+{
+    for( int i = 0; i < 3; i++ ) {
+        lightColor[i] = color[i];
+        light[i] = position[i];
+        ambientColor[i] = ambient[i];
+    }
+    lightColor[3] = ambientColor[3] = 1.0f;
+}
+
+///
+// begin() - start a new frame
+///
+void RayTracer::begin( void )
+{
+    draws.clear();
+}
+
+///
+// draw(B,M,T,scale,rotate,translate) - add an object
+///
+void RayTracer::draw( const BufferSet &B, const Material *M,
+                      const Texture *T, const float *scale,
+                      const float *rotate, const float *translate )
+{
+    Draw D;
+
+    D.buffers = &B;
+    D.material = M;
+    D.texture = M->textured ? T : NULL;
+    modelMatrix( D.model, scale, rotate, translate );
+
+    draws.push_back( D );
+}
+
+///
+// sameScene() - have the objects the BVH was built from stayed put?
+///
+bool RayTracer::sameScene( void ) const
+{
+    if( draws.size() != built.size() ) {
+        return false;
+    }
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        const Draw &A = draws[d], &B = built[d];
+        if( A.buffers != B.buffers || A.material != B.material ||
+            A.texture != B.texture ||
+            memcmp( A.model, B.model, sizeof(A.model) ) != 0 ) {
+            return false;
+        }
+    }
+    return true;
+}
+
+///
+// buildScene() - transform the objects into world space and build the
+//     BVH over them
+///
+void RayTracer::buildScene( void )
+{
+    vector<int> first( draws.size() + 1, 0 );
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        first[d + 1] = first[d] + draws[d].buffers->numElements / 3;
+    }
+    int count = first[draws.size()];
+
+    positions.resize( 9 * (size_t) count );
+    normals.resize( 9 * (size_t) count );
+    texCoords.resize( 6 * (size_t) count );
+    faceNormals.resize( 3 * (size_t) count );
+    texelDensity.resize( count );
+    triangleDraw.resize( count );
+
+    pool.parallelFor( draws.size(), [&]( int d, int ) {
+        const Draw &D = draws[d];
+        const BufferSet &B = *D.buffers;
+        const float *M = D.model;
+
+        for( int t = 0; t < B.numElements / 3; t++ ) {
+            size_t out = first[d] + t;
+            float *p = &positions[9 * out];
+            float *n = &normals[9 * out];
+            float *uv = &texCoords[6 * out];
+
+            for( int i = 0; i < 3; i++ ) {
+                const float *src = &B.points[4 * (3 * t + i)];
+                for( int k = 0; k < 3; k++ ) {
+                    p[3 * i + k] = M[k] * src[0] + M[4 + k] * src[1] +
+                                   M[8 + k] * src[2] + M[12 + k] * src[3];
+                }
+            }
+
+            float e1[3], e2[3], g[3];
+            for( int k = 0; k < 3; k++ ) {
+                e1[k] = p[3 + k] - p[k];
+                e2[k] = p[6 + k] - p[k];
+            }
+            g[0] = e1[1] * e2[2] - e1[2] * e2[1];
+            g[1] = e1[2] * e2[0] - e1[0] * e2[2];
+            g[2] = e1[0] * e2[1] - e1[1] * e2[0];
+            float worldArea = sqrtf( g[0] * g[0] + g[1] * g[1] + g[2] * g[2] );
+            for( int k = 0; k < 3; k++ ) {
+                faceNormals[3 * out + k] = worldArea > 0.0f ? g[k] / worldArea : 0.0f;
+            }
+
+            for( int i = 0; i < 3; i++ ) {
+                float *v = &n[3 * i];
+                if( B.normals.empty() ) {
+                    memcpy( v, g, sizeof(g) );
+                } else {
+                    const float *src = &B.normals[3 * (3 * t + i)];
+                    for( int k = 0; k < 3; k++ ) {
+                        v[k] = M[k] * src[0] + M[4 + k] * src[1] +
+                               M[8 + k] * src[2];
+                    }
+                }
+                float len = sqrtf( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+                if( len > 0.0f ) {
+                    v[0] /= len;
+                    v[1] /= len;
+                    v[2] /= len;
+                }
+
+                uv[2 * i] = B.uv.empty() ? 0.0f : B.uv[2 * (3 * t + i)];
+                uv[2 * i + 1] = B.uv.empty() ? 0.0f : B.uv[2 * (3 * t + i) + 1];
+            }
+
+            // texels per unit of length across the triangle
+            float density = 0.0f;
+            if( D.texture != NULL && worldArea > 0.0f ) {
+                float texelArea = fabsf( (uv[2] - uv[0]) * (uv[5] - uv[1]) -
+                                         (uv[4] - uv[0]) * (uv[3] - uv[1]) ) *
+                                  D.texture->width[0] * D.texture->height[0];
+                if( texelArea > 0.0f ) {
+                    density = 0.5f * log2f( texelArea / worldArea );
+                }
+            }
+            texelDensity[out] = density;
+            triangleDraw[out] = d;
+        }
+    } );
+
+    bvh.build( positions.data(), count );
+}
+
+///
+// prepare() - fill the shading table and rebuild the BVH if needed
+///
+bool RayTracer::prepare( void )
+{
+    // the light's colors are applied while shading
+    static const float white[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+
+    shading.assign( S_STRIDE * draws.size(), 0.0f );
+    textures.clear();
+    for( size_t d = 0; d < draws.size(); d++ ) {
+        const Draw &D = draws[d];
+        float *S = &shading[S_STRIDE * d];
+        shadingTerms( D.material, white, white, S + S_AMBIENT,
+                      S + S_DIFFUSE, S + S_SPECULAR );
+        S[S_EXPONENT] = D.material->specExponent;
+        S[S_MIRROR] = D.material->mirrorCoeff;
+        if( D.texture != NULL ) {
+            size_t k = find( textures.begin(), textures.end(), D.texture ) -
+                       textures.begin();
+            if( k == textures.size() ) {
+                textures.push_back( D.texture );
+            }
+            S[S_TEXTURE] = k + 1.0f;
+        }
+    }
+
+    buildMs = 0.0;
+    if( sameScene() ) {
+        return false;
+    }
+
+    uint64_t start = monotonicNs();
+    buildScene();
+    buildMs = elapsedMs( start );
+    built = draws;
+    return true;
+}
+
+///
+// primaryPacket(sx,sy,R) - primary rays through frame positions (sx,sy)
+///
+void RayTracer::primaryPacket( SimdFloat sx, SimdFloat sy,
+                               RayPacket &R ) const
+{
+    // eye-space position of frame position (sx,sy) on the near plane is
+    // (left + sx scaleX, bottom + sy scaleY, -near)
+    float scaleX = (frustum[1] - frustum[0]) / width;
+    float scaleY = (frustum[2] - frustum[3]) / height;
+    float near = frustum[4];
+
+    SimdFloat ex = fmadd( sx, SimdFloat( scaleX ), SimdFloat( frustum[0] ) );
+    SimdFloat ey = fmadd( sy, SimdFloat( scaleY ), SimdFloat( frustum[3] ) );
+    SimdFloat ez( -near );
+
+    R.ox = SimdFloat( eyePoint[0] );
+    R.oy = SimdFloat( eyePoint[1] );
+    R.oz = SimdFloat( eyePoint[2] );
+    R.dx = dot( ex, ey, ez, SimdFloat( camera[0][0] ),
+                SimdFloat( camera[1][0] ), SimdFloat( camera[2][0] ) );
+    R.dy = dot( ex, ey, ez, SimdFloat( camera[0][1] ),
+                SimdFloat( camera[1][1] ), SimdFloat( camera[2][1] ) );
+    R.dz = dot( ex, ey, ez, SimdFloat( camera[0][2] ),
+                SimdFloat( camera[1][2] ), SimdFloat( camera[2][2] ) );
+
+    // with this direction, t = 1 is the near plane
+    R.tMin = SimdFloat( 1.0f );
+    R.tMax = SimdFloat( frustum[5] / near );
+}
+
+///
+// findSurface(R,H,S) - gather the shading attributes of H's hits
+///
+void RayTracer::findSurface( const RayPacket &R, const PacketHit &H,
+                             Surface &S ) const
+{
+    SimdFloat zero( 0.0f );
+
+    S.hit = H.hit;
+    S.triangle = select( H.hit, H.triangle, SimdInt( 0 ) );
+    S.row = gather( triangleDraw.data(), S.triangle ) * SimdInt( S_STRIDE );
+    S.b1 = H.u;
+    S.b2 = H.v;
+    S.b0 = SimdFloat( 1.0f ) - S.b1 - S.b2;
+
+    SimdInt corner = S.triangle * SimdInt( 9 );
+    SimdFloat n[3];
+    for( int k = 0; k < 3; k++ ) {
+        SimdInt at = corner + SimdInt( k );
+        n[k] = fmadd( S.b0, gather( normals.data(), at ),
+               fmadd( S.b1, gather( normals.data(), at + SimdInt( 3 ) ),
+                      S.b2 * gather( normals.data(), at + SimdInt( 6 ) ) ) );
+    }
+    S.nx = n[0];
+    S.ny = n[1];
+    S.nz = n[2];
+    normalize( S.nx, S.ny, S.nz );
+
+    SimdInt face = S.triangle * SimdInt( 3 );
+    S.gx = gather( faceNormals.data(), face );
+    S.gy = gather( faceNormals.data(), face + SimdInt( 1 ) );
+    S.gz = gather( faceNormals.data(), face + SimdInt( 2 ) );
+
+    S.px = fmadd( H.t, R.dx, R.ox );
+    S.py = fmadd( H.t, R.dy, R.oy );
+    S.pz = fmadd( H.t, R.dz, R.oz );
+
+    S.vx = R.dx;
+    S.vy = R.dy;
+    S.vz = R.dz;
+    S.length = sqrt( dot( S.vx, S.vy, S.vz, S.vx, S.vy, S.vz ) );
+    normalize( S.vx, S.vy, S.vz );
+
+    S.facing = dot( S.gx, S.gy, S.gz, S.vx, S.vy, S.vz );
+    S.textured = H.hit & (gather( shading.data(), S.row + SimdInt( S_TEXTURE ) ) > zero);
+}
+
+///
+// unshadowed(S,rays) - the hits that see the light
+///
+SimdMask RayTracer::unshadowed( const Surface &S, uint64_t &rays ) const
+{
+    if( !shadows ) {
+        return S.hit;
+    }
+
+    // shadow rays run from just off the surface, on the light's side,
+    // to the light
+    SimdFloat zero( 0.0f );
+    SimdFloat lx = SimdFloat( light[0] ) - S.px;
+    SimdFloat ly = SimdFloat( light[1] ) - S.py;
+    SimdFloat lz = SimdFloat( light[2] ) - S.pz;
+    SimdFloat side = select( dot( S.gx, S.gy, S.gz, lx, ly, lz ) < zero,
+                             SimdFloat( -RT_OFFSET ), SimdFloat( RT_OFFSET ) );
+
+    RayPacket R;
+    R.ox = fmadd( side, S.gx, S.px );
+    R.oy = fmadd( side, S.gy, S.py );
+    R.oz = fmadd( side, S.gz, S.pz );
+    R.dx = SimdFloat( light[0] ) - R.ox;
+    R.dy = SimdFloat( light[1] ) - R.oy;
+    R.dz = SimdFloat( light[2] ) - R.oz;
+    R.tMin = zero;
+    R.tMax = SimdFloat( 1.0f );
+    R.active = S.hit;
+
+    rays += __builtin_popcount( bits( S.hit ) );
+    return andNot( S.hit, bvh.occluded( R ) );
+}
+
+///
+// directLight(S,lit,color) - light reflected toward the ray's origin,
+// as in phong.frag and texture.frag
+///
+void RayTracer::directLight( const Surface &S, SimdMask lit,
+                             SimdFloat *color ) const
+{
+    SimdFloat zero( 0.0f );
+    SimdFloat lx = SimdFloat( light[0] ) - S.px;
+    SimdFloat ly = SimdFloat( light[1] ) - S.py;
+    SimdFloat lz = SimdFloat( light[2] ) - S.pz;
+    normalize( lx, ly, lz );
+
+    SimdFloat nl = dot( S.nx, S.ny, S.nz, lx, ly, lz );
+    SimdFloat twoNL = nl + nl;
+    SimdFloat rx = lx - twoNL * S.nx;
+    SimdFloat ry = ly - twoNL * S.ny;
+    SimdFloat rz = lz - twoNL * S.nz;
+    SimdFloat vr = max( dot( S.vx, S.vy, S.vz, rx, ry, rz ), zero );
+
+    SimdFloat exponent = gather( shading.data(), S.row + SimdInt( S_EXPONENT ) );
+    SimdFloat diffuse = select( lit, max( nl, zero ), zero );
+    SimdFloat specular = select( lit, pow( vr, exponent ), zero );
+
+    for( int c = 0; c < 4; c++ ) {
+        SimdInt at = S.row + SimdInt( c );
+        color[c] = SimdFloat( lightColor[c] ) *
+                   fmadd( gather( shading.data(), at + SimdInt( S_DIFFUSE ) ), diffuse,
+                          gather( shading.data(), at + SimdInt( S_SPECULAR ) ) * specular );
+    }
+}
+
+///
+// textureColor(S,distance,color) - texture colors of the textured hits
+///
+void RayTracer::textureColor( const Surface &S, SimdFloat distance,
+                              SimdFloat *color ) const
+{
+    SimdFloat one( 1.0f );
+    for( int c = 0; c < 4; c++ ) {
+        color[c] = one;
+    }
+    if( !any( S.textured ) ) {
+        return;
+    }
+
+    SimdInt corners = S.triangle * SimdInt( 6 );
+    SimdFloat uv[2];
+    for( int k = 0; k < 2; k++ ) {
+        SimdInt at = corners + SimdInt( k );
+        uv[k] = fmadd( S.b0, gather( texCoords.data(), at ),
+                fmadd( S.b1, gather( texCoords.data(), at + SimdInt( 2 ) ),
+                       S.b2 * gather( texCoords.data(), at + SimdInt( 4 ) ) ) );
+    }
+
+    // the mip level: texels across the pixel's cone where it meets the
+    // surface, stretched by the slant.  The cone widens by one pixel
+    // per near-plane distance travelled.
+    float spread = (frustum[2] - frustum[3]) / height / frustum[4];
+    SimdFloat slant = max( abs( S.facing ), SimdFloat( 1e-3f ) );
+    SimdFloat cone = SimdFloat( spread ) * distance / slant;
+    SimdFloat lod = gather( texelDensity.data(), S.triangle ) +
+                    log2( max( cone, SimdFloat( 1e-20f ) ) );
+
+    // one sample() per texture in the packet
+    SimdFloat texture = gather( shading.data(), S.row + SimdInt( S_TEXTURE ) );
+    for( size_t k = 0; k < textures.size(); k++ ) {
+        SimdMask these = S.textured & (texture == SimdFloat( k + 1.0f ));
+        if( !any( these ) ) {
+            continue;
+        }
+        SimdFloat tex[4];
+        textures[k]->sample( uv[0], uv[1], lod, tex );
+        for( int c = 0; c < 4; c++ ) {
+            color[c] = select( these, tex[c], color[c] );
+        }
+    }
+}
+
+///
+// traceTile(tile) - trace one tile of the frame
+///
+void RayTracer::traceTile( int tile )
+{
+    int tx0 = (tile % tilesX) * RT_TILE;
+    int ty0 = (tile / tilesX) * RT_TILE;
+    int tx1 = min( tx0 + RT_TILE, width );
+    int ty1 = min( ty0 + RT_TILE, height );
+
+    uint64_t rays[3] = { 0, 0, 0 };
+    SimdFloat zero( 0.0f ), one( 1.0f ), half( 0.5f );
+    SimdInt lanes = laneIndex();
+    SimdInt laneX = lanes & SimdInt( 3 ), laneY = lanes >> 2;
+
+    for( int y = ty0; y < ty1; y += 2 ) {
+        for( int x = tx0; x < tx1; x += 4 ) {
+
+            // the 4x2 block of primary rays at (x,y), through the
+            // pixel centers
+            SimdInt px = SimdInt( x ) + laneX, py = SimdInt( y ) + laneY;
+            RayPacket R;
+            primaryPacket( toFloat( px ) + half, toFloat( py ) + half, R );
+            R.active = (SimdInt( tx1 - 1 ) >= px) & (SimdInt( ty1 - 1 ) >= py);
+
+            SimdFloat color[4] = { zero, zero, zero, zero };
+            SimdFloat weight = one;         // of the current bounce
+            SimdFloat travelled = zero;     // distance before this bounce
+
+            for( int bounce = 0; bounce <= bounces && any( R.active ); bounce++ ) {
+                rays[bounce == 0 ? PRIMARY : MIRROR] += __builtin_popcount( bits( R.active ) );
+
+                PacketHit H;
+                bvh.intersect( R, H );
+                if( !any( H.hit ) ) {
+                    break;
+                }
+
+                Surface S;
+                findSurface( R, H, S );
+
+                // the cloth is lit on whichever side faces the viewer
+                SimdMask flip = S.textured & (S.facing > zero);
+                S.nx = select( flip, -S.nx, S.nx );
+                S.ny = select( flip, -S.ny, S.ny );
+                S.nz = select( flip, -S.nz, S.nz );
+
+                SimdFloat local[4], tex[4];
+                directLight( S, unshadowed( S, rays[SHADOW] ), local );
+                SimdFloat distance = fmadd( H.t, S.length, travelled );
+                textureColor( S, distance, tex );
+                for( int c = 0; c < 4; c++ ) {
+                    SimdFloat ambient = SimdFloat( ambientColor[c] ) *
+                        gather( shading.data(), S.row + SimdInt( S_AMBIENT + c ) );
+                    local[c] = (local[c] + ambient) * tex[c];
+                }
+
+                // reflections add to the color only, not alpha
+                for( int c = 0; c < (bounce == 0 ? 4 : 3); c++ ) {
+                    color[c] = select( H.hit, fmadd( weight, local[c], color[c] ),
+                                       color[c] );
+                }
+
+                // mirror rays leave around the normal that faces the ray
+                SimdFloat mirror = gather( shading.data(), S.row + SimdInt( S_MIRROR ) );
+                SimdMask reflect = H.hit & (mirror > zero);
+                if( bounce == bounces || !any( reflect ) ) {
+                    break;
+                }
+
+                SimdFloat vn = dot( S.vx, S.vy, S.vz, S.nx, S.ny, S.nz );
+                SimdMask away = vn > zero;
+                SimdFloat twoVN = abs( vn ) + abs( vn );
+                SimdFloat side = select( S.facing > zero, SimdFloat( -RT_OFFSET ),
+                                         SimdFloat( RT_OFFSET ) );
+                travelled = distance;
+                weight = weight * mirror;
+
+                R.ox = fmadd( side, S.gx, S.px );
+                R.oy = fmadd( side, S.gy, S.py );
+                R.oz = fmadd( side, S.gz, S.pz );
+                R.dx = fmadd( twoVN, select( away, -S.nx, S.nx ), S.vx );
+                R.dy = fmadd( twoVN, select( away, -S.ny, S.ny ), S.vy );
+                R.dz = fmadd( twoVN, select( away, -S.nz, S.nz ), S.vz );
+                R.tMin = zero;
+                R.tMax = SimdFloat( FLT_MAX );
+                R.active = reflect;
+            }
+
+            SimdInt packed( 0 );
+            for( int c = 0; c < 4; c++ ) {
+                SimdInt byte = roundToInt( clamp( color[c], 0.0f, 1.0f ) *
+                                           SimdFloat( 255.0f ) );
+                packed = packed | (byte << (8 * c));
+            }
+            int32_t out[SIMD_WIDTH];
+            storeInt( out, packed );
+            for( int i = 0; i < SIMD_WIDTH; i++ ) {
+                int ox = x + (i & 3), oy = y + (i >> 2);
+                if( ox < tx1 && oy < ty1 ) {
+                    pixels[(size_t) oy * width + ox] = out[i];
+                }
+            }
+        }
+    }
+
+    for( int k = 0; k < 3; k++ ) {
+        rayCount[k] += rays[k];
+    }
+}
+
+///
+// render() - trace the frame
+///
+void RayTracer::render( void )
+{
+    if( width == 0 ) {
+        return;
+    }
+
+    prepare();
+
+    for( int k = 0; k < 3; k++ ) {
+        rayCount[k] = 0;
+    }
+
+    pool.parallelFor( tilesX * tilesY, [&]( int tile, int ) {
+        traceTile( tile );
+    } );
+
+    primaryRays = rayCount[PRIMARY];
+    shadowRays = rayCount[SHADOW];
+    mirrorRays = rayCount[MIRROR];
+}
+
+///
+// renderGuides(albedo,normal,depth) - first-hit guides for Denoiser
+///
+void RayTracer::renderGuides( float *albedo, float *normal, float *depth )
+{
+    if( width == 0 ) {
+        return;
+    }
+
+    prepare();
+
+    pool.parallelFor( tilesX * tilesY, [&]( int tile, int ) {
+        int tx0 = (tile % tilesX) * RT_TILE;
+        int ty0 = (tile / tilesX) * RT_TILE;
+        int tx1 = min( tx0 + RT_TILE, width );
+        int ty1 = min( ty0 + RT_TILE, height );
+
+        SimdFloat zero( 0.0f ), half( 0.5f );
+        SimdInt lanes = laneIndex();
+        SimdInt laneX = lanes & SimdInt( 3 ), laneY = lanes >> 2;
+
+        for( int y = ty0; y < ty1; y += 2 ) {
+            for( int x = tx0; x < tx1; x += 4 ) {
+                SimdInt px = SimdInt( x ) + laneX, py = SimdInt( y ) + laneY;
+                RayPacket R;
+                primaryPacket( toFloat( px ) + half, toFloat( py ) + half, R );
+                R.active = (SimdInt( tx1 - 1 ) >= px) & (SimdInt( ty1 - 1 ) >= py);
+
+                PacketHit H;
+                bvh.intersect( R, H );
+                Surface S;
+                findSurface( R, H, S );
+
+                SimdMask back = S.facing > zero;
+                SimdFloat tex[4], value[7];
+                textureColor( S, H.t * S.length, tex );
+                for( int c = 0; c < 3; c++ ) {
+                    value[c] = tex[c] * gather( shading.data(),
+                                                S.row + SimdInt( S_DIFFUSE + c ) );
+                }
+                value[3] = select( back, -S.nx, S.nx );
+                value[4] = select( back, -S.ny, S.ny );
+                value[5] = select( back, -S.nz, S.nz );
+
+                // with the primary rays' directions, t = 1 is the near
+                // plane
+                value[6] = H.t * SimdFloat( frustum[4] );
+
+                float out[7][SIMD_WIDTH];
+                for( int k = 0; k < 7; k++ ) {
+                    storeFloat( out[k], select( H.hit, value[k], zero ) );
+                }
+                for( int i = 0; i < SIMD_WIDTH; i++ ) {
+                    int ox = x + (i & 3), oy = y + (i >> 2);
+                    if( ox >= tx1 || oy >= ty1 ) {
+                        continue;
+                    }
+                    size_t p = (size_t) oy * width + ox;
+                    for( int c = 0; c < 3; c++ ) {
+                        albedo[3 * p + c] = out[c][i];
+                        normal[3 * p + c] = out[3 + c][i];
+                    }
+                    depth[p] = out[6][i];
+                }
+            }
+        }
+    } );
+}
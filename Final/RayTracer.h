@@ -0,0 +1,236 @@
+//
+//  RayTracer.h
+//
+//  CPU ray tracer for the still life: the same objects, camera and
+//  Phong shading as the GL path, plus the light's shadows and mirror
+//  reflections on materials with a mirrorCoeff (the glass and the
+//  bottle).
+//
+//  render() transforms every queued object into world space and builds
+//  one SAH BVH over the whole scene (skipped when no object moved since
+//  the last frame), then traces the frame in RT_TILE pixel tiles on a
+//  ThreadPool.  Each tile is traced in packets of 4x2 neighboring
+//  primary rays; the shadow rays of a packet's hits and its reflection
+//  rays travel as packets too.
+//
+//  Primary rays start on the near plane and end on the far one, so the
+//  image matches the rasterized one wherever nothing is in shadow or
+//  reflective.  The cloth's mip level comes from the width of each
+//  pixel's ray cone where it meets the table.
+//
+
+#ifndef _RAYTRACER_H_
+#define _RAYTRACER_H_
+
+#include <atomic>
+#include <stdint.h>
+#include <vector>
+
+#include "Buffers.h"
+#include "Bvh.h"
+#include "Lighting.h"
+#include "Simd.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// tile size in pixels
+#define RT_TILE         16
+
+// largest frame
+#define RT_MAX_DIM      8192
+
+// secondary rays start this far off the surface they leave, so they
+// cannot hit it again through rounding (the scene is about 10 units
+// across)
+#define RT_OFFSET       2e-4f
+
+class RayTracer {
+
+public:
+    // the frame: width*height RGBA pixels, bottom row first (the order
+    // glReadPixels() produces)
+    int width, height;
+    vector<uint32_t> pixels;
+
+    // trace shadow rays, and how many mirror bounces to follow
+    bool shadows;
+    int bounces;
+
+    // statistics of the last render(): BVH build time (0 if the old
+    // tree was reused) and rays traced, by kind
+    double buildMs;
+    uint64_t primaryRays, shadowRays, mirrorRays;
+
+    // one object of the frame
+    struct Draw {
+        const BufferSet *buffers;
+        const Material *material;
+        const Texture *texture;     // NULL unless the material is textured
+        float model[16];
+    };
+
+    // the scene in world space, one entry per triangle
+    Bvh bvh;
+    vector<float> positions;        // 3 corners, XYZ
+    vector<float> normals;          // 3 corners, XYZ
+    vector<float> texCoords;        // 3 corners, UV
+    vector<float> faceNormals;      // XYZ, unit length
+    vector<float> texelDensity;     // log2 of texels per unit of length
+    vector<int32_t> triangleDraw;   // index into draws
+
+protected:
+    ThreadPool &pool;
+
+    float eyePoint[3];
+    float camera[3][3];             // world-space u, v, n axes
+    float frustum[6];
+    float light[3];
+    float lightColor[4], ambientColor[4];
+
+    vector<Draw> draws, built;      // this frame's, and the BVH's
+    vector<float> shading;          // per draw, set by prepare()
+    vector<const Texture *> textures;
+    int tilesX, tilesY;
+
+    // per-draw entries of the shading table: the material's shading
+    // terms for a white light, specular exponent, mirror coefficient
+    // and texture (an index into 'textures' plus one, or 0)
+    enum {
+        S_AMBIENT = 0, S_DIFFUSE = 4, S_SPECULAR = 8, S_EXPONENT = 12,
+        S_MIRROR, S_TEXTURE, S_STRIDE = 16
+    };
+
+    // what shading needs to know about a packet's hits; lanes that
+    // missed hold triangle 0's attributes
+    struct Surface {
+        SimdMask hit, textured;
+        SimdInt triangle;
+        SimdInt row;                // the draw's entry in 'shading'
+        SimdFloat b0, b1, b2;       // barycentric coordinates
+        SimdFloat px, py, pz;       // the hit point
+        SimdFloat nx, ny, nz;       // interpolated unit normal
+        SimdFloat gx, gy, gz;       // unit face normal
+        SimdFloat vx, vy, vz;       // unit ray direction
+        SimdFloat facing;           // g . v
+        SimdFloat length;           // of the ray direction
+    };
+
+    bool sameScene( void ) const;
+    void buildScene( void );
+
+    ///
+    // prepare() - fill the shading table and rebuild the BVH if any
+    //     object moved
+    //
+    // @return true if the BVH was rebuilt
+    ///
+    bool prepare( void );
+
+    ///
+    // primaryPacket(sx,sy,R) - primary rays through the frame positions
+    //     (sx,sy), in pixels from its bottom left corner; sets all of R
+    //     but 'active'
+    ///
+    void primaryPacket( SimdFloat sx, SimdFloat sy, RayPacket &R ) const;
+
+    ///
+    // findSurface(R,H,S) - gather the shading attributes of H's hits
+    ///
+    void findSurface( const RayPacket &R, const PacketHit &H,
+                      Surface &S ) const;
+
+    ///
+    // unshadowed(S,rays) - the hits that see the light; adds the shadow
+    //     rays traced to 'rays'
+    ///
+    SimdMask unshadowed( const Surface &S, uint64_t &rays ) const;
+
+    ///
+    // directLight(S,lit,color) - diffuse and specular light reflected
+    //     toward the ray's origin, 0 where not 'lit'; the normal must
+    //     face the side being lit
+    ///
+    void directLight( const Surface &S, SimdMask lit,
+                      SimdFloat *color ) const;
+
+    ///
+    // textureColor(S,distance,color) - the textured hits' texture
+    //     colors, filtered for a pixel's ray cone after 'distance'; 1
+    //     for the other lanes
+    ///
+    void textureColor( const Surface &S, SimdFloat distance,
+                       SimdFloat *color ) const;
+
+private:
+    atomic<uint64_t> rayCount[3];
+
+    void traceTile( int tile );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param threads - the workers to render with
+    ///
+    RayTracer( ThreadPool &threads );
+
+    ///
+    // resize(w,h) - set the frame size
+    //
+    // @return true if the size is supported
+    ///
+    bool resize( int w, int h );
+
+    ///
+    // setCamera(eye,lookAt,up) - camera for the next frame; the view
+    //     volume is the one setUpFrustum() sends
+    ///
+    void setCamera( const float *eye, const float *lookAt, const float *up );
+
+    ///
+    // setLight(color,position,ambient) - the arguments of setUpLight()
+    //     as RGB triples and a world-space position
+    ///
+    void setLight( const float *color, const float *position,
+                   const float *ambient );
+
+    ///
+    // begin() - start a new frame with no objects
+    ///
+    void begin( void );
+
+    ///
+    // draw(B,M,T,scale,rotate,translate) - add an object, transformed
+    //     as setUpTransforms() would
+    //
+    // @param B         - its vertex data (points, normals, uv)
+    // @param M         - its material
+    // @param T         - the texture for a textured material
+    // @param scale     - x, y and z scale factors
+    // @param rotate    - x, y and z rotations in degrees
+    // @param translate - x, y and z translations
+    ///
+    void draw( const BufferSet &B, const Material *M, const Texture *T,
+               const float *scale, const float *rotate,
+               const float *translate );
+
+    ///
+    // render() - trace the objects added since begin() into 'pixels'
+    ///
+    void render( void );
+
+    ///
+    // renderGuides(albedo,normal,depth) - the first hits through the
+    //     pixel centers, as guides for Denoiser: the diffuse color
+    //     (RGB), the unit world-space normal on the side facing the
+    //     camera (XYZ) and the eye-space depth of each pixel, bottom row
+    //     first; all 0 where nothing is hit
+    ///
+    void renderGuides( float *albedo, float *normal, float *depth );
+
+};
+
+#endif
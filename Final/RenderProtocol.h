@@ -0,0 +1,87 @@
+//
+//  RenderProtocol.h
+//
+//  Wire format spoken over the render service's Unix domain socket
+//  (see RenderService.h).  Both sides are on the same machine, so the
+//  structures are sent as-is in native byte order.
+//
+//  A client writes RenderRequest records; for each one the service
+//  writes a RenderReply followed by 'bytes' bytes of RGBA pixels
+//  (bottom row first, as glReadPixels() returns them).  A client may
+//  have several requests in flight; replies can come back in a
+//  different order (cache hits are answered first), so match them up
+//  by 'id'.
+//
+
+#ifndef _RENDERPROTOCOL_H_
+#define _RENDERPROTOCOL_H_
+
+#include <stdint.h>
+
+// "RREQ" / "RREP"
+#define RENDER_REQUEST_MAGIC    0x51455252u
+#define RENDER_REPLY_MAGIC      0x50455252u
+
+// largest image the service will render
+#define RENDER_MAX_DIM          4096
+
+// reply status codes
+#define RENDER_OK               0
+#define RENDER_BAD_REQUEST      1
+#define RENDER_STATS            2   // reply to a stats request; no pixels
+#define RENDER_FAILED           3   // the server could not render it
+
+// request flags
+#define RENDER_FLAG_NOCACHE     0x1 // always render, never use the cache
+#define RENDER_FLAG_STATS       0x2 // ask for (and reset) server statistics
+
+///
+// One image to render.  Every field from 'eye' through 'height' takes
+// part in the cache key, so unused padding must be zeroed.
+///
+typedef struct RenderRequest {
+    uint32_t magic;
+    uint32_t id;                // echoed back in the reply
+    uint32_t flags;
+    uint32_t pad;
+
+    float eye[3];               // camera, as for setUpCamera()
+    float lookAt[3];
+    float up[3];
+    float angles[24];           // per-object x,y,z rotations (finalMain)
+    float lightColor[3];
+    float lightPosition[3];
+    float ambientColor[3];
+    uint32_t width;             // image size in pixels
+    uint32_t height;
+} RenderRequest;
+
+///
+// Reply header; followed by 'bytes' bytes of pixel data
+///
+typedef struct RenderReply {
+    uint32_t magic;
+    uint32_t id;
+    uint32_t status;
+    uint32_t cached;            // 1 if served from the result cache
+    uint32_t width;
+    uint32_t height;
+    uint64_t bytes;
+    float serviceMs;            // time from arrival to reply on the server
+    float renderMs;             // time spent rendering (0 if cached)
+} RenderReply;
+
+///
+// Server statistics, sent as the payload of a RENDER_STATS reply
+///
+typedef struct RenderStats {
+    uint64_t requests;
+    uint64_t rendered;
+    uint64_t cacheHits;
+    uint64_t batches;
+    double seconds;             // since the statistics were last reset
+    double p50Ms;               // service latency percentiles
+    double p99Ms;
+} RenderStats;
+
+#endif
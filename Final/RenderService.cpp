@@ -0,0 +1,558 @@
+//
+//  RenderService.cpp
+//
+//  Long-lived render service: socket handling, request batching and
+//  the LRU result cache.  All GL work happens through the callbacks
+//  handed to the constructor, on the thread that calls run().
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstddef>
+#include <cerrno>
+#include <iostream>
+#include <algorithm>
+
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include "RenderService.h"
+#include "Timing.h"
+
+using namespace std;
+
+// most requests folded into a single batch
+#define MAX_BATCH   64
+
+///
+// requestKey(req) - FNV-1a hash of every field that affects the image
+///
+uint64_t requestKey( const RenderRequest &req )
+{
+    const unsigned char *p = (const unsigned char *) &req.eye;
+    size_t n = sizeof(RenderRequest) - offsetof(RenderRequest, eye);
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for( size_t i = 0; i < n; i++ ) {
+        h ^= p[i];
+        h *= 0x100000001b3ull;
+    }
+
+    return h;
+}
+
+// do two requests produce the same image?
+static bool sameImage( const RenderRequest &a, const RenderRequest &b )
+{
+    return memcmp( &a.eye, &b.eye,
+        sizeof(RenderRequest) - offsetof(RenderRequest, eye) ) == 0;
+}
+
+///
+// ResultCache constructor
+///
+ResultCache::ResultCache( uint64_t cap ) : bytes(0), capacity(cap)
+{
+}
+
+///
+// find(key,req) - look up a result, marking it most recently used
+///
+const vector<unsigned char> *ResultCache::find( uint64_t key,
+                                                const RenderRequest &req )
+{
+    unordered_map< uint64_t, list<Entry>::iterator >::iterator it =
+        index.find( key );
+    if( it == index.end() || !sameImage( it->second->params, req ) ) {
+        return NULL;
+    }
+
+    // move to the front of the LRU list
+    lru.splice( lru.begin(), lru, it->second );
+    return &lru.front().pixels;
+}
+
+///
+// insert(key,req,pixels) - add a result, evicting old ones as needed
+///
+const vector<unsigned char> *ResultCache::insert( uint64_t key,
+    const RenderRequest &req, vector<unsigned char> &pixels )
+{
+    // an image larger than the whole cache is never kept
+    if( pixels.size() > capacity ) {
+        return NULL;
+    }
+
+    unordered_map< uint64_t, list<Entry>::iterator >::iterator it =
+        index.find( key );
+    if( it != index.end() ) {
+        bytes -= it->second->pixels.size();
+        lru.erase( it->second );
+        index.erase( it );
+    }
+
+    while( !lru.empty() && bytes + pixels.size() > capacity ) {
+        bytes -= lru.back().pixels.size();
+        index.erase( lru.back().key );
+        lru.pop_back();
+    }
+
+    lru.push_front( Entry() );
+    Entry &E = lru.front();
+    E.key = key;
+    E.params = req;
+    E.pixels.swap( pixels );
+    bytes += E.pixels.size();
+    index[key] = lru.begin();
+
+    return &E.pixels;
+}
+
+///
+// size() - number of cached images
+///
+size_t ResultCache::size( void ) const
+{
+    return lru.size();
+}
+
+///
+// RenderService constructor
+///
+RenderService::RenderService( BatchFunc begin, RenderFunc rend,
+                              uint64_t cacheBytes ) :
+    beginBatch(begin), render(rend), cache(cacheBytes), listenFd(-1),
+    requests(0), rendered(0), cacheHits(0), batches(0),
+    statsStartNs(monotonicNs())
+{
+    path[0] = '\0';
+}
+
+///
+// Destructor
+///
+RenderService::~RenderService( void )
+{
+    for( size_t i = 0; i < clients.size(); i++ ) {
+        close( clients[i]->fd );
+        delete clients[i];
+    }
+    if( listenFd >= 0 ) {
+        close( listenFd );
+        if( path[0] != '\0' ) {
+            unlink( path );
+        }
+    }
+}
+
+///
+// listenTcp(port) - create a TCP listening socket on all interfaces
+///
+static int listenTcp( int port )
+{
+    int fd = socket( AF_INET, SOCK_STREAM, 0 );
+    if( fd < 0 ) {
+        perror( "RenderService: socket" );
+        return -1;
+    }
+
+    int on = 1;
+    setsockopt( fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on) );
+
+    struct sockaddr_in addr;
+    memset( &addr, 0, sizeof(addr) );
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl( INADDR_ANY );
+    addr.sin_port = htons( port );
+
+    if( bind( fd, (struct sockaddr *) &addr, sizeof(addr) ) != 0 ||
+        ::listen( fd, 64 ) != 0 ) {
+        perror( "RenderService: tcp" );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+///
+// listen(where) - create the listening socket
+///
+bool RenderService::listen( const char *sockPath )
+{
+    struct sockaddr_un addr;
+
+    if( strncmp( sockPath, "tcp:", 4 ) == 0 ) {
+        listenFd = listenTcp( atoi( sockPath + 4 ) );
+        path[0] = '\0';
+        cerr << "render service listening on TCP port " <<
+            atoi( sockPath + 4 ) << endl;
+        return listenFd >= 0;
+    }
+
+    if( strlen( sockPath ) >= sizeof(addr.sun_path) ) {
+        cerr << "RenderService: socket path too long" << endl;
+        return false;
+    }
+
+    listenFd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( listenFd < 0 ) {
+        perror( "RenderService: socket" );
+        return false;
+    }
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strcpy( addr.sun_path, sockPath );
+    unlink( sockPath );
+
+    if( bind( listenFd, (struct sockaddr *) &addr, sizeof(addr) ) != 0 ||
+        ::listen( listenFd, 64 ) != 0 ) {
+        perror( sockPath );
+        close( listenFd );
+        listenFd = -1;
+        return false;
+    }
+
+    strcpy( path, sockPath );
+    cerr << "render service listening on " << path << endl;
+    return true;
+}
+
+///
+// acceptClient() - take a new connection
+///
+void RenderService::acceptClient( void )
+{
+    int fd = accept( listenFd, NULL, NULL );
+    if( fd < 0 ) {
+        if( errno != EINTR && errno != EAGAIN ) {
+            perror( "RenderService: accept" );
+        }
+        return;
+    }
+
+    // replies go out as soon as they are written
+    int on = 1;
+    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on) );
+
+    Client *C = new Client;
+    C->fd = fd;
+    C->dead = false;
+    clients.push_back( C );
+}
+
+///
+// receive(C) - pull whatever has arrived on a connection and queue
+//     every complete request
+///
+void RenderService::receive( Client *C )
+{
+    unsigned char buf[ 64 * sizeof(RenderRequest) ];
+
+    ssize_t n = recv( C->fd, buf, sizeof(buf), MSG_DONTWAIT );
+    if( n == 0 || (n < 0 && errno != EAGAIN && errno != EINTR) ) {
+        C->dead = true;
+        return;
+    }
+    if( n < 0 ) {
+        return;
+    }
+
+    C->inbuf.insert( C->inbuf.end(), buf, buf + n );
+
+    uint64_t now = monotonicNs();
+    size_t used = 0;
+    while( C->inbuf.size() - used >= sizeof(RenderRequest) ) {
+        Pending P;
+        memcpy( &P.req, &C->inbuf[used], sizeof(RenderRequest) );
+        P.client = C;
+        P.key = requestKey( P.req );
+        P.arrivalNs = now;
+        pending.push_back( P );
+        used += sizeof(RenderRequest);
+    }
+    C->inbuf.erase( C->inbuf.begin(), C->inbuf.begin() + used );
+}
+
+///
+// reply() - send a reply header and its payload
+///
+void RenderService::reply( Pending &P, int status, bool cached,
+                           float renderMs, const void *data, uint64_t bytes )
+{
+    if( P.client->dead ) {
+        return;
+    }
+
+    RenderReply R;
+    memset( &R, 0, sizeof(R) );
+    R.magic = RENDER_REPLY_MAGIC;
+    R.id = P.req.id;
+    R.status = status;
+    R.cached = cached;
+    R.width = status == RENDER_OK ? P.req.width : 0;
+    R.height = status == RENDER_OK ? P.req.height : 0;
+    R.bytes = bytes;
+    R.renderMs = renderMs;
+    R.serviceMs = elapsedMs( P.arrivalNs );
+
+    // the socket is blocking for writes; the client must keep reading
+    struct iovec iov[2] = {
+        { &R, sizeof(R) }, { (void *) data, (size_t) bytes }
+    };
+    struct msghdr msg;
+    memset( &msg, 0, sizeof(msg) );
+    msg.msg_iov = iov;
+    msg.msg_iovlen = bytes ? 2 : 1;
+
+    while( msg.msg_iovlen > 0 ) {
+        ssize_t n = sendmsg( P.client->fd, &msg, MSG_NOSIGNAL );
+        if( n < 0 ) {
+            if( errno == EINTR ) {
+                continue;
+            }
+            P.client->dead = true;
+            return;
+        }
+        // step past what was written
+        while( msg.msg_iovlen > 0 && (size_t) n >= msg.msg_iov->iov_len ) {
+            n -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if( msg.msg_iovlen > 0 ) {
+            msg.msg_iov->iov_base = (char *) msg.msg_iov->iov_base + n;
+            msg.msg_iov->iov_len -= n;
+        }
+    }
+
+    if( status == RENDER_OK ) {
+        latencyMs.push_back( R.serviceMs );
+    }
+}
+
+///
+// replyStats() - answer a statistics request (and reset the counters)
+///
+void RenderService::replyStats( Pending &P )
+{
+    RenderStats S;
+    stats( S, true );
+    reply( P, RENDER_STATS, false, 0.0f, &S, sizeof(S) );
+
+    cerr << "render service: " << S.requests << " requests in " <<
+        S.seconds << " s (" << (S.seconds > 0 ? S.requests / S.seconds : 0) <<
+        " req/s), " << S.cacheHits << " cache hits, " << S.batches <<
+        " batches, p50 " << S.p50Ms << " ms, p99 " << S.p99Ms << " ms" << endl;
+}
+
+///
+// processBatch() - answer everything that is queued
+///
+void RenderService::processBatch( void )
+{
+    size_t count = min( pending.size(), (size_t) MAX_BATCH );
+    vector<size_t> misses;
+
+    // first pass: validation, statistics and cache hits
+    for( size_t i = 0; i < count; i++ ) {
+        Pending &P = pending[i];
+        const RenderRequest &R = P.req;
+
+        if( R.magic != RENDER_REQUEST_MAGIC ) {
+            // out of sync; nothing more from this client makes sense
+            reply( P, RENDER_BAD_REQUEST, false, 0.0f, NULL, 0 );
+            P.client->dead = true;
+            continue;
+        }
+        if( R.flags & RENDER_FLAG_STATS ) {
+            replyStats( P );
+            continue;
+        }
+        if( R.width < 1 || R.height < 1 ||
+            R.width > RENDER_MAX_DIM || R.height > RENDER_MAX_DIM ) {
+            reply( P, RENDER_BAD_REQUEST, false, 0.0f, NULL, 0 );
+            continue;
+        }
+
+        requests++;
+        if( !(R.flags & RENDER_FLAG_NOCACHE) ) {
+            const vector<unsigned char> *hit = cache.find( P.key, R );
+            if( hit != NULL ) {
+                cacheHits++;
+                reply( P, RENDER_OK, true, 0.0f, hit->data(), hit->size() );
+                continue;
+            }
+        }
+        misses.push_back( i );
+    }
+
+    if( !misses.empty() ) {
+        batches++;
+
+        // group by resolution; identical requests end up next to each other
+        stable_sort( misses.begin(), misses.end(),
+            [this]( size_t i, size_t j ) {
+                const Pending &a = pending[i], &b = pending[j];
+                if( a.req.width != b.req.width )
+                    return a.req.width < b.req.width;
+                if( a.req.height != b.req.height )
+                    return a.req.height < b.req.height;
+                return a.key < b.key;
+            } );
+
+        vector<unsigned char> pixels;
+        const vector<unsigned char> *image = NULL;
+        float renderMs = 0.0f;
+        uint32_t curW = 0, curH = 0;
+        bool batchOk = false;
+
+        for( size_t m = 0; m < misses.size(); m++ ) {
+            Pending &P = pending[ misses[m] ];
+            const RenderRequest &R = P.req;
+
+            // a duplicate of the previous request reuses its image
+            bool dup = m > 0 && image != NULL &&
+                !(R.flags & RENDER_FLAG_NOCACHE) &&
+                P.key == pending[ misses[m-1] ].key &&
+                sameImage( R, pending[ misses[m-1] ].req );
+
+            if( !dup ) {
+                if( R.width != curW || R.height != curH ) {
+                    curW = R.width;
+                    curH = R.height;
+                    batchOk = beginBatch( curW, curH );
+                }
+                if( !batchOk ) {
+                    reply( P, RENDER_FAILED, false, 0.0f, NULL, 0 );
+                    image = NULL;
+                    continue;
+                }
+
+                uint64_t start = monotonicNs();
+                pixels.resize( (size_t) R.width * R.height * 4 );
+                render( R, pixels.data() );
+                renderMs = elapsedMs( start );
+                rendered++;
+
+                if( R.flags & RENDER_FLAG_NOCACHE ) {
+                    reply( P, RENDER_OK, false, renderMs,
+                           pixels.data(), pixels.size() );
+                    image = NULL;
+                    continue;
+                }
+
+                image = cache.insert( P.key, R, pixels );
+                if( image == NULL ) {
+                    // too big to cache; answer from the scratch buffer
+                    reply( P, RENDER_OK, false, renderMs,
+                           pixels.data(), pixels.size() );
+                    continue;
+                }
+            } else {
+                cacheHits++;
+            }
+
+            reply( P, RENDER_OK, dup, dup ? 0.0f : renderMs,
+                   image->data(), image->size() );
+        }
+    }
+
+    pending.erase( pending.begin(), pending.begin() + count );
+}
+
+///
+// dropDeadClients() - close connections that have gone away, once
+//     none of their requests are still queued
+///
+void RenderService::dropDeadClients( void )
+{
+    for( size_t i = 0; i < clients.size(); ) {
+        Client *C = clients[i];
+        bool queued = false;
+        for( size_t j = 0; j < pending.size() && !queued; j++ ) {
+            queued = pending[j].client == C;
+        }
+        if( C->dead && !queued ) {
+            close( C->fd );
+            delete C;
+            clients[i] = clients.back();
+            clients.pop_back();
+        } else {
+            i++;
+        }
+    }
+}
+
+///
+// run(stop) - serve requests until *stop becomes true
+///
+void RenderService::run( volatile bool *stop )
+{
+    vector<struct pollfd> fds;
+
+    while( !*stop ) {
+        fds.resize( clients.size() + 1 );
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        for( size_t i = 0; i < clients.size(); i++ ) {
+            fds[i+1].fd = clients[i]->fd;
+            fds[i+1].events = POLLIN;
+        }
+
+        // block only when there is nothing left to do; wake up now and
+        // then to notice *stop
+        int timeout = pending.empty() ? 250 : 0;
+        int n = poll( fds.data(), fds.size(), timeout );
+        if( n < 0 && errno != EINTR ) {
+            perror( "RenderService: poll" );
+            break;
+        }
+
+        if( n > 0 ) {
+            for( size_t i = 1; i < fds.size(); i++ ) {
+                if( fds[i].revents & (POLLIN | POLLHUP | POLLERR) ) {
+                    receive( clients[i-1] );
+                }
+            }
+            if( fds[0].revents & POLLIN ) {
+                acceptClient();
+            }
+        }
+
+        if( !pending.empty() ) {
+            processBatch();
+        }
+        dropDeadClients();
+    }
+}
+
+///
+// stats(S,reset) - fill in the current statistics
+///
+void RenderService::stats( RenderStats &S, bool reset )
+{
+    uint64_t now = monotonicNs();
+
+    sort( latencyMs.begin(), latencyMs.end() );
+    S.requests = requests;
+    S.rendered = rendered;
+    S.cacheHits = cacheHits;
+    S.batches = batches;
+    S.seconds = (now - statsStartNs) / 1.0e9;
+    S.p50Ms = percentile( latencyMs.data(), latencyMs.size(), 0.50 );
+    S.p99Ms = percentile( latencyMs.data(), latencyMs.size(), 0.99 );
+
+    if( reset ) {
+        latencyMs.clear();
+        requests = rendered = cacheHits = batches = 0;
+        statsStartNs = now;
+    }
+}
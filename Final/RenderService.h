@@ -0,0 +1,172 @@
+//
+//  RenderService.h
+//
+//  Long-lived render service.  Listens on a Unix domain socket (or on
+//  a TCP port, when used as a worker for renderCoordinator) for
+//  RenderRequest records (see RenderProtocol.h), renders them with the
+//  already-loaded scene and shaders, and keeps recent results in an
+//  LRU cache keyed by a hash of the request parameters.
+//
+//  Requests that arrive together are handled as one batch: cache hits
+//  are answered first, duplicate requests are rendered once, and the
+//  remaining ones are grouped by resolution so each offscreen target
+//  is set up only once per batch.
+//
+
+#ifndef _RENDERSERVICE_H_
+#define _RENDERSERVICE_H_
+
+#include <stdint.h>
+
+#include <list>
+#include <vector>
+#include <unordered_map>
+
+#include "RenderProtocol.h"
+
+using namespace std;
+
+///
+// Callbacks supplied by the program that owns the GL context.
+//
+// BatchFunc is called before a run of requests that share a
+// resolution, and returns false if it could not make a target of that
+// size (the run is then answered RENDER_FAILED); RenderFunc renders one
+// request into 'pixels', which has room for width*height RGBA bytes.
+///
+typedef bool (*BatchFunc)( int width, int height );
+typedef void (*RenderFunc)( const RenderRequest &req, unsigned char *pixels );
+
+///
+// requestKey(req) - hash of every request field that affects the image
+///
+uint64_t requestKey( const RenderRequest &req );
+
+///
+// LRU cache of rendered images, bounded by total pixel bytes
+///
+
+class ResultCache {
+
+    struct Entry {
+        uint64_t key;
+        RenderRequest params;           // to rule out hash collisions
+        vector<unsigned char> pixels;
+    };
+
+    list<Entry> lru;                    // most recently used first
+    unordered_map< uint64_t, list<Entry>::iterator > index;
+    uint64_t bytes, capacity;
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param capacity - maximum number of pixel bytes to keep
+    ///
+    ResultCache( uint64_t capacity );
+
+    ///
+    // find(key,req) - look up a result, marking it most recently used
+    //
+    // @return the cached pixels, or NULL on a miss
+    ///
+    const vector<unsigned char> *find( uint64_t key, const RenderRequest &req );
+
+    ///
+    // insert(key,req,pixels) - add a result, evicting the least
+    //     recently used ones as needed; 'pixels' is taken over
+    //
+    // @return the stored pixels
+    ///
+    const vector<unsigned char> *insert( uint64_t key,
+        const RenderRequest &req, vector<unsigned char> &pixels );
+
+    ///
+    // size() - number of cached images
+    ///
+    size_t size( void ) const;
+
+};
+
+///
+// The service itself
+///
+
+class RenderService {
+
+    struct Client {
+        int fd;
+        vector<unsigned char> inbuf;    // partially received requests
+        bool dead;
+    };
+
+    struct Pending {
+        Client *client;
+        RenderRequest req;
+        uint64_t key;
+        uint64_t arrivalNs;
+    };
+
+    BatchFunc beginBatch;
+    RenderFunc render;
+    ResultCache cache;
+
+    int listenFd;
+    char path[108];                     // socket file; empty for TCP
+    vector<Client *> clients;
+    vector<Pending> pending;
+
+    // statistics since the last reset
+    vector<double> latencyMs;
+    uint64_t requests, rendered, cacheHits, batches;
+    uint64_t statsStartNs;
+
+    void acceptClient( void );
+    void receive( Client *C );
+    void processBatch( void );
+    void reply( Pending &P, int status, bool cached, float renderMs,
+                const void *data, uint64_t bytes );
+    void replyStats( Pending &P );
+    void dropDeadClients( void );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param begin      - called before each run of same-sized requests
+    // @param render     - renders one request
+    // @param cacheBytes - capacity of the result cache
+    ///
+    RenderService( BatchFunc begin, RenderFunc render, uint64_t cacheBytes );
+
+    ///
+    // Destructor - closes all sockets and removes the socket file
+    ///
+    ~RenderService( void );
+
+    ///
+    // listen(where) - create the listening socket
+    //
+    // @param where - a Unix domain socket path, or "tcp:PORT" to accept
+    //    connections from other machines on that port
+    //
+    // @return true on success
+    ///
+    bool listen( const char *where );
+
+    ///
+    // run(stop) - serve requests until *stop becomes true
+    ///
+    void run( volatile bool *stop );
+
+    ///
+    // stats(S,reset) - fill in the current statistics
+    ///
+    void stats( RenderStats &S, bool reset );
+
+};
+
+#endif
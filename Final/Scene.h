@@ -0,0 +1,273 @@
+//
+//  Scene.h
+//
+//  The still life as finalMain.cpp sets it up and draws it, for the
+//  runs of Benchmarks.h: the drawing options, what a frame shows, what
+//  init() built, and the functions that draw a frame.  finalMain.cpp
+//  defines all of it and keeps the scene's state to itself; a run gets
+//  and sets it through the structs below.
+//
+
+#ifndef _SCENE_H_
+#define _SCENE_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+
+#include "Lod.h"
+
+class Impostor;
+class InstanceSet;
+class MeshletSet;
+class NormalMap;
+class ShadowMap;
+class Picker;
+class Rasterizer;
+class RayTracer;
+class ThreadPool;
+
+///
+// The drawing options: the ways of drawing less, or more cheaply, that
+// a frame uses.  All of them are off unless turned on, so a benchmark
+// starts from a RenderSettings of its own and turns on only what it
+// measures.
+///
+#define SHADING_LOD_PIXELS 128.0f
+struct RenderSettings {
+    // levels of detail (key 'l')
+    bool lod;
+    // meshlet culling (key 'm')
+    bool meshlets;
+    // leaving out objects wholly outside the view (key 'f')
+    bool culling;
+    // leaving out objects hidden behind the occluders (key 'h')
+    bool hiz;
+    // small, distant objects drawn as impostors (key 'i')
+    bool impostors;
+    // the objects with normal maps drawn as their coarse copies (key 'n')
+    bool normalMaps;
+    // the untextured objects narrower on the screen than
+    // shadingLodPixels shaded per corner (Gouraud) instead of per
+    // pixel, and those whose specular term is too faint to show under
+    // the light drawn without it (key 'g')
+    bool shadingLod;
+    float shadingLodPixels;
+    // the shadows of the light (key 'o')
+    bool shadows;
+
+    RenderSettings() : lod(false), meshlets(false), culling(false),
+        hiz(false), impostors(false), normalMaps(false), shadingLod(false),
+        shadingLodPixels(SHADING_LOD_PIXELS), shadows(false) {}
+};
+
+///
+// What a frame shows: the camera, the objects' rotations (about x, y
+// and z from each object's OBJ_ number on; see Shapes.h), whether they
+// are turning ANIMATION_STEP degrees a frame, as the 'a' key sets them
+// (the Hi-Z culler then works a frame ahead), and the light's color.  A
+// run that changes them sets them back as it found them.
+///
+#define ANIMATION_STEP 0.5f
+struct SceneView {
+    float eye[3], lookAt[3], up[3];
+    float angles[24];
+    bool animating;
+    float lightColor[3];
+};
+
+///
+// An object of the still life: its OBJ_ number (see Shapes.h), its name
+// for reports, its buffers and its material setup.
+///
+struct SceneObject {
+    int obj;
+    const char *name;
+    BufferSet *buffers;
+    void (*material)( GLuint );
+};
+
+///
+// What init() set up that the runs draw with: the window's size, which
+// the runs draw offscreen at, the CPU renderers and their threads once
+// initCPU() has started them (NULL before), and the mouse's picker
+// (see updatePicker()); the objects in drawing order, with the scale
+// and translation they all share (see modelMatrix()); the -threads
+// count (0 for one per hardware thread); the objects' levels of
+// detail and meshlets (for each level), their copies (see
+// Instances.h), their impostors (see bakeImpostors()) and their normal
+// maps with the level each is onto (see bakeNormalMaps()), in the same
+// order; the window's programs for the untextured and the textured
+// objects and for those with normal maps; the canvas the objects'
+// buffers are made with; and the light's shadow map.
+///
+struct SceneParts {
+    int width, height;
+    ThreadPool *cpuPool;
+    Rasterizer *rasterizer;
+    RayTracer *rayTracer;
+    Picker *picker;
+    const SceneObject *objects;
+    int objectCount;
+    const float *scale, *translate;
+    int cpuThreads;
+    LodChain *lods;
+    MeshletSet (*meshlets)[LOD_LEVELS];
+    GLuint phong, texture;
+    InstanceSet *instances;
+    Canvas *canvas;
+    Impostor *impostors;
+    NormalMap *normalMaps;
+    const int *normalMapLevels;
+    GLuint normalMap;
+    ShadowMap *shadowMap;
+};
+
+///
+// What the last drawScene() drew: the triangles sent; the objects drawn,
+// those left out as outside the view and those the Hi-Z culler found
+// hidden, and what finding them cost (ms and the occluders' triangles);
+// and the frames so far whose Hi-Z results were ready (culled a frame
+// ahead) or not; the objects drawn as impostors; and those shaded per
+// corner (see RenderSettings::shadingLod), which of them they were, and
+// how many pixels across each untextured object was, in drawing order.
+///
+struct SceneStats {
+    long drawnTriangles;
+    int visibleObjects, culledObjects, occludedObjects;
+    double hizCullMs;
+    long hizTriangles;
+    long hizReady, hizLate;
+    int impostorObjects;
+    int gouraudObjects;
+    const bool *shadedPerCorner;
+    const float *objectPixels;
+};
+
+///
+// sceneView() - the view the next frame shows
+///
+SceneView sceneView( void );
+
+///
+// setSceneView(V) - show another view from the next frame on
+///
+void setSceneView( const SceneView &V );
+
+///
+// sceneParts() - what init(), and initCPU() if called, set up so far
+///
+const SceneParts &sceneParts( void );
+
+///
+// sceneStats() - what the last drawScene() drew, as of this call
+///
+const SceneStats &sceneStats( void );
+
+///
+// initCPU() - start the CPU renderers (see SceneParts), if not yet
+// started
+//
+// @return true on success
+///
+bool initCPU( void );
+
+///
+// displayCPU() - draw the scene with the CPU rasterizer into its
+// current frame (see Rasterizer::resize())
+///
+void displayCPU( void );
+
+///
+// displayRayTraced(T) - trace the scene with a ray tracer into its
+// current frame (see RayTracer::resize())
+///
+void displayRayTraced( RayTracer &T );
+
+///
+// queueScene(T) - give a ray tracer the camera, light and objects
+///
+void queueScene( RayTracer &T );
+
+///
+// updatePicker() - bring the picker up to date with the objects and
+// camera as they are drawn now
+///
+void updatePicker( void );
+
+///
+// setUpLightAndFrustum(program) - send the light and projection
+// parameters to a program and make it current
+///
+void setUpLightAndFrustum( GLuint program );
+
+///
+// setUpScene(program,R) - send the light, projection, camera and
+// shadows (if R.shadows) to a program and make it current
+///
+void setUpScene( GLuint program, const RenderSettings &R );
+
+///
+// updateShadows() - draw the shadow map again if the light or any
+// object has moved since it was last drawn
+//
+// @return true if it was drawn
+///
+bool updateShadows( void );
+
+///
+// drawScene(phong,texture,levels,R) - draw every object with the given
+// programs, at the given levels of detail (NULL for the full meshes,
+// which leaves out every option of R)
+///
+void drawScene( GLuint phong, GLuint texture, const int *levels,
+                const RenderSettings &R = RenderSettings() );
+
+///
+// cycleLightColor() - step the disco lights' color, as the animation
+// does each frame
+///
+void cycleLightColor( void );
+
+///
+// turnObjects(angleSet) - turn every object but the room in a set of
+// rotations (see SceneView) by one step of the animation
+///
+void turnObjects( float *angleSet );
+
+///
+// bakeImpostors() - draw the views of the objects that get impostors
+// (see Impostor.h), if not yet drawn
+///
+void bakeImpostors( void );
+
+///
+// bakeNormalMaps() - bake the normal maps of the objects that get them
+// (see NormalMap.h), if not yet baked
+///
+void bakeNormalMaps( void );
+
+///
+// drawObject(program,material,B,obj,M,I,P,N,noSpecular) - send an
+// object's material and transformations and draw it: as the meshlets
+// M, the copies I, the impostor P or with the normal map N, where not
+// NULL, and without the specular term if noSpecular.  setUpScene()
+// must have been called for the program this frame.
+///
+void drawObject( GLuint program, void (*material)( GLuint ),
+                 BufferSet &B, int obj, const MeshletSet *M = NULL,
+                 InstanceSet *I = NULL, const Impostor *P = NULL,
+                 const NormalMap *N = NULL, bool noSpecular = false );
+
+///
+// display(R) - draw a frame as the window does, with the options R
+///
+void display( const RenderSettings &R );
+
+#endif
@@ -203,6 +203,14 @@ const char *errorString( ShaderError code ) {
             msg = "Error linking shader";
             break;
 
+        case E_GS_LOAD:
+            msg = "Error loading geometry shader";
+            break;
+
+        case E_GS_COMPILE:
+            msg = "Error compiling geometry shader";
+            break;
+
         default:
             sprintf( buffer, "Unknown error code %d", code );
             msg = (const char *) buffer;
@@ -234,17 +242,85 @@ const char *errorString( ShaderError code ) {
 //      Returns 0, and assigns an error code to 'err'.
 ///
 GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err ) {
-    GLchar *vsrc = NULL, *fsrc = NULL;
-    GLuint vs, fs, prog;
+
+    return( shaderSetupGeometry( vert, NULL, frag, err ) );
+
+}
+
+///
+// shaderSetupGeometry(vertex,geometry,fragment,err)
+//
+// Set up a GLSL shader program with an optional geometry shader.
+//
+// Arguments:
+//      vert - vertex shader program source file
+//      geom - geometry shader program source file, or NULL for none
+//      frag - fragment shader program source file
+//      err  - pointer to status variable
+//
+// Returns as for shaderSetup().
+///
+GLuint shaderSetupGeometry( const char *vert, const char *geom,
+                            const char *frag, ShaderError *err ) {
+
+    return( shaderSetupShared( vert, geom, frag, NULL, err ) );
+
+}
+
+///
+// shaderSetupShared(vertex,geometry,fragment,shared,err)
+//
+// Set up a GLSL shader program whose fragment stage is linked from two
+// source files: the fragment shader proper, and a shared one with
+// functions (and the uniforms they use) that several fragment shaders
+// call, so they need only declare them.
+//
+// Arguments:
+//      vert   - vertex shader program source file
+//      geom   - geometry shader program source file, or NULL for none
+//      frag   - fragment shader program source file
+//      shared - shared fragment shader source file, or NULL for none
+//      err    - pointer to status variable
+//
+// Returns as for shaderSetup().
+///
+GLuint shaderSetupShared( const char *vert, const char *geom,
+                          const char *frag, const char *shared,
+                          ShaderError *err ) {
+
+    return( shaderSetupSharedVertex( vert, NULL, geom, frag, shared,
+                                     err ) );
+
+}
+
+///
+// shaderSetupSharedVertex(vertex,vshared,geometry,fragment,shared,err)
+//
+// As shaderSetupShared(), with the vertex stage also linked from two
+// source files: the vertex shader proper, and a shared one with
+// functions several vertex shaders call.
+//
+// Arguments:
+//      vert    - vertex shader program source file
+//      vshared - shared vertex shader source file, or NULL for none
+//      geom    - geometry shader program source file, or NULL for none
+//      frag    - fragment shader program source file
+//      shared  - shared fragment shader source file, or NULL for none
+//      err     - pointer to status variable
+//
+// Returns as for shaderSetup().
+///
+GLuint shaderSetupSharedVertex( const char *vert, const char *vshared,
+                                const char *geom, const char *frag,
+                                const char *shared, ShaderError *err ) {
+    GLchar *vsrc = NULL, *vssrc = NULL, *gsrc = NULL, *fsrc = NULL;
+    GLchar *ssrc = NULL;
+    GLuint vs, vss = 0, gs = 0, fs, ss = 0, prog;
     GLint flag;
 
     // Assume that everything will work
     *err = E_NO_ERROR;
 
-    // Create the shader handles
-    vs = glCreateShader( GL_VERTEX_SHADER );
-    fs = glCreateShader( GL_FRAGMENT_SHADER );
-
     // Read in shader source
     vsrc = readTextFile( vert );
     if( vsrc == NULL ) {
@@ -254,6 +330,38 @@ GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err ) {
         return( 0 );
     }
 
+    if( vshared != NULL ) {
+        vssrc = readTextFile( vshared );
+        if( vssrc == NULL ) {
+            fprintf( stderr, "Error reading vertex shader file %s\n",
+                 vshared);
+            *err = E_VS_LOAD;
+#ifdef __cplusplus
+            delete [] vsrc;
+#else
+            free( vsrc );
+#endif
+            return( 0 );
+        }
+    }
+
+    if( geom != NULL ) {
+        gsrc = readTextFile( geom );
+        if( gsrc == NULL ) {
+            fprintf( stderr, "Error reading geometry shader file %s\n",
+                 geom);
+            *err = E_GS_LOAD;
+#ifdef __cplusplus
+            delete [] vsrc;
+            delete [] vssrc;
+#else
+            free( vsrc );
+            free( vssrc );
+#endif
+            return( 0 );
+        }
+    }
+
     fsrc = readTextFile( frag );
     if( fsrc == NULL ) {
         fprintf( stderr, "Error reading fragment shader file %s\n",
@@ -261,23 +369,68 @@ GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err ) {
         *err = E_FS_LOAD;
 #ifdef __cplusplus
         delete [] vsrc;
+        delete [] vssrc;
+        delete [] gsrc;
 #else
         free( vsrc );
+        free( vssrc );
+        free( gsrc );
 #endif
         return( 0 );
     }
 
-    // Attach the source to the shaders
+    if( shared != NULL ) {
+        ssrc = readTextFile( shared );
+        if( ssrc == NULL ) {
+            fprintf( stderr, "Error reading fragment shader file %s\n",
+                 shared);
+            *err = E_FS_LOAD;
+#ifdef __cplusplus
+            delete [] vsrc;
+            delete [] vssrc;
+            delete [] gsrc;
+            delete [] fsrc;
+#else
+            free( vsrc );
+            free( vssrc );
+            free( gsrc );
+            free( fsrc );
+#endif
+            return( 0 );
+        }
+    }
+
+    // Create the shader handles and attach the source to them
+    vs = glCreateShader( GL_VERTEX_SHADER );
+    fs = glCreateShader( GL_FRAGMENT_SHADER );
     glShaderSource( vs, 1, (const GLchar **) &vsrc, NULL );
     glShaderSource( fs, 1, (const GLchar **) &fsrc, NULL );
+    if( vssrc != NULL ) {
+        vss = glCreateShader( GL_VERTEX_SHADER );
+        glShaderSource( vss, 1, (const GLchar **) &vssrc, NULL );
+    }
+    if( gsrc != NULL ) {
+        gs = glCreateShader( GL_GEOMETRY_SHADER );
+        glShaderSource( gs, 1, (const GLchar **) &gsrc, NULL );
+    }
+    if( ssrc != NULL ) {
+        ss = glCreateShader( GL_FRAGMENT_SHADER );
+        glShaderSource( ss, 1, (const GLchar **) &ssrc, NULL );
+    }
 
     // We're done with the source code now
 #ifdef __cplusplus
     delete [] vsrc;
+    delete [] vssrc;
+    delete [] gsrc;
     delete [] fsrc;
+    delete [] ssrc;
 #else
     free(vsrc);
+    free(vssrc);
+    free(gsrc);
     free(fsrc);
+    free(ssrc);
 #endif
 
     // Compile the shaders, and print any relevant message logs
@@ -289,6 +442,26 @@ GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err ) {
         return( 0 );
     }
 
+    if( vss ) {
+        glCompileShader( vss );
+        glGetShaderiv( vss, GL_COMPILE_STATUS, &flag );
+        printShaderInfoLog( vss );
+        if( flag == GL_FALSE ) {
+            *err = E_VS_COMPILE;
+            return( 0 );
+        }
+    }
+
+    if( gs ) {
+        glCompileShader( gs );
+        glGetShaderiv( gs, GL_COMPILE_STATUS, &flag );
+        printShaderInfoLog( gs );
+        if( flag == GL_FALSE ) {
+            *err = E_GS_COMPILE;
+            return( 0 );
+        }
+    }
+
     glCompileShader( fs );
     glGetShaderiv( fs, GL_COMPILE_STATUS, &flag );
     printShaderInfoLog( fs );
@@ -297,10 +470,29 @@ GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err ) {
         return( 0 );
     }
 
+    if( ss ) {
+        glCompileShader( ss );
+        glGetShaderiv( ss, GL_COMPILE_STATUS, &flag );
+        printShaderInfoLog( ss );
+        if( flag == GL_FALSE ) {
+            *err = E_FS_COMPILE;
+            return( 0 );
+        }
+    }
+
     // Create the program and attach the shaders
     prog = glCreateProgram();
     glAttachShader( prog, vs );
+    if( vss ) {
+        glAttachShader( prog, vss );
+    }
+    if( gs ) {
+        glAttachShader( prog, gs );
+    }
     glAttachShader( prog, fs );
+    if( ss ) {
+        glAttachShader( prog, ss );
+    }
 
     // Report any message log information
     printProgramInfoLog( prog );
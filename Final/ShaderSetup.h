@@ -23,7 +23,7 @@
 
 typedef enum sError {
     E_NO_ERROR, E_VS_LOAD, E_FS_LOAD, E_VS_COMPILE,
-    E_FS_COMPILE, E_SHADER_LINK
+    E_FS_COMPILE, E_SHADER_LINK, E_GS_LOAD, E_GS_COMPILE
 } ShaderError;
 
 ///
@@ -83,4 +83,56 @@ const char *errorString( ShaderError code );
 ///
 GLuint shaderSetup( const char *vert, const char *frag, ShaderError *err );
 
+///
+// shaderSetupGeometry(vertex,geometry,fragment,err)
+//
+// As shaderSetup(), with a geometry shader between the vertex and
+// fragment stages.
+//
+// Arguments:
+//      vert - vertex shader program source file
+//      geom - geometry shader program source file, or NULL for none
+//      frag - fragment shader program source file
+//      err  - pointer to status variable
+///
+GLuint shaderSetupGeometry( const char *vert, const char *geom,
+                            const char *frag, ShaderError *err );
+
+///
+// shaderSetupShared(vertex,geometry,fragment,shared,err)
+//
+// As shaderSetupGeometry(), with a second fragment shader linked in:
+// functions several fragment shaders share, which each of them only
+// declares.
+//
+// Arguments:
+//      vert   - vertex shader program source file
+//      geom   - geometry shader program source file, or NULL for none
+//      frag   - fragment shader program source file
+//      shared - shared fragment shader source file, or NULL for none
+//      err    - pointer to status variable
+///
+GLuint shaderSetupShared( const char *vert, const char *geom,
+                          const char *frag, const char *shared,
+                          ShaderError *err );
+
+///
+// shaderSetupSharedVertex(vertex,vshared,geometry,fragment,shared,err)
+//
+// As shaderSetupShared(), with a second vertex shader linked in as
+// well: functions several vertex shaders share, which each of them
+// only declares.
+//
+// Arguments:
+//      vert    - vertex shader program source file
+//      vshared - shared vertex shader source file, or NULL for none
+//      geom    - geometry shader program source file, or NULL for none
+//      frag    - fragment shader program source file
+//      shared  - shared fragment shader source file, or NULL for none
+//      err     - pointer to status variable
+///
+GLuint shaderSetupSharedVertex( const char *vert, const char *vshared,
+                                const char *geom, const char *frag,
+                                const char *shared, ShaderError *err );
+
 #endif
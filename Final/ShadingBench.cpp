@@ -0,0 +1,107 @@
+//
+//  ShadingBench.cpp
+//
+//  The shading level of detail benchmark (-shadingbench; see
+//  Benchmarks.h): frames with and without the per-corner shading of
+//  small objects, smaller and smaller.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Lighting.h"
+#include "Scene.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// shadingBenchmark() - time B.count frames with and without the
+// per-corner shading of small objects, smaller and smaller, and
+// compare their images
+///
+void shadingBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+
+    // at the command line's threshold
+    RenderSettings S;
+    S.shadingLodPixels = B.draw.shadingLodPixels;
+    vector<unsigned char> images[2];
+
+    printf( "shading per corner under %.0f pixels; no specular term:",
+        S.shadingLodPixels );
+    int faint = 0;
+    for( int i = 0; i < P.objectCount; i++ ) {
+        if( negligibleSpecular( getMaterial( P.objects[i].obj ),
+                                sceneView().lightColor ) ) {
+            printf( " %s", P.objects[i].name );
+            faint++;
+        }
+    }
+    printf( "%s\n", faint > 0 ? "" : " none" );
+
+    Framebuffer offscreen;
+    printf( "frame    per corner  ms/frame     off %%  max diff"
+        "  shaded per corner\n" );
+    for( int shrink = 1; shrink <= 8; shrink *= 2 ) {
+        int w = P.width / shrink, h = P.height / shrink;
+        if( !offscreen.resize( w, h ) ) {
+            break;
+        }
+        offscreen.bind();
+        size_t frameBytes = (size_t) w * h * 4;
+        for( int on = 0; on < 2; on++ ) {
+            S.shadingLod = on;
+            for( int i = 0; i < P.objectCount; i++ ) {
+                P.lods[i].current = 0;
+            }
+            display( S );   // warm-up
+            images[on].resize( frameBytes );
+            offscreen.readPixels( images[on].data() );
+            glFinish();
+            uint64_t start = monotonicNs();
+            for( int f = 0; f < frames; f++ ) {
+                display( S );
+            }
+            glFinish();
+            double ms = elapsedMs( start ) / frames;
+            const SceneStats &D = sceneStats();
+            printf( "%3dx%-3d  %3s %6d  %8.3f", w, h, on ? "on" : "off",
+                D.gouraudObjects, ms );
+            if( !on ) {
+                printf( "\n" );
+                continue;
+            }
+
+            // per pixel against per corner, counting only pixels more
+            // than 16 levels off
+            long differ = 0;
+            int maxDiff = 0;
+            for( size_t q = 0; q < frameBytes; q += 4 ) {
+                int diff = 0;
+                for( int c = 0; c < 3; c++ ) {
+                    diff = max( diff,
+                                abs( images[0][q+c] - images[1][q+c] ) );
+                }
+                differ += diff > 16;
+                maxDiff = max( maxDiff, diff );
+            }
+            printf( "  %8.2f  %8d ", 100.0 * differ / (w * h), maxDiff );
+            for( int i = 0; i < P.objectCount; i++ ) {
+                if( D.shadedPerCorner[i] ) {
+                    printf( " %s (%.0f px)", P.objects[i].name,
+                        D.objectPixels[i] );
+                }
+            }
+            printf( "\n" );
+        }
+        offscreen.unbind( P.width, P.height );
+    }
+    offscreen.release();
+}
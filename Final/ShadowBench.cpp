@@ -0,0 +1,79 @@
+//
+//  ShadowBench.cpp
+//
+//  The shadow benchmark (-shadowbench; see Benchmarks.h): frames without
+//  shadows, with the cached shadow map, and with it drawn again.
+//
+
+#include <cstdio>
+
+#include "Benchmarks.h"
+#include "Framebuffer.h"
+#include "Scene.h"
+#include "ShadowMap.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// shadowBenchmark() - time B.count frames without shadows, with the
+// cached shadow map while nothing moves and while only the light's
+// color changes, and with it drawn again every frame, when the objects
+// turn or whatever moved
+///
+void shadowBenchmark( const BenchSettings &B )
+{
+    int frames = B.count;
+    const SceneParts &P = sceneParts();
+    ShadowMap &shadowMap = *P.shadowMap;
+    static const char *kinds[] = {
+        "no shadows", "still", "disco colors", "turning", "redrawn always"
+    };
+    Framebuffer offscreen;
+    if( !offscreen.resize( P.width, P.height ) ) {
+        return;
+    }
+    RenderSettings S;
+    SceneView saved = sceneView(), V;
+    offscreen.bind();
+
+    double offMs = 0.0;
+    printf( "frames          ms/frame  overhead  map draws\n" );
+    for( int kind = 0; kind < 5; kind++ ) {
+        S.shadows = kind > 0;
+        V = saved;
+        setSceneView( V );
+        display( S );   // warm-up
+        long draws = shadowMap.renders;
+        glFinish();
+        uint64_t start = monotonicNs();
+        for( int f = 0; f < frames; f++ ) {
+            if( kind == 2 ) {
+                cycleLightColor();
+            } else if( kind == 3 ) {
+                turnObjects( V.angles );
+                setSceneView( V );
+            } else if( kind == 4 ) {
+                shadowMap.invalidate();
+            }
+            display( S );
+        }
+        glFinish();
+        double ms = elapsedMs( start ) / frames;
+        draws = shadowMap.renders - draws;
+        if( kind == 0 ) {
+            offMs = ms;
+            printf( "%-14s  %8.3f\n", kinds[kind], ms );
+        } else {
+            printf( "%-14s  %8.3f  %7.1f%%  %9ld\n", kinds[kind], ms,
+                100.0 * (ms - offMs) / offMs, draws );
+        }
+    }
+    printf( "shadow map: 6 x %dx%d, %.1f MB, last drawn in %.1f ms\n",
+        SHADOW_SIZE, SHADOW_SIZE, shadowMap.gpuBytes() / 1048576.0,
+        shadowMap.renderMs );
+
+    offscreen.unbind( P.width, P.height );
+    offscreen.release();
+    setSceneView( saved );
+}
@@ -0,0 +1,283 @@
+//
+//  ShadowMap.cpp
+//
+//  Cube shadow map implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include "ShadowMap.h"
+#include "Timing.h"
+#include "Viewing.h"
+
+using namespace std;
+
+// distance stored where no surface was drawn: farther than anything
+#define SHADOW_EMPTY        1.0e30f
+
+// every face's direction from the light and its up vector, in the
+// order of GL_TEXTURE_CUBE_MAP_POSITIVE_X onward; the cube map's own
+// orientation, so that a face drawn with them is sampled the right
+// way round
+static const float faceDirs[6][3] = {
+    {  1.0f,  0.0f,  0.0f }, { -1.0f,  0.0f,  0.0f },
+    {  0.0f,  1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+    {  0.0f,  0.0f,  1.0f }, {  0.0f,  0.0f, -1.0f }
+};
+static const float faceUps[6][3] = {
+    {  0.0f, -1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f },
+    {  0.0f,  0.0f,  1.0f }, {  0.0f,  0.0f, -1.0f },
+    {  0.0f, -1.0f,  0.0f }, {  0.0f, -1.0f,  0.0f }
+};
+
+///
+// faceProjection(m,far) - projection of a 90 degree frustum from
+//     SHADOW_NEAR to 'far' (column-major)
+///
+static void faceProjection( float *m, float far )
+{
+    float near = SHADOW_NEAR;
+    memset( m, 0, 16 * sizeof(float) );
+    m[0] = 1.0f;
+    m[5] = 1.0f;
+    m[10] = -(far + near) / (far - near);
+    m[11] = -1.0f;
+    m[14] = -2.0f * far * near / (far - near);
+}
+
+///
+// Constructor
+///
+ShadowMap::ShadowMap( void ) :
+    texture(0), framebuffer(0), depth(0), range(0.0f), renders(0),
+    renderMs(0.0)
+{
+    light[0] = light[1] = light[2] = 0.0f;
+}
+
+///
+// bindUnits(program) - point a program at the shadow map's unit
+///
+void ShadowMap::bindUnits( GLuint program )
+{
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "shadowMap" ),
+                 SHADOW_UNIT );
+}
+
+///
+// update(program,light,casters,count) - draw the map again if the
+//     light or any caster has moved
+///
+bool ShadowMap::update( GLuint program, const float *lightPos,
+                        const ShadowCaster *casters, int count )
+{
+    bool moved = framebuffer == 0 || (int) models.size() != 16 * count ||
+                 memcmp( light, lightPos, sizeof(light) ) != 0;
+    for( int i = 0; i < count && !moved; i++ ) {
+        moved = memcmp( &models[16 * i], casters[i].model,
+                        sizeof(casters[i].model) ) != 0;
+    }
+    if( !moved ) {
+        return false;
+    }
+
+    uint64_t start = monotonicNs();
+    if( framebuffer == 0 ) {
+        glGenTextures( 1, &texture );
+        glBindTexture( GL_TEXTURE_CUBE_MAP, texture );
+        for( int f = 0; f < 6; f++ ) {
+            glTexImage2D( GL_TEXTURE_CUBE_MAP_POSITIVE_X + f, 0, GL_R32F,
+                          SHADOW_SIZE, SHADOW_SIZE, 0, GL_RED, GL_FLOAT,
+                          NULL );
+        }
+        // the nearest texel: distances blended across an edge would
+        // put a surface where there is none
+        glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER,
+                         GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER,
+                         GL_NEAREST );
+        glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S,
+                         GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T,
+                         GL_CLAMP_TO_EDGE );
+        glTexParameteri( GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R,
+                         GL_CLAMP_TO_EDGE );
+        glBindTexture( GL_TEXTURE_CUBE_MAP, 0 );
+
+        glGenRenderbuffers( 1, &depth );
+        glBindRenderbuffer( GL_RENDERBUFFER, depth );
+        glRenderbufferStorage( GL_RENDERBUFFER, GL_DEPTH_COMPONENT24,
+                               SHADOW_SIZE, SHADOW_SIZE );
+        glGenFramebuffers( 1, &framebuffer );
+    }
+    memcpy( light, lightPos, sizeof(light) );
+    models.resize( 16 * count );
+    for( int i = 0; i < count; i++ ) {
+        memcpy( &models[16 * i], casters[i].model, sizeof(casters[i].model) );
+    }
+
+    // far enough for every caster's bounding sphere
+    range = 2.0f * SHADOW_NEAR;
+    for( int i = 0; i < count; i++ ) {
+        const BufferSet &B = *casters[i].buffers;
+        const float *model = casters[i].model;
+        if( B.radius < 0.0f ) {
+            continue;
+        }
+        float c[3], scale = 0.0f;
+        for( int k = 0; k < 3; k++ ) {
+            c[k] = model[k] * B.center[0] + model[4 + k] * B.center[1] +
+                   model[8 + k] * B.center[2] + model[12 + k] - light[k];
+            const float *axis = &model[4 * k];
+            scale = max( scale, sqrtf( axis[0] * axis[0] +
+                                       axis[1] * axis[1] +
+                                       axis[2] * axis[2] ) );
+        }
+        range = max( range, sqrtf( c[0] * c[0] + c[1] * c[1] +
+                                   c[2] * c[2] ) + B.radius * scale );
+    }
+
+    GLint viewport[4], previous;
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    glGetIntegerv( GL_FRAMEBUFFER_BINDING, &previous );
+    glBindFramebuffer( GL_FRAMEBUFFER, framebuffer );
+    glFramebufferRenderbuffer( GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                               GL_RENDERBUFFER, depth );
+    glViewport( 0, 0, SHADOW_SIZE, SHADOW_SIZE );
+
+    glUseProgram( program );
+    glUniform3fv( glGetUniformLocation( program, "shadowLight" ), 1, light );
+    GLint vPosition = glGetAttribLocation( program, "vPosition" );
+
+    // only the positions are read; arrays other programs left enabled
+    // may point past the end of these buffers
+    GLint attributes;
+    glGetIntegerv( GL_MAX_VERTEX_ATTRIBS, &attributes );
+    for( GLint a = 0; a < attributes; a++ ) {
+        glDisableVertexAttribArray( a );
+    }
+    glEnableVertexAttribArray( vPosition );
+    GLint modelLoc = glGetUniformLocation( program, "model" );
+    GLint faceLoc = glGetUniformLocation( program, "faceViewProjection" );
+
+    float projection[16];
+    faceProjection( projection, range );
+    GLenum status = GL_FRAMEBUFFER_COMPLETE;
+    for( int f = 0; f < 6 && status == GL_FRAMEBUFFER_COMPLETE; f++ ) {
+        glFramebufferTexture2D( GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                                GL_TEXTURE_CUBE_MAP_POSITIVE_X + f,
+                                texture, 0 );
+        status = glCheckFramebufferStatus( GL_FRAMEBUFFER );
+        if( status != GL_FRAMEBUFFER_COMPLETE ) {
+            break;
+        }
+        static const GLfloat empty[4] = { SHADOW_EMPTY, 0.0f, 0.0f, 0.0f };
+        static const GLfloat farDepth = 1.0f;
+        glClearBufferfv( GL_COLOR, 0, empty );
+        glClearBufferfv( GL_DEPTH, 0, &farDepth );
+
+        float lookAt[3], view[16], viewProjection[16];
+        for( int k = 0; k < 3; k++ ) {
+            lookAt[k] = light[k] + faceDirs[f][k];
+        }
+        viewMatrix( view, light, lookAt, faceUps[f] );
+        multiplyMatrices( viewProjection, projection, view );
+        glUniformMatrix4fv( faceLoc, 1, GL_FALSE, viewProjection );
+
+        for( int i = 0; i < count; i++ ) {
+            const InstanceSet *I = casters[i].copies;
+            const BufferSet &B = I != NULL ? I->prototype : *casters[i].buffers;
+            glUniformMatrix4fv( modelLoc, 1, GL_FALSE, casters[i].model );
+            glBindBuffer( GL_ARRAY_BUFFER, B.vbuffer );
+            glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, B.ebuffer );
+            glVertexAttribPointer( vPosition, 4, GL_FLOAT, GL_FALSE, 0,
+                                   (void *) 0 );
+            if( I != NULL ) {
+                I->draw( program );
+            } else {
+                glDrawElements( GL_TRIANGLES, B.numElements,
+                                GL_UNSIGNED_INT, (void *) 0 );
+            }
+        }
+    }
+
+    glBindFramebuffer( GL_FRAMEBUFFER, previous );
+    glViewport( viewport[0], viewport[1], viewport[2], viewport[3] );
+    if( status != GL_FRAMEBUFFER_COMPLETE ) {
+        cerr << "*** ShadowMap: face incomplete, status 0x" << hex <<
+            status << dec << endl;
+        release();
+        return false;
+    }
+    renders++;
+    renderMs = elapsedMs( start );
+    return true;
+}
+
+///
+// invalidate() - have the next update() draw the map
+///
+void ShadowMap::invalidate( void )
+{
+    models.clear();
+}
+
+///
+// setUp(program,view) - send the shadow map to a program, or turn its
+//     shadows off
+///
+void ShadowMap::setUp( GLuint program, const float *view ) const
+{
+    bool on = view != NULL && texture != 0;
+    glUniform1i( glGetUniformLocation( program, "shadows" ), on );
+    if( !on ) {
+        return;
+    }
+
+    // the transpose of the view's rotation, column-major
+    float eyeToWorld[9];
+    for( int i = 0; i < 3; i++ ) {
+        for( int j = 0; j < 3; j++ ) {
+            eyeToWorld[3 * j + i] = view[4 * i + j];
+        }
+    }
+    glUniformMatrix3fv( glGetUniformLocation( program, "eyeToWorld" ), 1,
+                        GL_FALSE, eyeToWorld );
+    glActiveTexture( GL_TEXTURE0 + SHADOW_UNIT );
+    glBindTexture( GL_TEXTURE_CUBE_MAP, texture );
+    glActiveTexture( GL_TEXTURE0 );
+}
+
+///
+// gpuBytes() - bytes of texture and depth buffer the map takes
+///
+long ShadowMap::gpuBytes( void ) const
+{
+    if( texture == 0 ) {
+        return 0;
+    }
+    return 6L * SHADOW_SIZE * SHADOW_SIZE * 4 +
+           (long) SHADOW_SIZE * SHADOW_SIZE * 4;
+}
+
+///
+// release() - delete the map
+///
+void ShadowMap::release( void )
+{
+    if( texture != 0 ) {
+        glDeleteTextures( 1, &texture );
+    }
+    if( depth != 0 ) {
+        glDeleteRenderbuffers( 1, &depth );
+    }
+    if( framebuffer != 0 ) {
+        glDeleteFramebuffers( 1, &framebuffer );
+    }
+    texture = framebuffer = depth = 0;
+    models.clear();
+}
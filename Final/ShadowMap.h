@@ -0,0 +1,144 @@
+//
+//  ShadowMap.h
+//
+//  A cube shadow map for the point light: for every direction from the
+//  light, the distance to the nearest surface, drawn into the six faces
+//  of a cube map of SHADOW_SIZE x SHADOW_SIZE floats, one 90 degree
+//  frustum per face.  A shader sampling it along the direction from the
+//  light to a point finds that point in shadow when it is farther away
+//  than that surface.
+//
+//  The map depends only on where the light is and where every object
+//  is, not on the light's color; so update() remembers the light
+//  position and the casters' model matrices it was last drawn with and
+//  draws it again only when one of them has changed.  The disco lights
+//  of the animation, which only change colors, never redraw it; turning
+//  the objects does.
+//
+//  Receivers (phong.frag, texture.frag, gouraud.frag, normalMap.frag,
+//  impostor.frag and the G-buffer's) are linked with SHADOW_LOOKUP,
+//  which looks the map up for them.  They have the eye-space point and light, so setUp()
+//  also sends the rotation that takes eye space back to the world's,
+//  in which the cube's faces lie.  Points are compared with a bias that
+//  grows with their distance and as the light grazes their surface,
+//  since one texel covers more of the surface there.
+//
+
+#ifndef _SHADOWMAP_H_
+#define _SHADOWMAP_H_
+
+#if defined(_WIN32) || defined(_WIN64)
+#include <windows.h>
+#endif
+
+#ifndef __APPLE__
+#include <GL/glew.h>
+#endif
+
+#include <GLFW/glfw3.h>
+#include <vector>
+
+#include "Buffers.h"
+#include "Instances.h"
+
+using namespace std;
+
+// texels per side of each face of the cube
+#define SHADOW_SIZE         1024
+
+// nearest distance from the light that is drawn
+#define SHADOW_NEAR         0.05f
+
+// texture unit of the shadow map
+#define SHADOW_UNIT         6
+
+// fragment shader with lightReaching(), linked into every receiver
+// (see shaderSetupShared())
+#define SHADOW_LOOKUP       "shadowLookup.frag"
+
+///
+// An object that casts shadows: its buffers (for its bounds, if it is
+// drawn as copies), its copies or NULL, and its model matrix
+// (column-major)
+///
+struct ShadowCaster {
+    const BufferSet *buffers;
+    const InstanceSet *copies;
+    float model[16];
+};
+
+class ShadowMap {
+
+public:
+    // the cube map of distances, and the framebuffer and depth buffer
+    // it is drawn with; 0 until created
+    GLuint texture, framebuffer, depth;
+
+    // the light position and the casters' model matrices the map was
+    // last drawn for, and the farthest any caster reaches from the light
+    float light[3];
+    vector<float> models;
+    float range;
+
+    // times the map has been drawn, and how long the last time took
+    long renders;
+    double renderMs;
+
+public:
+
+    ///
+    // Constructor
+    ///
+    ShadowMap( void );
+
+    ///
+    // bindUnits(program) - point a program that receives shadows at the
+    //     shadow map's unit
+    ///
+    static void bindUnits( GLuint program );
+
+    ///
+    // update(program,light,casters,count) - draw the map again if the
+    //     light or any caster has moved since it was last drawn.  The
+    //     viewport and framebuffer are put back as they were.
+    //
+    // @param program - a program linked with shadow.vert and shadow.frag,
+    //                  its copy samplers bound (see
+    //                  InstanceSet::bindUnits())
+    // @param light   - the light's position
+    // @param casters - the objects
+    // @param count   - how many there are
+    //
+    // @return true if the map was drawn
+    ///
+    bool update( GLuint program, const float *light,
+                 const ShadowCaster *casters, int count );
+
+    ///
+    // invalidate() - have the next update() draw the map whatever moved
+    ///
+    void invalidate( void );
+
+    ///
+    // setUp(program,view) - send the shadow map to a program that
+    //     receives shadows, or turn its shadows off
+    //
+    // @param program - the program, in use
+    // @param view    - the camera's viewing matrix (column-major), or
+    //                  NULL to draw without shadows
+    ///
+    void setUp( GLuint program, const float *view ) const;
+
+    ///
+    // gpuBytes() - bytes of texture and depth buffer the map takes
+    ///
+    long gpuBytes( void ) const;
+
+    ///
+    // release() - delete the map
+    ///
+    void release( void );
+
+};
+
+#endif
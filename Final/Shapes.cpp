@@ -23,10 +23,15 @@
 using namespace std;
 
 #include "Canvas.h"
+#include "Normals.h"
 #include "Shapes.h"
 
-vector< unsigned int > vertInds, normInds;
-vector< Vertex > verts, norms;
+// no index given for this attribute of a triangle corner
+#define OBJ_NONE	0xffffffffu
+
+vector< unsigned int > vertInds, normInds, texInds;
+vector< Vertex > verts, norms, texs;
+vector< ObjGroup > groups;
 
 ///
 // makeMesh() - bind the correct vertex and normal buffers
@@ -122,71 +127,509 @@ static void makeTexture( Canvas &C , int choice)
         UVcoord uv1 = { verts[normal1].x, verts[normal1].z, 0.0f };
         UVcoord uv2 = { verts[normal2].x, verts[normal2].z, 0.0f };
         UVcoord uv3 = { verts[normal3].x, verts[normal3].z, 0.0f };
+
+		// Use the file's own coordinates where it has them.
+		if( texInds[3 * i] != OBJ_NONE && texInds[3 * i + 1] != OBJ_NONE &&
+			texInds[3 * i + 2] != OBJ_NONE )
+		{
+			const Vertex &t1 = texs[texInds[3 * i]];
+			const Vertex &t2 = texs[texInds[3 * i + 1]];
+			const Vertex &t3 = texs[texInds[3 * i + 2]];
+			UVcoord f1 = { t1.x, t1.y, 0.0f };
+			UVcoord f2 = { t2.x, t2.y, 0.0f };
+			UVcoord f3 = { t3.x, t3.y, 0.0f };
+			uv1 = f1;
+			uv2 = f2;
+			uv3 = f3;
+		}
 					  
 		C.addTriangleWithUV( p1, uv1, p2, uv2, p3, uv3 );
     }
 }
 
 ///
-// loadMesh() - Read .obj files and format the data to
-// load them into our buffers.
+// One corner of an .obj face: its position, texture coordinate
+// and normal indices (OBJ_NONE where the face gives none).
+///
+typedef struct ObjCorner {
+	unsigned int v, t, n;
+} ObjCorner;
+
+///
+// skipBlanks() - Step over spaces, tabs, carriage returns and
+// backslash line continuations.
+//
+// @param p - where to start
+// @param line - line number, counted up past continuations
+///
+static inline const char *skipBlanks( const char *p, int &line )
+{
+	for( ;; )
+	{
+		if( *p == ' ' || *p == '\t' || *p == '\r' )
+			p++;
+		else if( *p == '\\' && p[1] == '\n' )
+		{
+			p += 2;
+			line++;
+		}
+		else if( *p == '\\' && p[1] == '\r' && p[2] == '\n' )
+		{
+			p += 3;
+			line++;
+		}
+		else
+			return p;
+	}
+}
+
+///
+// skipLine() - Step to the newline that ends the current line.
+///
+static inline const char *skipLine( const char *p )
+{
+	while( *p != '\n' )
+		p++;
+	return p;
+}
+
+static inline bool isDigit( char c )
+{
+	return c >= '0' && c <= '9';
+}
+
+///
+// parseFloat() - Read a number.  Plain decimals of up to 15 digits
+// are read here; anything longer or with an exponent is handed to
+// strtof().
+//
+// @return the end of the number, or NULL if there is none
+///
+static const char *parseFloat( const char *p, float &value )
+{
+	static const double powers[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15
+	};
+	const char *start = p;
+	bool negative = *p == '-';
+	if( *p == '-' || *p == '+' )
+		p++;
+	
+	unsigned long long mantissa = 0;
+	int digits = 0, decimals = 0;
+	while( isDigit( *p ) )
+	{
+		mantissa = mantissa * 10 + (*p++ - '0');
+		digits++;
+	}
+	if( *p == '.' )
+	{
+		p++;
+		while( isDigit( *p ) )
+		{
+			mantissa = mantissa * 10 + (*p++ - '0');
+			digits++;
+			decimals++;
+		}
+	}
+	if( digits == 0 )
+		return NULL;
+	
+	if( digits > 15 || *p == 'e' || *p == 'E' )
+	{
+		char *end;
+		value = strtof( start, &end );
+		return end;
+	}
+	double v = mantissa / powers[decimals];
+	value = (float) (negative ? -v : v);
+	return p;
+}
+
+///
+// parseIndex() - Read a whole number, possibly negative.
+//
+// @return the end of the number, or NULL if there is none
+///
+static inline const char *parseIndex( const char *p, long &value )
+{
+	bool negative = *p == '-';
+	if( *p == '-' || *p == '+' )
+		p++;
+	if( !isDigit( *p ) )
+		return NULL;
+	long v = 0;
+	while( isDigit( *p ) )
+		v = v * 10 + (*p++ - '0');
+	value = negative ? -v : v;
+	return p;
+}
+
+///
+// resolveIndex() - Turn a 1-based or negative (counted back from
+// the last one read) .obj index into a 0-based one.
+//
+// @param index - as written in the file
+// @param count - entries read so far
+///
+static inline unsigned int resolveIndex( long index, size_t count )
+{
+	if( index > 0 )
+		return index - 1;
+	if( index < 0 && (size_t) -index <= count )
+		return count + index;
+	return OBJ_NONE;
+}
+
+///
+// addTriangle() - Push three corners of a face to the buffers.
+///
+static inline void addTriangle( const ObjCorner &a, const ObjCorner &b,
+	const ObjCorner &c )
+{
+	vertInds.push_back(a.v);
+	vertInds.push_back(b.v);
+	vertInds.push_back(c.v);
+	texInds.push_back(a.t);
+	texInds.push_back(b.t);
+	texInds.push_back(c.t);
+	normInds.push_back(a.n);
+	normInds.push_back(b.n);
+	normInds.push_back(c.n);
+}
+
+///
+// addPolygon() - Split a face of any number of corners into
+// triangles: a fan if it is convex, otherwise by clipping ears off
+// it in the plane it faces.
+///
+static void addPolygon( const vector< ObjCorner > &poly )
+{
+	int n = poly.size();
+	if( n == 3 )
+	{
+		addTriangle( poly[0], poly[1], poly[2] );
+		return;
+	}
+	
+	// positions that are not read yet (forward references) cannot
+	// be looked at; fan those
+	bool known = true;
+	for( int i = 0; i < n; i++ )
+		known = known && poly[i].v < verts.size();
+	
+	// Newell's normal, and the plane most square to it
+	double nx = 0.0, ny = 0.0, nz = 0.0;
+	for( int i = 0; known && i < n; i++ )
+	{
+		const Vertex &a = verts[poly[i].v], &b = verts[poly[(i + 1) % n].v];
+		nx += (double) (a.y - b.y) * (a.z + b.z);
+		ny += (double) (a.z - b.z) * (a.x + b.x);
+		nz += (double) (a.x - b.x) * (a.y + b.y);
+	}
+	int axis = fabs( nx ) > fabs( ny ) ?
+		(fabs( nx ) > fabs( nz ) ? 0 : 2) : (fabs( ny ) > fabs( nz ) ? 1 : 2);
+	double sign = (axis == 0 ? nx : axis == 1 ? ny : nz) < 0.0 ? -1.0 : 1.0;
+	
+	vector< double > u( n ), w( n );
+	for( int i = 0; known && i < n; i++ )
+	{
+		const Vertex &p = verts[poly[i].v];
+		u[i] = axis == 0 ? p.y : axis == 1 ? p.z : p.x;
+		w[i] = axis == 0 ? p.z : axis == 1 ? p.x : p.y;
+	}
+	
+	// twice the signed area of corners a, b, c, positive if they
+	// turn the way the polygon does
+	#define TURN(a,b,c) (sign * ((u[b] - u[a]) * (w[c] - w[a]) - \
+		(w[b] - w[a]) * (u[c] - u[a])))
+	
+	bool convex = known;
+	for( int i = 0; convex && i < n; i++ )
+		convex = TURN( i, (i + 1) % n, (i + 2) % n ) >= 0.0;
+	if( convex || !known )
+	{
+		for( int i = 1; i + 1 < n; i++ )
+			addTriangle( poly[0], poly[i], poly[i + 1] );
+		return;
+	}
+	
+	vector< int > left( n );
+	for( int i = 0; i < n; i++ )
+		left[i] = i;
+	while( left.size() > 3 )
+	{
+		int m = left.size(), ear = -1;
+		for( int i = 0; i < m && ear < 0; i++ )
+		{
+			int a = left[(i + m - 1) % m], b = left[i], c = left[(i + 1) % m];
+			if( TURN( a, b, c ) <= 0.0 )
+				continue;
+			bool empty = true;
+			for( int j = 0; j < m && empty; j++ )
+			{
+				int q = left[j];
+				if( q == a || q == b || q == c )
+					continue;
+				empty = !(TURN( a, b, q ) >= 0.0 && TURN( b, c, q ) >= 0.0 &&
+					TURN( c, a, q ) >= 0.0);
+			}
+			if( empty )
+				ear = i;
+		}
+		if( ear < 0 )
+			break;	// degenerate: fan what is left
+		addTriangle( poly[left[(ear + m - 1) % m]], poly[left[ear]],
+			poly[left[(ear + 1) % m]] );
+		left.erase( left.begin() + ear );
+	}
+	#undef TURN
+	for( size_t i = 1; i + 1 < left.size(); i++ )
+		addTriangle( poly[left[0]], poly[left[i]], poly[left[i + 1]] );
+}
+
+///
+// startGroup() - Begin a new group of triangles, or rename the
+// current one if it has none yet.
+///
+static void startGroup( const string &name, const string &material )
+{
+	unsigned int triangles = vertInds.size() / 3;
+	if( groups.empty() || groups.back().firstTriangle != triangles )
+		groups.push_back( ObjGroup() );
+	groups.back().name = name;
+	groups.back().material = material;
+	groups.back().firstTriangle = triangles;
+}
+
+///
+// readObj() - Read an .obj file into the vertex, normal, texture
+// coordinate and index buffers.  Faces may have any number of
+// corners, written as v, v/vt, v//vn or v/vt/vn, with positive or
+// negative (relative) indices.
 //
 // @param path - Path of the Object file
-// @param C - Canvas object
-// @param choice - Object ID
+//
+// @return false if the file could not be read
 ///
-void loadMesh( char const * path, Canvas &C , int choice)
+static bool readObj( char const * path )
 {
 	//clear the buffers
 	verts.clear();
 	norms.clear();
+	texs.clear();
 	vertInds.clear();
 	normInds.clear();
+	texInds.clear();
+	groups.clear();
 	
-	FILE * file = fopen(path, "r");
+	FILE * file = fopen(path, "rb");
 	if( file == NULL ){
 		printf("File not found. Please check again !\n");
+		return false;
 	}
-	char lineHeader[128];
-	while( 1 ){
-		
-		int res = fscanf(file, "%s", lineHeader);
-		if (res == EOF)
-			break; 
+	
+	// the whole file, ending in a newline
+	vector< char > text;
+	fseek( file, 0, SEEK_END );
+	long size = ftell( file );
+	fseek( file, 0, SEEK_SET );
+	text.resize( size > 0 ? size + 2 : 2 );
+	if( size > 0 && fread( &text[0], 1, size, file ) != (size_t) size ){
+		perror( path );
+		fclose(file);
+		return false;
+	}
+	fclose(file);
+	text[text.size() - 2] = '\n';
+	text[text.size() - 1] = '\0';
+	
+	const char *p = &text[0], *end = p + text.size() - 1;
+	int line = 1, errors = 0;
+	string object, material;
+	vector< ObjCorner > poly;
+	
+	for( ; p < end; p++, line++ )
+	{
+		p = skipBlanks( p, line );
+		const char *word = p;
+		while( *p > ' ' )
+			p++;
+		size_t length = p - word;
+		p = skipBlanks( p, line );
+		bool bad = false;
 		
-		// Read vertices.
-		if ( strcmp( lineHeader, "v" ) == 0 )
+		// Read vertices, normals and texture coordinates.
+		if( word[0] == 'v' && (length == 1 ||
+			(length == 2 && (word[1] == 'n' || word[1] == 't'))) )
 		{
-			Vertex vert;
-			fscanf(file, "%f %f %f\n", &vert.x, &vert.y, &vert.z );
-			verts.push_back(vert);
+			Vertex value = { 0.0f, 0.0f, 0.0f };
+			float *out = &value.x;
+			int count = 0;
+			while( count < 3 && *p != '\n' && *p != '#' )
+			{
+				const char *q = parseFloat( p, out[count] );
+				if( q == NULL )
+					break;
+				count++;
+				p = skipBlanks( q, line );
+			}
+			if( length == 1 )
+			{
+				bad = count < 3;
+				verts.push_back(value);
+			}
+			else if( word[1] == 'n' )
+			{
+				bad = count < 3;
+				norms.push_back(value);
+			}
+			else
+			{
+				bad = count < 1;
+				texs.push_back(value);
+			}
 		}
 		
-		// Read normals.
-		else if ( strcmp( lineHeader, "vn" ) == 0 )
+		// Read faces: a corner per vertex.
+		else if( length == 1 && word[0] == 'f' )
 		{
-			Vertex norm;
-			fscanf(file, "%f %f %f\n", &norm.x, &norm.y, &norm.z );
-			norms.push_back(norm);
+			poly.clear();
+			while( !bad && *p != '\n' && *p != '#' )
+			{
+				ObjCorner c = { OBJ_NONE, OBJ_NONE, OBJ_NONE };
+				long index;
+				const char *q = parseIndex( p, index );
+				bad = q == NULL;
+				if( !bad )
+					c.v = resolveIndex( index, verts.size() );
+				if( !bad && *q == '/' )
+				{
+					q++;
+					if( *q != '/' )
+					{
+						q = parseIndex( q, index );
+						bad = q == NULL;
+						if( !bad )
+							c.t = resolveIndex( index, texs.size() );
+					}
+					if( !bad && *q == '/' )
+					{
+						q = parseIndex( q + 1, index );
+						bad = q == NULL;
+						if( !bad )
+							c.n = resolveIndex( index, norms.size() );
+					}
+				}
+				bad = bad || c.v == OBJ_NONE ||
+					(*q != ' ' && *q != '\t' && *q != '\r' && *q != '\n' &&
+					 *q != '\\' && *q != '#');
+				if( !bad )
+				{
+					poly.push_back(c);
+					p = skipBlanks( q, line );
+				}
+			}
+			bad = bad || poly.size() < 3;
+			if( !bad )
+				addPolygon( poly );
 		}
 		
-		// Read triangle vertex and normal indices.
-		else if ( strcmp( lineHeader, "f" ) == 0 )
+		// Name groups of faces and their materials.
+		else if( length == 1 && (word[0] == 'o' || word[0] == 'g') )
+		{
+			const char *q = skipLine( p );
+			while( q > p && (q[-1] == ' ' || q[-1] == '\t' || q[-1] == '\r') )
+				q--;
+			object.assign( p, q - p );
+			startGroup( object, material );
+		}
+		else if( length == 6 && strncmp( word, "usemtl", 6 ) == 0 )
 		{
-			unsigned int vertIndex[3], normIndex[3];
-			fscanf(file, "%d//%d %d//%d %d//%d\n", &vertIndex[0], &normIndex[0], 
-			&vertIndex[1], &normIndex[1], &vertIndex[2], &normIndex[2] );
-			
-			// Push vertex indices to buffers.
-			vertInds.push_back(vertIndex[0] - 1);
-			vertInds.push_back(vertIndex[1] - 1);
-			vertInds.push_back(vertIndex[2] - 1);
-			
-			// Push normal indices to buffers.
-			normInds.push_back(normIndex[0] - 1);
-			normInds.push_back(normIndex[1] - 1);
-			normInds.push_back(normIndex[2] - 1);
+			const char *q = skipLine( p );
+			while( q > p && (q[-1] == ' ' || q[-1] == '\t' || q[-1] == '\r') )
+				q--;
+			material.assign( p, q - p );
+			startGroup( object, material );
 		}
+		
+		if( bad && errors++ < 10 )
+			printf("%s:%d: cannot read this line\n", path, line);
+		p = skipLine( p );
+	}
+	
+	// positive indices may point ahead, so check them at the end
+	for( size_t i = 0; i < vertInds.size(); i++ )
+	{
+		if( vertInds[i] >= verts.size() ){
+			printf("%s: vertex %u does not exist\n", path, vertInds[i] + 1);
+			return false;
+		}
+		if( texInds[i] != OBJ_NONE && texInds[i] >= texs.size() )
+			texInds[i] = OBJ_NONE;
+		if( normInds[i] != OBJ_NONE && normInds[i] >= norms.size() )
+			normInds[i] = OBJ_NONE;
+	}
+	return true;
+}
+
+///
+// usableNormals() - Check that every triangle corner has a normal
+// that can be shaded with.
+//
+// @return false if any normal is missing, zero or not a number
+///
+static bool usableNormals( void )
+{
+	for( size_t i = 0; i < normInds.size(); i++ )
+	{
+		if( normInds[i] >= norms.size() )
+			return false;
+		const Vertex &n = norms[normInds[i]];
+		float length = n.x * n.x + n.y * n.y + n.z * n.z;
+		if( !(length > 0.0f) || !isfinite( length ) )
+			return false;
+	}
+	return true;
+}
+
+///
+// smoothNormals() - Replace the normals with smooth ones made
+// from the triangles (see Normals.h), one per triangle corner.
+///
+static void smoothNormals( void )
+{
+	ThreadPool pool;
+	NormalGenerator generator( pool );
+	
+	norms.resize( vertInds.size() );
+	generator.generate( &verts[0].x, verts.size(), vertInds.data(),
+		vertInds.size() / 3, &norms[0].x );
+	
+	normInds.resize( vertInds.size() );
+	for( size_t i = 0; i < normInds.size(); i++ )
+		normInds[i] = i;
+}
+
+///
+// loadMesh() - Read .obj files and format the data to
+// load them into our buffers.
+//
+// @param path - Path of the Object file
+// @param C - Canvas object
+// @param choice - Object ID
+///
+void loadMesh( char const * path, Canvas &C , int choice)
+{
+	if( !readObj( path ) )
+		return;
+	
+	// Make up normals where the file has none we can use.
+	if( choice != OBJ_BOTTOM && !vertInds.empty() && !usableNormals() )
+	{
+		printf("%s: no usable normals, smoothing\n", path);
+		smoothNormals();
 	}
 	
 	if(choice != OBJ_BOTTOM)
@@ -195,6 +638,77 @@ void loadMesh( char const * path, Canvas &C , int choice)
 		makeTexture ( C , choice);
 }
 
+///
+// loadMeshData() - Read the positions and triangles of an .obj
+// file without making a shape of them.
+//
+// @param path - Path of the Object file
+// @param positions - receives x, y, z of every vertex
+// @param indices - receives three vertex indices per triangle
+// @param normals - if not NULL, receives x, y, z of the normal of
+//		every triangle corner, or nothing if the file has none we can use
+// @param objGroups - if not NULL, receives the o, g and usemtl groups
+//
+// @return false if the file could not be read
+///
+bool loadMeshData( char const * path, vector< float > &positions,
+	vector< unsigned int > &indices, vector< float > *normals,
+	vector< ObjGroup > *objGroups )
+{
+	if( !readObj( path ) )
+		return false;
+	
+	positions.resize( 3 * verts.size() );
+	for( size_t i = 0; i < verts.size(); i++ )
+	{
+		positions[3 * i + 0] = verts[i].x;
+		positions[3 * i + 1] = verts[i].y;
+		positions[3 * i + 2] = verts[i].z;
+	}
+	indices = vertInds;
+	if( objGroups != NULL )
+		*objGroups = groups;
+	
+	if( normals != NULL )
+	{
+		normals->clear();
+		if( usableNormals() )
+		{
+			normals->resize( 3 * normInds.size() );
+			for( size_t i = 0; i < normInds.size(); i++ )
+			{
+				(*normals)[3 * i + 0] = norms[normInds[i]].x;
+				(*normals)[3 * i + 1] = norms[normInds[i]].y;
+				(*normals)[3 * i + 2] = norms[normInds[i]].z;
+			}
+		}
+	}
+	return true;
+}
+
+///
+// shapeFile() - The .obj file an object is made from.
+//
+// @param choice - Object ID
+//
+// @return the path, or NULL for an unknown ID
+///
+const char *shapeFile( int choice )
+{
+	switch( choice )
+	{
+		case OBJ_SLAB:		return "SlabScaled.obj";
+		case OBJ_CHEESE:	return "NewCheese.obj";
+		case OBJ_GRAPES:	return "GrapesScaled.obj";
+		case OBJ_GLASS:		return "GlassScaled.obj";
+		case OBJ_BOTTLE:	return "NewBottle.obj";
+		case OBJ_MUG:		return "MugScaled.obj";
+		case OBJ_BOTTOM:	return "BottomScaled.obj";
+		case OBJ_ROOM:		return "NewRoom.obj";
+	}
+	return NULL;
+}
+
 ///
 // Make objects from .obj files of the objects.
 //
@@ -211,20 +725,7 @@ void loadMesh( char const * path, Canvas &C , int choice)
 ///
 void makeShape( int choice, Canvas &C )
 {
-	if(choice == OBJ_SLAB)
-		loadMesh( "SlabScaled.obj" , C , OBJ_SLAB);
-	if(choice == OBJ_CHEESE)
-		loadMesh( "NewCheese.obj" , C , OBJ_CHEESE);
-	if(choice == OBJ_GRAPES)
-		loadMesh( "GrapesScaled.obj" , C , OBJ_GRAPES);
-	if(choice == OBJ_GLASS)
-		loadMesh( "GlassScaled.obj" , C , OBJ_GLASS);
-	if(choice == OBJ_BOTTLE)
-		loadMesh( "NewBottle.obj" , C , OBJ_BOTTLE);
-	if(choice == OBJ_MUG)
-		loadMesh( "MugScaled.obj" , C , OBJ_MUG);
-	if(choice == OBJ_BOTTOM)
-		loadMesh( "BottomScaled.obj" , C , OBJ_BOTTOM);
-	if(choice == OBJ_ROOM)
-		loadMesh( "NewRoom.obj" , C , OBJ_ROOM);
+	const char *path = shapeFile( choice );
+	if( path != NULL )
+		loadMesh( path , C , choice);
 }
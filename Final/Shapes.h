@@ -23,6 +23,17 @@
 #define OBJ_BOTTOM	18
 #define OBJ_ROOM	21
 
+///
+// A run of triangles that an .obj file names with 'o' or 'g',
+// and the material it gives them with 'usemtl'.  Each group lasts
+// until the next one's first triangle.
+///
+typedef struct ObjGroup {
+	string name;
+	string material;
+	unsigned int firstTriangle;
+} ObjGroup;
+
 ///
 // Make objects 
 //
@@ -39,6 +50,15 @@
 ///
 void makeShape( int choice, Canvas &C );
 
+///
+// shapeFile() - The .obj file an object is made from.
+//
+// @param choice - Object ID
+//
+// @return the path, or NULL for an unknown ID
+///
+const char *shapeFile( int choice );
+
 ///
 // loadMesh() - Read .obj files and format the data to
 // load them into our buffers.
@@ -49,4 +69,21 @@ void makeShape( int choice, Canvas &C );
 ///
 void loadMesh( char* path, Canvas &C );
 
+///
+// loadMeshData() - Read the positions and triangles of an .obj
+// file without making a shape of them.
+//
+// @param path - Path of the Object file
+// @param positions - receives x, y, z of every vertex
+// @param indices - receives three vertex indices per triangle
+// @param normals - if not NULL, receives x, y, z of the normal of
+//		every triangle corner, or nothing if the file has none we can use
+// @param objGroups - if not NULL, receives the o, g and usemtl groups
+//
+// @return false if the file could not be read
+///
+bool loadMeshData( char const * path, vector< float > &positions,
+	vector< unsigned int > &indices, vector< float > *normals = NULL,
+	vector< ObjGroup > *objGroups = NULL );
+
 #endif
@@ -0,0 +1,326 @@
+//
+//  Simd.h
+//
+//  Eight-lane float and integer vectors for the CPU renderers.
+//
+//  With AVX2 and FMA enabled (-mavx2 -mfma, see OPTFLAGS in the
+//  Makefile) these map one-to-one onto 256-bit registers; otherwise
+//  they fall back to plain eight-element loops that the compiler can
+//  still vectorize with whatever the target offers.  Every translation
+//  unit must be built with the same flags.
+//
+//  Comparisons yield a SimdMask; select(m,a,b) picks a where m is set.
+//
+
+#ifndef _SIMD_H_
+#define _SIMD_H_
+
+#include <stdint.h>
+#include <cmath>
+
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SIMD_AVX2 1
+#endif
+
+#define SIMD_WIDTH 8
+
+#ifdef SIMD_AVX2
+
+///
+// AVX2 implementation
+///
+
+struct SimdMask {
+    __m256 v;
+    SimdMask( void ) {}
+    SimdMask( __m256 m ) : v(m) {}
+};
+
+struct SimdFloat {
+    __m256 v;
+    SimdFloat( void ) {}
+    SimdFloat( __m256 x ) : v(x) {}
+    SimdFloat( float x ) : v(_mm256_set1_ps( x )) {}
+};
+
+struct SimdInt {
+    __m256i v;
+    SimdInt( void ) {}
+    SimdInt( __m256i x ) : v(x) {}
+    SimdInt( int32_t x ) : v(_mm256_set1_epi32( x )) {}
+};
+
+static inline SimdFloat loadFloat( const float *p ) { return _mm256_loadu_ps( p ); }
+static inline void storeFloat( float *p, SimdFloat a ) { _mm256_storeu_ps( p, a.v ); }
+static inline SimdInt loadInt( const int32_t *p ) { return _mm256_loadu_si256( (const __m256i *) p ); }
+static inline void storeInt( int32_t *p, SimdInt a ) { _mm256_storeu_si256( (__m256i *) p, a.v ); }
+
+// 0, 1, ... 7
+static inline SimdInt laneIndex( void ) { return _mm256_setr_epi32( 0, 1, 2, 3, 4, 5, 6, 7 ); }
+
+static inline SimdFloat operator+( SimdFloat a, SimdFloat b ) { return _mm256_add_ps( a.v, b.v ); }
+static inline SimdFloat operator-( SimdFloat a, SimdFloat b ) { return _mm256_sub_ps( a.v, b.v ); }
+static inline SimdFloat operator*( SimdFloat a, SimdFloat b ) { return _mm256_mul_ps( a.v, b.v ); }
+static inline SimdFloat operator/( SimdFloat a, SimdFloat b ) { return _mm256_div_ps( a.v, b.v ); }
+static inline SimdFloat operator-( SimdFloat a ) { return _mm256_xor_ps( a.v, _mm256_set1_ps( -0.0f ) ); }
+
+// a*b + c
+static inline SimdFloat fmadd( SimdFloat a, SimdFloat b, SimdFloat c ) { return _mm256_fmadd_ps( a.v, b.v, c.v ); }
+static inline SimdFloat min( SimdFloat a, SimdFloat b ) { return _mm256_min_ps( a.v, b.v ); }
+static inline SimdFloat max( SimdFloat a, SimdFloat b ) { return _mm256_max_ps( a.v, b.v ); }
+static inline SimdFloat sqrt( SimdFloat a ) { return _mm256_sqrt_ps( a.v ); }
+static inline SimdFloat floor( SimdFloat a ) { return _mm256_floor_ps( a.v ); }
+static inline SimdFloat abs( SimdFloat a ) { return _mm256_andnot_ps( _mm256_set1_ps( -0.0f ), a.v ); }
+
+static inline SimdMask operator<( SimdFloat a, SimdFloat b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LT_OQ ); }
+static inline SimdMask operator<=( SimdFloat a, SimdFloat b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_LE_OQ ); }
+static inline SimdMask operator>( SimdFloat a, SimdFloat b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GT_OQ ); }
+static inline SimdMask operator>=( SimdFloat a, SimdFloat b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_GE_OQ ); }
+static inline SimdMask operator==( SimdFloat a, SimdFloat b ) { return _mm256_cmp_ps( a.v, b.v, _CMP_EQ_OQ ); }
+
+static inline SimdMask operator&( SimdMask a, SimdMask b ) { return _mm256_and_ps( a.v, b.v ); }
+static inline SimdMask operator|( SimdMask a, SimdMask b ) { return _mm256_or_ps( a.v, b.v ); }
+static inline SimdMask andNot( SimdMask a, SimdMask b ) { return _mm256_andnot_ps( b.v, a.v ); }  // a & ~b
+
+// one bit per lane, lane 0 in bit 0
+static inline int bits( SimdMask m ) { return _mm256_movemask_ps( m.v ); }
+static inline bool any( SimdMask m ) { return !_mm256_testz_ps( m.v, m.v ); }
+
+static inline SimdFloat select( SimdMask m, SimdFloat a, SimdFloat b ) { return _mm256_blendv_ps( b.v, a.v, m.v ); }
+
+static inline SimdInt operator+( SimdInt a, SimdInt b ) { return _mm256_add_epi32( a.v, b.v ); }
+static inline SimdInt operator-( SimdInt a, SimdInt b ) { return _mm256_sub_epi32( a.v, b.v ); }
+static inline SimdInt operator*( SimdInt a, SimdInt b ) { return _mm256_mullo_epi32( a.v, b.v ); }
+static inline SimdInt operator&( SimdInt a, SimdInt b ) { return _mm256_and_si256( a.v, b.v ); }
+static inline SimdInt operator|( SimdInt a, SimdInt b ) { return _mm256_or_si256( a.v, b.v ); }
+static inline SimdInt operator<<( SimdInt a, int n ) { return _mm256_slli_epi32( a.v, n ); }
+static inline SimdInt operator>>( SimdInt a, int n ) { return _mm256_srli_epi32( a.v, n ); }  // logical
+static inline SimdInt min( SimdInt a, SimdInt b ) { return _mm256_min_epi32( a.v, b.v ); }
+static inline SimdInt max( SimdInt a, SimdInt b ) { return _mm256_max_epi32( a.v, b.v ); }
+static inline SimdMask operator>( SimdInt a, SimdInt b ) { return _mm256_castsi256_ps( _mm256_cmpgt_epi32( a.v, b.v ) ); }
+
+// lanes whose sign bit is clear (a >= 0)
+static inline SimdMask nonNegative( SimdInt a ) {
+    return _mm256_castsi256_ps( _mm256_cmpgt_epi32( a.v, _mm256_set1_epi32( -1 ) ) );
+}
+
+static inline SimdInt toInt( SimdFloat a ) { return _mm256_cvttps_epi32( a.v ); }      // truncates
+static inline SimdInt roundToInt( SimdFloat a ) { return _mm256_cvtps_epi32( a.v ); }  // nearest
+static inline SimdFloat toFloat( SimdInt a ) { return _mm256_cvtepi32_ps( a.v ); }
+static inline SimdInt asInt( SimdFloat a ) { return _mm256_castps_si256( a.v ); }
+static inline SimdFloat asFloat( SimdInt a ) { return _mm256_castsi256_ps( a.v ); }
+static inline SimdInt asInt( SimdMask m ) { return _mm256_castps_si256( m.v ); }
+
+// p[index[i]] for every lane
+static inline SimdInt gather( const int32_t *p, SimdInt index ) { return _mm256_i32gather_epi32( (const int *) p, index.v, 4 ); }
+static inline SimdFloat gather( const float *p, SimdInt index ) { return _mm256_i32gather_ps( p, index.v, 4 ); }
+
+// store only the lanes selected by 'm'
+static inline void storeMasked( int32_t *p, SimdMask m, SimdInt a ) {
+    _mm256_maskstore_epi32( (int *) p, _mm256_castps_si256( m.v ), a.v );
+}
+static inline void storeMasked( float *p, SimdMask m, SimdFloat a ) {
+    _mm256_maskstore_ps( p, _mm256_castps_si256( m.v ), a.v );
+}
+
+// sum of all lanes
+static inline float horizontalSum( SimdFloat a ) {
+    __m128 s = _mm_add_ps( _mm256_castps256_ps128( a.v ), _mm256_extractf128_ps( a.v, 1 ) );
+    s = _mm_add_ps( s, _mm_movehl_ps( s, s ) );
+    s = _mm_add_ss( s, _mm_shuffle_ps( s, s, 1 ) );
+    return _mm_cvtss_f32( s );
+}
+
+#else
+
+///
+// Portable implementation
+///
+
+#define SIMD_LOOP(i) for( int i = 0; i < SIMD_WIDTH; i++ )
+
+struct SimdMask {
+    int32_t v[SIMD_WIDTH];      // 0 or -1
+};
+
+struct SimdFloat {
+    float v[SIMD_WIDTH];
+    SimdFloat( void ) {}
+    SimdFloat( float x ) { SIMD_LOOP(i) v[i] = x; }
+};
+
+struct SimdInt {
+    int32_t v[SIMD_WIDTH];
+    SimdInt( void ) {}
+    SimdInt( int32_t x ) { SIMD_LOOP(i) v[i] = x; }
+};
+
+static inline SimdFloat loadFloat( const float *p ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = p[i]; return r; }
+static inline void storeFloat( float *p, SimdFloat a ) { SIMD_LOOP(i) p[i] = a.v[i]; }
+static inline SimdInt loadInt( const int32_t *p ) { SimdInt r; SIMD_LOOP(i) r.v[i] = p[i]; return r; }
+static inline void storeInt( int32_t *p, SimdInt a ) { SIMD_LOOP(i) p[i] = a.v[i]; }
+
+static inline SimdInt laneIndex( void ) { SimdInt r; SIMD_LOOP(i) r.v[i] = i; return r; }
+
+#define SIMD_FLOAT_OP(op) \
+    static inline SimdFloat operator op( SimdFloat a, SimdFloat b ) { \
+        SimdFloat r; SIMD_LOOP(i) r.v[i] = a.v[i] op b.v[i]; return r; }
+SIMD_FLOAT_OP(+)
+SIMD_FLOAT_OP(-)
+SIMD_FLOAT_OP(*)
+SIMD_FLOAT_OP(/)
+#undef SIMD_FLOAT_OP
+
+static inline SimdFloat operator-( SimdFloat a ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = -a.v[i]; return r; }
+static inline SimdFloat fmadd( SimdFloat a, SimdFloat b, SimdFloat c ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = a.v[i] * b.v[i] + c.v[i]; return r; }
+static inline SimdFloat min( SimdFloat a, SimdFloat b ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+static inline SimdFloat max( SimdFloat a, SimdFloat b ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+static inline SimdFloat sqrt( SimdFloat a ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = std::sqrt( a.v[i] ); return r; }
+static inline SimdFloat floor( SimdFloat a ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = std::floor( a.v[i] ); return r; }
+static inline SimdFloat abs( SimdFloat a ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = std::fabs( a.v[i] ); return r; }
+
+#define SIMD_COMPARE(op) \
+    static inline SimdMask operator op( SimdFloat a, SimdFloat b ) { \
+        SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] op b.v[i] ? -1 : 0; return r; }
+SIMD_COMPARE(<)
+SIMD_COMPARE(<=)
+SIMD_COMPARE(>)
+SIMD_COMPARE(>=)
+SIMD_COMPARE(==)
+#undef SIMD_COMPARE
+
+static inline SimdMask operator&( SimdMask a, SimdMask b ) { SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] & b.v[i]; return r; }
+static inline SimdMask operator|( SimdMask a, SimdMask b ) { SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] | b.v[i]; return r; }
+static inline SimdMask andNot( SimdMask a, SimdMask b ) { SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] & ~b.v[i]; return r; }
+
+static inline int bits( SimdMask m ) { int b = 0; SIMD_LOOP(i) b |= (m.v[i] & 1) << i; return b; }
+static inline bool any( SimdMask m ) { return bits( m ) != 0; }
+
+static inline SimdFloat select( SimdMask m, SimdFloat a, SimdFloat b ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r; }
+
+#define SIMD_INT_OP(op) \
+    static inline SimdInt operator op( SimdInt a, SimdInt b ) { \
+        SimdInt r; SIMD_LOOP(i) r.v[i] = (int32_t) ((uint32_t) a.v[i] op (uint32_t) b.v[i]); return r; }
+SIMD_INT_OP(+)
+SIMD_INT_OP(-)
+SIMD_INT_OP(*)
+SIMD_INT_OP(&)
+SIMD_INT_OP(|)
+#undef SIMD_INT_OP
+
+static inline SimdInt operator<<( SimdInt a, int n ) { SimdInt r; SIMD_LOOP(i) r.v[i] = (int32_t) ((uint32_t) a.v[i] << n); return r; }
+static inline SimdInt operator>>( SimdInt a, int n ) { SimdInt r; SIMD_LOOP(i) r.v[i] = (int32_t) ((uint32_t) a.v[i] >> n); return r; }
+static inline SimdInt min( SimdInt a, SimdInt b ) { SimdInt r; SIMD_LOOP(i) r.v[i] = a.v[i] < b.v[i] ? a.v[i] : b.v[i]; return r; }
+static inline SimdInt max( SimdInt a, SimdInt b ) { SimdInt r; SIMD_LOOP(i) r.v[i] = a.v[i] > b.v[i] ? a.v[i] : b.v[i]; return r; }
+static inline SimdMask operator>( SimdInt a, SimdInt b ) { SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] > b.v[i] ? -1 : 0; return r; }
+static inline SimdMask nonNegative( SimdInt a ) { SimdMask r; SIMD_LOOP(i) r.v[i] = a.v[i] >= 0 ? -1 : 0; return r; }
+
+static inline SimdInt toInt( SimdFloat a ) { SimdInt r; SIMD_LOOP(i) r.v[i] = (int32_t) a.v[i]; return r; }
+static inline SimdInt roundToInt( SimdFloat a ) { SimdInt r; SIMD_LOOP(i) r.v[i] = (int32_t) std::nearbyint( a.v[i] ); return r; }
+static inline SimdFloat toFloat( SimdInt a ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = (float) a.v[i]; return r; }
+static inline SimdInt asInt( SimdFloat a ) { SimdInt r; SIMD_LOOP(i) { union { float f; int32_t n; } u; u.f = a.v[i]; r.v[i] = u.n; } return r; }
+static inline SimdFloat asFloat( SimdInt a ) { SimdFloat r; SIMD_LOOP(i) { union { float f; int32_t n; } u; u.n = a.v[i]; r.v[i] = u.f; } return r; }
+static inline SimdInt asInt( SimdMask m ) { SimdInt r; SIMD_LOOP(i) r.v[i] = m.v[i]; return r; }
+
+static inline SimdInt gather( const int32_t *p, SimdInt index ) { SimdInt r; SIMD_LOOP(i) r.v[i] = p[index.v[i]]; return r; }
+static inline SimdFloat gather( const float *p, SimdInt index ) { SimdFloat r; SIMD_LOOP(i) r.v[i] = p[index.v[i]]; return r; }
+
+static inline void storeMasked( int32_t *p, SimdMask m, SimdInt a ) { SIMD_LOOP(i) if( m.v[i] ) p[i] = a.v[i]; }
+static inline void storeMasked( float *p, SimdMask m, SimdFloat a ) { SIMD_LOOP(i) if( m.v[i] ) p[i] = a.v[i]; }
+
+static inline float horizontalSum( SimdFloat a ) { float s = 0.0f; SIMD_LOOP(i) s += a.v[i]; return s; }
+
+#undef SIMD_LOOP
+
+#endif
+
+///
+// Derived operations, shared by both implementations
+///
+
+static inline SimdMask operator>=( SimdInt a, SimdInt b ) { return nonNegative( a - b ); }
+
+static inline SimdInt select( SimdMask m, SimdInt a, SimdInt b )
+{
+    return asInt( select( m, asFloat( a ), asFloat( b ) ) );
+}
+
+static inline SimdFloat clamp( SimdFloat a, float lo, float hi )
+{
+    return min( max( a, SimdFloat( lo ) ), SimdFloat( hi ) );
+}
+
+static inline SimdFloat dot( SimdFloat ax, SimdFloat ay, SimdFloat az,
+                             SimdFloat bx, SimdFloat by, SimdFloat bz )
+{
+    return fmadd( ax, bx, fmadd( ay, by, az * bz ) );
+}
+
+///
+// normalize(x,y,z) - scale each lane's vector to unit length in place
+///
+static inline void normalize( SimdFloat &x, SimdFloat &y, SimdFloat &z )
+{
+    SimdFloat s = SimdFloat( 1.0f ) / sqrt( dot( x, y, z, x, y, z ) );
+    x = x * s;
+    y = y * s;
+    z = z * s;
+}
+
+///
+// log2(x), exp2(x) and pow(x,y) - accurate to a few ulp (Cephes
+// polynomials); pow() is meant for x >= 0 and returns 0 for x == 0
+///
+static inline SimdFloat log2( SimdFloat x )
+{
+    // split x into 2^e * m with m in [sqrt(1/2), sqrt(2))
+    SimdInt xi = asInt( x );
+    SimdInt e = ((xi >> 23) & SimdInt( 0xff )) - SimdInt( 127 );
+    SimdFloat m = asFloat( (xi & SimdInt( 0x007fffff )) | SimdInt( 0x3f800000 ) );
+    SimdMask big = m > SimdFloat( 1.41421356f );
+    m = select( big, m * SimdFloat( 0.5f ), m );
+    e = select( big, e + SimdInt( 1 ), e );
+
+    // log(1+f) = f - f^2/2 + f^3 P(f)
+    SimdFloat f = m - SimdFloat( 1.0f );
+    SimdFloat p = SimdFloat( 7.0376836292e-2f );
+    p = fmadd( p, f, SimdFloat( -1.1514610310e-1f ) );
+    p = fmadd( p, f, SimdFloat( 1.1676998740e-1f ) );
+    p = fmadd( p, f, SimdFloat( -1.2420140846e-1f ) );
+    p = fmadd( p, f, SimdFloat( 1.4249322787e-1f ) );
+    p = fmadd( p, f, SimdFloat( -1.6668057665e-1f ) );
+    p = fmadd( p, f, SimdFloat( 2.0000714765e-1f ) );
+    p = fmadd( p, f, SimdFloat( -2.4999993993e-1f ) );
+    p = fmadd( p, f, SimdFloat( 3.3333331174e-1f ) );
+    SimdFloat f2 = f * f;
+    SimdFloat ln = fmadd( f2 * f, p, fmadd( f2, SimdFloat( -0.5f ), f ) );
+
+    return fmadd( ln, SimdFloat( 1.44269504089f ), toFloat( e ) );
+}
+
+static inline SimdFloat exp2( SimdFloat x )
+{
+    x = clamp( x, -126.0f, 127.0f );
+    SimdFloat n = floor( x + SimdFloat( 0.5f ) );
+    SimdFloat f = x - n;
+
+    SimdFloat p = SimdFloat( 1.535336188319500e-4f );
+    p = fmadd( p, f, SimdFloat( 1.339887440266574e-3f ) );
+    p = fmadd( p, f, SimdFloat( 9.618437357674640e-3f ) );
+    p = fmadd( p, f, SimdFloat( 5.550332471162809e-2f ) );
+    p = fmadd( p, f, SimdFloat( 2.402264791363012e-1f ) );
+    p = fmadd( p, f, SimdFloat( 6.931472028550421e-1f ) );
+    p = fmadd( p, f, SimdFloat( 1.0f ) );
+
+    // scale by 2^n through the exponent field
+    return asFloat( asInt( p ) + (toInt( n ) << 23) );
+}
+
+static inline SimdFloat pow( SimdFloat x, SimdFloat y )
+{
+    SimdFloat r = exp2( y * log2( x ) );
+    return select( x > SimdFloat( 0.0f ), r, SimdFloat( 0.0f ) );
+}
+
+#endif
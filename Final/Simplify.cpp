@@ -0,0 +1,470 @@
+//
+//  Simplify.cpp
+//
+//  Quadric error metric simplification implementation.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+
+#include "Simplify.h"
+#include "Timing.h"
+
+using namespace std;
+
+// doubles per quadric: the upper triangle of a symmetric 4x4,
+// a2 ab ac ad b2 bc bd c2 cd d2 for the plane ax + by + cz + d = 0
+#define QUADRIC     10
+
+// least cosine between a triangle's normal before and after a collapse
+#define FLIP_COSINE 0.1
+
+///
+// Constructor
+///
+MeshSimplifier::MeshSimplifier( void ) :
+    vertices(0), triangles(0), error(0.0), simplifyMs(0.0),
+    recordHistory(false)
+{
+}
+
+// the value of quadric q at p
+static inline double quadricError( const double *q, const double *p )
+{
+    double x = p[0], y = p[1], z = p[2];
+    return q[0] * x * x + 2.0 * q[1] * x * y + 2.0 * q[2] * x * z +
+           2.0 * q[3] * x + q[4] * y * y + 2.0 * q[5] * y * z +
+           2.0 * q[6] * y + q[7] * z * z + 2.0 * q[8] * z + q[9];
+}
+
+// (b - a) x (c - a)
+static inline void triangleNormal( const double *a, const double *b,
+                                   const double *c, double *n )
+{
+    double e[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+    double f[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+    n[0] = e[1] * f[2] - e[2] * f[1];
+    n[1] = e[2] * f[0] - e[0] * f[2];
+    n[2] = e[0] * f[1] - e[1] * f[0];
+}
+
+///
+// addPlane(v,plane,weight) - add a plane's quadric to vertex v
+///
+void MeshSimplifier::addPlane( uint32_t v, const double *plane,
+                               double weight )
+{
+    double *q = &quadric[QUADRIC * (size_t) v];
+    int i = 0;
+    for( int r = 0; r < 4; r++ ) {
+        for( int c = r; c < 4; c++ ) {
+            q[i++] += weight * plane[r] * plane[c];
+        }
+    }
+}
+
+///
+// load(points,stride,corners) - start from a triangle soup
+///
+void MeshSimplifier::load( const float *points, int stride, int corners )
+{
+    uint64_t start = monotonicNs();
+
+    // weld: sort the corners by position, and number the positions
+    vector<uint32_t> order( corners );
+    for( int i = 0; i < corners; i++ ) {
+        order[i] = i;
+    }
+    sort( order.begin(), order.end(), [&]( uint32_t a, uint32_t b ) {
+        const float *p = &points[(size_t) stride * a];
+        const float *q = &points[(size_t) stride * b];
+        if( p[0] != q[0] ) return p[0] < q[0];
+        if( p[1] != q[1] ) return p[1] < q[1];
+        return p[2] < q[2];
+    } );
+    vertex.resize( corners );
+    position.clear();
+    vertices = 0;
+    for( int i = 0; i < corners; i++ ) {
+        const float *p = &points[(size_t) stride * order[i]];
+        if( i == 0 || memcmp( p, &points[(size_t) stride * order[i - 1]],
+                              3 * sizeof(float) ) != 0 ) {
+            position.push_back( p[0] );
+            position.push_back( p[1] );
+            position.push_back( p[2] );
+            vertices++;
+        }
+        vertex[order[i]] = vertices - 1;
+    }
+
+    int faces = corners / 3;
+    dead.assign( faces, false );
+    around.assign( vertices, vector<uint32_t>() );
+    quadric.assign( QUADRIC * (size_t) vertices, 0.0 );
+    stamp.assign( vertices, 0 );
+    removed.assign( vertices, false );
+    error = 0.0;
+    history.clear();
+    deadTriangles.clear();
+    movedCorners.clear();
+
+    // every triangle's plane goes to its corners; triangles with two
+    // corners welded together are dropped now
+    triangles = 0;
+    vector<uint64_t> edges;
+    for( int t = 0; t < faces; t++ ) {
+        uint32_t *v = &vertex[3 * t];
+        if( v[0] == v[1] || v[1] == v[2] || v[2] == v[0] ) {
+            dead[t] = true;
+            continue;
+        }
+        triangles++;
+
+        double n[3];
+        triangleNormal( &position[3 * v[0]], &position[3 * v[1]],
+                        &position[3 * v[2]], n );
+        double length = sqrt( n[0] * n[0] + n[1] * n[1] + n[2] * n[2] );
+        if( length > 0.0 ) {
+            double plane[4] = { n[0] / length, n[1] / length, n[2] / length, 0.0 };
+            const double *p = &position[3 * v[0]];
+            plane[3] = -(plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2]);
+            for( int k = 0; k < 3; k++ ) {
+                addPlane( v[k], plane, 1.0 );
+            }
+        }
+        for( int k = 0; k < 3; k++ ) {
+            around[v[k]].push_back( t );
+            uint32_t a = v[k], b = v[(k + 1) % 3];
+            edges.push_back( (uint64_t) min( a, b ) << 32 | max( a, b ) );
+        }
+    }
+
+    // an edge with one triangle is open: add a plane standing on it,
+    // square to the triangle, so the outline stays where it is
+    vector<uint64_t> sorted( edges );
+    sort( sorted.begin(), sorted.end() );
+    for( int t = 0; t < faces; t++ ) {
+        if( dead[t] ) {
+            continue;
+        }
+        const uint32_t *v = &vertex[3 * t];
+        double n[3];
+        triangleNormal( &position[3 * v[0]], &position[3 * v[1]],
+                        &position[3 * v[2]], n );
+        for( int k = 0; k < 3; k++ ) {
+            uint32_t a = v[k], b = v[(k + 1) % 3];
+            uint64_t key = (uint64_t) min( a, b ) << 32 | max( a, b );
+            pair<vector<uint64_t>::iterator, vector<uint64_t>::iterator> run =
+                equal_range( sorted.begin(), sorted.end(), key );
+            if( run.second - run.first != 1 ) {
+                continue;
+            }
+            const double *p = &position[3 * a], *q = &position[3 * b];
+            double e[3] = { q[0] - p[0], q[1] - p[1], q[2] - p[2] };
+            double s[3] = { e[1] * n[2] - e[2] * n[1], e[2] * n[0] - e[0] * n[2],
+                            e[0] * n[1] - e[1] * n[0] };
+            double length = sqrt( s[0] * s[0] + s[1] * s[1] + s[2] * s[2] );
+            if( length > 0.0 ) {
+                double plane[4] = { s[0] / length, s[1] / length,
+                                    s[2] / length, 0.0 };
+                plane[3] = -(plane[0] * p[0] + plane[1] * p[1] + plane[2] * p[2]);
+                addPlane( a, plane, 1.0 );
+                addPlane( b, plane, 1.0 );
+            }
+        }
+    }
+
+    // every edge once
+    sorted.erase( unique( sorted.begin(), sorted.end() ), sorted.end() );
+    heap.clear();
+    for( size_t i = 0; i < sorted.size(); i++ ) {
+        Collapse C;
+        evaluate( sorted[i] >> 32, (uint32_t) sorted[i], C );
+        heap.push_back( C );
+    }
+    make_heap( heap.begin(), heap.end(), greater<Collapse>() );
+
+    simplifyMs = elapsedMs( start );
+}
+
+///
+// evaluate(u,v,C) - the cheapest place for u and v to go, and its cost
+///
+void MeshSimplifier::evaluate( uint32_t u, uint32_t v, Collapse &C ) const
+{
+    double q[QUADRIC];
+    for( int i = 0; i < QUADRIC; i++ ) {
+        q[i] = quadric[QUADRIC * (size_t) u + i] + quadric[QUADRIC * (size_t) v + i];
+    }
+    const double *a = &position[3 * u], *b = &position[3 * v];
+
+    C.u = u;
+    C.v = v;
+    C.stampU = stamp[u];
+    C.stampV = stamp[v];
+
+    // the ends and the middle
+    double middle[3] = { 0.5 * (a[0] + b[0]), 0.5 * (a[1] + b[1]),
+                         0.5 * (a[2] + b[2]) };
+    const double *choices[3] = { a, b, middle };
+    C.cost = HUGE_VAL;
+    for( int i = 0; i < 3; i++ ) {
+        double cost = quadricError( q, choices[i] );
+        if( cost < C.cost ) {
+            C.cost = cost;
+            C.target[0] = choices[i][0];
+            C.target[1] = choices[i][1];
+            C.target[2] = choices[i][2];
+        }
+    }
+
+    // the minimum, where the gradient is zero, if it is well defined
+    // and not far off the edge
+    double m[3][3] = { { q[0], q[1], q[2] }, { q[1], q[4], q[5] },
+                       { q[2], q[5], q[7] } };
+    double det = m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+                 m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+                 m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    double trace = m[0][0] + m[1][1] + m[2][2];
+    if( fabs( det ) > 1.0e-9 * trace * trace * trace ) {
+        double r[3] = { -q[3], -q[6], -q[8] }, p[3];
+        for( int k = 0; k < 3; k++ ) {
+            // Cramer's rule: column k replaced by r
+            double c[3][3];
+            for( int i = 0; i < 3; i++ ) {
+                for( int j = 0; j < 3; j++ ) {
+                    c[i][j] = j == k ? r[i] : m[i][j];
+                }
+            }
+            p[k] = (c[0][0] * (c[1][1] * c[2][2] - c[1][2] * c[2][1]) -
+                    c[0][1] * (c[1][0] * c[2][2] - c[1][2] * c[2][0]) +
+                    c[0][2] * (c[1][0] * c[2][1] - c[1][1] * c[2][0])) / det;
+        }
+        double edge2 = (b[0] - a[0]) * (b[0] - a[0]) +
+                       (b[1] - a[1]) * (b[1] - a[1]) +
+                       (b[2] - a[2]) * (b[2] - a[2]);
+        double off2 = (p[0] - middle[0]) * (p[0] - middle[0]) +
+                      (p[1] - middle[1]) * (p[1] - middle[1]) +
+                      (p[2] - middle[2]) * (p[2] - middle[2]);
+        double cost = quadricError( q, p );
+        if( off2 <= edge2 && cost < C.cost ) {
+            C.cost = cost;
+            C.target[0] = p[0];
+            C.target[1] = p[1];
+            C.target[2] = p[2];
+        }
+    }
+    C.cost = max( C.cost, 0.0 );
+}
+
+///
+// push(u,v) - queue the collapse of edge u-v
+///
+void MeshSimplifier::push( uint32_t u, uint32_t v )
+{
+    Collapse C;
+    evaluate( u, v, C );
+    heap.push_back( C );
+    push_heap( heap.begin(), heap.end(), greater<Collapse>() );
+}
+
+// the vertices that share a triangle with v, sorted, v left out
+static void neighbors( const vector<uint32_t> &vertex,
+                       const vector<bool> &dead,
+                       const vector<uint32_t> &tris, uint32_t v,
+                       vector<uint32_t> &out )
+{
+    out.clear();
+    for( size_t i = 0; i < tris.size(); i++ ) {
+        if( dead[tris[i]] ) {
+            continue;
+        }
+        for( int k = 0; k < 3; k++ ) {
+            uint32_t w = vertex[3 * tris[i] + k];
+            if( w != v ) {
+                out.push_back( w );
+            }
+        }
+    }
+    sort( out.begin(), out.end() );
+    out.erase( unique( out.begin(), out.end() ), out.end() );
+}
+
+///
+// allowed(C) - may this collapse be made without folding the surface
+// over or joining two sheets?
+///
+bool MeshSimplifier::allowed( const Collapse &C ) const
+{
+    // the vertices next to both u and v must be those of the triangles
+    // on the edge, or the collapse pinches the surface
+    vector<uint32_t> nu, nv, common;
+    neighbors( vertex, dead, around[C.u], C.u, nu );
+    neighbors( vertex, dead, around[C.v], C.v, nv );
+    set_intersection( nu.begin(), nu.end(), nv.begin(), nv.end(),
+                      back_inserter( common ) );
+    int shared = 0;
+    for( size_t i = 0; i < around[C.u].size(); i++ ) {
+        uint32_t t = around[C.u][i];
+        const uint32_t *v = &vertex[3 * t];
+        shared += !dead[t] && (v[0] == C.v || v[1] == C.v || v[2] == C.v);
+    }
+    if( (int) common.size() != shared ) {
+        return false;
+    }
+
+    // no triangle that stays may turn over
+    for( int side = 0; side < 2; side++ ) {
+        uint32_t moved = side == 0 ? C.u : C.v, other = side == 0 ? C.v : C.u;
+        const vector<uint32_t> &tris = around[moved];
+        for( size_t i = 0; i < tris.size(); i++ ) {
+            uint32_t t = tris[i];
+            const uint32_t *v = &vertex[3 * t];
+            if( dead[t] || v[0] == other || v[1] == other || v[2] == other ) {
+                continue;
+            }
+            const double *p[3];
+            for( int k = 0; k < 3; k++ ) {
+                p[k] = &position[3 * v[k]];
+            }
+            double before[3], after[3];
+            triangleNormal( p[0], p[1], p[2], before );
+            for( int k = 0; k < 3; k++ ) {
+                if( v[k] == moved ) {
+                    p[k] = C.target;
+                }
+            }
+            triangleNormal( p[0], p[1], p[2], after );
+            double b2 = before[0] * before[0] + before[1] * before[1] +
+                        before[2] * before[2];
+            double a2 = after[0] * after[0] + after[1] * after[1] +
+                        after[2] * after[2];
+            double d = before[0] * after[0] + before[1] * after[1] +
+                       before[2] * after[2];
+            if( !(a2 > 0.0) || d < FLIP_COSINE * sqrt( a2 * b2 ) ) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+///
+// collapse(C) - move u to the target and fold v into it
+///
+void MeshSimplifier::collapse( const Collapse &C )
+{
+    uint32_t u = C.u, v = C.v;
+    Record R;
+    if( recordHistory ) {
+        R.u = u;
+        R.v = v;
+        for( int k = 0; k < 3; k++ ) {
+            R.from[k] = (float) position[3 * u + k];
+            R.at[k] = (float) position[3 * v + k];
+        }
+        R.firstDead = deadTriangles.size();
+        R.firstMoved = movedCorners.size();
+    }
+    for( int k = 0; k < 3; k++ ) {
+        position[3 * u + k] = C.target[k];
+    }
+    for( int i = 0; i < QUADRIC; i++ ) {
+        quadric[QUADRIC * (size_t) u + i] += quadric[QUADRIC * (size_t) v + i];
+    }
+    removed[v] = true;
+    stamp[u]++;
+    error = max( error, sqrt( C.cost ) );
+
+    // the triangles on the edge go; v's others are now u's
+    vector<uint32_t> &mine = around[u];
+    for( size_t i = 0; i < around[v].size(); i++ ) {
+        uint32_t t = around[v][i];
+        if( dead[t] ) {
+            continue;
+        }
+        uint32_t *w = &vertex[3 * t];
+        if( w[0] == u || w[1] == u || w[2] == u ) {
+            dead[t] = true;
+            triangles--;
+            if( recordHistory ) {
+                deadTriangles.push_back( t );
+            }
+            continue;
+        }
+        for( int k = 0; k < 3; k++ ) {
+            if( w[k] == v ) {
+                w[k] = u;
+                if( recordHistory ) {
+                    movedCorners.push_back( 3 * t + k );
+                }
+            }
+        }
+        mine.push_back( t );
+    }
+    if( recordHistory ) {
+        R.dead = deadTriangles.size() - R.firstDead;
+        R.moved = movedCorners.size() - R.firstMoved;
+        history.push_back( R );
+    }
+    vector<uint32_t>().swap( around[v] );
+    size_t kept = 0;
+    for( size_t i = 0; i < mine.size(); i++ ) {
+        if( !dead[mine[i]] ) {
+            mine[kept++] = mine[i];
+        }
+    }
+    mine.resize( kept );
+
+    // u has moved, so all its edges cost something new
+    vector<uint32_t> ring;
+    neighbors( vertex, dead, mine, u, ring );
+    for( size_t i = 0; i < ring.size(); i++ ) {
+        push( u, ring[i] );
+    }
+}
+
+///
+// simplify(target,maxError) - collapse edges down to 'target' triangles
+///
+int MeshSimplifier::simplify( int target, double maxError )
+{
+    uint64_t start = monotonicNs();
+    while( triangles > target && !heap.empty() &&
+           heap.front().cost <= maxError * maxError ) {
+        pop_heap( heap.begin(), heap.end(), greater<Collapse>() );
+        Collapse C = heap.back();
+        heap.pop_back();
+        if( removed[C.u] || removed[C.v] || stamp[C.u] != C.stampU ||
+            stamp[C.v] != C.stampV || !allowed( C ) ) {
+            continue;
+        }
+        collapse( C );
+    }
+    simplifyMs += elapsedMs( start );
+    return triangles;
+}
+
+///
+// result(corners,positions) - the triangles that are left
+///
+void MeshSimplifier::result( vector<uint32_t> &corners,
+                             vector<float> &positions ) const
+{
+    corners.clear();
+    positions.clear();
+    for( size_t t = 0; t < dead.size(); t++ ) {
+        if( dead[t] ) {
+            continue;
+        }
+        for( int k = 0; k < 3; k++ ) {
+            const double *p = &position[3 * vertex[3 * t + k]];
+            corners.push_back( 3 * t + k );
+            positions.push_back( (float) p[0] );
+            positions.push_back( (float) p[1] );
+            positions.push_back( (float) p[2] );
+        }
+    }
+}
@@ -0,0 +1,139 @@
+//
+//  Simplify.h
+//
+//  Mesh simplification by edge collapse with quadric error metrics
+//  (Garland and Heckbert, "Surface Simplification Using Quadric Error
+//  Metrics", SIGGRAPH 1997), for the levels of detail in Lod.h.
+//
+//  The input is a triangle soup, as the BufferSets hold it: corners at
+//  the same position are welded into one vertex first.  Every vertex
+//  keeps a quadric, the sum of the squared distances to the planes of
+//  the triangles around it (and, along open edges, to planes standing
+//  on them, so holes do not grow).  Collapsing an edge moves its two
+//  vertices to the point that minimizes their summed quadric, and the
+//  edges are collapsed cheapest first from a heap whose stale entries
+//  are told apart by a per-vertex stamp.  A collapse that would flip a
+//  triangle, or join two sheets at a vertex, is refused.
+//
+//  Triangles remember which input corner each of their corners came
+//  from, so the caller can carry normals, texture coordinates and
+//  occlusion over unchanged.  simplify() may be called again with a
+//  smaller target to go on from where it stopped, which makes a whole
+//  chain of levels cost little more than the coarsest one alone.
+//
+//  With 'recordHistory' set, every collapse is logged, with what it
+//  takes to undo it: the progressive meshes of Progressive.h are the
+//  log read backwards.
+//
+
+#ifndef _SIMPLIFY_H_
+#define _SIMPLIFY_H_
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+class MeshSimplifier {
+
+public:
+    // welded vertices, and triangles left after the last simplify()
+    int vertices, triangles;
+
+    // the square root of the largest quadric error of any collapse so
+    // far: roughly how far, in model units, the surface has moved
+    double error;
+
+    // time taken by load() and all simplify() calls
+    double simplifyMs;
+
+    // one collapse: v folded into u, u moved 'from' its old position,
+    // v 'at' its own; the triangles it removed, and the corners (3t+k)
+    // that it turned from v to u, are deadTriangles[firstDead ..] and
+    // movedCorners[firstMoved ..]
+    struct Record {
+        uint32_t u, v;
+        float from[3], at[3];
+        uint32_t firstDead, dead;
+        uint32_t firstMoved, moved;
+    };
+
+    // the log of collapses, kept if 'recordHistory' is set before load()
+    bool recordHistory;
+    vector<Record> history;
+    vector<uint32_t> deadTriangles, movedCorners;
+
+private:
+    // per vertex: position, quadric (upper triangle of a symmetric
+    // 4x4, row by row), stamp, and the triangles that use it
+    vector<double> position, quadric;
+    vector<uint32_t> stamp;
+    vector< vector<uint32_t> > around;
+    vector<bool> removed;
+
+    // per triangle (in input order, so corner k of triangle t came
+    // from input corner 3t+k): its three vertices
+    vector<uint32_t> vertex;
+    vector<bool> dead;
+
+    // a candidate collapse of v into u, to 'target'
+    struct Collapse {
+        double cost;
+        uint32_t u, v, stampU, stampV;
+        double target[3];
+        bool operator>( const Collapse &C ) const { return cost > C.cost; }
+    };
+    vector<Collapse> heap;
+
+    void addPlane( uint32_t v, const double *plane, double weight );
+    void evaluate( uint32_t u, uint32_t v, Collapse &C ) const;
+    void push( uint32_t u, uint32_t v );
+    bool allowed( const Collapse &C ) const;
+    void collapse( const Collapse &C );
+
+public:
+
+    ///
+    // Constructor
+    ///
+    MeshSimplifier( void );
+
+    ///
+    // load(points,stride,corners) - start from a triangle soup
+    //
+    // @param points  - the first corner's X; Y and Z follow it
+    // @param stride  - floats from one corner to the next (4 for XYZW)
+    // @param corners - number of corners, three per triangle
+    ///
+    void load( const float *points, int stride, int corners );
+
+    ///
+    // simplify(target,maxError) - collapse edges until no more than
+    //     'target' triangles are left, or no edge can go without moving
+    //     the surface more than 'maxError'
+    //
+    // @return the number of triangles left
+    ///
+    int simplify( int target, double maxError );
+
+    ///
+    // the mesh as it stands: the input triangles, which of them are
+    // left and their (welded) vertices, and where those are now
+    ///
+    int inputTriangles( void ) const { return (int) dead.size(); }
+    bool triangleLeft( uint32_t t ) const { return !dead[t]; }
+    const uint32_t *triangleVertices( uint32_t t ) const { return &vertex[3 * t]; }
+    bool vertexLeft( uint32_t v ) const { return !removed[v]; }
+    const double *vertexPosition( uint32_t v ) const { return &position[3 * v]; }
+
+    ///
+    // result(corners,positions) - the triangles that are left
+    //
+    // @param corners   - receives the input corner each corner came from
+    // @param positions - receives x, y, z of each corner
+    ///
+    void result( vector<uint32_t> &corners, vector<float> &positions ) const;
+
+};
+
+#endif
@@ -0,0 +1,254 @@
+//
+//  Texture.cpp
+//
+//  Mipmapped RGBA texture implementation.
+//
+
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+#include <SOIL.h>
+
+#include "Texture.h"
+
+using namespace std;
+
+///
+// Constructor
+///
+Texture::Texture( void ) :
+    levels(0)
+{
+    memset( width, 0, sizeof(width) );
+    memset( height, 0, sizeof(height) );
+    memset( offset, 0, sizeof(offset) );
+}
+
+// smallest power of two >= n
+static int powerOfTwo( int n )
+{
+    int p = 1;
+    while( p < n ) {
+        p *= 2;
+    }
+    return p;
+}
+
+///
+// load(path) - read and prepare an image file
+///
+bool Texture::load( const char *path )
+{
+    int w, h, channels;
+    unsigned char *img = SOIL_load_image( path, &w, &h, &channels,
+                                          SOIL_LOAD_RGBA );
+    if( img == NULL ) {
+        cerr << "Texture: cannot load " << path << endl;
+        return false;
+    }
+
+    // SOIL_FLAG_INVERT_Y
+    vector<unsigned char> base( (size_t) w * h * 4 );
+    for( int y = 0; y < h; y++ ) {
+        memcpy( &base[(size_t) y * w * 4], img + (size_t) (h - 1 - y) * w * 4,
+                w * 4 );
+    }
+    SOIL_free_image_data( img );
+
+    // SOIL stretches mipmapped images to power-of-two sides with this
+    // bilinear filter (its up_scale_image())
+    int pw = powerOfTwo( w ), ph = powerOfTwo( h );
+    if( pw != w || ph != h ) {
+        vector<unsigned char> big( (size_t) pw * ph * 4 );
+        float dx = (w - 1.0f) / (pw - 1.0f);
+        float dy = (h - 1.0f) / (ph - 1.0f);
+        for( int y = 0; y < ph; y++ ) {
+            float sy = y * dy;
+            int iy = (int) sy;
+            if( iy > h - 2 ) {
+                iy = h - 2;
+            }
+            sy -= iy;
+            for( int x = 0; x < pw; x++ ) {
+                float sx = x * dx;
+                int ix = (int) sx;
+                if( ix > w - 2 ) {
+                    ix = w - 2;
+                }
+                sx -= ix;
+                const unsigned char *p = &base[((size_t) iy * w + ix) * 4];
+                for( int c = 0; c < 4; c++, p++ ) {
+                    float value = 0.5f;
+                    value += p[0] * (1.0f - sx) * (1.0f - sy);
+                    value += p[4] * sx * (1.0f - sy);
+                    value += p[w * 4] * (1.0f - sx) * sy;
+                    value += p[w * 4 + 4] * sx * sy;
+                    big[((size_t) y * pw + x) * 4 + c] = (unsigned char) value;
+                }
+            }
+        }
+        base.swap( big );
+        w = pw;
+        h = ph;
+    }
+
+    // level L averages 2^L x 2^L blocks of level 0, rounding, as
+    // SOIL's mipmap_image() does
+    texels.clear();
+    levels = 0;
+    for( int L = 0; L < TEXTURE_MAX_LEVELS; L++ ) {
+        int block = 1 << L;
+        if( L > 0 && block > w && block > h ) {
+            break;
+        }
+        int lw = w / block > 0 ? w / block : 1;
+        int lh = h / block > 0 ? h / block : 1;
+        int bw = block < w ? block : w;
+        int bh = block < h ? block : h;
+        int area = bw * bh;
+
+        width[L] = lw;
+        height[L] = lh;
+        offset[L] = texels.size();
+        levels = L + 1;
+
+        for( int y = 0; y < lh; y++ ) {
+            for( int x = 0; x < lw; x++ ) {
+                uint32_t texel = 0;
+                for( int c = 0; c < 4; c++ ) {
+                    int sum = area >> 1;
+                    for( int v = 0; v < bh; v++ ) {
+                        const unsigned char *p =
+                            &base[(((size_t) y * block + v) * w +
+                                   (size_t) x * block) * 4 + c];
+                        for( int u = 0; u < bw; u++ ) {
+                            sum += p[u * 4];
+                        }
+                    }
+                    texel |= (uint32_t) (sum / area) << (8 * c);
+                }
+                texels.push_back( texel );
+            }
+        }
+    }
+
+    return true;
+}
+
+///
+// lod(...) - level of detail for a texel footprint
+///
+float Texture::lod( float dudx, float dvdx, float dudy, float dvdy ) const
+{
+    float w = width[0], h = height[0];
+    float x = dudx * dudx * w * w + dvdx * dvdx * h * h;
+    float y = dudy * dudy * w * w + dvdy * dvdy * h * h;
+
+    return 0.5f * log2f( x > y ? x : y );
+}
+
+SimdFloat Texture::lod( SimdFloat dudx, SimdFloat dvdx,
+                        SimdFloat dudy, SimdFloat dvdy ) const
+{
+    SimdFloat w2( (float) width[0] * width[0] );
+    SimdFloat h2( (float) height[0] * height[0] );
+    SimdFloat x = fmadd( dudx * dudx, w2, dvdx * dvdx * h2 );
+    SimdFloat y = fmadd( dudy * dudy, w2, dvdy * dvdy * h2 );
+
+    return SimdFloat( 0.5f ) * log2( max( max( x, y ), SimdFloat( 1e-30f ) ) );
+}
+
+///
+// bilinear(L,u,v,rgba) - GL_LINEAR filtering within level L, repeating
+///
+static void bilinear( const Texture &T, int L, float u, float v, float *rgba )
+{
+    int w = T.width[L], h = T.height[L];
+    float s = u * w - 0.5f, t = v * h - 0.5f;
+    float fs = floorf( s ), ft = floorf( t );
+    float a = s - fs, b = t - ft;
+    int x0 = (int) fs & (w - 1), x1 = (x0 + 1) & (w - 1);
+    int y0 = (int) ft & (h - 1), y1 = (y0 + 1) & (h - 1);
+    const uint32_t *p = &T.texels[T.offset[L]];
+    uint32_t c00 = p[y0 * w + x0], c10 = p[y0 * w + x1];
+    uint32_t c01 = p[y1 * w + x0], c11 = p[y1 * w + x1];
+
+    for( int c = 0; c < 4; c++ ) {
+        int k = 8 * c;
+        float bottom = ((c00 >> k) & 0xff) * (1.0f - a) + ((c10 >> k) & 0xff) * a;
+        float top = ((c01 >> k) & 0xff) * (1.0f - a) + ((c11 >> k) & 0xff) * a;
+        rgba[c] = (bottom * (1.0f - b) + top * b) / 255.0f;
+    }
+}
+
+static void bilinear( const Texture &T, SimdInt L, SimdFloat u, SimdFloat v,
+                      SimdFloat *rgba )
+{
+    SimdInt w = gather( T.width, L ), h = gather( T.height, L );
+    SimdFloat s = fmadd( u, toFloat( w ), SimdFloat( -0.5f ) );
+    SimdFloat t = fmadd( v, toFloat( h ), SimdFloat( -0.5f ) );
+    SimdFloat fs = floor( s ), ft = floor( t );
+    SimdFloat a = s - fs, b = t - ft;
+    SimdInt wm = w - SimdInt( 1 ), hm = h - SimdInt( 1 );
+    SimdInt x0 = toInt( fs ) & wm, x1 = (x0 + SimdInt( 1 )) & wm;
+    SimdInt y0 = toInt( ft ) & hm, y1 = (y0 + SimdInt( 1 )) & hm;
+    SimdInt row0 = gather( T.offset, L ) + y0 * w;
+    SimdInt row1 = gather( T.offset, L ) + y1 * w;
+    const int32_t *p = (const int32_t *) T.texels.data();
+    SimdInt c00 = gather( p, row0 + x0 ), c10 = gather( p, row0 + x1 );
+    SimdInt c01 = gather( p, row1 + x0 ), c11 = gather( p, row1 + x1 );
+    SimdInt byte( 0xff );
+
+    for( int c = 0; c < 4; c++ ) {
+        int k = 8 * c;
+        SimdFloat f00 = toFloat( (c00 >> k) & byte );
+        SimdFloat f10 = toFloat( (c10 >> k) & byte );
+        SimdFloat f01 = toFloat( (c01 >> k) & byte );
+        SimdFloat f11 = toFloat( (c11 >> k) & byte );
+        SimdFloat bottom = fmadd( a, f10 - f00, f00 );
+        SimdFloat top = fmadd( a, f11 - f01, f01 );
+        rgba[c] = fmadd( b, top - bottom, bottom ) * SimdFloat( 1.0f / 255.0f );
+    }
+}
+
+///
+// sample(u,v,lod,rgba) - GL_LINEAR_MIPMAP_LINEAR filtering; a lod of
+//     zero or less is magnification, which uses level 0 alone
+///
+void Texture::sample( float u, float v, float lod, float *rgba ) const
+{
+    float top = levels - 1;
+    float lam = lod < 0.0f ? 0.0f : (lod > top ? top : lod);
+    int L0 = (int) lam;
+    int L1 = L0 < levels - 1 ? L0 + 1 : L0;
+    float f = lam - L0;
+
+    bilinear( *this, L0, u, v, rgba );
+    if( f > 0.0f ) {
+        float upper[4];
+        bilinear( *this, L1, u, v, upper );
+        for( int c = 0; c < 4; c++ ) {
+            rgba[c] += f * (upper[c] - rgba[c]);
+        }
+    }
+}
+
+void Texture::sample( SimdFloat u, SimdFloat v, SimdFloat lod,
+                      SimdFloat *rgba ) const
+{
+    SimdFloat lam = clamp( lod, 0.0f, levels - 1.0f );
+    SimdFloat fl = floor( lam );
+    SimdInt L0 = toInt( fl );
+    SimdInt L1 = min( L0 + SimdInt( 1 ), SimdInt( levels - 1 ) );
+    SimdFloat f = lam - fl;
+
+    bilinear( *this, L0, u, v, rgba );
+    if( any( f > SimdFloat( 0.0f ) ) ) {
+        SimdFloat upper[4];
+        bilinear( *this, L1, u, v, upper );
+        for( int c = 0; c < 4; c++ ) {
+            rgba[c] = fmadd( f, upper[c] - rgba[c], rgba[c] );
+        }
+    }
+}
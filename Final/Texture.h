@@ -0,0 +1,68 @@
+//
+//  Texture.h
+//
+//  A mipmapped RGBA texture in memory, for the CPU renderers.
+//
+//  load() prepares an image file the way Lighting.cpp's call to
+//  SOIL_load_OGL_texture() does (SOIL_FLAG_MIPMAPS | SOIL_FLAG_INVERT_Y
+//  | SOIL_FLAG_TEXTURE_REPEATS): flipped, stretched to power-of-two
+//  sides and box-filtered down to 1x1.  The sample() functions then
+//  filter like GL_LINEAR_MIPMAP_LINEAR with GL_REPEAT wrapping.
+//
+
+#ifndef _TEXTURE_H_
+#define _TEXTURE_H_
+
+#include <stdint.h>
+#include <vector>
+
+#include "Simd.h"
+
+using namespace std;
+
+#define TEXTURE_MAX_LEVELS  16
+
+class Texture {
+
+public:
+    // every level, largest first; one RGBA texel per word with red in
+    // the low byte, rows bottom first
+    vector<uint32_t> texels;
+
+    int levels;
+    int32_t width[TEXTURE_MAX_LEVELS];
+    int32_t height[TEXTURE_MAX_LEVELS];
+    int32_t offset[TEXTURE_MAX_LEVELS];    // of each level in 'texels'
+
+public:
+
+    ///
+    // Constructor
+    ///
+    Texture( void );
+
+    ///
+    // load(path) - read and prepare an image file
+    //
+    // @return true on success
+    ///
+    bool load( const char *path );
+
+    ///
+    // lod(dudx,dvdx,dudy,dvdy) - the level of detail (log2 of the texel
+    //     footprint) for texture coordinate derivatives along x and y
+    ///
+    float lod( float dudx, float dvdx, float dudy, float dvdy ) const;
+    SimdFloat lod( SimdFloat dudx, SimdFloat dvdx,
+                   SimdFloat dudy, SimdFloat dvdy ) const;
+
+    ///
+    // sample(u,v,lod,rgba) - filtered color at (u,v), components 0..1
+    ///
+    void sample( float u, float v, float lod, float *rgba ) const;
+    void sample( SimdFloat u, SimdFloat v, SimdFloat lod,
+                 SimdFloat *rgba ) const;
+
+};
+
+#endif
@@ -0,0 +1,128 @@
+//
+//  ThreadPool.cpp
+//
+//  Worker threads for the CPU renderers.
+//
+
+#include "ThreadPool.h"
+
+///
+// Constructor
+///
+ThreadPool::ThreadPool( int size ) :
+    job(NULL), jobItems(0), nextItem(0), busy(0), generation(0),
+    stopping(false)
+{
+    if( size < 1 ) {
+        size = thread::hardware_concurrency();
+        if( size < 1 ) {
+            size = 1;
+        }
+    }
+
+    for( int i = 1; i < size; i++ ) {
+        threads.push_back( thread( &ThreadPool::work, this, i ) );
+    }
+}
+
+///
+// Destructor
+///
+ThreadPool::~ThreadPool( void )
+{
+    {
+        unique_lock<mutex> guard( lock );
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for( size_t i = 0; i < threads.size(); i++ ) {
+        threads[i].join();
+    }
+}
+
+///
+// size() - number of workers
+///
+int ThreadPool::size( void ) const
+{
+    return threads.size() + 1;
+}
+
+///
+// runItems(worker) - take items of the current loop until none are left
+///
+void ThreadPool::runItems( int worker )
+{
+    for( ;; ) {
+        int item = nextItem.fetch_add( 1 );
+        if( item >= jobItems ) {
+            break;
+        }
+        (*job)( item, worker );
+    }
+}
+
+///
+// work(worker) - body of each extra thread
+///
+void ThreadPool::work( int worker )
+{
+    unsigned seen = 0;
+
+    for( ;; ) {
+        {
+            unique_lock<mutex> guard( lock );
+            while( !stopping && generation == seen ) {
+                wake.wait( guard );
+            }
+            if( stopping ) {
+                return;
+            }
+            seen = generation;
+        }
+
+        runItems( worker );
+
+        unique_lock<mutex> guard( lock );
+        if( --busy == 0 ) {
+            idle.notify_one();
+        }
+    }
+}
+
+///
+// parallelFor(items,fn) - run a loop on every worker
+///
+void ThreadPool::parallelFor( int items, const function<void( int, int )> &fn )
+{
+    if( items <= 0 ) {
+        return;
+    }
+
+    // not worth waking anyone
+    if( threads.empty() || items == 1 ) {
+        for( int i = 0; i < items; i++ ) {
+            fn( i, 0 );
+        }
+        return;
+    }
+
+    {
+        unique_lock<mutex> guard( lock );
+        job = &fn;
+        jobItems = items;
+        nextItem = 0;
+        busy = threads.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    runItems( 0 );
+
+    unique_lock<mutex> guard( lock );
+    while( busy > 0 ) {
+        idle.wait( guard );
+    }
+    job = NULL;
+}
@@ -0,0 +1,78 @@
+//
+//  ThreadPool.h
+//
+//  A fixed set of worker threads for the CPU renderers.
+//
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+///
+// Runs parallel loops on a fixed set of threads.  The thread that
+// calls parallelFor() takes part as worker 0, so a pool of size 1 has
+// no extra threads at all.
+///
+
+class ThreadPool {
+
+    vector<thread> threads;
+
+    mutex lock;
+    condition_variable wake, idle;
+
+    // the loop being run
+    const function<void( int, int )> *job;
+    int jobItems;
+    atomic<int> nextItem;
+
+    // workers still inside the current loop
+    int busy;
+
+    // bumped for every loop, so sleeping workers see new work
+    unsigned generation;
+    bool stopping;
+
+    void work( int worker );
+    void runItems( int worker );
+
+public:
+
+    ///
+    // Constructor
+    //
+    // @param size - number of workers, including the calling thread;
+    //               0 for one per hardware thread
+    ///
+    ThreadPool( int size = 0 );
+
+    ///
+    // Destructor - stops and joins the workers
+    ///
+    ~ThreadPool( void );
+
+    ///
+    // size() - number of workers, including the calling thread
+    ///
+    int size( void ) const;
+
+    ///
+    // parallelFor(items,fn) - call fn(item,worker) for every item in
+    //     0 .. items-1 and return when all calls have finished.  Items
+    //     are handed out one at a time, in order; 'worker' is in
+    //     0 .. size()-1 and no two concurrent calls share it, so it can
+    //     index per-worker scratch space.
+    ///
+    void parallelFor( int items, const function<void( int, int )> &fn );
+
+};
+
+#endif
@@ -0,0 +1,46 @@
+//
+//  Timing.h
+//
+//  Small timing helpers shared by the benchmarks and services.
+//
+//  This code can be compiled as either C or C++.
+//
+
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+///
+// monotonicNs() - CLOCK_MONOTONIC time in nanoseconds; comparable
+//     between processes on the same machine
+///
+static inline uint64_t monotonicNs( void )
+{
+    struct timespec ts;
+    clock_gettime( CLOCK_MONOTONIC, &ts );
+    return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+///
+// elapsedMs(startNs) - milliseconds since 'startNs'
+///
+static inline double elapsedMs( uint64_t startNs )
+{
+    return (monotonicNs() - startNs) / 1.0e6;
+}
+
+///
+// percentile(v,n,p) - the p-th percentile (0..1) of 'n' sorted values
+///
+static inline double percentile( const double *v, size_t n, double p )
+{
+    if( n == 0 ) {
+        return 0.0;
+    }
+    return v[ (size_t) (p * (n - 1) + 0.5) ];
+}
+
+#endif
@@ -0,0 +1,203 @@
+//
+//  Transform.cpp
+//
+//  Batched vertex transform implementation.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+#include "Transform.h"
+
+using namespace std;
+
+// count rounded up to whole SIMD_WIDTH vectors
+static inline int padded( int count )
+{
+    return (count + SIMD_WIDTH - 1) / SIMD_WIDTH * SIMD_WIDTH;
+}
+
+static inline void emptyBounds( Bounds &B )
+{
+    for( int k = 0; k < 3; k++ ) {
+        B.lo[k] = FLT_MAX;
+        B.hi[k] = -FLT_MAX;
+        B.center[k] = 0.0f;
+    }
+    B.radius = 0.0f;
+}
+
+///
+// transformRange(M,P,first,last,out,B) - transform positions first ..
+//     last-1 (whole vectors) and grow B around them; B.center must be
+//     set, and B.radius grows as the squared radius
+///
+static void transformRange( const float *M, const PositionArrays &P,
+                            int first, int last, PositionArrays *out,
+                            Bounds &B )
+{
+    SimdFloat m[12];
+    for( int c = 0; c < 4; c++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            m[3 * c + k] = SimdFloat( M[4 * c + k] );
+        }
+    }
+    SimdFloat cx( B.center[0] ), cy( B.center[1] ), cz( B.center[2] );
+
+    SimdFloat lo[3], hi[3], r2( B.radius );
+    for( int k = 0; k < 3; k++ ) {
+        lo[k] = SimdFloat( B.lo[k] );
+        hi[k] = SimdFloat( B.hi[k] );
+    }
+
+    for( int i = first; i < last; i += SIMD_WIDTH ) {
+        SimdFloat x = loadFloat( &P.x[i] );
+        SimdFloat y = loadFloat( &P.y[i] );
+        SimdFloat z = loadFloat( &P.z[i] );
+
+        SimdFloat t[3];
+        for( int k = 0; k < 3; k++ ) {
+            t[k] = fmadd( m[k], x, fmadd( m[3 + k], y,
+                   fmadd( m[6 + k], z, m[9 + k] ) ) );
+            lo[k] = min( lo[k], t[k] );
+            hi[k] = max( hi[k], t[k] );
+        }
+        if( out != NULL ) {
+            storeFloat( &out->x[i], t[0] );
+            storeFloat( &out->y[i], t[1] );
+            storeFloat( &out->z[i], t[2] );
+        }
+
+        SimdFloat dx = t[0] - cx, dy = t[1] - cy, dz = t[2] - cz;
+        r2 = max( r2, dot( dx, dy, dz, dx, dy, dz ) );
+    }
+
+    // fold the lanes
+    float l[3][SIMD_WIDTH], h[3][SIMD_WIDTH], r[SIMD_WIDTH];
+    for( int k = 0; k < 3; k++ ) {
+        storeFloat( l[k], lo[k] );
+        storeFloat( h[k], hi[k] );
+    }
+    storeFloat( r, r2 );
+    for( int i = 0; i < SIMD_WIDTH; i++ ) {
+        for( int k = 0; k < 3; k++ ) {
+            B.lo[k] = min( B.lo[k], l[k][i] );
+            B.hi[k] = max( B.hi[k], h[k][i] );
+        }
+        B.radius = max( B.radius, r[i] );
+    }
+}
+
+// the bounds' center, moved by M
+static inline void transformCenter( const float *M, const Bounds &from,
+                                    Bounds &to )
+{
+    const float *c = from.center;
+    for( int k = 0; k < 3; k++ ) {
+        to.center[k] = M[k] * c[0] + M[4 + k] * c[1] + M[8 + k] * c[2] +
+                       M[12 + k];
+    }
+}
+
+// size the output arrays of a transform of P
+static inline void prepareOutput( const PositionArrays &P,
+                                  PositionArrays *out )
+{
+    if( out != NULL ) {
+        out->count = P.count;
+        out->x.resize( padded( P.count ) );
+        out->y.resize( padded( P.count ) );
+        out->z.resize( padded( P.count ) );
+    }
+}
+
+///
+// splitPositions(points,stride,count,P) - copy positions into P
+///
+void splitPositions( const float *points, int stride, int count,
+                     PositionArrays &P )
+{
+    int size = padded( count );
+    P.count = count;
+    P.x.resize( size );
+    P.y.resize( size );
+    P.z.resize( size );
+    for( int i = 0; i < size; i++ ) {
+        const float *p = &points[(size_t) stride * min( i, count - 1 )];
+        P.x[i] = p[0];
+        P.y[i] = p[1];
+        P.z[i] = p[2];
+    }
+
+    // the box first, then the sphere around its center
+    static const float identity[16] = { 1, 0, 0, 0,  0, 1, 0, 0,
+                                        0, 0, 1, 0,  0, 0, 0, 1 };
+    emptyBounds( P.bounds );
+    if( count == 0 ) {
+        return;
+    }
+    transformRange( identity, P, 0, size, NULL, P.bounds );
+    for( int k = 0; k < 3; k++ ) {
+        P.bounds.center[k] = 0.5f * (P.bounds.lo[k] + P.bounds.hi[k]);
+    }
+    P.bounds.radius = 0.0f;
+    transformRange( identity, P, 0, size, NULL, P.bounds );
+    P.bounds.radius = sqrtf( P.bounds.radius );
+}
+
+///
+// transformPositions(M,P,out,B) - transform a mesh on the calling thread
+///
+void transformPositions( const float *M, const PositionArrays &P,
+                         PositionArrays *out, Bounds &B )
+{
+    prepareOutput( P, out );
+    emptyBounds( B );
+    transformCenter( M, P.bounds, B );
+    transformRange( M, P, 0, padded( P.count ), out, B );
+    B.radius = sqrtf( B.radius );
+}
+
+///
+// transformMeshes(pool,jobs,count) - transform several meshes at once
+///
+void transformMeshes( ThreadPool &pool, TransformJob *jobs, int count )
+{
+    // every job's chunks, in order, and the bounds each one finds
+    vector<int> firstChunk( count + 1, 0 );
+    for( int j = 0; j < count; j++ ) {
+        int size = padded( jobs[j].positions->count );
+        firstChunk[j + 1] = firstChunk[j] +
+                            (size + TRANSFORM_CHUNK - 1) / TRANSFORM_CHUNK;
+        prepareOutput( *jobs[j].positions, jobs[j].out );
+        emptyBounds( jobs[j].bounds );
+        transformCenter( jobs[j].matrix, jobs[j].positions->bounds,
+                         jobs[j].bounds );
+    }
+    vector<Bounds> partial( firstChunk[count] );
+
+    pool.parallelFor( firstChunk[count], [&]( int chunk, int ) {
+        int j = upper_bound( firstChunk.begin(), firstChunk.end(), chunk ) -
+                firstChunk.begin() - 1;
+        const TransformJob &J = jobs[j];
+        int first = (chunk - firstChunk[j]) * TRANSFORM_CHUNK;
+        int last = min( first + TRANSFORM_CHUNK, padded( J.positions->count ) );
+
+        Bounds &B = partial[chunk];
+        B = J.bounds;
+        transformRange( J.matrix, *J.positions, first, last, J.out, B );
+    } );
+
+    for( int j = 0; j < count; j++ ) {
+        Bounds &B = jobs[j].bounds;
+        for( int c = firstChunk[j]; c < firstChunk[j + 1]; c++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                B.lo[k] = min( B.lo[k], partial[c].lo[k] );
+                B.hi[k] = max( B.hi[k], partial[c].hi[k] );
+            }
+            B.radius = max( B.radius, partial[c].radius );
+        }
+        B.radius = sqrtf( B.radius );
+    }
+}
@@ -0,0 +1,98 @@
+//
+//  Transform.h
+//
+//  Batched vertex transforms on the CPU: whole meshes moved by the
+//  4x4 model matrix that setUpTransforms() gives the vertex shaders
+//  (see modelMatrix() in Viewing.h), with the bounds of the result.
+//
+//  Positions are kept as structure-of-arrays, so SIMD_WIDTH vertices
+//  are transformed with a handful of multiply-adds per coordinate.
+//  The arrays are padded to a multiple of SIMD_WIDTH with copies of
+//  the last vertex, which leaves the bounds alone and spares the
+//  kernels a ragged tail.
+//
+//  The same pass that writes the transformed positions grows an
+//  axis-aligned box around them and measures a bounding sphere: its
+//  center is the transformed center of the mesh's model-space box, so
+//  it is known before the pass starts and only the radius has to be
+//  found.  transformMeshes() cuts every mesh into TRANSFORM_CHUNK
+//  vertex pieces and hands them all to a ThreadPool at once, so one
+//  large mesh among small ones still keeps every worker busy.
+//
+
+#ifndef _TRANSFORM_H_
+#define _TRANSFORM_H_
+
+#include <vector>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+
+using namespace std;
+
+// vertices per work item of transformMeshes() (a multiple of SIMD_WIDTH)
+#define TRANSFORM_CHUNK 4096
+
+///
+// box and sphere around some points
+///
+struct Bounds {
+    float lo[3], hi[3];
+    float center[3];
+    float radius;
+};
+
+///
+// 'count' XYZ positions as separate arrays, each padded to a multiple
+// of SIMD_WIDTH, and their model-space bounds
+///
+struct PositionArrays {
+    int count;
+    vector<float> x, y, z;
+    Bounds bounds;
+};
+
+///
+// one mesh for transformMeshes(): its positions and matrix, where the
+// result goes (NULL for the bounds alone) and the bounds of the result
+///
+struct TransformJob {
+    const PositionArrays *positions;
+    float matrix[16];
+    PositionArrays *out;
+    Bounds bounds;
+};
+
+///
+// splitPositions(points,stride,count,P) - copy positions into P and
+//     find their bounds
+//
+// @param points - the first vertex's X; Y and Z follow it
+// @param stride - floats from one vertex to the next (4 for XYZW)
+// @param count  - number of vertices
+// @param P      - receives the arrays
+///
+void splitPositions( const float *points, int stride, int count,
+                     PositionArrays &P );
+
+///
+// transformPositions(M,P,out,B) - transform a mesh on the calling thread
+//
+// @param M   - column-major 4x4 matrix; the last row must be 0 0 0 1
+// @param P   - the positions
+// @param out - receives M times every position; may be NULL
+// @param B   - receives the bounds of the transformed positions
+///
+void transformPositions( const float *M, const PositionArrays &P,
+                         PositionArrays *out, Bounds &B );
+
+///
+// transformMeshes(pool,jobs,count) - transform several meshes at once
+//
+// @param pool  - the workers to transform with
+// @param jobs  - the meshes; each gets its 'out' and 'bounds' filled in
+// @param count - number of jobs
+///
+void transformMeshes( ThreadPool &pool, TransformJob *jobs, int count );
+
+#endif
@@ -0,0 +1,136 @@
+//
+//  TransformBench.cpp
+//
+//  The vertex transform benchmark (-transformbench; see Benchmarks.h):
+//  the objects moved into world space by a plain loop and by the SIMD
+//  kernels of Transform.h.
+//
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmarks.h"
+#include "Buffers.h"
+#include "Scene.h"
+#include "Shapes.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "Transform.h"
+#include "Viewing.h"
+
+using namespace std;
+
+///
+// transformBenchmark() - time moving the grapes and the room into
+// world space B.count times, vertex by vertex as the ray tracer does
+// and with the Transform.h kernels, then every object on the thread
+// pool, and report
+///
+void transformBenchmark( const BenchSettings &B )
+{
+    int repeats = B.count;
+    const SceneParts &S = sceneParts();
+    SceneView V = sceneView();
+    ThreadPool pool( S.cpuThreads );
+
+    // a pose that exercises every rotation
+    float model[16], rotate[3] = { 15.0f, 30.0f, 45.0f };
+    modelMatrix( model, S.scale, rotate, S.translate );
+
+    printf( "transforms: %d repeats\n", repeats );
+    printf( "object  vertices  loop Mv/s  SIMD Mv/s  speedup  max error"
+        "  box                                        radius\n" );
+
+    const int tested[2] = { OBJ_GRAPES, OBJ_ROOM };
+    for( int o = 0; o < 2; o++ ) {
+        const SceneObject *T = S.objects;
+        while( T->obj != tested[o] ) {
+            T++;
+        }
+        const BufferSet &M = *T->buffers;
+        int n = M.numElements;
+
+        // the plain loop: XYZW in, XYZ out, with a box and a sphere
+        // around the transformed model-space box center
+        PositionArrays P, out;
+        splitPositions( M.points.data(), 4, n, P );
+        vector<float> plain( 3 * (size_t) n );
+        Bounds ref;
+        uint64_t start = monotonicNs();
+        for( int r = 0; r < repeats; r++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                ref.lo[k] = FLT_MAX;
+                ref.hi[k] = -FLT_MAX;
+                ref.center[k] = model[k] * P.bounds.center[0] +
+                                model[4 + k] * P.bounds.center[1] +
+                                model[8 + k] * P.bounds.center[2] +
+                                model[12 + k];
+            }
+            float r2 = 0.0f;
+            for( int i = 0; i < n; i++ ) {
+                const float *p = &M.points[4 * (size_t) i];
+                float *q = &plain[3 * (size_t) i];
+                float d2 = 0.0f;
+                for( int k = 0; k < 3; k++ ) {
+                    q[k] = model[k] * p[0] + model[4 + k] * p[1] +
+                           model[8 + k] * p[2] + model[12 + k] * p[3];
+                    ref.lo[k] = min( ref.lo[k], q[k] );
+                    ref.hi[k] = max( ref.hi[k], q[k] );
+                    d2 += (q[k] - ref.center[k]) * (q[k] - ref.center[k]);
+                }
+                r2 = max( r2, d2 );
+            }
+            ref.radius = sqrtf( r2 );
+        }
+        double plainMs = elapsedMs( start );
+
+        Bounds bounds;
+        start = monotonicNs();
+        for( int r = 0; r < repeats; r++ ) {
+            transformPositions( model, P, &out, bounds );
+        }
+        double simdMs = elapsedMs( start );
+
+        float error = fabsf( bounds.radius - ref.radius );
+        for( int i = 0; i < n; i++ ) {
+            error = max( error, fabsf( out.x[i] - plain[3 * i] ) );
+            error = max( error, fabsf( out.y[i] - plain[3 * i + 1] ) );
+            error = max( error, fabsf( out.z[i] - plain[3 * i + 2] ) );
+        }
+
+        double vertices = (double) n * repeats;
+        printf( "%-6s  %8d  %9.1f  %9.1f  %6.2fx  %9.2g  (%5.2f %5.2f %5.2f)"
+            "-(%5.2f %5.2f %5.2f)  %6.3f\n", T->name, n,
+            vertices / (plainMs * 1000.0), vertices / (simdMs * 1000.0),
+            plainMs / simdMs, error, bounds.lo[0], bounds.lo[1],
+            bounds.lo[2], bounds.hi[0], bounds.hi[1], bounds.hi[2],
+            bounds.radius );
+    }
+
+    // the whole scene, each object in its own pose
+    int objects = S.objectCount;
+    vector<PositionArrays> positions( objects ), results( objects );
+    vector<TransformJob> jobs( objects );
+    int total = 0;
+    for( int i = 0; i < objects; i++ ) {
+        const SceneObject &O = S.objects[i];
+        splitPositions( O.buffers->points.data(), 4, O.buffers->numElements,
+                        positions[i] );
+        jobs[i].positions = &positions[i];
+        jobs[i].out = &results[i];
+        modelMatrix( jobs[i].matrix, S.scale, &V.angles[O.obj],
+                     S.translate );
+        total += O.buffers->numElements;
+    }
+    uint64_t start = monotonicNs();
+    for( int r = 0; r < repeats; r++ ) {
+        transformMeshes( pool, jobs.data(), objects );
+    }
+    double ms = elapsedMs( start );
+    printf( "all %d objects, %d vertices, on %d threads: %.1f Mv/s\n",
+        objects, total, pool.size(),
+        (double) total * repeats / (ms * 1000.0) );
+}
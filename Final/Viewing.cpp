@@ -10,6 +10,8 @@
 //  This code can be compiled as either C or C++.
 //
 
+#include <math.h>
+
 #include "Viewing.h"
 
 // current values for transformations
@@ -54,6 +56,22 @@ void setUpFrustum( GLuint program )
     glUniform1f( farLoc,    cwFar );
 }
 
+///
+// This function returns the view volume boundaries sent by
+// setUpFrustum().
+//
+// @param bounds - receives left, right, top, bottom, near and far
+///
+void getFrustum( GLfloat *bounds )
+{
+    bounds[0] = cwLeft;
+    bounds[1] = cwRight;
+    bounds[2] = cwTop;
+    bounds[3] = cwBottom;
+    bounds[4] = cwNear;
+    bounds[5] = cwFar;
+}
+
 ///
 // This function clears any transformations, setting the values to the
 // defaults: scale by 4 in Y, rotate by 50 in Y and 90 in Z, and
@@ -163,3 +181,303 @@ void setUpCamera( GLuint program,
     glUniform3fv( lookLoc, 1, lookatVec );
     glUniform3fv( upVecLoc, 1, upVec );
 }
+
+///
+// This function sets up the parameters of several cameras at once, for
+// programs that render every view in one pass (see multiview.geom).
+//
+// @param program - The ID of an OpenGL (GLSL) shader program to which
+//    parameter values are to be sent
+// @param count - number of cameras
+// @param eyes - 'count' camera locations, as x,y,z triples
+// @param lookats - 'count' lookat points, as x,y,z triples
+// @param ups - 'count' up vectors, as x,y,z triples
+///
+void setUpCameras( GLuint program, GLint count, const GLfloat *eyes,
+    const GLfloat *lookats, const GLfloat *ups )
+{
+    GLint viewsLoc = glGetUniformLocation( program, "views" );
+    GLint posLoc = glGetUniformLocation( program, "cPositions" );
+    GLint lookLoc = glGetUniformLocation( program, "cLookAts" );
+    GLint upVecLoc = glGetUniformLocation( program, "cUps" );
+
+    // send down to the shader
+    glUniform1i( viewsLoc, count );
+    glUniform3fv( posLoc, count, eyes );
+    glUniform3fv( lookLoc, count, lookats );
+    glUniform3fv( upVecLoc, count, ups );
+}
+
+///
+// This function computes the model matrix: scale, then rotate around
+// Z, Y and X, then translate.
+//
+// @param m - receives the matrix
+// @param scale - x, y and z scale factors
+// @param rotate - x, y and z rotations, in degrees
+// @param translate - x, y and z translations
+///
+void modelMatrix( GLfloat *m, const GLfloat *scale, const GLfloat *rotate,
+    const GLfloat *translate )
+{
+    GLfloat c[3], s[3];
+    int i;
+
+    for( i = 0; i < 3; i++ ) {
+        GLfloat a = rotate[i] * 3.14159265358979f / 180.0f;
+        c[i] = cosf( a );
+        s[i] = sinf( a );
+    }
+
+    // columns of Rx * Ry * Rz, each scaled; then the translation
+    m[0]  = c[1] * c[2] * scale[0];
+    m[1]  = (s[0] * s[1] * c[2] + c[0] * s[2]) * scale[0];
+    m[2]  = (s[0] * s[2] - c[0] * s[1] * c[2]) * scale[0];
+    m[3]  = 0.0f;
+    m[4]  = -c[1] * s[2] * scale[1];
+    m[5]  = (c[0] * c[2] - s[0] * s[1] * s[2]) * scale[1];
+    m[6]  = (c[0] * s[1] * s[2] + s[0] * c[2]) * scale[1];
+    m[7]  = 0.0f;
+    m[8]  = s[1] * scale[2];
+    m[9]  = -s[0] * c[1] * scale[2];
+    m[10] = c[0] * c[1] * scale[2];
+    m[11] = 0.0f;
+    m[12] = translate[0];
+    m[13] = translate[1];
+    m[14] = translate[2];
+    m[15] = 1.0f;
+}
+
+// normalize a 3-vector in place
+static void normalize3( GLfloat *v )
+{
+    GLfloat len = sqrtf( v[0] * v[0] + v[1] * v[1] + v[2] * v[2] );
+
+    v[0] /= len;
+    v[1] /= len;
+    v[2] /= len;
+}
+
+// r = a x b
+static void cross3( GLfloat *r, const GLfloat *a, const GLfloat *b )
+{
+    r[0] = a[1] * b[2] - a[2] * b[1];
+    r[1] = a[2] * b[0] - a[0] * b[2];
+    r[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+///
+// This function computes the viewing matrix of a camera.
+//
+// @param m - receives the matrix
+// @param eye - camera location
+// @param lookat - lookat point
+// @param up - up vector
+///
+void viewMatrix( GLfloat *m, const GLfloat *eye, const GLfloat *lookat,
+    const GLfloat *up )
+{
+    GLfloat n[3], u[3], v[3], upN[3];
+    int i;
+
+    for( i = 0; i < 3; i++ ) {
+        n[i] = eye[i] - lookat[i];
+        upN[i] = up[i];
+    }
+    normalize3( n );
+    normalize3( upN );
+    cross3( u, upN, n );
+    normalize3( u );
+    cross3( v, n, u );
+    normalize3( v );
+
+    for( i = 0; i < 3; i++ ) {
+        m[4*i]   = u[i];
+        m[4*i+1] = v[i];
+        m[4*i+2] = n[i];
+        m[4*i+3] = 0.0f;
+    }
+    m[12] = -(u[0] * eye[0] + u[1] * eye[1] + u[2] * eye[2]);
+    m[13] = -(v[0] * eye[0] + v[1] * eye[1] + v[2] * eye[2]);
+    m[14] = -(n[0] * eye[0] + n[1] * eye[1] + n[2] * eye[2]);
+    m[15] = 1.0f;
+}
+
+///
+// This function computes the projection matrix of the view volume
+// sent by setUpFrustum().
+//
+// @param m - receives the matrix
+///
+void projectionMatrix( GLfloat *m )
+{
+    int i;
+
+    for( i = 0; i < 16; i++ ) {
+        m[i] = 0.0f;
+    }
+    m[0]  = (2.0f * cwNear) / (cwRight - cwLeft);
+    m[5]  = (2.0f * cwNear) / (cwTop - cwBottom);
+    m[8]  = (cwRight + cwLeft) / (cwRight - cwLeft);
+    m[9]  = (cwTop + cwBottom) / (cwTop - cwBottom);
+    m[10] = -(cwFar + cwNear) / (cwFar - cwNear);
+    m[11] = -1.0f;
+    m[14] = (-2.0f * cwFar * cwNear) / (cwFar - cwNear);
+}
+
+///
+// This function multiplies two matrices.
+//
+// @param r - receives a * b; may not be a or b
+// @param a - left-hand matrix
+// @param b - right-hand matrix
+///
+void multiplyMatrices( GLfloat *r, const GLfloat *a, const GLfloat *b )
+{
+    int row, col, k;
+
+    for( col = 0; col < 4; col++ ) {
+        for( row = 0; row < 4; row++ ) {
+            GLfloat sum = 0.0f;
+            for( k = 0; k < 4; k++ ) {
+                sum += a[4*k+row] * b[4*col+k];
+            }
+            r[4*col+row] = sum;
+        }
+    }
+}
+
+///
+// This function computes the planes of a view volume in eye space,
+// pointing in and of unit length: left, right, bottom, top, near and
+// far.
+//
+// @param planes - receives six planes of four values
+// @param bounds - left, right, top, bottom, near and far, as
+//    getFrustum() gives them
+///
+void frustumPlanes( GLfloat *planes, const GLfloat *bounds )
+{
+    GLfloat l = bounds[0], r = bounds[1], t = bounds[2], b = bounds[3];
+    GLfloat n = bounds[4], f = bounds[5];
+    GLfloat p[24] = {
+         n,    0.0f,  l,    0.0f,
+        -n,    0.0f, -r,    0.0f,
+         0.0f, n,     b,    0.0f,
+         0.0f, -n,   -t,    0.0f,
+         0.0f, 0.0f, -1.0f, -n,
+         0.0f, 0.0f,  1.0f,  f
+    };
+    int i, k;
+
+    for( i = 0; i < 6; i++ ) {
+        GLfloat length = sqrtf( p[4*i] * p[4*i] + p[4*i+1] * p[4*i+1] +
+                                p[4*i+2] * p[4*i+2] );
+        for( k = 0; k < 4; k++ ) {
+            planes[4*i+k] = p[4*i+k] / length;
+        }
+    }
+}
+
+///
+// This function tests whether any of an object's bounding volumes is
+// inside a view volume.
+//
+// @param planes - view volume planes, from frustumPlanes()
+// @param modelView - the object's model-view matrix
+// @param center - model space center of the bounding sphere
+// @param radius - its radius
+// @param boxMin - low corner of the model space bounding box
+// @param boxMax - high corner of the model space bounding box
+//
+// @return 0 if the object is wholly outside the view volume
+///
+int boundsInFrustum( const GLfloat *planes, const GLfloat *modelView,
+    const GLfloat *center, GLfloat radius, const GLfloat *boxMin,
+    const GLfloat *boxMax )
+{
+    GLfloat e[3], scale = 0.0f;
+    int i, j, k;
+
+    // the sphere in eye space, its radius grown by the largest scale
+    for( k = 0; k < 3; k++ ) {
+        e[k] = modelView[k] * center[0] + modelView[4+k] * center[1] +
+               modelView[8+k] * center[2] + modelView[12+k];
+    }
+    for( j = 0; j < 3; j++ ) {
+        GLfloat s = sqrtf( modelView[4*j] * modelView[4*j] +
+                           modelView[4*j+1] * modelView[4*j+1] +
+                           modelView[4*j+2] * modelView[4*j+2] );
+        scale = s > scale ? s : scale;
+    }
+    radius *= scale;
+
+    for( i = 0; i < 6; i++ ) {
+        const GLfloat *p = &planes[4*i];
+        GLfloat q[4], d;
+
+        d = p[0] * e[0] + p[1] * e[1] + p[2] * e[2] + p[3];
+        if( d < -radius ) {
+            return 0;
+        }
+        if( d >= radius ) {
+            continue;
+        }
+
+        // the sphere straddles the plane: take the plane to model
+        // space and test the box corner farthest along it
+        for( j = 0; j < 4; j++ ) {
+            q[j] = modelView[4*j] * p[0] + modelView[4*j+1] * p[1] +
+                   modelView[4*j+2] * p[2] + modelView[4*j+3] * p[3];
+        }
+        d = q[3];
+        for( j = 0; j < 3; j++ ) {
+            d += q[j] * (q[j] >= 0.0f ? boxMax[j] : boxMin[j]);
+        }
+        if( d < 0.0f ) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+///
+// This function places an object's bounding sphere in the world and
+// measures it from the camera, for the objects' sizes on the screen.
+// The sphere's radius is grown by the model matrix's largest scale.
+//
+// @param model - the object's model matrix
+// @param eye - camera location
+// @param center - model space center of the bounding sphere
+// @param scale - receives the model matrix's largest scale
+// @param toEye - receives the vector from the sphere's center to the
+//    camera, unless NULL
+//
+// @return the distance from the camera to the sphere's center
+///
+GLfloat sphereFromEye( const GLfloat *model, const GLfloat *eye,
+    const GLfloat *center, GLfloat *scale, GLfloat *toEye )
+{
+    GLfloat w[3];
+    int j, k;
+
+    for( k = 0; k < 3; k++ ) {
+        w[k] = eye[k] - (model[k] * center[0] + model[4+k] * center[1] +
+                         model[8+k] * center[2] + model[12+k]);
+    }
+    *scale = 0.0f;
+    for( j = 0; j < 3; j++ ) {
+        GLfloat s = sqrtf( model[4*j] * model[4*j] +
+                           model[4*j+1] * model[4*j+1] +
+                           model[4*j+2] * model[4*j+2] );
+        *scale = s > *scale ? s : *scale;
+    }
+    if( toEye != NULL ) {
+        for( k = 0; k < 3; k++ ) {
+            toEye[k] = w[k];
+        }
+    }
+
+    return sqrtf( w[0] * w[0] + w[1] * w[1] + w[2] * w[2] );
+}
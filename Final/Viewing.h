@@ -33,6 +33,14 @@
 ///
 void setUpFrustum( GLuint program );
 
+///
+// This function returns the view volume boundaries sent by
+// setUpFrustum().
+//
+// @param bounds - receives left, right, top, bottom, near and far
+///
+void getFrustum( GLfloat *bounds );
+
 ///
 // This function clears any transformations, setting the values to the
 // defaults: scale by 4 in Y, rotate by 50 in Y and 90 in Z, and
@@ -96,4 +104,111 @@ void setUpCamera( GLuint program,
     GLfloat lookatX, GLfloat lookatY, GLfloat lookatZ,
     GLfloat upX, GLfloat upY, GLfloat upZ );
 
+///
+// This function sets up the parameters of several cameras at once, for
+// programs that render every view in one pass (see multiview.geom).
+//
+// @param program - The ID of an OpenGL (GLSL) shader program to which
+//    parameter values are to be sent
+// @param count - number of cameras
+// @param eyes - 'count' camera locations, as x,y,z triples
+// @param lookats - 'count' lookat points, as x,y,z triples
+// @param ups - 'count' up vectors, as x,y,z triples
+///
+void setUpCameras( GLuint program, GLint count, const GLfloat *eyes,
+    const GLfloat *lookats, const GLfloat *ups );
+
+///
+// The functions below build the matrices that the vertex shaders
+// compute from the parameters above, for renderers that run on the
+// CPU.  Matrices are 4x4 and column-major, as in GLSL.
+///
+
+///
+// This function computes the model matrix: scale, then rotate around
+// Z, Y and X, then translate.
+//
+// @param m - receives the matrix
+// @param scale - x, y and z scale factors
+// @param rotate - x, y and z rotations, in degrees
+// @param translate - x, y and z translations
+///
+void modelMatrix( GLfloat *m, const GLfloat *scale, const GLfloat *rotate,
+    const GLfloat *translate );
+
+///
+// This function computes the viewing matrix of a camera.
+//
+// @param m - receives the matrix
+// @param eye - camera location
+// @param lookat - lookat point
+// @param up - up vector
+///
+void viewMatrix( GLfloat *m, const GLfloat *eye, const GLfloat *lookat,
+    const GLfloat *up );
+
+///
+// This function computes the projection matrix of the view volume
+// sent by setUpFrustum().
+//
+// @param m - receives the matrix
+///
+void projectionMatrix( GLfloat *m );
+
+///
+// This function multiplies two matrices.
+//
+// @param r - receives a * b; may not be a or b
+// @param a - left-hand matrix
+// @param b - right-hand matrix
+///
+void multiplyMatrices( GLfloat *r, const GLfloat *a, const GLfloat *b );
+
+///
+// This function computes the planes of a view volume in eye space,
+// pointing in and of unit length: left, right, bottom, top, near and
+// far.  A point (x,y,z) is inside a plane (a,b,c,d) when
+// ax + by + cz + d >= 0.
+//
+// @param planes - receives six planes of four values
+// @param bounds - left, right, top, bottom, near and far, as
+//    getFrustum() gives them
+///
+void frustumPlanes( GLfloat *planes, const GLfloat *bounds );
+
+///
+// This function tests whether any of an object's bounding volumes is
+// inside a view volume.  The sphere is tried first; if it is cut by a
+// plane, the box is tested against the plane in model space.
+//
+// @param planes - view volume planes, from frustumPlanes()
+// @param modelView - the object's model-view matrix
+// @param center - model space center of the bounding sphere
+// @param radius - its radius
+// @param boxMin - low corner of the model space bounding box
+// @param boxMax - high corner of the model space bounding box
+//
+// @return 0 if the object is wholly outside the view volume
+///
+int boundsInFrustum( const GLfloat *planes, const GLfloat *modelView,
+    const GLfloat *center, GLfloat radius, const GLfloat *boxMin,
+    const GLfloat *boxMax );
+
+///
+// This function places an object's bounding sphere in the world and
+// measures it from the camera, for the objects' sizes on the screen.
+// The sphere's radius is grown by the model matrix's largest scale.
+//
+// @param model - the object's model matrix
+// @param eye - camera location
+// @param center - model space center of the bounding sphere
+// @param scale - receives the model matrix's largest scale
+// @param toEye - receives the vector from the sphere's center to the
+//    camera, unless NULL
+//
+// @return the distance from the camera to the sphere's center
+///
+GLfloat sphereFromEye( const GLfloat *model, const GLfloat *eye,
+    const GLfloat *center, GLfloat *scale, GLfloat *toEye );
+
 #endif
@@ -26,6 +26,73 @@
 //	keyboard '4' : rotate objects counter-clockwise along x axis;
 //	keyboard '5' : rotate objects counter-clockwise along y axis;
 //	keyboard '6' : rotate objects counter-clockwise along z axis;
+//	keyboard 'l' : turn the levels of detail on or off;
+//	keyboard 'm' : turn the meshlet culling off or on;
+//	keyboard 'f' : turn the culling of objects outside the view off
+//		or on;
+//	keyboard 'h' : turn the culling of objects hidden behind others
+//		off or on;
+//	keyboard 'i' : turn the impostors on or off;
+//	keyboard 'n' : turn the normal-mapped coarse copies on or off;
+//	keyboard 'g' : turn the per-corner shading of small objects on or
+//		off;
+//	keyboard 'o' : turn the shadows off or on;
+//	mouse click : select the object under the cursor; its name, the
+//		triangle and the point hit are printed, and keys '1' to '6'
+//		then turn only that object.  Clicking the room or empty space
+//		selects all of them again.
+//	
+//	COMMAND LINE OPTIONS:
+//	-shm name : publish every rendered frame into the shared-memory
+//		frame ring 'name' (see FrameRing.h); read it with frameConsumer.
+//	-animate : start with the animation running.
+//	-serve socket [-cache MB] : run as a render service on the Unix
+//		domain socket 'socket' with a result cache of MB megabytes
+//		(default 256); see RenderService.h.  Drive it with renderClient.
+//		With 'socket' given as tcp:PORT the service accepts connections
+//		from other machines and acts as a renderCoordinator worker.
+//	-cpu : draw with the CPU rasterizer (Rasterizer.h) instead of
+//		OpenGL, in the window and in the render service.
+//	-raytrace : draw with the CPU ray tracer (RayTracer.h), with
+//		shadows and reflections, in the window and in the render
+//		service.
+//	-threads N : number of threads of the CPU renderers (default: one
+//		per hardware thread).
+//	-occlusion file : cache the ambient occlusion of the objects (see
+//		Occlusion.h) in 'file' (default occlusion.cache).  It is baked
+//		at startup, on every thread, unless 'file' holds the values for
+//		the same objects; -noocclusion leaves it out.
+//	-lod : draw each object at the coarsest of its levels of detail (see
+//		Lod.h) that is less than a pixel off on the screen; by default
+//		every object is drawn in full detail.
+//	-nomeshlets : draw every triangle of every object; by default the
+//		objects are drawn as meshlets (see Meshlet.h), leaving out those
+//		outside the view or facing away from the camera.
+//	-noinstancing : draw the grapes as one mesh; by default objects
+//		made of copies of one part are drawn instanced (see
+//		Instances.h), the part kept once.
+//	-nocull : draw every object; by default those wholly outside the
+//		view are left out, by their bounding spheres and boxes.
+//	-nohiz : draw the objects hidden behind the room, the slab and the
+//		bottle; by default they are found on the CPU (see HiZ.h), a
+//		frame ahead, and left out.
+//	-impostors : draw the objects on the table as impostors (see
+//		Impostor.h), a quad sampling a view baked at startup, once they
+//		are under IMPOSTOR_PIXELS pixels across; by default every object
+//		is drawn as a mesh.
+//	-normalmaps : draw the grapes, the glass and the mug as the
+//		coarsest of their levels of detail that keeps their walls
+//		apart, with normal maps baked at startup from their full
+//		meshes (see NormalMap.h).
+//	-shadinglod P : shade the untextured objects narrower than P pixels
+//		on the screen (the default with key 'g' is 128) per corner
+//		instead of per pixel (gouraud.vert), and draw those whose
+//		specular term is too faint to show under the light without it.
+//	-noshadows : draw without the shadows of the light; by default they
+//		come from a cube shadow map (see ShadowMap.h), drawn again only
+//		when the light or an object moves.
+//	The other runs that draw offscreen, report and exit instead of
+//	opening the window take the options listed in Benchmarks.h.
 //	
 //	CREDITS and REFERENCES:
 //	Prof. Warren R. Carithers for guidance.
@@ -47,8 +114,17 @@
 //	cloth texture object was obtained from https://www.textures.com/
 //
 
+#include <algorithm>
+#include <cfloat>
 #include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cmath>
+#include <csignal>
 #include <iostream>
+#include <vector>
+
+#include <unistd.h>
 
 #if defined(_WIN32) || defined(_WIN64)
 #include <windows.h>
@@ -65,6 +141,30 @@
 #include "Shapes.h"
 #include "Viewing.h"
 #include "Lighting.h"
+#include "FrameRing.h"
+#include "Framebuffer.h"
+#include "GBuffer.h"
+#include "Denoiser.h"
+#include "GBufferFile.h"
+#include "HiZ.h"
+#include "Impostor.h"
+#include "Instances.h"
+#include "Lod.h"
+#include "Meshlet.h"
+#include "NormalMap.h"
+#include "Occlusion.h"
+#include "PathTracer.h"
+#include "Picker.h"
+#include "Rasterizer.h"
+#include "RayTracer.h"
+#include "RenderService.h"
+#include "ShadowMap.h"
+#include "Texture.h"
+#include "ThreadPool.h"
+#include "Timing.h"
+#include "Transform.h"
+#include "Scene.h"
+#include "Benchmarks.h"
 
 using namespace std;
 
@@ -98,7 +198,7 @@ BufferSet mugBuffers;
 BufferSet bottomBuffers;
 BufferSet roomBuffers;
 
-// Animation flag
+// Animation flag (see ANIMATION_STEP)
 bool animating = false;
 
 // Initial animation rotation angles for all the objects
@@ -113,15 +213,142 @@ float angles[24] = { 	0.0f, 0.0f, 0.0f,
 						0.0f, 0.0f, 0.0f, 
 						0.0f, 0.0f, 0.0f	};
 
+// camera used for every object
+float cameraEye[3]    = { 1.55f, 2.2f, 5.5f };
+float cameraLookAt[3] = { 1.55f, 1.0f, 0.0f };
+float cameraUp[3]     = { 0.0f, 2.0f, 0.0f };
+
+// scale and placement shared by every object
+float sceneScale[3]     = { 5.0f, 5.0f, 5.0f };
+float sceneTranslate[3] = { 1.55f, 0.5f, -1.5f };
+
 float sceneLightColor[3] = {1.0, 1.0, 1.0};
 float lightPosition[3] = {-1.2, 2.5, 0.1};
 float sceneAmbColor[3] = {1.0, 1.0, 0.0};
 
+// shared-memory frame output (-shm); NULL if not publishing
+const char *shmName = NULL;
+FrameRing frameRing;
+
+// render service mode (-serve); NULL when running interactively
+const char *servePath = NULL;
+long serveCacheMB = 256;
+volatile bool serviceStop = false;
+Framebuffer offscreen;
+
+// CPU renderers (-cpu, -raytrace, and the runs of Benchmarks.h); set up
+// by initCPU().  useCPU is set for either renderer.
+bool useCPU = false;
+bool useRayTracer = false;
+int cpuThreads = 0;
+ThreadPool *cpuPool = NULL;
+Rasterizer *rasterizer = NULL;
+RayTracer *rayTracer = NULL;
+Texture clothImage;
+
+// ambient occlusion cache (-occlusion); NULL to go without (-noocclusion)
+const char *occlusionPath = "occlusion.cache";
+
+// mouse picking, and the object the number keys turn (-1 for all of
+// them)
+Picker picker;
+int selectedObject = -1;
+
+// the drawing options of the window, the render service and the
+// G-buffer export, as the command line and the keys set them
+RenderSettings settings;
+
+// the triangles drawn by the last drawScene()
+long drawnTriangles = 0;
+
+// are objects made of copies drawn instanced (-noinstancing)?
+bool instancingEnabled = true;
+
+// the objects drawn and left out by the last drawScene()
+int visibleObjects = 0, culledObjects = 0;
+
+// the Hi-Z culler, whether it has a frame under way, the objects it
+// left out of the last drawScene() and what finding them cost (on
+// whichever thread), the frames whose results were ready (culled ahead
+// of time) or not
+HiZCuller hiz;
+bool hizStarted = false;
+int occludedObjects = 0;
+double hizCullMs = 0.0;
+long hizTriangles = 0;
+long hizReady = 0, hizLate = 0;
+
+// the objects the Hi-Z culler rasterizes: the room's walls, the slab and
+// the bottle
+const int hizOccluders[] = { OBJ_ROOM, OBJ_SLAB, OBJ_BOTTLE };
+
+// whether the impostors have been baked, the programs that bake and
+// draw them, and the objects drawn as impostors by the last drawScene()
+bool impostorsBaked = false;
+GLuint impostorBakeShader, impostorShader;
+int impostorObjects = 0;
+
+// the objects that get impostors: those on the table
+const int impostorCandidates[] = {
+    OBJ_CHEESE, OBJ_GRAPES, OBJ_GLASS, OBJ_BOTTLE, OBJ_MUG
+};
+
+// whether the normal maps have been baked, and the program that draws
+// the objects with them
+bool normalMapsBaked = false;
+GLuint normalMapShader;
+
+// the objects that get normal maps: those with the most vertices
+const int normalMapCandidates[] = { OBJ_GRAPES, OBJ_GLASS, OBJ_MUG };
+
+// the program that shades small objects per corner, and the objects it
+// drew in the last drawScene()
+GLuint gouraudShader;
+int gouraudObjects = 0;
+
+// the program that draws the shadow map, and the map, drawn again only
+// when the light or an object moves
+GLuint shadowShader;
+ShadowMap shadowMap;
+
 // program IDs...for shader programs
 // bottomShader for textured objects
 // meshShader for normal objects
 GLuint textureShader, phongShader;
 
+// every object in drawing order, with its buffers and material setup
+SceneObject sceneObjects[] = {
+    { OBJ_SLAB,   "slab",   &slabBuffers,   setUpSlab },
+    { OBJ_CHEESE, "cheese", &cheeseBuffers, setUpCheese },
+    { OBJ_GRAPES, "grapes", &grapesBuffers, setUpGrapes },
+    { OBJ_GLASS,  "glass",  &glassBuffers,  setUpGlass },
+    { OBJ_BOTTLE, "bottle", &bottleBuffers, setUpBottle },
+    { OBJ_MUG,    "mug",    &mugBuffers,    setUpMug },
+    { OBJ_BOTTOM, "cloth",  &bottomBuffers, setUpBottom },
+    { OBJ_ROOM,   "room",   &roomBuffers,   setUpRoom }
+};
+#define SCENE_OBJECTS (int) (sizeof(sceneObjects) / sizeof(*sceneObjects))
+
+// every object's levels of detail, in the same order, and the meshlets
+// of each level
+LodChain sceneLods[SCENE_OBJECTS];
+MeshletSet sceneMeshlets[SCENE_OBJECTS][LOD_LEVELS];
+
+// every object's copies, if it is made of them and instancing is on
+InstanceSet sceneInstances[SCENE_OBJECTS];
+
+// every object's impostor, if it gets one and impostors are on
+Impostor sceneImpostors[SCENE_OBJECTS];
+
+// every object's normal map, once baked, and the level it is onto
+NormalMap sceneNormalMaps[SCENE_OBJECTS];
+int normalMapLevels[SCENE_OBJECTS];
+
+// which objects the last drawScene() shaded per corner, and how many
+// pixels across each untextured one was, if it used the shading LOD
+bool shadedPerCorner[SCENE_OBJECTS];
+float objectPixels[SCENE_OBJECTS];
+
 //
 // createShape() - create vertex and element buffers for a shape
 //
@@ -163,6 +390,245 @@ void createShape( int obj, Canvas &C )
 	}
 }
 
+///
+// bakeOcclusion() - give every object its ambient occlusion, from the
+// cache at occlusionPath if it is up to date, or else baked on all
+// threads and saved there
+///
+void bakeOcclusion( void )
+{
+    ThreadPool pool( cpuThreads );
+    OcclusionBaker baker( pool );
+    BufferSet *sets[SCENE_OBJECTS];
+
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        sets[i] = sceneObjects[i].buffers;
+    }
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        int splits = baker.refine( *sets[i], sets, SCENE_OBJECTS, *canvas );
+        if( splits > 0 ) {
+            printf( "occlusion: split the %s's triangles %d times, to %d\n",
+                sceneObjects[i].name, splits, sets[i]->numElements / 3 );
+        }
+    }
+    baker.build( sets, SCENE_OBJECTS );
+
+    vector< vector<float> > values;
+    if( access( occlusionPath, F_OK ) == 0 &&
+        baker.load( occlusionPath, values ) ) {
+        printf( "occlusion: read from %s\n", occlusionPath );
+    } else {
+        values.resize( SCENE_OBJECTS );
+        double totalMs = baker.buildMs;
+        printf( "occlusion: %d rays per vertex, BVH built in %.1f ms\n",
+            baker.rays, baker.buildMs );
+        for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+            double ms = baker.bake( i, values[i] );
+            printf( "occlusion: %-6s %6d vertices in %7.1f ms\n",
+                sceneObjects[i].name, sets[i]->numElements, ms );
+            totalMs += ms;
+        }
+        printf( "occlusion: baked in %.1f ms on %d threads\n", totalMs,
+            pool.size() );
+        if( baker.save( occlusionPath, values ) ) {
+            printf( "occlusion: saved to %s\n", occlusionPath );
+        }
+    }
+
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        sets[i]->addOcclusion( values[i].data() );
+    }
+}
+
+// (defined with the drawing functions below)
+void selectBuffers( GLuint program, BufferSet &B );
+
+///
+// getsImpostor(obj) - is an object one of those that get impostors?
+///
+bool getsImpostor( int obj )
+{
+    for( size_t k = 0; k < sizeof(impostorCandidates) / sizeof(int); k++ ) {
+        if( obj == impostorCandidates[k] ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+///
+// bakeImpostors() - draw the views of the objects that get impostors,
+// then let go of the buffers buildInstances() kept for them; once only
+///
+void bakeImpostors( void )
+{
+    if( impostorsBaked ) {
+        return;
+    }
+    double totalMs = 0.0;
+    long bytes = 0;
+    int count = 0;
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        if( !getsImpostor( S.obj ) ) {
+            continue;
+        }
+        // the views look from as far away as the still-life camera is
+        const BufferSet &B = *S.buffers;
+        GLfloat model[16], c[3];
+        modelMatrix( model, sceneScale, &angles[S.obj], sceneTranslate );
+        for( int k = 0; k < 3; k++ ) {
+            c[k] = model[k] * B.center[0] + model[4 + k] * B.center[1] +
+                   model[8 + k] * B.center[2] + model[12 + k] - cameraEye[k];
+        }
+        float from = sqrtf( c[0] * c[0] + c[1] * c[1] + c[2] * c[2] ) /
+                     (B.radius * sceneScale[0]);
+
+        Impostor &P = sceneImpostors[i];
+        selectBuffers( impostorBakeShader, *S.buffers );
+        if( P.bake( impostorBakeShader, B, from ) ) {
+            totalMs += P.bakeMs;
+            bytes += P.gpuBytes();
+            count++;
+        }
+        if( sceneInstances[i].instances > 0 ) {
+            BufferSet &B = *S.buffers;
+            glDeleteBuffers( 1, &B.vbuffer );
+            glDeleteBuffers( 1, &B.ebuffer );
+            B.vbuffer = B.ebuffer = 0;
+        }
+    }
+    impostorsBaked = true;
+    printf( "impostors: %d baked, %d views of %dx%d, %.0f KB of textures,"
+        " in %.1f ms\n", count, IMPOSTOR_VIEWS * IMPOSTOR_VIEWS,
+        IMPOSTOR_TILE, IMPOSTOR_TILE, bytes / 1024.0, totalMs );
+}
+
+///
+// buildInstances() - find the objects made of copies of one part; they
+// are drawn instanced, and their own vertex buffers are let go, but for
+// those that get impostors not yet baked (see bakeImpostors())
+///
+void buildInstances( void )
+{
+    vector<float> positions;
+    vector<unsigned int> indices;
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        BufferSet &B = *sceneObjects[i].buffers;
+        InstanceSet &I = sceneInstances[i];
+        if( !loadMeshData( shapeFile( sceneObjects[i].obj ), positions,
+                           indices ) || !I.build( indices, B, *canvas ) ) {
+            continue;
+        }
+        long fullBytes = B.vSize + B.cSize + B.nSize + B.oSize + B.eSize;
+        printf( "instances: %-6s %d copies of %d triangles, %.0f KB of"
+            " buffers instead of %.0f KB, in %.1f ms\n", sceneObjects[i].name,
+            I.instances, I.prototype.numElements / 3, I.gpuBytes() / 1024.0,
+            fullBytes / 1024.0, I.buildMs );
+        if( !impostorsBaked && getsImpostor( sceneObjects[i].obj ) ) {
+            continue;
+        }
+        glDeleteBuffers( 1, &B.vbuffer );
+        glDeleteBuffers( 1, &B.ebuffer );
+        B.vbuffer = B.ebuffer = 0;
+    }
+}
+
+///
+// buildLods() - make every object's levels of detail
+///
+void buildLods( void )
+{
+    static const float fractions[] = { 0.5f, 0.25f, 0.1f };
+    double totalMs = 0.0;
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        LodChain &L = sceneLods[i];
+        L.build( *sceneObjects[i].buffers, fractions,
+                 sizeof(fractions) / sizeof(*fractions), *canvas );
+        totalMs += L.buildMs;
+        if( L.levels < 2 ) {
+            continue;
+        }
+        printf( "lod: %-6s", sceneObjects[i].name );
+        for( int l = 0; l < L.levels; l++ ) {
+            printf( " %6d", L.triangles[l] );
+        }
+        printf( " triangles, largest error %.2g of radius %.2g\n",
+            L.error[L.levels - 1], L.radius );
+    }
+    printf( "lod: built in %.1f ms\n", totalMs );
+}
+
+///
+// bakeNormalMaps() - bake the normal maps of the objects that get
+// them, on all threads, onto the coarsest of their levels that does not
+// cross their walls; once only
+///
+void bakeNormalMaps( void )
+{
+    if( normalMapsBaked ) {
+        return;
+    }
+    ThreadPool pool( cpuThreads );
+    double totalMs = 0.0;
+    long bytes = 0;
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        const LodChain &L = sceneLods[i];
+        bool candidate = false;
+        for( size_t k = 0; k < sizeof(normalMapCandidates) / sizeof(int);
+             k++ ) {
+            candidate = candidate || S.obj == normalMapCandidates[k];
+        }
+        NormalMap &N = sceneNormalMaps[i];
+        for( int l = candidate ? L.levels - 1 : 0; l > 0; l-- ) {
+            if( !N.bake( *S.buffers, *L.buffers[l], pool ) ) {
+                break;
+            }
+            totalMs += N.bakeMs;
+            double crossed = (double) N.crossed / max( N.baked, 1L );
+            if( crossed > NMAP_MAX_CROSSED && l > 1 ) {
+                printf( "normal maps: %-6s level %d lies across its walls at"
+                    " %.1f%% of its texels, in %.1f ms\n", S.name, l,
+                    100.0 * crossed, N.bakeMs );
+                N.release();
+                continue;
+            }
+            normalMapLevels[i] = l;
+            printf( "normal maps: %-6s level %d, %6d vertices instead of"
+                " %6d, %dx%d texels, %.1f%% of %ld found the full mesh,"
+                " in %.1f ms\n", S.name, l, L.buffers[l]->numElements,
+                S.buffers->numElements, N.size, N.size,
+                100.0 * N.hits / max( N.baked, 1L ), N.baked, N.bakeMs );
+            bytes += N.gpuBytes();
+            break;
+        }
+    }
+    normalMapsBaked = true;
+    printf( "normal maps: %.0f KB of textures and buffers, baked in %.1f ms"
+        " on %d threads\n", bytes / 1024.0, totalMs, pool.size() );
+}
+
+///
+// buildMeshlets() - cut every level of every object into meshlets
+///
+void buildMeshlets( void )
+{
+    double totalMs = 0.0;
+    int count = 0;
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const LodChain &L = sceneLods[i];
+        for( int l = sceneInstances[i].instances > 0 ? 1 : 0;
+             l < L.levels; l++ ) {
+            MeshletSet &M = sceneMeshlets[i][l];
+            M.build( *L.buffers[l] );
+            totalMs += M.buildMs;
+            count += (int) M.meshlets.size();
+        }
+    }
+    printf( "meshlets: %d built in %.1f ms\n", count, totalMs );
+}
+
 ///
 // OpenGL initialization
 ///
@@ -180,7 +646,8 @@ void init( void )
     // Load shaders, verifying each
     // texture shader files for textured objects
     ShaderError error;
-    textureShader = shaderSetup( "texture.vert", "texture.frag", &error );
+    textureShader = shaderSetupShared( "texture.vert", NULL, "texture.frag",
+        SHADOW_LOOKUP, &error );
     if( !textureShader ) {
         cerr << "Error setting up texture shader - " <<
             errorString(error) << endl;
@@ -189,13 +656,73 @@ void init( void )
     }
 
     // phong shader files for non-textured objects
-    phongShader = shaderSetup( "phong.vert", "phong.frag", &error );
+    phongShader = shaderSetupSharedVertex( "phong.vert", INSTANCE_PLACEMENT,
+        NULL, "phong.frag", SHADOW_LOOKUP, &error );
     if( !phongShader ) {
         cerr << "Error setting up phong shader - " <<
             errorString(error) << endl;
         glfwTerminate();
         exit( 1 );
     }
+    InstanceSet::bindUnits( phongShader );
+
+    // impostor shader files, to bake the views and to draw them
+    impostorBakeShader = shaderSetup( "impostorBake.vert",
+        "impostorBake.frag", &error );
+    if( !impostorBakeShader || !Impostor::bindOutputs( impostorBakeShader ) ) {
+        cerr << "Error setting up impostor baking shader - " <<
+            errorString(error) << endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    impostorShader = shaderSetupShared( "impostor.vert", NULL,
+        "impostor.frag", SHADOW_LOOKUP, &error );
+    if( !impostorShader ) {
+        cerr << "Error setting up impostor shader - " <<
+            errorString(error) << endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    Impostor::bindUnits( impostorShader );
+
+    // normal map shader files, for the coarse copies of objects
+    normalMapShader = shaderSetupShared( "normalMap.vert", NULL,
+        "normalMap.frag", SHADOW_LOOKUP, &error );
+    if( !normalMapShader ) {
+        cerr << "Error setting up normal map shader - " <<
+            errorString(error) << endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    NormalMap::bindUnits( normalMapShader );
+
+    // gouraud shader files, for small untextured objects
+    gouraudShader = shaderSetupSharedVertex( "gouraud.vert",
+        INSTANCE_PLACEMENT, NULL, "gouraud.frag", SHADOW_LOOKUP, &error );
+    if( !gouraudShader ) {
+        cerr << "Error setting up gouraud shader - " <<
+            errorString(error) << endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    InstanceSet::bindUnits( gouraudShader );
+
+    // shadow map shader files, and the shadow map's unit in every
+    // program that receives shadows
+    shadowShader = shaderSetupSharedVertex( "shadow.vert",
+        INSTANCE_PLACEMENT, NULL, "shadow.frag", NULL, &error );
+    if( !shadowShader ) {
+        cerr << "Error setting up shadow map shader - " <<
+            errorString(error) << endl;
+        glfwTerminate();
+        exit( 1 );
+    }
+    InstanceSet::bindUnits( shadowShader );
+    ShadowMap::bindUnits( phongShader );
+    ShadowMap::bindUnits( textureShader );
+    ShadowMap::bindUnits( impostorShader );
+    ShadowMap::bindUnits( normalMapShader );
+    ShadowMap::bindUnits( gouraudShader );
 	
     // Other OpenGL initialization
     glEnable( GL_DEPTH_TEST );
@@ -213,6 +740,21 @@ void init( void )
     createShape( OBJ_MUG, *canvas );
     createShape( OBJ_BOTTOM, *canvas );
     createShape( OBJ_ROOM, *canvas );
+
+    if( occlusionPath != NULL ) {
+        bakeOcclusion();
+    }
+    if( settings.impostors ) {
+        bakeImpostors();
+    }
+    if( instancingEnabled ) {
+        buildInstances();
+    }
+    buildLods();
+    buildMeshlets();
+    if( settings.normalMaps ) {
+        bakeNormalMaps();
+    }
 }
 
 ///
@@ -256,361 +798,1007 @@ void selectBuffers( GLuint program, BufferSet &B ) {
         glVertexAttribPointer( vTexCoord, 2, GL_FLOAT, GL_FALSE, 0,
                                BUFFER_OFFSET(offset) );
         offset += B.tSize;
+    } else {
+        // don't leave another object's texture coordinates enabled for
+        // a program that reads them (the multi-view shaders)
+        GLint vTexCoord = glGetAttribLocation( program, "vTexCoord" );
+        if( vTexCoord >= 0 ) {
+            glDisableVertexAttribArray( vTexCoord );
+        }
+    }
+
+    // ambient occlusion data; without it, none
+    GLint vOcclusion = glGetAttribLocation( program, "vOcclusion" );
+    if( vOcclusion >= 0 ) {
+        if( B.oSize ) {
+            glEnableVertexAttribArray( vOcclusion );
+            glVertexAttribPointer( vOcclusion, 1, GL_FLOAT, GL_FALSE, 0,
+                                   BUFFER_OFFSET(offset) );
+            offset += B.oSize;
+        } else {
+            glDisableVertexAttribArray( vOcclusion );
+            glVertexAttrib1f( vOcclusion, 1.0f );
+        }
     }
 }
 
 ///
-// Display callback
-//
-// Invoked whenever the image must be redrawn
+// sceneView() - the camera and the objects' rotations the next frame
+// shows
 ///
-void display( void )
+SceneView sceneView( void )
 {
-    // clear and draw params..
-    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
-    
-    // Set up lights
-    glUseProgram( phongShader );
-	setUpLight(	phongShader, sceneLightColor[0],	sceneLightColor[1],	sceneLightColor[2],
-				lightPosition[0],	lightPosition[1],	lightPosition[2],
-				sceneAmbColor[0],	sceneAmbColor[1],	sceneAmbColor[2]);
-				
-    glUseProgram( textureShader );
-	setUpLight(	textureShader, sceneLightColor[0],	sceneLightColor[1],	sceneLightColor[2],
-				lightPosition[0],	lightPosition[1],	lightPosition[2],
-				sceneAmbColor[0],	sceneAmbColor[1],	sceneAmbColor[2]);
-	
-    // =========================draw the Cheese=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpSlab( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_SLAB], angles[OBJ_SLAB+1], angles[OBJ_SLAB+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( phongShader, slabBuffers );
-    glDrawElements( GL_TRIANGLES, slabBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-        
-    // =========================draw the Cheese=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpCheese( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_CHEESE], angles[OBJ_CHEESE+1], angles[OBJ_CHEESE+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( phongShader, cheeseBuffers );
-    glDrawElements( GL_TRIANGLES, cheeseBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-        
-    // =========================draw the Grapes=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpGrapes( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_GRAPES], angles[OBJ_GRAPES+1], angles[OBJ_GRAPES+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( phongShader, grapesBuffers );
-    glDrawElements( GL_TRIANGLES, grapesBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-    
-    // =========================draw the Glass=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpGlass( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_GLASS], angles[OBJ_GLASS+1], angles[OBJ_GLASS+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( phongShader, glassBuffers );
-    glDrawElements( GL_TRIANGLES, glassBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-    
-    // =========================draw the Bottle=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpBottle( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_BOTTLE], angles[OBJ_BOTTLE+1], angles[OBJ_BOTTLE+2],
-        1.55f, 0.5f, -1.5f 
-    );
-    // draw it
-    selectBuffers( phongShader, bottleBuffers );
-    glDrawElements( GL_TRIANGLES, bottleBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-        
-    // =========================draw the Mug=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpMug( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_MUG], angles[OBJ_MUG+1], angles[OBJ_MUG+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( phongShader, mugBuffers );
-    glDrawElements( GL_TRIANGLES, mugBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-        
-    // =========================draw the Table=====================
-    
-    glUseProgram( textureShader );
-    // set up viewing and projection parameters
-    setUpFrustum( textureShader );
-    // set up the Phong shading information
-    setUpBottom( textureShader );
-    // set up the camera
-    setUpCamera( textureShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f	
-    );
-    setUpTransforms( textureShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_BOTTOM], angles[OBJ_BOTTOM+1], angles[OBJ_BOTTOM+2],
-        1.55f, 0.5f, -1.5f 	
-    );
-    // draw it
-    selectBuffers( textureShader, bottomBuffers );
-    glDrawElements( GL_TRIANGLES, bottomBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
-        
-    // =========================draw the Room=====================
-    
-    glUseProgram( phongShader );
-    // set up viewing and projection parameters
-    setUpFrustum( phongShader );
-    // set up the Phong shading information
-    setUpRoom( phongShader );
-    // set up the camera
-    setUpCamera( phongShader,
-        1.55f, 2.2f, 5.5f,
-        1.55f, 1.0f, 0.0f,
-        0.0f, 2.0f, 0.0f
-    );
-    setUpTransforms( phongShader,
-        5.0f, 5.0f, 5.0f,
-        angles[OBJ_ROOM], angles[OBJ_ROOM+1], angles[OBJ_ROOM+2],
-        1.55f, 0.5f, -1.5f 
-    );
-    // draw it
-    selectBuffers( phongShader, roomBuffers );
-    glDrawElements( GL_TRIANGLES, roomBuffers.numElements,
-        GL_UNSIGNED_INT, (void *)0 );
+    SceneView V;
+    memcpy( V.eye, cameraEye, sizeof(V.eye) );
+    memcpy( V.lookAt, cameraLookAt, sizeof(V.lookAt) );
+    memcpy( V.up, cameraUp, sizeof(V.up) );
+    memcpy( V.angles, angles, sizeof(V.angles) );
+    V.animating = animating;
+    memcpy( V.lightColor, sceneLightColor, sizeof(V.lightColor) );
+    return V;
 }
 
 ///
-// Rotate all the objects in the given direction.
+// setSceneView(V) - show another camera and rotations from the next
+// frame on
 //
-// @param direction - GLSL program object.
+// @param V - the view to show
 ///
-void rotateAllObjects(int direction)
+void setSceneView( const SceneView &V )
 {
-	for(int i = 0; i < (sizeof(angles)/sizeof(*angles)) - 3; i+=3)
-	{
-			if(direction == 1)
-				angles[i+0] += 1.5f;
-			if(direction == 2)
-				angles[i+1] += 1.5f;
-			if(direction == 3)
-				angles[i+2] += 1.5f;
-			if(direction == 4)
-				angles[i+0] -= 1.5f;
-			if(direction == 5)
-				angles[i+1] -= 1.5f;
-			if(direction == 6)
-				angles[i+2] -= 1.5f;
-	}
+    memcpy( cameraEye, V.eye, sizeof(cameraEye) );
+    memcpy( cameraLookAt, V.lookAt, sizeof(cameraLookAt) );
+    memcpy( cameraUp, V.up, sizeof(cameraUp) );
+    memcpy( angles, V.angles, sizeof(angles) );
+    animating = V.animating;
+    memcpy( sceneLightColor, V.lightColor, sizeof(sceneLightColor) );
 }
 
 ///
-// reset all the objects in default direction and lighting.
+// sceneParts() - what init() set up that the runs of Benchmarks.h draw
+// with
 ///
-void resetAllObjects( void )
+const SceneParts &sceneParts( void )
 {
-	stopR = false;
-	stopR = false;
-	stopR = false;
-	sceneLightColor[0] = 1.0;
-	sceneLightColor[1] = 1.0;
-	sceneLightColor[2] = 1.0;
-	lightPosition[0] = -1.2;
-	lightPosition[1] = 2.5;
-	lightPosition[2] = 1.0;
-	sceneAmbColor[0] = 1.0;
-	sceneAmbColor[1] = 1.0;
-	sceneAmbColor[2] = 0.0;
-	for(int i = 0; i < sizeof(angles)/sizeof(*angles); i++)
-	{
-		angles[i] = 0.0f;
-	}
+    static SceneParts P;
+    P.width = w_width;
+    P.height = w_height;
+    P.cpuPool = cpuPool;
+    P.rasterizer = rasterizer;
+    P.rayTracer = rayTracer;
+    P.picker = &picker;
+    P.objects = sceneObjects;
+    P.objectCount = SCENE_OBJECTS;
+    P.scale = sceneScale;
+    P.translate = sceneTranslate;
+    P.cpuThreads = cpuThreads;
+    P.lods = sceneLods;
+    P.phong = phongShader;
+    P.texture = textureShader;
+    P.meshlets = sceneMeshlets;
+    P.instances = sceneInstances;
+    P.canvas = canvas;
+    P.impostors = sceneImpostors;
+    P.normalMaps = sceneNormalMaps;
+    P.normalMapLevels = normalMapLevels;
+    P.normalMap = normalMapShader;
+    P.shadowMap = &shadowMap;
+    return P;
 }
 
 ///
-// Keyboard callback
+// sceneStats() - what the last drawScene() drew
+///
+const SceneStats &sceneStats( void )
+{
+    static SceneStats S;
+    S.drawnTriangles = drawnTriangles;
+    S.visibleObjects = visibleObjects;
+    S.culledObjects = culledObjects;
+    S.occludedObjects = occludedObjects;
+    S.hizCullMs = hizCullMs;
+    S.hizTriangles = hizTriangles;
+    S.hizReady = hizReady;
+    S.hizLate = hizLate;
+    S.impostorObjects = impostorObjects;
+    S.gouraudObjects = gouraudObjects;
+    S.shadedPerCorner = shadedPerCorner;
+    S.objectPixels = objectPixels;
+    return S;
+}
+
+///
+// setUpLightAndFrustum() - send the light and projection parameters
+// to a program and make it current.
 //
-// We don't need to distinguish between (e.g.) 'a' and 'A', so
-// we can use the simpler form of callback
+// @param program - GLSL program object
 ///
-void keyboard( GLFWwindow *window, int key, int scan, int action, int mods )
+void setUpLightAndFrustum( GLuint program )
 {
-    switch( key & 0x7f ) {
+    glUseProgram( program );
+    setUpLight( program, sceneLightColor[0], sceneLightColor[1],
+                sceneLightColor[2], lightPosition[0], lightPosition[1],
+                lightPosition[2], sceneAmbColor[0], sceneAmbColor[1],
+                sceneAmbColor[2] );
+    // set up viewing and projection parameters
+    setUpFrustum( program );
+}
 
-	// termination
-        case 033:  // Escape key
-        case 'q': case 'Q':
-            glfwSetWindowShouldClose( window, 1 );
+///
+// setUpScene() - send the per-frame state shared by every object
+// drawn with a program: light, projection, camera and shadows.
+//
+// @param program - GLSL program object
+// @param R       - the drawing options; the shadows are left out unless
+//                  R.shadows
+///
+void setUpScene( GLuint program, const RenderSettings &R )
+{
+    setUpLightAndFrustum( program );
+    // set up the camera
+    setUpCamera( program,
+        cameraEye[0], cameraEye[1], cameraEye[2],
+        cameraLookAt[0], cameraLookAt[1], cameraLookAt[2],
+        cameraUp[0], cameraUp[1], cameraUp[2]
+    );
+    GLfloat view[16];
+    viewMatrix( view, cameraEye, cameraLookAt, cameraUp );
+    shadowMap.setUp( program, R.shadows ? view : NULL );
+}
 
-	// automated animation
-        case 'a': case 'A':
-	    animating = true;
-	    break;
-	    
+///
+// updateShadows() - draw the shadow map again if the light or any
+// object has moved since it was last drawn
+//
+// @return true if it was drawn
+///
+bool updateShadows( void )
+{
+    ShadowCaster casters[SCENE_OBJECTS];
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        casters[i].buffers = S.buffers;
+        casters[i].copies = sceneInstances[i].instances > 0 ?
+                            &sceneInstances[i] : NULL;
+        modelMatrix( casters[i].model, sceneScale, &angles[S.obj],
+                     sceneTranslate );
+    }
+    return shadowMap.update( shadowShader, lightPosition, casters,
+                             SCENE_OBJECTS );
+}
+
+///
+// drawObject() - set up the material and transformations for one
+// object and draw it.  setUpScene() must already have been called for
+// the program this frame.
+//
+// @param program  - GLSL program object
+// @param material - function that sends the object's material
+// @param B        - the object's BufferSet
+// @param obj      - the object's ID (OBJ_SLAB etc.)
+// @param M        - B's meshlets, culled for this frame, to draw
+//                   instead of all of B; or NULL
+// @param I        - B's copies, to draw instanced instead of B; or NULL
+// @param P        - the object's impostor, to draw instead of B, with
+//                   the view choose() picked; or NULL
+// @param N        - the normal map baked for B, to draw B with; or NULL
+// @param noSpecular - leave out the specular term (see
+//                   negligibleSpecular())
+///
+void drawObject( GLuint program, void (*material)( GLuint ),
+                 BufferSet &B, int obj, const MeshletSet *M,
+                 InstanceSet *I, const Impostor *P, const NormalMap *N,
+                 bool noSpecular )
+{
+    glUseProgram( program );
+    // set up the Phong shading information
+    material( program );
+    GLint specLoc = glGetUniformLocation( program, "noSpecular" );
+    if( specLoc >= 0 ) {
+        glUniform1i( specLoc, noSpecular );
+    }
+    // identify the object to the G-buffer shaders
+    GLint idLoc = glGetUniformLocation( program, "objectId" );
+    if( idLoc >= 0 ) {
+        glUniform1ui( idLoc, obj );
+    }
+    setUpTransforms( program,
+        sceneScale[0], sceneScale[1], sceneScale[2],
+        angles[obj], angles[obj+1], angles[obj+2],
+        sceneTranslate[0], sceneTranslate[1], sceneTranslate[2]
+    );
+    // draw it
+    if( P != NULL ) {
+        P->draw( program );
+        return;
+    }
+    selectBuffers( program, I != NULL ? I->prototype : B );
+    if( N != NULL ) {
+        N->draw( program );
+    } else if( I != NULL ) {
+        I->draw( program );
+    } else if( M != NULL ) {
+        M->draw();
+    } else {
+        glDrawElements( GL_TRIANGLES, B.numElements,
+            GL_UNSIGNED_INT, (void *)0 );
+    }
+}
+
+///
+// screenScale() - pixels covered by one unit at unit distance from the
+// camera, for the current viewport
+///
+float screenScale( void )
+{
+    GLfloat frustum[6];
+    GLint viewport[4];
+    getFrustum( frustum );
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    return viewport[3] * frustum[4] / (frustum[2] - frustum[3]);
+}
+
+///
+// screenWidth(model,B,pixelsPerUnit) - pixels across the screen that
+// the bounding sphere of an object covers, seen from the camera
+// (cameraEye); infinite if the camera is inside it
+//
+// @param model         - the object's model matrix (column-major)
+// @param B             - the object's BufferSet
+// @param pixelsPerUnit - see screenScale()
+///
+float screenWidth( const float *model, const BufferSet &B,
+                   float pixelsPerUnit )
+{
+    float scale;
+    float distance = sphereFromEye( model, cameraEye, B.center, &scale,
+                                    NULL );
+    if( distance <= B.radius * scale ) {
+        return HUGE_VALF;
+    }
+    return 2.0f * B.radius * scale * pixelsPerUnit / distance;
+}
+
+///
+// selectLods(levels,R,angleSet) - choose every object's level of
+// detail for the current camera and viewport
+//
+// @param levels   - receives a level per object; all 0 unless R.lod
+// @param R        - the drawing options
+// @param angleSet - the objects' rotations (see 'angles')
+///
+void selectLods( int *levels, const RenderSettings &R,
+                 const float *angleSet = angles )
+{
+    float pixelsPerUnit = screenScale();
+
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        levels[i] = 0;
+        if( R.lod ) {
+            float model[16];
+            modelMatrix( model, sceneScale, &angleSet[S.obj], sceneTranslate );
+            levels[i] = sceneLods[i].select( model, cameraEye, pixelsPerUnit );
+        }
+    }
+}
+
+///
+// Step the disco lights: raise the light's red, then green, then blue
+// intensity, each back to dim once it is full.
+///
+void cycleLightColor( void ) {
+	if(!stopR)
+	{
+		stopG = true;
+		stopB = true;
+		sceneLightColor[0] += 0.1f;
+		if(sceneLightColor[0] > 1.0)
+		{
+			stopR = true;
+			stopG = false;
+			sceneLightColor[0] = 0.05f;
+		}
+	}
+	
+	if(!stopG)
+	{
+		sceneLightColor[1] += 0.1f;
+		if(sceneLightColor[1] > 1.0)
+		{
+			stopG = true;
+			stopB = false;
+			sceneLightColor[1] = 0.05f;
+		}
+	}
+	
+	if(!stopB)
+	{
+		sceneLightColor[2] += 0.1f;
+		if(sceneLightColor[2] > 1.0)
+		{
+			stopB = true;
+			sceneLightColor[2] = 0.05f;
+		}
+	}
+	
+	if(stopR && stopB && stopG)
+	{
+		stopR = false;
+		stopB = false; 
+		stopG = false; 
+	}
+}
+
+///
+// turnObjects(angleSet) - turn every object but the room by one step
+// of the animation
+///
+void turnObjects( float *angleSet )
+{
+    for( int i = 0; i < OBJ_ROOM; i++ ) {
+        angleSet[i] += ANIMATION_STEP;
+    }
+}
+
+///
+// describeFrame(F,angleSet,levels) - describe a frame from the current
+// camera and viewport to the Hi-Z culler
+//
+// @param F        - receives the frame
+// @param angleSet - the objects' rotations (see 'angles')
+// @param levels   - each object's level of detail (see selectLods())
+///
+void describeFrame( HiZFrame &F, const float *angleSet, const int *levels )
+{
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    F.width = viewport[2];
+    F.height = viewport[3];
+    GLfloat view[16], projection[16];
+    viewMatrix( view, cameraEye, cameraLookAt, cameraUp );
+    projectionMatrix( projection );
+    multiplyMatrices( F.viewProjection, projection, view );
+
+    F.objects.resize( SCENE_OBJECTS );
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        const LodChain &L = sceneLods[i];
+        HiZObject &O = F.objects[i];
+        modelMatrix( O.model, sceneScale, &angleSet[S.obj], sceneTranslate );
+
+        // occluders as they will be drawn
+        O.occluder = NULL;
+        for( size_t k = 0; k < sizeof(hizOccluders) / sizeof(int); k++ ) {
+            if( S.obj == hizOccluders[k] ) {
+                O.occluder = levels[i] > 0 ? L.buffers[levels[i]] : S.buffers;
+            }
+        }
+
+        // the box around every level, whichever is drawn
+        memcpy( O.boxMin, S.buffers->boxMin, sizeof(O.boxMin) );
+        memcpy( O.boxMax, S.buffers->boxMax, sizeof(O.boxMax) );
+        for( int l = 1; l < L.levels; l++ ) {
+            for( int k = 0; k < 3; k++ ) {
+                O.boxMin[k] = min( O.boxMin[k], L.buffers[l]->boxMin[k] );
+                O.boxMax[k] = max( O.boxMax[k], L.buffers[l]->boxMax[k] );
+            }
+        }
+    }
+}
+
+///
+// findOccluded(levels) - have the Hi-Z culler's results for the frame
+// about to be drawn: those of the frame culled ahead of time if it is
+// this one, or else this one's, culled now
+//
+// @param levels - each object's level of detail (see selectLods())
+///
+void findOccluded( const int *levels )
+{
+    HiZFrame now;
+    describeFrame( now, angles, levels );
+    if( hizStarted ) {
+        hiz.wait();
+        hizStarted = false;
+    }
+    if( !hiz.occluded.empty() && sameFrame( hiz.frame, now ) ) {
+        hizReady++;
+    } else {
+        hiz.frame = now;
+        hiz.cull();
+        hizLate++;
+    }
+    hizCullMs = hiz.rasterMs + hiz.testMs;
+    hizTriangles = hiz.triangles;
+}
+
+///
+// cullAhead(R) - start culling, on the culler's thread, the frame that
+// follows this one if nothing but the animation changes
+//
+// @param R - the drawing options the frame is drawn with
+///
+void cullAhead( const RenderSettings &R )
+{
+    float next[sizeof(angles) / sizeof(*angles)];
+    memcpy( next, angles, sizeof(next) );
+    if( animating ) {
+        turnObjects( next );
+    }
+
+    // the levels it will have, without moving the levels' hysteresis
+    int levels[SCENE_OBJECTS], current[SCENE_OBJECTS];
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        current[i] = sceneLods[i].current;
+    }
+    selectLods( levels, R, next );
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        sceneLods[i].current = current[i];
+    }
+
+    if( hizStarted ) {
+        hiz.wait();
+    }
+    describeFrame( hiz.frame, next, levels );
+    hiz.start();
+    hizStarted = true;
+}
+
+///
+// drawScene() - draw all eight objects
+//
+// @param phong   - program for the untextured objects
+// @param texture - program for the table cloth
+// @param levels  - each object's level of detail (see selectLods()), or
+//                  NULL for full detail; with levels, the objects
+//                  wholly outside the view of the camera (cameraEye)
+//                  are left out if R.culling, those hidden behind the
+//                  occluders if R.hiz, those small enough drawn as
+//                  impostors (with impostorShader) if R.impostors,
+//                  those with normal maps drawn as the level they were
+//                  baked onto (with normalMapShader) if R.normalMaps,
+//                  the meshlets of the others culled if R.meshlets, and
+//                  those untextured ones narrower than
+//                  R.shadingLodPixels shaded per corner (with
+//                  gouraudShader) if R.shadingLod.  Objects made of
+//                  copies are drawn instanced in full detail.
+// @param R       - the drawing options
+///
+void drawScene( GLuint phong, GLuint texture, const int *levels,
+                const RenderSettings &R )
+{
+    bool cull = levels != NULL && R.meshlets;
+    bool cullObjects = levels != NULL && R.culling;
+    bool occlude = levels != NULL && R.hiz;
+    bool impostors = levels != NULL && R.impostors;
+    bool normalMaps = levels != NULL && R.normalMaps;
+    bool shading = levels != NULL && R.shadingLod;
+    if( occlude ) {
+        findOccluded( levels );
+    }
+    float pixelsPerUnit = impostors || shading ? screenScale() : 0.0f;
+    GLfloat frustum[6], view[16], planes[24];
+    if( cull || cullObjects ) {
+        getFrustum( frustum );
+        viewMatrix( view, cameraEye, cameraLookAt, cameraUp );
+        frustumPlanes( planes, frustum );
+    }
+
+    drawnTriangles = 0;
+    visibleObjects = culledObjects = occludedObjects = impostorObjects = 0;
+    gouraudObjects = 0;
+    memset( shadedPerCorner, 0, sizeof(shadedPerCorner) );
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        int level = levels != NULL ? levels[i] : 0;
+        BufferSet &B = level > 0 ? *sceneLods[i].buffers[level] : *S.buffers;
+        InstanceSet *I = level == 0 && sceneInstances[i].instances > 0 ?
+                         &sceneInstances[i] : NULL;
+        GLfloat model[16];
+        if( cull || cullObjects || impostors || shading ) {
+            modelMatrix( model, sceneScale, &angles[S.obj], sceneTranslate );
+        }
+        if( cullObjects && B.radius >= 0.0f ) {
+            GLfloat modelView[16];
+            multiplyMatrices( modelView, view, model );
+            if( !boundsInFrustum( planes, modelView, B.center, B.radius,
+                                  B.boxMin, B.boxMax ) ) {
+                culledObjects++;
+                continue;
+            }
+        }
+        if( occlude && hiz.occluded[i] ) {
+            occludedObjects++;
+            continue;
+        }
+        visibleObjects++;
+        bool noSpecular = shading &&
+            negligibleSpecular( getMaterial( S.obj ), sceneLightColor );
+        if( impostors &&
+            sceneImpostors[i].choose( model, cameraEye, pixelsPerUnit ) ) {
+            impostorObjects++;
+            drawObject( impostorShader, S.material, B, S.obj, NULL, NULL,
+                        &sceneImpostors[i], NULL, noSpecular );
+            drawnTriangles += 2;
+            continue;
+        }
+        const NormalMap &N = sceneNormalMaps[i];
+        if( normalMaps && N.texture != 0 ) {
+            BufferSet &proxy = *sceneLods[i].buffers[normalMapLevels[i]];
+            drawObject( normalMapShader, S.material, proxy, S.obj, NULL,
+                        NULL, NULL, &N, noSpecular );
+            drawnTriangles += proxy.numElements / 3;
+            continue;
+        }
+        MeshletSet *M = NULL;
+        if( cull && I == NULL ) {
+            M = &sceneMeshlets[i][level];
+            M->cull( model, view, frustum, cameraEye );
+        }
+        GLuint program = phong;
+        if( getMaterial( S.obj )->textured ) {
+            program = texture;
+        } else if( shading ) {
+            objectPixels[i] = screenWidth( model, *S.buffers, pixelsPerUnit );
+            if( objectPixels[i] < R.shadingLodPixels ) {
+                program = gouraudShader;
+                shadedPerCorner[i] = true;
+                gouraudObjects++;
+            }
+        }
+        drawObject( program, S.material, B, S.obj, M, I, NULL, NULL,
+                    noSpecular );
+        drawnTriangles += M != NULL ? M->drawnTriangles : B.numElements / 3;
+    }
+}
+
+///
+// Display callback
+//
+// Invoked whenever the image must be redrawn
+//
+// @param R - the drawing options ('settings' for the window)
+///
+void display( const RenderSettings &R )
+{
+    // the shadows, if anything has moved
+    if( R.shadows ) {
+        updateShadows();
+    }
+
+    // clear and draw params..
+    glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+    // Set up lights, projection, camera and shadows once per program
+    setUpScene( phongShader, R );
+    setUpScene( textureShader, R );
+    if( R.impostors ) {
+        setUpScene( impostorShader, R );
+    }
+    if( R.normalMaps ) {
+        setUpScene( normalMapShader, R );
+    }
+    if( R.shadingLod ) {
+        setUpScene( gouraudShader, R );
+    }
+
+    int levels[SCENE_OBJECTS];
+    selectLods( levels, R );
+    drawScene( phongShader, textureShader, levels, R );
+
+    // find the next frame's hidden objects while this one is drawn
+    if( R.hiz ) {
+        cullAhead( R );
+    }
+}
+
+///
+// initCPU() - start the CPU renderers' threads and load their copy of
+// the cloth texture
+//
+// @return true on success
+///
+bool initCPU( void )
+{
+    if( rasterizer != NULL ) {
+        return true;
+    }
+    if( !clothImage.load( CLOTH_TEXTURE ) ) {
+        return false;
+    }
+    cpuPool = new ThreadPool( cpuThreads );
+    rasterizer = new Rasterizer( *cpuPool );
+    rayTracer = new RayTracer( *cpuPool );
+    cerr << "CPU renderers: " << cpuPool->size() << " threads" << endl;
+    return true;
+}
+
+///
+// displayCPU() - draw the scene with the CPU rasterizer into its
+// current frame (see Rasterizer::resize())
+///
+void displayCPU( void )
+{
+    rasterizer->setCamera( cameraEye, cameraLookAt, cameraUp );
+    rasterizer->setLight( sceneLightColor, lightPosition, sceneAmbColor );
+
+    rasterizer->begin();
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        rasterizer->draw( *S.buffers, getMaterial( S.obj ), &clothImage,
+                          sceneScale, &angles[S.obj], sceneTranslate );
+    }
+    rasterizer->render();
+}
+
+///
+// queueScene(T) - give a ray tracer the camera, light and objects
+///
+void queueScene( RayTracer &T )
+{
+    T.setCamera( cameraEye, cameraLookAt, cameraUp );
+    T.setLight( sceneLightColor, lightPosition, sceneAmbColor );
+
+    T.begin();
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        T.draw( *S.buffers, getMaterial( S.obj ), &clothImage,
+                sceneScale, &angles[S.obj], sceneTranslate );
+    }
+}
+
+///
+// displayRayTraced(T) - trace the scene with a ray tracer into its
+// current frame (see RayTracer::resize())
+///
+void displayRayTraced( RayTracer &T )
+{
+    queueScene( T );
+    T.render();
+}
+
+///
+// resizeCPU(w,h) - set the frame size of the CPU renderer in use
+//
+// @return true if the size is supported
+///
+bool resizeCPU( int w, int h )
+{
+    return useRayTracer ? rayTracer->resize( w, h ) :
+                          rasterizer->resize( w, h );
+}
+
+///
+// drawCPU() - draw the scene with the CPU renderer in use
+//
+// @return its frame, bottom row first
+///
+const uint32_t *drawCPU( void )
+{
+    if( useRayTracer ) {
+        displayRayTraced( *rayTracer );
+        return rayTracer->pixels.data();
+    }
+    displayCPU();
+    return rasterizer->pixels.data();
+}
+
+///
+// stopService() - SIGINT/SIGTERM handler for the render service
+///
+void stopService( int )
+{
+    serviceStop = true;
+}
+
+///
+// updatePicker() - bring the picker up to date with the objects and
+// camera as they are drawn now
+///
+void updatePicker( void )
+{
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        const SceneObject &S = sceneObjects[i];
+        picker.add( S.obj, *S.buffers );
+        picker.place( S.obj, sceneScale, &angles[S.obj], sceneTranslate );
+    }
+    picker.setCamera( cameraEye, cameraLookAt, cameraUp );
+}
+
+///
+// objectName(obj) - the name of an object, for reports
+///
+const char *objectName( int obj )
+{
+    for( int i = 0; i < SCENE_OBJECTS; i++ ) {
+        if( sceneObjects[i].obj == obj ) {
+            return sceneObjects[i].name;
+        }
+    }
+    return "nothing";
+}
+
+///
+// serviceBatch() - render service callback: prepare an offscreen
+// target (or the CPU renderer's frame) for a run of w x h requests.
+//
+// @return false if it could not be made
+///
+bool serviceBatch( int w, int h )
+{
+    if( useCPU ) {
+        return resizeCPU( w, h );
+    }
+    if( !offscreen.resize( w, h ) ) {
+        return false;
+    }
+    offscreen.bind();
+    return true;
+}
+
+///
+// serviceRender() - render service callback: draw one request into
+// the current offscreen target and read back the pixels.
+///
+void serviceRender( const RenderRequest &req, unsigned char *pixels )
+{
+    memcpy( cameraEye, req.eye, sizeof(cameraEye) );
+    memcpy( cameraLookAt, req.lookAt, sizeof(cameraLookAt) );
+    memcpy( cameraUp, req.up, sizeof(cameraUp) );
+    memcpy( angles, req.angles, sizeof(angles) );
+    memcpy( sceneLightColor, req.lightColor, sizeof(sceneLightColor) );
+    memcpy( lightPosition, req.lightPosition, sizeof(lightPosition) );
+    memcpy( sceneAmbColor, req.ambientColor, sizeof(sceneAmbColor) );
+
+    if( useCPU ) {
+        int w = useRayTracer ? rayTracer->width : rasterizer->width;
+        int h = useRayTracer ? rayTracer->height : rasterizer->height;
+        memcpy( pixels, drawCPU(), (size_t) w * h * sizeof(uint32_t) );
+    } else {
+        display( settings );
+        offscreen.readPixels( pixels );
+    }
+}
+
+///
+// publishFrame() - read the frame just drawn straight into the next
+// slot of the shared-memory ring and hand it to the consumers.
+///
+void publishFrame( void )
+{
+    glPixelStorei( GL_PACK_ALIGNMENT, 1 );
+    glReadPixels( 0, 0, w_width, w_height, GL_RGBA, GL_UNSIGNED_BYTE,
+        frameRing.beginFrame() );
+    frameRing.publish();
+}
+
+///
+// Rotate the selected object, or all the objects if none is selected,
+// by a step about one axis.
+//
+// @param direction - the axis and sign, as keys 1-6 give them: 1, 2
+//                    and 3 turn about x, y and z, 4, 5 and 6 back
+///
+void rotateObjects(int direction)
+{
+	for(int i = 0; i < (sizeof(angles)/sizeof(*angles)) - 3; i+=3)
+	{
+			if(selectedObject >= 0 && i != selectedObject)
+				continue;
+			if(direction == 1)
+				angles[i+0] += 1.5f;
+			if(direction == 2)
+				angles[i+1] += 1.5f;
+			if(direction == 3)
+				angles[i+2] += 1.5f;
+			if(direction == 4)
+				angles[i+0] -= 1.5f;
+			if(direction == 5)
+				angles[i+1] -= 1.5f;
+			if(direction == 6)
+				angles[i+2] -= 1.5f;
+	}
+}
+
+///
+// reset all the objects in default direction and lighting.
+///
+void resetAllObjects( void )
+{
+	stopR = false;
+	stopR = false;
+	stopR = false;
+	sceneLightColor[0] = 1.0;
+	sceneLightColor[1] = 1.0;
+	sceneLightColor[2] = 1.0;
+	lightPosition[0] = -1.2;
+	lightPosition[1] = 2.5;
+	lightPosition[2] = 1.0;
+	sceneAmbColor[0] = 1.0;
+	sceneAmbColor[1] = 1.0;
+	sceneAmbColor[2] = 0.0;
+	for(int i = 0; i < sizeof(angles)/sizeof(*angles); i++)
+	{
+		angles[i] = 0.0f;
+	}
+}
+
+///
+// Keyboard callback
+//
+// We don't need to distinguish between (e.g.) 'a' and 'A', so
+// we can use the simpler form of callback
+///
+void keyboard( GLFWwindow *window, int key, int scan, int action, int mods )
+{
+    switch( key & 0x7f ) {
+
+	// termination
+        case 033:  // Escape key
+        case 'q': case 'Q':
+            glfwSetWindowShouldClose( window, 1 );
+
+	// automated animation
+        case 'a': case 'A':
+	    animating = true;
+	    break;
+	    
         case 's': case 'S':    // stop animating
         animating = false;
         break;
 
 	// incremental rotation along the axes
-        case '1': rotateAllObjects(1); 
-        break;
-        case '2': rotateAllObjects(2); 
-        break;
-        case '3': rotateAllObjects(3); 
-        break;
-        case '4': rotateAllObjects(4);  
-        break;
-        case '5': rotateAllObjects(5);
-        break;
-        case '6': rotateAllObjects(6);
-        break;
+		case '1':
+			rotateObjects(1);
+			break;
+		case '2':
+			rotateObjects(2);
+			break;
+		case '3':
+			rotateObjects(3);
+			break;
+		case '4':
+			rotateObjects(4);
+			break;
+		case '5':
+			rotateObjects(5);
+			break;
+		case '6':
+			rotateObjects(6);
+			break;
 
 	// reset
 		case 'r': case 'R':    // reset rotations
 			resetAllObjects();
 			break;
+
+	// levels of detail
+		case 'l': case 'L':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.lod = !settings.lod;
+			printf( "levels of detail %s\n", settings.lod ? "on" : "off" );
+			break;
+
+	// meshlet culling
+		case 'm': case 'M':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.meshlets = !settings.meshlets;
+			printf( "meshlet culling %s\n", settings.meshlets ? "on" : "off" );
+			break;
+
+	// culling the objects outside the view
+		case 'f': case 'F':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.culling = !settings.culling;
+			printf( "object culling %s\n", settings.culling ? "on" : "off" );
+			break;
+
+	// culling the objects hidden behind others
+		case 'h': case 'H':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.hiz = !settings.hiz;
+			printf( "occlusion culling %s\n", settings.hiz ? "on" : "off" );
+			break;
+
+	// impostors for small, distant objects, baked the first time
+		case 'i': case 'I':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.impostors = !settings.impostors;
+			if( settings.impostors && !impostorsBaked ) {
+				bakeImpostors();
+			}
+			printf( "impostors %s\n", settings.impostors ? "on" : "off" );
+			break;
+
+	// coarse copies with normal maps, baked the first time
+		case 'n': case 'N':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.normalMaps = !settings.normalMaps;
+			if( settings.normalMaps && !normalMapsBaked ) {
+				bakeNormalMaps();
+			}
+			printf( "normal maps %s\n", settings.normalMaps ? "on" : "off" );
+			break;
+
+	// per-corner shading of small objects
+		case 'g': case 'G':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.shadingLod = !settings.shadingLod;
+			printf( "shading level of detail %s\n",
+				settings.shadingLod ? "on" : "off" );
+			break;
+
+	// shadows of the light
+		case 'o': case 'O':
+			if( action != GLFW_PRESS ) {
+				break;
+			}
+			settings.shadows = !settings.shadows;
+			printf( "shadows %s\n", settings.shadows ? "on" : "off" );
+			break;
     }
 
     updateDisplay = true;
 }
 
+///
+// Mouse button callback: pick the object under the cursor and select
+// it, or select all of them if it is the room or nothing
+///
+void mouseButton( GLFWwindow *window, int button, int action, int mods )
+{
+    if( button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS ) {
+        return;
+    }
+
+    double x, y;
+    int w, h;
+    glfwGetCursorPos( window, &x, &y );
+    glfwGetWindowSize( window, &w, &h );
+    if( w < 1 || h < 1 ) {
+        return;
+    }
+
+    // the cursor's y runs down from the top
+    uint64_t start = monotonicNs();
+    updatePicker();
+    PickHit H;
+    bool hit = picker.pick( x / w, 1.0 - y / h, H );
+    double ms = elapsedMs( start );
+
+    if( hit ) {
+        printf( "picked %s (object %d), triangle %d at (%.3f, %.3f, %.3f)"
+            " in %.3f ms\n", objectName( H.object ), H.object, H.triangle,
+            H.point[0], H.point[1], H.point[2], ms );
+    } else {
+        printf( "picked nothing in %.3f ms\n", ms );
+    }
+    selectedObject = hit && H.object != OBJ_ROOM ? H.object : -1;
+}
+
 ///
 // Animate (rotate in all directions) the objects.
 // Try different colors as well along with that.
 ///
 void animate( void ) {
     if( animating ) {
-		
-		if(!stopR)
-		{
-			stopG = true;
-			stopB = true;
-			sceneLightColor[0] += 0.1f;
-			if(sceneLightColor[0] > 1.0)
-			{
-				stopR = true;
-				stopG = false;
-				sceneLightColor[0] = 0.05f;
-			}
-		}
-		
-		if(!stopG)
-		{
-			sceneLightColor[1] += 0.1f;
-			if(sceneLightColor[1] > 1.0)
-			{
-				stopG = true;
-				stopB = false;
-				sceneLightColor[1] = 0.05f;
-			}
-		}
-		
-		if(!stopB)
-		{
-			sceneLightColor[2] += 0.1f;
-			if(sceneLightColor[2] > 1.0)
-			{
-				stopB = true;
-				sceneLightColor[2] = 0.05f;
-			}
-		}
-		
-		if(stopR && stopB && stopG)
-		{
-			stopR = false;
-			stopB = false; 
-			stopG = false; 
-		}
-		
-		for(int i = 0; i < (sizeof(angles)/sizeof(*angles)) - 3; i++)
-		{
-			angles[i] += 0.5f;
-		}
+		cycleLightColor();
+		turnObjects( angles );
         updateDisplay = true;
     }
 }
@@ -629,6 +1817,67 @@ void glfwError( int code, const char *desc )
 ///
 int main( int argc, char **argv ) {
 
+    // the drawing options that leave the image as it is, on unless the
+    // command line turns them off; the others are turned on by it
+    settings.meshlets = settings.culling = true;
+    settings.hiz = settings.shadows = true;
+
+    bool badOption = false;
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[i], "-shm" ) == 0 && i + 1 < argc ) {
+            shmName = argv[++i];
+        } else if( strcmp( argv[i], "-animate" ) == 0 ) {
+            animating = true;
+        } else if( strcmp( argv[i], "-serve" ) == 0 && i + 1 < argc ) {
+            servePath = argv[++i];
+        } else if( strcmp( argv[i], "-cache" ) == 0 && i + 1 < argc ) {
+            serveCacheMB = atol( argv[++i] );
+        } else if( strcmp( argv[i], "-cpu" ) == 0 ) {
+            useCPU = true;
+        } else if( strcmp( argv[i], "-raytrace" ) == 0 ) {
+            useCPU = true;
+            useRayTracer = true;
+        } else if( strcmp( argv[i], "-threads" ) == 0 && i + 1 < argc ) {
+            cpuThreads = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-occlusion" ) == 0 && i + 1 < argc ) {
+            occlusionPath = argv[++i];
+        } else if( strcmp( argv[i], "-noocclusion" ) == 0 ) {
+            occlusionPath = NULL;
+        } else if( strcmp( argv[i], "-lod" ) == 0 ) {
+            settings.lod = true;
+        } else if( strcmp( argv[i], "-nomeshlets" ) == 0 ) {
+            settings.meshlets = false;
+        } else if( strcmp( argv[i], "-noinstancing" ) == 0 ) {
+            instancingEnabled = false;
+        } else if( strcmp( argv[i], "-nocull" ) == 0 ) {
+            settings.culling = false;
+        } else if( strcmp( argv[i], "-nohiz" ) == 0 ) {
+            settings.hiz = false;
+        } else if( strcmp( argv[i], "-impostors" ) == 0 ) {
+            settings.impostors = true;
+        } else if( strcmp( argv[i], "-normalmaps" ) == 0 ) {
+            settings.normalMaps = true;
+        } else if( strcmp( argv[i], "-shadinglod" ) == 0 && i + 1 < argc ) {
+            settings.shadingLod = true;
+            settings.shadingLodPixels = atof( argv[++i] );
+        } else if( strcmp( argv[i], "-noshadows" ) == 0 ) {
+            settings.shadows = false;
+        } else if( !benchOption( argc, argv, i ) ) {
+            badOption = true;
+            break;
+        }
+    }
+
+    if( badOption || !benchValid() || cpuThreads < 0 ||
+        !(settings.shadingLodPixels > 0.0f) ) {
+        cerr << "usage: " << argv[0] << " [-shm name] [-animate]"
+            " [-serve socket [-cache MB]] [-cpu | -raytrace] [-threads N]"
+            " [-occlusion file | -noocclusion] [-lod] [-nomeshlets]"
+            " [-noinstancing] [-nocull] [-nohiz] [-impostors] [-normalmaps]"
+            " [-shadinglod P] [-noshadows]" << benchUsage() << endl;
+        exit( 1 );
+    }
+
     glfwSetErrorCallback( glfwError );
 
     if( !glfwInit() ) {
@@ -644,6 +1893,11 @@ int main( int argc, char **argv ) {
     // glfwWindowHint( GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE );
     // glfwWindowHint( GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE );
 
+    // the render service and the benchmarks draw offscreen only
+    if( servePath != NULL || benchRequested() ) {
+        glfwWindowHint( GLFW_VISIBLE, GL_FALSE );
+    }
+
     GLFWwindow *window = glfwCreateWindow( w_width, w_height,
         "Check README section in finalMain.cpp for controls", NULL, NULL );
 
@@ -684,13 +1938,63 @@ int main( int argc, char **argv ) {
 
     init();
 
+    if( useCPU && !initCPU() ) {
+        glfwTerminate();
+        exit( 1 );
+    }
+
+    if( benchRequested() ) {
+        runBenchmarks( settings );
+        glfwDestroyWindow( window );
+        glfwTerminate();
+        return 0;
+    }
+
+    if( servePath != NULL ) {
+        RenderService service( serviceBatch, serviceRender,
+                               (uint64_t) serveCacheMB << 20 );
+        if( !service.listen( servePath ) ) {
+            glfwTerminate();
+            exit( 1 );
+        }
+        signal( SIGINT, stopService );
+        signal( SIGTERM, stopService );
+        service.run( &serviceStop );
+
+        glfwDestroyWindow( window );
+        glfwTerminate();
+        return 0;
+    }
+
+    if( shmName != NULL ) {
+        if( !frameRing.create( shmName, w_width, w_height, 4 ) ) {
+            glfwTerminate();
+            exit( 1 );
+        }
+        cerr << "publishing frames to shared memory " << shmName << endl;
+    }
+
     glfwSetKeyCallback( window, keyboard );
+    glfwSetMouseButtonCallback( window, mouseButton );
 
     while( !glfwWindowShouldClose(window) ) {
         animate();
         if( updateDisplay ) {
             updateDisplay = false;
-            display();
+            if( useCPU ) {
+                // draw on the CPU and copy the result into the window
+                resizeCPU( w_width, w_height );
+                const uint32_t *frame = drawCPU();
+                glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+                glWindowPos2i( 0, 0 );
+                glDrawPixels( w_width, w_height, GL_RGBA, GL_UNSIGNED_BYTE,
+                              frame );
+            } else {
+                display( settings );
+            }
+            if( shmName != NULL ) {
+                publishFrame();
+            }
             glfwSwapBuffers( window );
         }
         glfwPollEvents();
@@ -0,0 +1,276 @@
+//
+//  frameConsumer.cpp
+//
+//  Reference consumer for the shared-memory frame ring published by
+//  "finalMain -shm <name>".  Frames are read in place from the shared
+//  mapping; nothing is copied out of the ring unless -dump is given.
+//
+//  USAGE:
+//      frameConsumer [-n frames] [-dump file.ppm] <name>
+//          attach to a running renderer and report per-frame latency
+//          (publish to read complete) and throughput
+//
+//      frameConsumer -bench [-w width] [-h height] [-n frames]
+//                    [-slots n] [-fps rate]
+//          transport benchmark: fork a synthetic producer that fills
+//          frames as fast as it can (or at 'rate' frames/s) and
+//          measure the ring alone, without any rendering cost
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include <unistd.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "FrameRing.h"
+
+using namespace std;
+
+///
+// Consumer-side statistics
+///
+struct Stats {
+    vector<double> latencyUs;   // publish -> read complete
+    uint64_t frames;            // frames read successfully
+    uint64_t skipped;           // frames published but never looked at
+    uint64_t torn;              // frames overwritten while being read
+    uint64_t bytes;             // pixel bytes read
+    uint64_t checksum;          // keeps the reads from being optimized out
+};
+
+///
+// readFrame() - walk every pixel of a frame in place
+//
+// @return false if the producer overwrote the frame mid-read
+///
+static bool readFrame( FrameRing &ring, uint64_t frame, Stats &S )
+{
+    uint64_t stamp = ring.readBegin( frame );
+    if( stamp == 0 ) {
+        return false;
+    }
+
+    const FrameSlot *slot = ring.slot( frame );
+    uint64_t published = slot->timestampNs;
+    uint64_t n = ring.header()->frameBytes / sizeof(uint64_t);
+    const uint64_t *words = (const uint64_t *) ring.pixels( frame );
+
+    uint64_t sum = 0;
+    for( uint64_t i = 0; i < n; i++ ) {
+        sum += words[i];
+    }
+
+    if( !ring.readValid( frame, stamp ) ) {
+        return false;
+    }
+
+    S.checksum += sum;
+    S.bytes += ring.header()->frameBytes;
+    S.latencyUs.push_back( (monotonicNs() - published) / 1000.0 );
+    S.frames++;
+    return true;
+}
+
+///
+// dumpFrame() - write a frame as a binary PPM (top row first)
+///
+static void dumpFrame( FrameRing &ring, uint64_t frame, const char *path )
+{
+    FrameRingHeader *H = ring.header();
+    FILE *fp = fopen( path, "wb" );
+    if( fp == NULL ) {
+        perror( path );
+        return;
+    }
+
+    fprintf( fp, "P6\n%u %u\n255\n", H->width, H->height );
+    const unsigned char *px = ring.pixels( frame );
+    for( int y = (int) H->height - 1; y >= 0; y-- ) {
+        const unsigned char *row = px + (uint64_t) y * H->width * 4;
+        for( uint32_t x = 0; x < H->width; x++ ) {
+            fwrite( row + x * 4, 1, 3, fp );
+        }
+    }
+    fclose( fp );
+}
+
+///
+// report() - print the statistics gathered over 'seconds'
+///
+static void report( Stats &S, double seconds )
+{
+    sort( S.latencyUs.begin(), S.latencyUs.end() );
+
+    printf( "frames read:   %llu  (skipped %llu, torn %llu)\n",
+        (unsigned long long) S.frames, (unsigned long long) S.skipped,
+        (unsigned long long) S.torn );
+    printf( "latency (us):  p50 %.1f  p99 %.1f  max %.1f\n",
+        percentile( S.latencyUs.data(), S.latencyUs.size(), 0.50 ),
+        percentile( S.latencyUs.data(), S.latencyUs.size(), 0.99 ),
+        S.latencyUs.empty() ? 0.0 : S.latencyUs.back() );
+    if( seconds > 0.0 ) {
+        printf( "throughput:    %.1f frames/s  %.1f MB/s\n",
+            S.frames / seconds, S.bytes / seconds / 1.0e6 );
+    }
+    printf( "checksum:      %016llx\n", (unsigned long long) S.checksum );
+}
+
+///
+// consume() - follow the ring until 'count' more frames have been
+//     published, reading the newest one each time we wake up
+///
+static void consume( FrameRing &ring, uint64_t count, Stats &S,
+                     const char *dump )
+{
+    uint64_t seen = ring.latest();
+    uint64_t last = seen + count;
+    uint64_t start = 0;
+
+    while( seen < last ) {
+        uint64_t newest = ring.waitFor( seen, 5000 );
+        if( newest == 0 ) {
+            cerr << "frameConsumer: no frame for 5 seconds, giving up" <<
+                endl;
+            break;
+        }
+        if( start == 0 ) {
+            start = monotonicNs();
+        }
+
+        // always jump to the newest frame; older ones are stale
+        S.skipped += newest - seen - 1;
+        if( readFrame( ring, newest, S ) ) {
+            if( dump != NULL ) {
+                dumpFrame( ring, newest, dump );
+                dump = NULL;
+            }
+        } else {
+            S.torn++;
+        }
+        seen = newest;
+    }
+
+    double seconds = start ? (monotonicNs() - start) / 1.0e9 : 0.0;
+    report( S, seconds );
+}
+
+///
+// produce() - synthetic producer for -bench; runs in a child process
+///
+static void produce( const char *name, uint64_t count, double fps )
+{
+    FrameRing ring;
+    if( !ring.attach( name ) ) {
+        _exit( 1 );
+    }
+    uint64_t bytes = ring.header()->frameBytes;
+    uint64_t period = fps > 0.0 ? (uint64_t) (1.0e9 / fps) : 0;
+    uint64_t next = monotonicNs();
+
+    // a few extra frames so the consumer never waits on the last one
+    for( uint64_t i = 1; i <= count + 8; i++ ) {
+        unsigned char *px = ring.beginFrame();
+        // the same traffic a glReadPixels() into the slot would cause
+        memset( px, (int) (i & 0xff), bytes );
+        ring.publish();
+
+        if( period ) {
+            next += period;
+            uint64_t now = monotonicNs();
+            if( next > now ) {
+                usleep( (next - now) / 1000 );
+            }
+        }
+    }
+    _exit( 0 );
+}
+
+///
+// main program for the reference consumer
+///
+int main( int argc, char **argv )
+{
+    bool bench = false;
+    int width = 800, height = 800, slots = 4;
+    uint64_t count = 1000;
+    double fps = 0.0;
+    const char *dump = NULL;
+    const char *name = NULL;
+
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[i], "-bench" ) == 0 ) {
+            bench = true;
+        } else if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+            count = strtoull( argv[++i], NULL, 10 );
+        } else if( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) {
+            width = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-h" ) == 0 && i + 1 < argc ) {
+            height = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-slots" ) == 0 && i + 1 < argc ) {
+            slots = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-fps" ) == 0 && i + 1 < argc ) {
+            fps = atof( argv[++i] );
+        } else if( strcmp( argv[i], "-dump" ) == 0 && i + 1 < argc ) {
+            dump = argv[++i];
+        } else if( argv[i][0] != '-' ) {
+            name = argv[i];
+        } else {
+            cerr << "usage: " << argv[0] <<
+                " [-n frames] [-dump file.ppm] name" << endl;
+            cerr << "       " << argv[0] << " -bench [-w width] [-h height]"
+                " [-n frames] [-slots n] [-fps rate]" << endl;
+            exit( 1 );
+        }
+    }
+
+    FrameRing ring;
+    Stats S;
+    S.frames = S.skipped = S.torn = S.bytes = S.checksum = 0;
+    S.latencyUs.reserve( count );
+
+    if( !bench ) {
+        if( name == NULL ) {
+            cerr << "frameConsumer: no ring name given" << endl;
+            exit( 1 );
+        }
+        if( !ring.attach( name ) ) {
+            exit( 1 );
+        }
+        FrameRingHeader *H = ring.header();
+        printf( "attached to %s: %ux%u, %u slots, producer pid %u\n",
+            name, H->width, H->height, H->slotCount, H->producerPid );
+        consume( ring, count, S, dump );
+        return 0;
+    }
+
+    // benchmark: we own the ring, a child process writes into it
+    char benchName[64];
+    snprintf( benchName, sizeof(benchName), "/frameRingBench.%d",
+        (int) getpid() );
+    if( !ring.create( benchName, width, height, slots ) ) {
+        exit( 1 );
+    }
+    printf( "transport benchmark: %dx%d RGBA, %d slots, %llu frames\n",
+        width, height, slots, (unsigned long long) count );
+
+    pid_t child = fork();
+    if( child < 0 ) {
+        perror( "fork" );
+        exit( 1 );
+    }
+    if( child == 0 ) {
+        produce( benchName, count, fps );
+    }
+
+    consume( ring, count, S, dump );
+    kill( child, SIGTERM );
+    waitpid( child, NULL, 0 );
+
+    return 0;
+}
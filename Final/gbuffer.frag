@@ -0,0 +1,58 @@
+#version 150
+
+// G-buffer fragment shader for objects with no textures
+//
+// Shades exactly as phong.frag, and also writes the eye-space depth,
+// normal and object ID to the other G-buffer targets (see GBuffer.h).
+
+uniform vec4 ambMatColor;
+uniform vec4 diffMatColor;
+uniform vec4 specMatColor;
+
+uniform float ambRefCoeff;
+uniform float diffRefCoeff;
+uniform float specRefCoeff;
+uniform float specExponent;
+
+uniform vec4 lightSourceColor;
+uniform vec4 lightSourcePosition;
+uniform vec4 sceneAmbLightColor;
+
+uniform uint objectId;
+
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
+// INCOMING DATA
+in vec3 normal;
+in vec3 light;
+in vec3 viewing;
+in float occlusion;
+
+// OUTGOING DATA
+out vec4 finalColor;
+out float fragDepth;
+out vec3 fragNormal;
+out uint fragObject;
+
+void main()
+{
+	//Compute vectors N, L, V, and R.
+	vec3 vectorN = normalize( normal );
+	vec3 vectorV = normalize( viewing );
+	vec3 vectorL = normalize( light - viewing);
+	vec3 vectorR = normalize( reflect( vectorL, vectorN));		//reflect
+	
+	//Apply Ambient, Diffuse and Specular lighting.
+	vec4 amb = ambMatColor * ambRefCoeff  * sceneAmbLightColor * occlusion;
+	vec4 dif = diffMatColor * diffRefCoeff* max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
+	vec4 spec = specMatColor * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
+	
+	//Result
+    finalColor = amb + (dif + spec) * lightReaching( viewing, light, dot( vectorN, vectorL ) );
+
+	// Geometry
+	fragDepth = -viewing.z;
+	fragNormal = vectorN;
+	fragObject = objectId;
+}
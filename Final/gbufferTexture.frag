@@ -0,0 +1,59 @@
+#version 150
+
+// G-buffer fragment shader for the table
+//
+// Shades exactly as texture.frag, and also writes the eye-space depth,
+// normal and object ID to the other G-buffer targets (see GBuffer.h).
+
+uniform float ambRefCoeff;
+uniform float diffRefCoeff;
+uniform float specRefCoeff;
+uniform float specExponent;
+
+uniform vec4 lightSourceColor;
+uniform vec4 sceneAmbLightColor;
+
+uniform sampler2D clothTexture;
+
+uniform uint objectId;
+
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
+in vec3 normal;
+in vec3 light;
+in vec3 viewing;
+in vec2 texCoordinates;
+in float occlusion;
+
+out vec4 finalColor;
+out float fragDepth;
+out vec3 fragNormal;
+out uint fragObject;
+
+void main()
+{
+	// Convert texture in vector
+	vec4 tex = texture(clothTexture, texCoordinates);
+	
+	// Compute vector N, facing the viewer on both sides of the cloth
+	vec3 vectorN = normalize( gl_FrontFacing ? normal : -normal );
+	
+	// Compute other vectors
+	vec3 vectorV = normalize( viewing );
+	vec3 vectorL = normalize( light - viewing );
+	vec3 vectorR = normalize( reflect( vectorL, vectorN) );
+	
+	//Apply Ambient, Diffuse and Specular lighting to quad.
+	vec4 amb = tex * ambRefCoeff * sceneAmbLightColor * occlusion;
+	vec4 dif = tex * diffRefCoeff * max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
+	vec4 spec = tex * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
+	
+	//Result
+    finalColor = amb + (dif + spec) * lightReaching( viewing, light, dot( vectorN, vectorL ) );
+
+	// Geometry
+	fragDepth = -viewing.z;
+	fragNormal = vectorN;
+	fragObject = objectId;
+}
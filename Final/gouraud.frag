@@ -0,0 +1,23 @@
+#version 150
+
+// Gouraud fragment shader for small objects with no textures: the
+// colors gouraud.vert found at the corners, blended across the
+// triangle, with the light the shadow map lets through
+
+// INCOMING DATA
+in vec4 ambient;
+in vec4 lit;
+in vec3 viewing;
+in vec3 light;
+in float facing;
+
+// OUTGOING DATA
+out vec4 finalColor;
+
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
+void main()
+{
+    finalColor = ambient + lit * lightReaching( viewing, light, facing );
+}
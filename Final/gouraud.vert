@@ -0,0 +1,159 @@
+#version 150
+
+// Gouraud vertex shader for small objects with no textures: the same
+// ambient, diffuse and specular terms as phong.frag, evaluated once
+// per corner instead of once per pixel (see shadingLodPixels in
+// finalMain.cpp)
+
+// INCOMING DATA
+
+// Vertex location (in model space)
+in vec4 vPosition;
+
+// Normal vector at vertex (in model space)
+in vec3 vNormal;
+
+// Ambient occlusion at vertex (see Occlusion.h)
+in float vOcclusion;
+
+// Model transformations
+uniform vec3 theta;
+uniform vec3 trans;
+uniform vec3 scale;
+
+// Camera parameters
+uniform vec3 cPosition;
+uniform vec3 cLookAt;
+uniform vec3 cUp;
+
+// View volume boundaries
+uniform float left;
+uniform float right;
+uniform float top;
+uniform float bottom;
+uniform float near;
+uniform float far;
+
+// Material and light, as phong.frag has them
+uniform vec4 ambMatColor;
+uniform vec4 diffMatColor;
+uniform vec4 specMatColor;
+
+uniform float ambRefCoeff;
+uniform float diffRefCoeff;
+uniform float specRefCoeff;
+uniform float specExponent;
+
+uniform vec4 lightSourceColor;
+uniform vec4 lightSourcePosition;
+uniform vec4 sceneAmbLightColor;
+
+// Leave out the specular term, which the material and light make too
+// faint to show (see negligibleSpecular())
+uniform bool noSpecular;
+
+// OUTGOING DATA
+
+// Ambient color of the corner, and the diffuse and specular color
+// that shadows take away; and, for looking shadows up, the corner and
+// the light (in eye space) and how squarely the corner faces the light
+out vec4 ambient;
+out vec4 lit;
+out vec3 viewing;
+out vec3 light;
+out float facing;
+
+// Copies of one part drawn instanced: place a corner of the one being
+// drawn (see instancePlacement.vert)
+void placeCopy( inout vec4 position, inout vec3 normal,
+                inout float occlusion );
+
+void main()
+{
+    // Place this copy's corner where its transformation takes the
+    // prototype's
+    vec4 position = vPosition;
+    vec3 vertexNormal = vNormal;
+    float vertexOcclusion = vOcclusion;
+    placeCopy( position, vertexNormal, vertexOcclusion );
+
+    // Compute the sines and cosines of each rotation about each axis
+    vec3 angles = radians( theta );
+    vec3 c = cos( angles );
+    vec3 s = sin( angles );
+
+    // Create rotation matrices
+    mat4 rxMat = mat4( 1.0,  0.0,  0.0,  0.0,
+                       0.0,  c.x,  s.x,  0.0,
+                       0.0,  -s.x, c.x,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 ryMat = mat4( c.y,  0.0,  -s.y, 0.0,
+                       0.0,  1.0,  0.0,  0.0,
+                       s.y,  0.0,  c.y,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 rzMat = mat4( c.z,  s.z,  0.0,  0.0,
+                       -s.z, c.z,  0.0,  0.0,
+                       0.0,  0.0,  1.0,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 xlateMat = mat4( 1.0,     0.0,     0.0,     0.0,
+                          0.0,     1.0,     0.0,     0.0,
+                          0.0,     0.0,     1.0,     0.0,
+                          trans.x, trans.y, trans.z, 1.0 );
+
+    mat4 scaleMat = mat4( scale.x,  0.0,     0.0,     0.0,
+                          0.0,      scale.y, 0.0,     0.0,
+                          0.0,      0.0,     scale.z, 0.0,
+                          0.0,      0.0,     0.0,     1.0 );
+
+    // Create view matrix
+    vec3 nVec = normalize( cPosition - cLookAt );
+    vec3 uVec = normalize( cross (normalize(cUp), nVec) );
+    vec3 vVec = normalize( cross (nVec, uVec) );
+
+    mat4 viewMat = mat4( uVec.x, vVec.x, nVec.x, 0.0,
+                         uVec.y, vVec.y, nVec.y, 0.0,
+                         uVec.z, vVec.z, nVec.z, 0.0,
+                         -1.0*(dot(uVec, cPosition)),
+                         -1.0*(dot(vVec, cPosition)),
+                         -1.0*(dot(nVec, cPosition)), 1.0 );
+
+    // Create projection matrix
+    mat4 projMat = mat4( (2.0*near)/(right-left), 0.0, 0.0, 0.0,
+                         0.0, ((2.0*near)/(top-bottom)), 0.0, 0.0,
+                         ((right+left)/(right-left)),
+                         ((top+bottom)/(top-bottom)),
+                         ((-1.0*(far+near)) / (far-near)), -1.0,
+                         0.0, 0.0, ((-2.0*far*near)/(far-near)), 0.0 );
+
+    // Transformation order:
+    //    scale, rotate Z, rotate Y, rotate X, translate
+    mat4 modelMat = xlateMat * rxMat * ryMat * rzMat * scaleMat;
+    mat4 modelViewMat = viewMat * modelMat;
+
+    // Shade the corner as phong.frag shades a pixel
+    vec3 normal = vec3(normalize(modelViewMat * vec4(vertexNormal,0.0)));
+    light = vec3(viewMat * lightSourcePosition);
+    viewing = vec3(modelViewMat * position);
+
+    vec3 vectorN = normalize( normal );
+    vec3 vectorV = normalize( viewing );
+    vec3 vectorL = normalize( light - viewing );
+    vec3 vectorR = normalize( reflect( vectorL, vectorN ) );
+
+    ambient = ambMatColor * ambRefCoeff * sceneAmbLightColor *
+              vertexOcclusion;
+    facing = dot( vectorN, vectorL );
+    lit = diffMatColor * diffRefCoeff * max( 0.0, facing ) *
+          lightSourceColor;
+    if( !noSpecular ) {
+        lit += specMatColor * specRefCoeff *
+               pow( max( 0.0, dot( vectorV, vectorR ) ), specExponent ) *
+               lightSourceColor;
+    }
+
+    // Transform the vertex location into clip space
+    gl_Position =  projMat * viewMat  * modelMat * position;
+}
@@ -15,18 +15,23 @@ INCLUDE = -I/usr/include/SOIL
 LIBDIRS =
 
 # common linker options
-LDLIBS = -lSOIL -lGL -lm -lGLEW -lglfw
+LDLIBS = -lSOIL -lGL -lm -lGLEW -lglfw -lrt -pthread
 
 # language-specific linker options
 CLDLIBS =
 CCLDLIBS =
 
+# optimization; -mavx2 -mfma let Simd.h use 256-bit vectors in the
+# CPU renderers (remove them for processors without AVX2 and Simd.h
+# falls back to plain loops)
+OPTFLAGS = -O2 -mavx2 -mfma
+
 # common compiler flags
-COMMONFLAGS = -g $(INCLUDE) -DGL_GLEXT_PROTOTYPES
+COMMONFLAGS = -g $(OPTFLAGS) $(INCLUDE) -DGL_GLEXT_PROTOTYPES
 
 # language-specific compiler flags
 CFLAGS = -std=c99 $(COMMONFLAGS)
-CXXFLAGS = $(COMMONFLAGS)
+CXXFLAGS = -std=c++11 $(COMMONFLAGS)
 
 # linker flags
 LIBFLAGS = -g $(LIBDIRS) $(LDLIBS)
@@ -0,0 +1,79 @@
+#version 150
+
+// Impostor fragment shader
+//
+// Shades the surface an impostor's atlas (see Impostor.h) holds at
+// this point of the quad exactly as phong.frag shades the mesh, and
+// puts it at its own place and depth rather than the quad's.
+
+uniform vec4 ambMatColor;
+uniform vec4 diffMatColor;
+uniform vec4 specMatColor;
+
+uniform float ambRefCoeff;
+uniform float diffRefCoeff;
+uniform float specRefCoeff;
+uniform float specExponent;
+
+uniform vec4 lightSourceColor;
+uniform vec4 lightSourcePosition;
+uniform vec4 sceneAmbLightColor;
+
+// View volume depth boundaries
+uniform float near;
+uniform float far;
+
+// How far, in radii, the view was baked from
+uniform float impostorDistance;
+
+// The atlas: model-space normal and occlusion, and how far in front
+// of the quad the surface is (below -2 where there is none)
+uniform sampler2D impostorNormals;
+uniform sampler2D impostorDepths;
+
+// INCOMING DATA
+in vec2 atlasCoord;
+in vec3 light;
+in vec3 viewing;
+in vec3 bakeEye;
+in mat3 normalMat;
+
+// OUTGOING DATA
+out vec4 finalColor;
+
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
+void main()
+{
+	float offset = texture( impostorDepths, atlasCoord ).r;
+	if( offset < -2.0 ) {
+		discard;
+	}
+	vec4 surface = texture( impostorNormals, atlasCoord );
+
+	// the surface is on the baking ray through this point of the quad,
+	// 'offset' radii in front of it
+	vec3 position = bakeEye + (viewing - bakeEye) *
+		(1.0 - offset / impostorDistance);
+	float occlusion = surface.a;
+
+	//Compute vectors N, L, V, and R.
+	vec3 vectorN = normalize( normalMat * (surface.xyz * 2.0 - 1.0) );
+	vec3 vectorV = normalize( position );
+	vec3 vectorL = normalize( light - position);
+	vec3 vectorR = normalize( reflect( vectorL, vectorN));		//reflect
+	
+	//Apply Ambient, Diffuse and Specular lighting.
+	vec4 amb = ambMatColor * ambRefCoeff  * sceneAmbLightColor * occlusion;
+	vec4 dif = diffMatColor * diffRefCoeff* max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
+	vec4 spec = specMatColor * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
+	
+	//Result
+    finalColor = amb + (dif + spec) * lightReaching( position, light, dot( vectorN, vectorL ) );
+
+	// Depth of the surface: the projection's z over its w, -z
+	float z = position.z;
+	float ndc = ((far + near) * z + 2.0 * far * near) / ((far - near) * z);
+	gl_FragDepth = ndc * 0.5 + 0.5;
+}
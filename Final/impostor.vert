@@ -0,0 +1,127 @@
+#version 150
+
+// Impostor vertex shader, used with impostor.frag
+//
+// Draws the quad of one of an object's impostor views (see Impostor.h):
+// the square around the object's bounding sphere, in the plane of the
+// view, as four vertices numbered by gl_VertexID; and where the view
+// was baked from, for impostor.frag to find the surface.
+
+// Model transformations
+uniform vec3 theta;
+uniform vec3 trans;
+uniform vec3 scale;
+
+// Camera parameters
+uniform vec3 cPosition;
+uniform vec3 cLookAt;
+uniform vec3 cUp;
+
+// View volume boundaries
+uniform float left;
+uniform float right;
+uniform float top;
+uniform float bottom;
+uniform float near;
+uniform float far;
+
+uniform vec4 lightSourcePosition;
+
+// The model-space bounding sphere, the view's axes (right and up in
+// the image, and the direction it looks from), the distance it looks
+// from and the half width of its square (in radii), and where its tile
+// is in the atlas
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform vec3 impostorRight;
+uniform vec3 impostorUp;
+uniform vec3 impostorDir;
+uniform float impostorDistance;
+uniform float impostorHalfWidth;
+uniform vec2 impostorTile;
+uniform float impostorTileSize;
+
+// OUTGOING DATA
+
+out vec2 atlasCoord;
+out vec3 light;
+out vec3 viewing;
+out vec3 bakeEye;
+out mat3 normalMat;
+
+void main()
+{
+    // Corner of the quad
+    vec2 corner = vec2( gl_VertexID & 1, gl_VertexID >> 1 ) * 2.0 - 1.0;
+    vec4 position = vec4( impostorCenter + impostorRadius *
+        impostorHalfWidth * (corner.x * impostorRight +
+        corner.y * impostorUp), 1.0 );
+    atlasCoord = impostorTile + (corner * 0.5 + 0.5) * impostorTileSize;
+
+    // Compute the sines and cosines of each rotation about each axis
+    vec3 angles = radians( theta );
+    vec3 c = cos( angles );
+    vec3 s = sin( angles );
+
+    // Create rotation matrices
+    mat4 rxMat = mat4( 1.0,  0.0,  0.0,  0.0,
+                       0.0,  c.x,  s.x,  0.0,
+                       0.0,  -s.x, c.x,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 ryMat = mat4( c.y,  0.0,  -s.y, 0.0,
+                       0.0,  1.0,  0.0,  0.0,
+                       s.y,  0.0,  c.y,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 rzMat = mat4( c.z,  s.z,  0.0,  0.0,
+                       -s.z, c.z,  0.0,  0.0,
+                       0.0,  0.0,  1.0,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 xlateMat = mat4( 1.0,     0.0,     0.0,     0.0,
+                          0.0,     1.0,     0.0,     0.0,
+                          0.0,     0.0,     1.0,     0.0,
+                          trans.x, trans.y, trans.z, 1.0 );
+
+    mat4 scaleMat = mat4( scale.x,  0.0,     0.0,     0.0,
+                          0.0,      scale.y, 0.0,     0.0,
+                          0.0,      0.0,     scale.z, 0.0,
+                          0.0,      0.0,     0.0,     1.0 );
+
+    // Create view matrix
+    vec3 nVec = normalize( cPosition - cLookAt );
+    vec3 uVec = normalize( cross (normalize(cUp), nVec) );
+    vec3 vVec = normalize( cross (nVec, uVec) );
+
+    mat4 viewMat = mat4( uVec.x, vVec.x, nVec.x, 0.0,
+                         uVec.y, vVec.y, nVec.y, 0.0,
+                         uVec.z, vVec.z, nVec.z, 0.0,
+                         -1.0*(dot(uVec, cPosition)),
+                         -1.0*(dot(vVec, cPosition)),
+                         -1.0*(dot(nVec, cPosition)), 1.0 );
+
+    // Create projection matrix
+    mat4 projMat = mat4( (2.0*near)/(right-left), 0.0, 0.0, 0.0,
+                         0.0, ((2.0*near)/(top-bottom)), 0.0, 0.0,
+                         ((right+left)/(right-left)),
+                         ((top+bottom)/(top-bottom)),
+                         ((-1.0*(far+near)) / (far-near)), -1.0,
+                         0.0, 0.0, ((-2.0*far*near)/(far-near)), 0.0 );
+
+    // Transformation order:
+    //    scale, rotate Z, rotate Y, rotate X, translate
+    mat4 modelMat = xlateMat * rxMat * ryMat * rzMat * scaleMat;
+    mat4 modelViewMat = viewMat * modelMat;
+
+    // Vectors for the fragments: the eye-space point the view was
+    // baked from, and the normals' transform
+    light = vec3(viewMat * lightSourcePosition);
+    viewing = vec3(modelViewMat * position);
+    bakeEye = vec3(modelViewMat * vec4(impostorCenter + impostorDir *
+        impostorRadius * impostorDistance, 1.0));
+    normalMat = mat3(modelViewMat);
+
+    // Transform the vertex location into clip space
+    gl_Position = projMat * viewMat * modelMat * position;
+}
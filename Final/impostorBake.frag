@@ -0,0 +1,22 @@
+#version 150
+
+// Impostor baking fragment shader
+//
+// Writes the model-space normal and ambient occlusion of the surface,
+// and how far in front of the view's plane it is, to an impostor's
+// atlas (see Impostor.h).
+
+// INCOMING DATA
+in vec3 normal;
+in float occlusion;
+in float offset;
+
+// OUTGOING DATA
+out vec4 bakeNormal;
+out float bakeDepth;
+
+void main()
+{
+    bakeNormal = vec4( normalize( normal ) * 0.5 + 0.5, occlusion );
+    bakeDepth = offset;
+}
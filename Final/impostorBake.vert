@@ -0,0 +1,56 @@
+#version 150
+
+// Impostor baking vertex shader, used with impostorBake.frag
+//
+// Draws an object as seen from one of its impostor's views (see
+// Impostor.h): from impostorDistance radii away along impostorDir,
+// with the square around the bounding sphere in the plane through its
+// center filling the viewport.
+
+// INCOMING DATA
+
+// Vertex location (in model space)
+in vec4 vPosition;
+
+// Normal vector at vertex (in model space)
+in vec3 vNormal;
+
+// Ambient occlusion at vertex (see Occlusion.h)
+in float vOcclusion;
+
+// The model-space bounding sphere, the view's axes (right and up in
+// the image, and the direction it looks from), the distance it looks
+// from in radii, and the half width of the square, also in radii
+uniform vec3 impostorCenter;
+uniform float impostorRadius;
+uniform vec3 impostorRight;
+uniform vec3 impostorUp;
+uniform vec3 impostorDir;
+uniform float impostorDistance;
+uniform float impostorHalfWidth;
+
+// OUTGOING DATA
+
+out vec3 normal;
+out float occlusion;
+out float offset;
+
+void main()
+{
+    vec3 p = (vPosition.xyz - impostorCenter) / impostorRadius;
+
+    // how far toward the viewer, as a share of the radius
+    offset = dot( p, impostorDir );
+    normal = vNormal;
+    occlusion = vOcclusion;
+
+    // a frustum from just in front of the sphere to just behind it
+    float z = offset - impostorDistance;
+    float near = impostorDistance - 1.0;
+    float far = impostorDistance + 1.0;
+    float scale = impostorDistance / impostorHalfWidth;
+    gl_Position = vec4( dot( p, impostorRight ) * scale,
+                        dot( p, impostorUp ) * scale,
+                        (-(far + near) * z - 2.0 * far * near) / (far - near),
+                        -z );
+}
@@ -0,0 +1,45 @@
+#version 150
+
+// Placement of the copies of one part drawn instanced, shared by the
+// vertex shaders that draw them (phong.vert, gouraud.vert,
+// multiview.vert and shadow.vert), linked in with each of them by
+// shaderSetupSharedVertex().  See Instances.h.
+
+// Every copy's transformation and its inverse transpose, six texels
+// per copy, the occlusion of every copy's corners, and the corners of
+// one copy (0 when not drawing copies)
+uniform samplerBuffer instanceTransforms;
+uniform samplerBuffer instanceOcclusion;
+uniform int instanceCorners;
+
+// Place this copy's corner where its transformation takes the
+// prototype's; left as it is when not drawing copies
+void placeCopy( inout vec4 position )
+{
+	if( instanceCorners > 0 ) {
+		int texel = 6 * gl_InstanceID;
+		mat4 instanceMat = transpose( mat4(
+			texelFetch( instanceTransforms, texel ),
+			texelFetch( instanceTransforms, texel + 1 ),
+			texelFetch( instanceTransforms, texel + 2 ),
+			vec4( 0.0, 0.0, 0.0, 1.0 ) ) );
+		position = instanceMat * position;
+	}
+}
+
+// As above, with the corner's normal and this copy's occlusion there
+void placeCopy( inout vec4 position, inout vec3 normal,
+                inout float occlusion )
+{
+	if( instanceCorners > 0 ) {
+		placeCopy( position );
+		int texel = 6 * gl_InstanceID;
+		mat3 normalMat = transpose( mat3(
+			texelFetch( instanceTransforms, texel + 3 ).xyz,
+			texelFetch( instanceTransforms, texel + 4 ).xyz,
+			texelFetch( instanceTransforms, texel + 5 ).xyz ) );
+		normal = normalMat * normal;
+		occlusion = texelFetch( instanceOcclusion,
+			gl_InstanceID * instanceCorners + gl_VertexID ).r;
+	}
+}
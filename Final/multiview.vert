@@ -0,0 +1,88 @@
+#version 150
+
+// Multi-view vertex shader, used with multiview.geom
+//
+// Applies the model transformation only; the geometry shader applies
+// each camera's view and projection and sends one copy of every
+// triangle to each layer of the render target.
+
+// INCOMING DATA
+
+// Vertex location (in model space)
+in vec4 vPosition;
+
+// Normal vector at vertex (in model space)
+in vec3 vNormal;
+
+// Texture coordinate for this vertex (textured objects only)
+in vec2 vTexCoord;
+
+// Ambient occlusion at vertex (see Occlusion.h)
+in float vOcclusion;
+
+// Model transformations
+uniform vec3 theta;
+uniform vec3 trans;
+uniform vec3 scale;
+
+// OUTGOING DATA
+
+out vec4 worldPosition;
+out vec3 worldNormal;
+out vec2 worldTexCoord;
+out float worldOcclusion;
+
+// Copies of one part drawn instanced: place a corner of the one being
+// drawn (see instancePlacement.vert)
+void placeCopy( inout vec4 position, inout vec3 normal,
+                inout float occlusion );
+
+void main()
+{
+    // Place this copy's corner where its transformation takes the
+    // prototype's
+    vec4 position = vPosition;
+    vec3 vertexNormal = vNormal;
+    float vertexOcclusion = vOcclusion;
+    placeCopy( position, vertexNormal, vertexOcclusion );
+
+    // Compute the sines and cosines of each rotation about each axis
+    vec3 angles = radians( theta );
+    vec3 c = cos( angles );
+    vec3 s = sin( angles );
+
+    // Create rotation matrices
+    mat4 rxMat = mat4( 1.0,  0.0,  0.0,  0.0,
+                       0.0,  c.x,  s.x,  0.0,
+                       0.0,  -s.x, c.x,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 ryMat = mat4( c.y,  0.0,  -s.y, 0.0,
+                       0.0,  1.0,  0.0,  0.0,
+                       s.y,  0.0,  c.y,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 rzMat = mat4( c.z,  s.z,  0.0,  0.0,
+                       -s.z, c.z,  0.0,  0.0,
+                       0.0,  0.0,  1.0,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 xlateMat = mat4( 1.0,     0.0,     0.0,     0.0,
+                          0.0,     1.0,     0.0,     0.0,
+                          0.0,     0.0,     1.0,     0.0,
+                          trans.x, trans.y, trans.z, 1.0 );
+
+    mat4 scaleMat = mat4( scale.x,  0.0,     0.0,     0.0,
+                          0.0,      scale.y, 0.0,     0.0,
+                          0.0,      0.0,     scale.z, 0.0,
+                          0.0,      0.0,     0.0,     1.0 );
+
+    // Transformation order:
+    //    scale, rotate Z, rotate Y, rotate X, translate
+    mat4 modelMat = xlateMat * rxMat * ryMat * rzMat * scaleMat;
+
+    worldPosition = modelMat * position;
+    worldNormal = vec3( modelMat * vec4( vertexNormal, 0.0 ) );
+    worldTexCoord = vTexCoord;
+    worldOcclusion = vertexOcclusion;
+}
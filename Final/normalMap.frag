@@ -0,0 +1,60 @@
+#version 150
+
+// Phong fragment shader for coarse copies of objects drawn with normal
+// maps baked from their full meshes (see NormalMap.h)
+
+uniform vec4 ambMatColor;
+uniform vec4 diffMatColor;
+uniform vec4 specMatColor;
+
+uniform float ambRefCoeff;
+uniform float diffRefCoeff;
+uniform float specRefCoeff;
+uniform float specExponent;
+
+uniform vec4 lightSourceColor;
+uniform vec4 lightSourcePosition;
+uniform vec4 sceneAmbLightColor;
+
+// the full mesh's normals in the tangent space of the coarse one, and
+// its ambient occlusion in alpha
+uniform sampler2D normalMap;
+
+// INCOMING DATA
+in vec3 normal;
+in vec4 tangent;
+in vec3 light;
+in vec3 viewing;
+in vec2 texCoordinates;
+
+// OUTGOING DATA
+out vec4 finalColor;
+
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
+void main()
+{
+    // The tangent frame, built as NormalMap::bake() built it, and the
+    // full mesh's normal in it
+    vec3 frameN = normalize( normal );
+    vec3 frameT = normalize( tangent.xyz - frameN * dot( frameN, tangent.xyz ) );
+    vec3 frameB = cross( frameN, frameT ) * tangent.w;
+    vec4 texel = texture( normalMap, texCoordinates );
+    vec3 mapped = texel.xyz * 2.0 - 1.0;
+    float occlusion = texel.a;
+
+	//Compute vectors N, L, V, and R.
+	vec3 vectorN = normalize( mat3( frameT, frameB, frameN ) * mapped );
+	vec3 vectorV = normalize( viewing );
+	vec3 vectorL = normalize( light - viewing);
+	vec3 vectorR = normalize( reflect( vectorL, vectorN));		//reflect
+	
+	//Apply Ambient, Diffuse and Specular lighting.
+	vec4 amb = ambMatColor * ambRefCoeff  * sceneAmbLightColor * occlusion;
+	vec4 dif = diffMatColor * diffRefCoeff* max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
+	vec4 spec = specMatColor * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
+	
+	//Result
+    finalColor = amb + (dif + spec) * lightReaching( viewing, light, dot( vectorN, vectorL ) );
+}
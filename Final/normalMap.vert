@@ -0,0 +1,118 @@
+#version 150
+
+// Vertex shader for coarse copies of objects drawn with normal maps
+// baked from their full meshes (see NormalMap.h)
+
+// INCOMING DATA
+
+// Vertex location (in model space)
+in vec4 vPosition;
+
+// Normal vector at vertex (in model space)
+in vec3 vNormal;
+
+// Coordinates of the vertex in the normal map, and the tangent of its
+// triangle along u (in model space), with the sign of the bitangent
+// in w
+in vec2 vTexCoord;
+in vec4 vTangent;
+
+// Model transformations
+uniform vec3 theta;
+uniform vec3 trans;
+uniform vec3 scale;
+
+// Camera parameters
+uniform vec3 cPosition;
+uniform vec3 cLookAt;
+uniform vec3 cUp;
+
+// View volume boundaries
+uniform float left;
+uniform float right;
+uniform float top;
+uniform float bottom;
+uniform float near;
+uniform float far;
+
+uniform vec4 lightSourcePosition;
+
+// OUTGOING DATA
+
+out vec3 normal;
+out vec4 tangent;
+out vec3 light;
+out vec3 viewing;
+out vec2 texCoordinates;
+
+void main()
+{
+
+    // Compute the sines and cosines of each rotation about each axis
+    vec3 angles = radians( theta );
+    vec3 c = cos( angles );
+    vec3 s = sin( angles );
+
+    // Create rotation matrices
+    mat4 rxMat = mat4( 1.0,  0.0,  0.0,  0.0,
+                       0.0,  c.x,  s.x,  0.0,
+                       0.0,  -s.x, c.x,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 ryMat = mat4( c.y,  0.0,  -s.y, 0.0,
+                       0.0,  1.0,  0.0,  0.0,
+                       s.y,  0.0,  c.y,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 rzMat = mat4( c.z,  s.z,  0.0,  0.0,
+                       -s.z, c.z,  0.0,  0.0,
+                       0.0,  0.0,  1.0,  0.0,
+                       0.0,  0.0,  0.0,  1.0 );
+
+    mat4 xlateMat = mat4( 1.0,     0.0,     0.0,     0.0,
+                          0.0,     1.0,     0.0,     0.0,
+                          0.0,     0.0,     1.0,     0.0,
+                          trans.x, trans.y, trans.z, 1.0 );
+
+    mat4 scaleMat = mat4( scale.x,  0.0,     0.0,     0.0,
+                          0.0,      scale.y, 0.0,     0.0,
+                          0.0,      0.0,     scale.z, 0.0,
+                          0.0,      0.0,     0.0,     1.0 );
+
+    // Create view matrix
+    vec3 nVec = normalize( cPosition - cLookAt );
+    vec3 uVec = normalize( cross (normalize(cUp), nVec) );
+    vec3 vVec = normalize( cross (nVec, uVec) );
+
+    mat4 viewMat = mat4( uVec.x, vVec.x, nVec.x, 0.0,
+                         uVec.y, vVec.y, nVec.y, 0.0,
+                         uVec.z, vVec.z, nVec.z, 0.0,
+                         -1.0*(dot(uVec, cPosition)),
+                         -1.0*(dot(vVec, cPosition)),
+                         -1.0*(dot(nVec, cPosition)), 1.0 );
+
+    // Create projection matrix
+    mat4 projMat = mat4( (2.0*near)/(right-left), 0.0, 0.0, 0.0,
+                         0.0, ((2.0*near)/(top-bottom)), 0.0, 0.0,
+                         ((right+left)/(right-left)),
+                         ((top+bottom)/(top-bottom)),
+                         ((-1.0*(far+near)) / (far-near)), -1.0,
+                         0.0, 0.0, ((-2.0*far*near)/(far-near)), 0.0 );
+
+    // Transformation order:
+    //    scale, rotate Z, rotate Y, rotate X, translate
+    mat4 modelMat = xlateMat * rxMat * ryMat * rzMat * scaleMat;
+    mat4 modelViewMat = viewMat * modelMat;
+
+
+    // Compute vectors; the tangent is left for normalMap.frag to make
+    // square with the interpolated normal, as NormalMap::bake() did
+    normal = vec3(normalize(modelViewMat * vec4(vNormal,0.0)));
+    tangent = vec4(vec3(modelViewMat * vec4(vTangent.xyz,0.0)), vTangent.w);
+    light = vec3(viewMat * lightSourcePosition);
+    viewing = vec3(modelViewMat * vPosition);
+    texCoordinates = vTexCoord;
+
+    // Transform the vertex location into clip space
+    gl_Position =  projMat * viewMat  * modelMat * vPosition;
+}
@@ -17,14 +17,22 @@ uniform vec4 lightSourceColor;
 uniform vec4 lightSourcePosition;
 uniform vec4 sceneAmbLightColor;
 
+// Leave out the specular term, which the material and light make too
+// faint to show (see negligibleSpecular())
+uniform bool noSpecular;
+
 // INCOMING DATA
 in vec3 normal;
 in vec3 light;
 in vec3 viewing;
+in float occlusion;
 
 // OUTGOING DATA
 out vec4 finalColor;
 
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
 void main()
 {
 	//Compute vectors N, L, V, and R.
@@ -34,10 +42,13 @@ void main()
 	vec3 vectorR = normalize( reflect( vectorL, vectorN));		//reflect
 	
 	//Apply Ambient, Diffuse and Specular lighting to teapot.
-	vec4 amb = ambMatColor * ambRefCoeff  * sceneAmbLightColor;
+	vec4 amb = ambMatColor * ambRefCoeff  * sceneAmbLightColor * occlusion;
 	vec4 dif = diffMatColor * diffRefCoeff* max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
-	vec4 spec = specMatColor * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
 	
 	//Result
-    finalColor = amb + dif + spec;
+	vec4 lit = dif;
+	if( !noSpecular ) {
+		lit += specMatColor * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
+	}
+    finalColor = amb + lit * lightReaching( viewing, light, dot( vectorN, vectorL ) );
 }
@@ -12,6 +12,9 @@ in vec4 vPosition;
 // Normal vector at vertex (in model space)
 in vec3 vNormal;
 
+// Ambient occlusion at vertex (see Occlusion.h)
+in float vOcclusion;
+
 // Model transformations
 uniform vec3 theta;
 uniform vec3 trans;
@@ -37,9 +40,22 @@ uniform vec4 lightSourcePosition;
 out vec3 normal;
 out vec3 light;
 out vec3 viewing;
+out float occlusion;
+
+// Copies of one part drawn instanced: place a corner of the one being
+// drawn (see instancePlacement.vert)
+void placeCopy( inout vec4 position, inout vec3 normal,
+                inout float occlusion );
 
 void main()
 {
+    // Place this copy's corner where its transformation takes the
+    // prototype's
+    vec4 position = vPosition;
+    vec3 vertexNormal = vNormal;
+    float vertexOcclusion = vOcclusion;
+    placeCopy( position, vertexNormal, vertexOcclusion );
+
     // Compute the sines and cosines of each rotation about each axis
     vec3 angles = radians( theta );
     vec3 c = cos( angles );
@@ -97,10 +113,11 @@ void main()
     mat4 modelViewMat = viewMat * modelMat;
 
 	//Compute vectors.
-	normal = vec3(normalize(modelViewMat * vec4(vNormal,0.0)));
+	normal = vec3(normalize(modelViewMat * vec4(vertexNormal,0.0)));
 	light = vec3(viewMat * lightSourcePosition);
-	viewing = vec3(modelViewMat * vPosition);
+	viewing = vec3(modelViewMat * position);
+	occlusion = vertexOcclusion;
 	
     // Transform the vertex location into clip space
-    gl_Position =  projMat * viewMat  * modelMat * vPosition;
+    gl_Position =  projMat * viewMat  * modelMat * position;
 }
@@ -0,0 +1,336 @@
+//
+//  renderClient.cpp
+//
+//  Load generator for the render service ("finalMain -serve <socket>").
+//
+//  Opens several connections, keeps a number of requests in flight on
+//  each, and reports client-side p50/p99 latency, requests/s and the
+//  cache hit rate, followed by the server's own statistics.
+//
+//  USAGE:
+//      renderClient [-c connections] [-n requests] [-d depth]
+//                   [-pool distinct] [-w width] [-h height]
+//                   [-nocache] [-dump file.ppm] <socket>
+//
+//  Requests are drawn from a pool of 'distinct' parameter sets (camera
+//  orbit position, object angles and light color), so the pool size
+//  controls how often the result cache can help.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "RenderProtocol.h"
+#include "Timing.h"
+
+using namespace std;
+
+///
+// Load parameters shared by all connections
+///
+struct Load {
+    const char *path;
+    int requests;           // per connection
+    int depth;              // requests in flight per connection
+    int pool;               // distinct parameter sets
+    int width, height;
+    bool nocache;
+    const char *dump;
+};
+
+///
+// Per-connection results
+///
+struct Result {
+    vector<double> latencyMs;
+    int hits;
+    int errors;
+};
+
+///
+// connectTo(path) - open a connection to the service
+///
+static int connectTo( const char *path )
+{
+    struct sockaddr_un addr;
+    int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+    if( fd < 0 ) {
+        perror( "socket" );
+        return -1;
+    }
+
+    memset( &addr, 0, sizeof(addr) );
+    addr.sun_family = AF_UNIX;
+    strncpy( addr.sun_path, path, sizeof(addr.sun_path) - 1 );
+    if( connect( fd, (struct sockaddr *) &addr, sizeof(addr) ) != 0 ) {
+        perror( path );
+        close( fd );
+        return -1;
+    }
+
+    return fd;
+}
+
+///
+// readFully(fd,buf,n) - read exactly n bytes
+///
+static bool readFully( int fd, void *buf, size_t n )
+{
+    char *p = (char *) buf;
+    while( n > 0 ) {
+        ssize_t r = read( fd, p, n );
+        if( r <= 0 ) {
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+///
+// makeRequest(R,which,L) - fill in parameter set 'which' of the pool
+///
+static void makeRequest( RenderRequest &R, int which, const Load &L )
+{
+    memset( &R, 0, sizeof(R) );
+    R.magic = RENDER_REQUEST_MAGIC;
+    R.flags = L.nocache ? RENDER_FLAG_NOCACHE : 0;
+
+    // orbit the default camera around the default look-at point
+    float phi = 0.35f * (which % 16) - 2.8f;
+    R.eye[0] = 1.55f + 5.5f * sinf( phi );
+    R.eye[1] = 2.2f;
+    R.eye[2] = 5.5f * cosf( phi );
+    R.lookAt[0] = 1.55f;
+    R.lookAt[1] = 1.0f;
+    R.lookAt[2] = 0.0f;
+    R.up[1] = 2.0f;
+
+    // every 16 camera positions, turn the objects (but not the room)
+    for( int i = 0; i < 21; i++ ) {
+        R.angles[i] = 15.0f * (which / 16);
+    }
+
+    R.lightColor[0] = 1.0f;
+    R.lightColor[1] = 1.0f - 0.05f * (which % 10);
+    R.lightColor[2] = 1.0f - 0.05f * (which % 7);
+    R.lightPosition[0] = -1.2f;
+    R.lightPosition[1] = 2.5f;
+    R.lightPosition[2] = 0.1f;
+    R.ambientColor[0] = 1.0f;
+    R.ambientColor[1] = 1.0f;
+    R.width = L.width;
+    R.height = L.height;
+}
+
+///
+// dumpImage() - save a reply as a binary PPM (top row first)
+///
+static void dumpImage( const char *path, const RenderReply &R,
+                       const vector<unsigned char> &px )
+{
+    FILE *fp = fopen( path, "wb" );
+    if( fp == NULL ) {
+        perror( path );
+        return;
+    }
+    fprintf( fp, "P6\n%u %u\n255\n", R.width, R.height );
+    for( int y = (int) R.height - 1; y >= 0; y-- ) {
+        for( uint32_t x = 0; x < R.width; x++ ) {
+            fwrite( &px[ ((size_t) y * R.width + x) * 4 ], 1, 3, fp );
+        }
+    }
+    fclose( fp );
+}
+
+///
+// connection() - drive one connection; runs on its own thread
+///
+static void connection( const Load &L, int seed, Result &res )
+{
+    res.hits = res.errors = 0;
+
+    int fd = connectTo( L.path );
+    if( fd < 0 ) {
+        res.errors = L.requests;
+        return;
+    }
+
+    vector<uint64_t> sentNs( L.requests );
+    vector<unsigned char> pixels;
+    unsigned int rng = seed * 2654435761u + 1;
+    int sent = 0, received = 0;
+
+    while( received < L.requests ) {
+        // top up the pipeline
+        while( sent < L.requests && sent - received < L.depth ) {
+            RenderRequest R;
+            makeRequest( R, rand_r( &rng ) % L.pool, L );
+            R.id = sent;
+            sentNs[sent] = monotonicNs();
+            if( write( fd, &R, sizeof(R) ) != (ssize_t) sizeof(R) ) {
+                perror( "write" );
+                res.errors += L.requests - received;
+                close( fd );
+                return;
+            }
+            sent++;
+        }
+
+        RenderReply R;
+        if( !readFully( fd, &R, sizeof(R) ) ||
+            R.magic != RENDER_REPLY_MAGIC || R.id >= (uint32_t) sent ) {
+            cerr << "renderClient: lost the connection" << endl;
+            res.errors += L.requests - received;
+            close( fd );
+            return;
+        }
+        pixels.resize( R.bytes );
+        if( R.bytes && !readFully( fd, pixels.data(), R.bytes ) ) {
+            res.errors += L.requests - received;
+            close( fd );
+            return;
+        }
+
+        received++;
+        if( R.status != RENDER_OK ) {
+            res.errors++;
+            continue;
+        }
+        res.latencyMs.push_back( elapsedMs( sentNs[R.id] ) );
+        res.hits += R.cached;
+
+        if( L.dump != NULL && seed == 0 && received == 1 ) {
+            dumpImage( L.dump, R, pixels );
+        }
+    }
+
+    close( fd );
+}
+
+///
+// serverStats(path) - fetch (and reset) the service's statistics
+///
+static bool serverStats( const char *path, RenderStats &S )
+{
+    int fd = connectTo( path );
+    if( fd < 0 ) {
+        return false;
+    }
+
+    RenderRequest Q;
+    memset( &Q, 0, sizeof(Q) );
+    Q.magic = RENDER_REQUEST_MAGIC;
+    Q.flags = RENDER_FLAG_STATS;
+
+    RenderReply R;
+    bool ok = write( fd, &Q, sizeof(Q) ) == (ssize_t) sizeof(Q) &&
+        readFully( fd, &R, sizeof(R) ) && R.status == RENDER_STATS &&
+        R.bytes == sizeof(S) && readFully( fd, &S, sizeof(S) );
+
+    close( fd );
+    return ok;
+}
+
+///
+// main program for the load generator
+///
+int main( int argc, char **argv )
+{
+    Load L = { NULL, 200, 4, 32, 800, 800, false, NULL };
+    int conns = 4;
+
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[i], "-c" ) == 0 && i + 1 < argc ) {
+            conns = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-n" ) == 0 && i + 1 < argc ) {
+            L.requests = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-d" ) == 0 && i + 1 < argc ) {
+            L.depth = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-pool" ) == 0 && i + 1 < argc ) {
+            L.pool = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-w" ) == 0 && i + 1 < argc ) {
+            L.width = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-h" ) == 0 && i + 1 < argc ) {
+            L.height = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-nocache" ) == 0 ) {
+            L.nocache = true;
+        } else if( strcmp( argv[i], "-dump" ) == 0 && i + 1 < argc ) {
+            L.dump = argv[++i];
+        } else if( argv[i][0] != '-' ) {
+            L.path = argv[i];
+        } else {
+            L.path = NULL;
+            break;
+        }
+    }
+
+    if( L.path == NULL || conns < 1 || L.requests < 1 || L.depth < 1 ||
+        L.pool < 1 ) {
+        cerr << "usage: " << argv[0] << " [-c connections] [-n requests]"
+            " [-d depth] [-pool distinct] [-w width] [-h height]"
+            " [-nocache] [-dump file.ppm] socket" << endl;
+        exit( 1 );
+    }
+
+    // start from clean server-side counters
+    RenderStats S;
+    if( !serverStats( L.path, S ) ) {
+        cerr << "renderClient: no render service at " << L.path << endl;
+        exit( 1 );
+    }
+
+    vector<Result> results( conns );
+    vector<thread> threads;
+    uint64_t start = monotonicNs();
+    for( int c = 0; c < conns; c++ ) {
+        threads.push_back( thread( connection, cref( L ), c,
+                                   ref( results[c] ) ) );
+    }
+    for( int c = 0; c < conns; c++ ) {
+        threads[c].join();
+    }
+    double seconds = elapsedMs( start ) / 1000.0;
+
+    vector<double> all;
+    int hits = 0, errors = 0;
+    for( int c = 0; c < conns; c++ ) {
+        all.insert( all.end(), results[c].latencyMs.begin(),
+                    results[c].latencyMs.end() );
+        hits += results[c].hits;
+        errors += results[c].errors;
+    }
+    sort( all.begin(), all.end() );
+
+    printf( "%d connections x %d requests, depth %d, pool %d, %dx%d%s\n",
+        conns, L.requests, L.depth, L.pool, L.width, L.height,
+        L.nocache ? ", cache disabled" : "" );
+    printf( "client:  %zu ok, %d errors, %.1f req/s, hit rate %.1f%%\n",
+        all.size(), errors, all.size() / seconds,
+        all.empty() ? 0.0 : 100.0 * hits / all.size() );
+    printf( "client latency (ms):  p50 %.2f  p99 %.2f\n",
+        percentile( all.data(), all.size(), 0.50 ),
+        percentile( all.data(), all.size(), 0.99 ) );
+
+    if( serverStats( L.path, S ) ) {
+        printf( "server:  %llu requests, %llu rendered, %llu batches, "
+            "%.1f req/s\n", (unsigned long long) S.requests,
+            (unsigned long long) S.rendered, (unsigned long long) S.batches,
+            S.seconds > 0.0 ? S.requests / S.seconds : 0.0 );
+        printf( "server latency (ms):  p50 %.2f  p99 %.2f\n",
+            S.p50Ms, S.p99Ms );
+    }
+
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,722 @@
+//
+//  renderCoordinator.cpp
+//
+//  Renders a camera path by spreading its frames over several render
+//  workers ("finalMain -serve tcp:PORT"), on this machine or on others.
+//  Each worker loads the scene once and then renders whatever frames
+//  it is sent.
+//
+//  Scheduling: every worker starts with an equal contiguous share of
+//  the frame range.  A worker that runs out steals the upper half of
+//  the largest share still left, so a slow worker never holds up the
+//  tail.  Frames whose worker fails are put on a retry list that every
+//  worker serves first.  Finished frames go through a reorder buffer
+//  and are written out strictly in sequence.
+//
+//  USAGE:
+//      renderCoordinator [options] host:port [host:port ...]
+//      renderCoordinator [options] -spawn N
+//      renderCoordinator [options] -scaling
+//
+//  Options:
+//      -frames n       length of the camera path (default 240)
+//      -size WxH       frame size (default 800x800)
+//      -depth n        frames in flight per worker (default 2)
+//      -o prefix       write prefix00000.ppm, ... ; "-" streams the
+//                      PPM frames to stdout in order (default: discard)
+//      -spawn N        start N local workers on ports -port, -port+1, ...
+//      -port p         first port for spawned workers (default 7100)
+//      -exe path       worker executable (default ./finalMain)
+//      -occlusion file ambient occlusion cache of spawned workers
+//                      (default occlusion.cache)
+//      -scaling        measure 1, 2, 4 and 8 spawned local workers
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <iostream>
+#include <vector>
+#include <deque>
+#include <map>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include <unistd.h>
+#include <signal.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include "RenderProtocol.h"
+#include "Timing.h"
+
+using namespace std;
+
+// attempts per frame before it is given up on
+#define MAX_ATTEMPTS    3
+
+// how long the first spawned worker may take to bake and start serving
+#define BAKE_TIMEOUT_MS 600000
+
+///
+// Job parameters
+///
+struct Job {
+    int frames;
+    int width, height;
+    int depth;
+    const char *output;     // NULL, "-" or a file name prefix
+};
+
+///
+// pathRequest(R,frame,J) - scene parameters for one frame of the path:
+// the camera makes one orbit around the table while the objects turn
+// the way animate() turns them
+///
+static void pathRequest( RenderRequest &R, int frame, const Job &J )
+{
+    memset( &R, 0, sizeof(R) );
+    R.magic = RENDER_REQUEST_MAGIC;
+    R.id = frame;
+    // frames are never requested twice, so don't fill the worker caches
+    R.flags = RENDER_FLAG_NOCACHE;
+
+    float phi = 2.0f * (float) M_PI * frame / J.frames;
+    R.eye[0] = 1.55f + 5.5f * sinf( phi );
+    R.eye[1] = 2.2f;
+    R.eye[2] = 5.5f * cosf( phi );
+    R.lookAt[0] = 1.55f;
+    R.lookAt[1] = 1.0f;
+    R.up[1] = 2.0f;
+
+    for( int i = 0; i < 21; i++ ) {
+        R.angles[i] = 0.5f * frame;
+    }
+
+    R.lightColor[0] = R.lightColor[1] = R.lightColor[2] = 1.0f;
+    R.lightPosition[0] = -1.2f;
+    R.lightPosition[1] = 2.5f;
+    R.lightPosition[2] = 0.1f;
+    R.ambientColor[0] = R.ambientColor[1] = 1.0f;
+    R.width = J.width;
+    R.height = J.height;
+}
+
+///
+// Work-stealing scheduler shared by the worker threads
+///
+class Scheduler {
+
+    struct Share {
+        int next, end;      // frames [next,end) not yet handed out
+        bool dead;
+        int steals;
+    };
+
+    mutex lock;
+    condition_variable changed;
+    vector<Share> shares;
+    deque<int> retry;
+    vector<int> attempts;
+    int outstanding;        // frames neither finished nor abandoned
+
+public:
+    int retries, abandoned;
+
+    Scheduler( int frames, int workers ) :
+        shares( workers ), attempts( frames, 0 ), outstanding( frames ),
+        retries( 0 ), abandoned( 0 )
+    {
+        for( int w = 0; w < workers; w++ ) {
+            shares[w].next = (long) frames * w / workers;
+            shares[w].end = (long) frames * (w + 1) / workers;
+            shares[w].dead = false;
+            shares[w].steals = 0;
+        }
+    }
+
+    ///
+    // next(w,frame,wait) - the next frame for worker w
+    //
+    // @param wait - block until work appears (true) or return at once
+    //
+    // @return false when there is nothing (more) for this worker
+    ///
+    bool next( int w, int &frame, bool wait )
+    {
+        unique_lock<mutex> guard( lock );
+
+        for( ;; ) {
+            if( !retry.empty() ) {
+                frame = retry.front();
+                retry.pop_front();
+                return true;
+            }
+
+            Share &mine = shares[w];
+            if( mine.next < mine.end ) {
+                frame = mine.next++;
+                return true;
+            }
+
+            // steal the upper half of the largest remaining share; a
+            // dead worker's share is taken whole
+            int victim = -1, best = 0;
+            for( size_t v = 0; v < shares.size(); v++ ) {
+                int left = shares[v].end - shares[v].next;
+                int take = shares[v].dead ? left : left / 2;
+                if( take > best ) {
+                    best = take;
+                    victim = v;
+                }
+            }
+            if( victim >= 0 ) {
+                Share &S = shares[victim];
+                mine.end = S.end;
+                mine.next = S.end - best;
+                S.end = mine.next;
+                mine.steals++;
+                frame = mine.next++;
+                return true;
+            }
+
+            if( !wait || outstanding == 0 ) {
+                return false;
+            }
+            // other workers still have frames in flight that may fail
+            changed.wait( guard );
+        }
+    }
+
+    ///
+    // done() - a frame has been delivered
+    ///
+    void done( void )
+    {
+        lock_guard<mutex> guard( lock );
+        outstanding--;
+        changed.notify_all();
+    }
+
+    ///
+    // fail(frame) - a frame was lost; retry it or give up on it
+    //
+    // @return true if the frame will be retried
+    ///
+    bool fail( int frame )
+    {
+        lock_guard<mutex> guard( lock );
+        bool again = ++attempts[frame] < MAX_ATTEMPTS;
+        if( again ) {
+            retry.push_back( frame );
+            retries++;
+        } else {
+            outstanding--;
+            abandoned++;
+        }
+        changed.notify_all();
+        return again;
+    }
+
+    ///
+    // retire(w) - worker w has gone away; its share is up for grabs
+    ///
+    void retire( int w )
+    {
+        lock_guard<mutex> guard( lock );
+        shares[w].dead = true;
+        changed.notify_all();
+    }
+
+    ///
+    // abandonAll(frames) - give up on every frame not yet handed out
+    ///
+    void abandonAll( vector<int> &frames )
+    {
+        lock_guard<mutex> guard( lock );
+        frames.assign( retry.begin(), retry.end() );
+        retry.clear();
+        for( size_t w = 0; w < shares.size(); w++ ) {
+            for( ; shares[w].next < shares[w].end; shares[w].next++ ) {
+                frames.push_back( shares[w].next );
+            }
+        }
+        outstanding -= frames.size();
+        abandoned += frames.size();
+    }
+
+    int steals( int w )
+    {
+        lock_guard<mutex> guard( lock );
+        return shares[w].steals;
+    }
+
+};
+
+///
+// Reorder buffer: frames arrive in any order and leave in sequence
+///
+class Reorder {
+
+    mutex lock;
+    condition_variable arrived;
+    map< int, vector<unsigned char> > ready;    // empty vector: abandoned
+    int frames;
+
+public:
+    size_t peak;            // most frames ever waiting to be written
+
+    Reorder( int n ) : frames( n ), peak( 0 ) {}
+
+    void put( int frame, vector<unsigned char> &pixels )
+    {
+        lock_guard<mutex> guard( lock );
+        ready[frame].swap( pixels );
+        if( ready.size() > peak ) {
+            peak = ready.size();
+        }
+        arrived.notify_one();
+    }
+
+    ///
+    // drain(J) - write frames in order as they become available;
+    //     runs on its own thread
+    ///
+    void drain( const Job &J )
+    {
+        for( int f = 0; f < frames; f++ ) {
+            vector<unsigned char> px;
+            {
+                unique_lock<mutex> guard( lock );
+                while( ready.find( f ) == ready.end() ) {
+                    arrived.wait( guard );
+                }
+                px.swap( ready[f] );
+                ready.erase( f );
+            }
+            if( px.empty() ) {
+                cerr << "renderCoordinator: frame " << f <<
+                    " could not be rendered" << endl;
+                continue;
+            }
+            if( J.output != NULL ) {
+                writeFrame( J, f, px );
+            }
+        }
+    }
+
+    ///
+    // writeFrame() - write one frame as a binary PPM (top row first)
+    ///
+    static void writeFrame( const Job &J, int f,
+                            const vector<unsigned char> &px )
+    {
+        FILE *fp = stdout;
+        if( strcmp( J.output, "-" ) != 0 ) {
+            char name[1024];
+            snprintf( name, sizeof(name), "%s%05d.ppm", J.output, f );
+            fp = fopen( name, "wb" );
+            if( fp == NULL ) {
+                perror( name );
+                return;
+            }
+        }
+
+        fprintf( fp, "P6\n%d %d\n255\n", J.width, J.height );
+        vector<unsigned char> row( J.width * 3 );
+        for( int y = J.height - 1; y >= 0; y-- ) {
+            const unsigned char *src = &px[ (size_t) y * J.width * 4 ];
+            for( int x = 0; x < J.width; x++ ) {
+                row[x*3+0] = src[x*4+0];
+                row[x*3+1] = src[x*4+1];
+                row[x*3+2] = src[x*4+2];
+            }
+            fwrite( row.data(), 1, row.size(), fp );
+        }
+
+        if( fp == stdout ) {
+            fflush( fp );
+        } else {
+            fclose( fp );
+        }
+    }
+
+};
+
+///
+// connectTo(hostport,timeoutMs) - connect to "host:port", retrying
+//     while the worker is still starting up
+///
+static int connectTo( const string &hostport, int timeoutMs )
+{
+    size_t colon = hostport.rfind( ':' );
+    if( colon == string::npos ) {
+        cerr << "renderCoordinator: expected host:port, got " <<
+            hostport << endl;
+        return -1;
+    }
+    string host = hostport.substr( 0, colon );
+    string port = hostport.substr( colon + 1 );
+
+    uint64_t deadline = monotonicNs() + (uint64_t) timeoutMs * 1000000ull;
+    for( ;; ) {
+        struct addrinfo hints, *res = NULL;
+        memset( &hints, 0, sizeof(hints) );
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if( getaddrinfo( host.empty() ? "localhost" : host.c_str(),
+                         port.c_str(), &hints, &res ) == 0 ) {
+            for( struct addrinfo *a = res; a != NULL; a = a->ai_next ) {
+                int fd = socket( a->ai_family, a->ai_socktype,
+                                 a->ai_protocol );
+                if( fd < 0 ) {
+                    continue;
+                }
+                if( connect( fd, a->ai_addr, a->ai_addrlen ) == 0 ) {
+                    int on = 1;
+                    setsockopt( fd, IPPROTO_TCP, TCP_NODELAY, &on,
+                                sizeof(on) );
+                    freeaddrinfo( res );
+                    return fd;
+                }
+                close( fd );
+            }
+            freeaddrinfo( res );
+        }
+
+        if( monotonicNs() > deadline ) {
+            cerr << "renderCoordinator: cannot reach " << hostport << endl;
+            return -1;
+        }
+        usleep( 100000 );
+    }
+}
+
+///
+// readFully(fd,buf,n) - read exactly n bytes
+///
+static bool readFully( int fd, void *buf, size_t n )
+{
+    char *p = (char *) buf;
+    while( n > 0 ) {
+        ssize_t r = read( fd, p, n );
+        if( r <= 0 ) {
+            return false;
+        }
+        p += r;
+        n -= r;
+    }
+    return true;
+}
+
+///
+// Per-worker results
+///
+struct WorkerStats {
+    int frames;
+    int failures;
+    double busyMs;
+};
+
+///
+// worker() - feed one worker until the path is done; runs on its own
+//     thread with an already-open connection
+///
+static void worker( int w, int fd, const Job &J, Scheduler &S, Reorder &out,
+                    WorkerStats &stats )
+{
+    map<uint32_t, int> inflight;        // request id -> frame
+    uint32_t nextId = 0;
+    bool alive = fd >= 0;
+    uint64_t start = monotonicNs();
+
+    while( alive ) {
+        // keep 'depth' frames in flight; only block for work when idle
+        int frame;
+        while( (int) inflight.size() < J.depth &&
+               S.next( w, frame, inflight.empty() ) ) {
+            RenderRequest R;
+            pathRequest( R, frame, J );
+            R.id = nextId++;
+            if( write( fd, &R, sizeof(R) ) != (ssize_t) sizeof(R) ) {
+                S.fail( frame );
+                alive = false;
+                break;
+            }
+            inflight[R.id] = frame;
+        }
+        if( !alive || inflight.empty() ) {
+            break;
+        }
+
+        RenderReply R;
+        vector<unsigned char> px;
+        if( !readFully( fd, &R, sizeof(R) ) ||
+            R.magic != RENDER_REPLY_MAGIC ||
+            inflight.find( R.id ) == inflight.end() ) {
+            alive = false;
+            break;
+        }
+        px.resize( R.bytes );
+        if( R.bytes && !readFully( fd, px.data(), R.bytes ) ) {
+            alive = false;
+            break;
+        }
+
+        frame = inflight[R.id];
+        inflight.erase( R.id );
+        if( R.status != RENDER_OK ||
+            R.bytes != (uint64_t) J.width * J.height * 4 ) {
+            stats.failures++;
+            if( !S.fail( frame ) ) {
+                px.clear();
+                out.put( frame, px );
+            }
+            continue;
+        }
+
+        stats.frames++;
+        out.put( frame, px );
+        S.done();
+    }
+
+    // anything still in flight goes back for another worker
+    for( map<uint32_t, int>::iterator it = inflight.begin();
+         it != inflight.end(); ++it ) {
+        stats.failures++;
+        if( !S.fail( it->second ) ) {
+            vector<unsigned char> none;
+            out.put( it->second, none );
+        }
+    }
+    if( !alive ) {
+        if( fd >= 0 ) {
+            cerr << "renderCoordinator: worker " << w << " failed" << endl;
+        }
+        S.retire( w );
+    }
+
+    stats.busyMs = elapsedMs( start );
+    if( fd >= 0 ) {
+        close( fd );
+    }
+}
+
+///
+// render(J,addrs) - render the whole path on the given workers
+//
+// @return frames per second, or 0 on failure
+///
+static double render( const Job &J, const vector<string> &addrs )
+{
+    int n = addrs.size();
+
+    // connect to everyone first, so worker start-up isn't timed
+    vector<int> fds( n );
+    int live = 0;
+    for( int w = 0; w < n; w++ ) {
+        fds[w] = connectTo( addrs[w], 60000 );
+        live += fds[w] >= 0;
+    }
+    if( live == 0 ) {
+        return 0.0;
+    }
+
+    Scheduler S( J.frames, n );
+    Reorder out( J.frames );
+    vector<WorkerStats> stats( n );
+    vector<thread> threads;
+
+    uint64_t start = monotonicNs();
+    thread writer( &Reorder::drain, &out, cref( J ) );
+    for( int w = 0; w < n; w++ ) {
+        stats[w].frames = stats[w].failures = 0;
+        stats[w].busyMs = 0.0;
+        threads.push_back( thread( worker, w, fds[w], cref( J ), ref( S ),
+                                   ref( out ), ref( stats[w] ) ) );
+    }
+    for( int w = 0; w < n; w++ ) {
+        threads[w].join();
+    }
+
+    // if every worker died, whatever is left can't be rendered
+    vector<int> lost;
+    S.abandonAll( lost );
+    for( size_t i = 0; i < lost.size(); i++ ) {
+        vector<unsigned char> none;
+        out.put( lost[i], none );
+    }
+    writer.join();
+    double seconds = elapsedMs( start ) / 1000.0;
+
+    cerr << J.frames << " frames " << J.width << "x" << J.height <<
+        " on " << n << " workers: " << seconds << " s, " <<
+        J.frames / seconds << " frames/s, " << S.retries << " retries, " <<
+        S.abandoned << " abandoned, reorder peak " << out.peak << endl;
+    for( int w = 0; w < n; w++ ) {
+        cerr << "  worker " << w << " (" << addrs[w] << "): " <<
+            stats[w].frames << " frames, " << S.steals( w ) << " steals, " <<
+            stats[w].failures << " failures" << endl;
+    }
+
+    return S.abandoned ? 0.0 : J.frames / seconds;
+}
+
+///
+// spawnWorker(exe,port,threads,occlusion) - start one local worker
+//
+// @return its process id
+///
+static pid_t spawnWorker( const char *exe, int port, int threads,
+                          const char *occlusion )
+{
+    char where[32], count[16];
+    snprintf( where, sizeof(where), "tcp:%d", port );
+    snprintf( count, sizeof(count), "%d", threads );
+
+    pid_t pid = fork();
+    if( pid == 0 ) {
+        execl( exe, exe, "-serve", where, "-cache", "0", "-threads", count,
+               "-occlusion", occlusion, (char *) NULL );
+        perror( exe );
+        _exit( 127 );
+    }
+    return pid;
+}
+
+///
+// spawnWorkers(exe,n,port,occlusion,pids,addrs) - start n local
+//     workers, each with its share of the hardware threads.  The first
+//     bakes the occlusion cache (if it is out of date) and the rest are
+//     started once it serves, so that they read the cache instead of
+//     each baking it again.
+///
+static void spawnWorkers( const char *exe, int n, int port,
+                          const char *occlusion, vector<pid_t> &pids,
+                          vector<string> &addrs )
+{
+    int threads = max( 1, (int) thread::hardware_concurrency() / n );
+
+    for( int w = 0; w < n; w++ ) {
+        pids.push_back( spawnWorker( exe, port + w, threads, occlusion ) );
+        addrs.push_back( "localhost:" + to_string( port + w ) );
+
+        if( w == 0 && n > 1 ) {
+            int fd = connectTo( addrs[0], BAKE_TIMEOUT_MS );
+            if( fd >= 0 ) {
+                close( fd );
+            }
+        }
+    }
+}
+
+///
+// stopWorkers(pids) - shut down spawned workers
+///
+static void stopWorkers( vector<pid_t> &pids )
+{
+    for( size_t i = 0; i < pids.size(); i++ ) {
+        kill( pids[i], SIGTERM );
+    }
+    for( size_t i = 0; i < pids.size(); i++ ) {
+        waitpid( pids[i], NULL, 0 );
+    }
+    pids.clear();
+}
+
+///
+// main program for the coordinator
+///
+int main( int argc, char **argv )
+{
+    Job J = { 240, 800, 800, 2, NULL };
+    const char *exe = "./finalMain";
+    const char *occlusion = "occlusion.cache";
+    int spawn = 0, port = 7100;
+    bool scaling = false;
+    vector<string> addrs;
+
+    for( int i = 1; i < argc; i++ ) {
+        if( strcmp( argv[i], "-frames" ) == 0 && i + 1 < argc ) {
+            J.frames = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-size" ) == 0 && i + 1 < argc ) {
+            sscanf( argv[++i], "%dx%d", &J.width, &J.height );
+        } else if( strcmp( argv[i], "-depth" ) == 0 && i + 1 < argc ) {
+            J.depth = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-o" ) == 0 && i + 1 < argc ) {
+            J.output = argv[++i];
+        } else if( strcmp( argv[i], "-spawn" ) == 0 && i + 1 < argc ) {
+            spawn = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-port" ) == 0 && i + 1 < argc ) {
+            port = atoi( argv[++i] );
+        } else if( strcmp( argv[i], "-exe" ) == 0 && i + 1 < argc ) {
+            exe = argv[++i];
+        } else if( strcmp( argv[i], "-occlusion" ) == 0 && i + 1 < argc ) {
+            occlusion = argv[++i];
+        } else if( strcmp( argv[i], "-scaling" ) == 0 ) {
+            scaling = true;
+        } else if( argv[i][0] != '-' ) {
+            addrs.push_back( argv[i] );
+        } else {
+            cerr << "usage: " << argv[0] << " [-frames n] [-size WxH]"
+                " [-depth n] [-o prefix|-] [-port p] [-exe path]"
+                " [-occlusion file] {host:port ... | -spawn N | -scaling}" <<
+                endl;
+            exit( 1 );
+        }
+    }
+
+    if( J.frames < 1 || J.width < 1 || J.height < 1 || J.depth < 1 ||
+        J.width > RENDER_MAX_DIM || J.height > RENDER_MAX_DIM ) {
+        cerr << "renderCoordinator: bad job parameters" << endl;
+        exit( 1 );
+    }
+    signal( SIGPIPE, SIG_IGN );
+
+    if( scaling ) {
+        // each run gets freshly started workers; start-up is not timed
+        const int counts[] = { 1, 2, 4, 8 };
+        double base = 0.0;
+        vector<double> fps;
+        for( int c = 0; c < 4; c++ ) {
+            vector<pid_t> pids;
+            vector<string> local;
+            spawnWorkers( exe, counts[c], port, occlusion, pids, local );
+            fps.push_back( render( J, local ) );
+            stopWorkers( pids );
+            if( c == 0 ) {
+                base = fps[0];
+            }
+        }
+
+        printf( "workers  frames/s  speedup  efficiency\n" );
+        for( int c = 0; c < 4; c++ ) {
+            double speedup = base > 0.0 ? fps[c] / base : 0.0;
+            printf( "%7d  %8.2f  %7.2f  %9.0f%%\n", counts[c], fps[c],
+                speedup, 100.0 * speedup / counts[c] );
+        }
+        return 0;
+    }
+
+    vector<pid_t> pids;
+    if( spawn > 0 ) {
+        spawnWorkers( exe, spawn, port, occlusion, pids, addrs );
+    }
+    if( addrs.empty() ) {
+        cerr << "renderCoordinator: no workers given" << endl;
+        exit( 1 );
+    }
+
+    double fps = render( J, addrs );
+    stopWorkers( pids );
+
+    return fps > 0.0 ? 0 : 1;
+}
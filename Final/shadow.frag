@@ -0,0 +1,15 @@
+#version 150
+
+// Fragment shader for the faces of the shadow map (see ShadowMap.h):
+// the distance from the light to the surface
+
+// INCOMING DATA
+in vec3 fromLight;
+
+// OUTGOING DATA
+out float lightDistance;
+
+void main()
+{
+    lightDistance = length( fromLight );
+}
@@ -0,0 +1,35 @@
+#version 150
+
+// Vertex shader for the faces of the shadow map (see ShadowMap.h)
+
+// INCOMING DATA
+
+// Vertex location (in model space)
+in vec4 vPosition;
+
+// The object's model matrix, the face's viewing and projection
+// matrices, and the light's position
+uniform mat4 model;
+uniform mat4 faceViewProjection;
+uniform vec3 shadowLight;
+
+// OUTGOING DATA
+
+// Direction and distance from the light (in world space)
+out vec3 fromLight;
+
+// Copies of one part drawn instanced: place a corner of the one being
+// drawn (see instancePlacement.vert)
+void placeCopy( inout vec4 position );
+
+void main()
+{
+    // Place this copy's corner where its transformation takes the
+    // prototype's
+    vec4 position = vPosition;
+    placeCopy( position );
+
+    position = model * position;
+    fromLight = position.xyz - shadowLight;
+    gl_Position = faceViewProjection * position;
+}
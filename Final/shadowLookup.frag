@@ -0,0 +1,29 @@
+#version 150
+
+// Shadow lookup shared by the fragment shaders that receive shadows
+// (phong.frag, texture.frag, gouraud.frag, normalMap.frag,
+// impostor.frag, gbuffer.frag, gbufferTexture.frag), linked in with
+// each of them by shaderSetupShared().  See ShadowMap.h.
+
+// Shadows of the light: whether to look for them, the distance from
+// the light to the nearest surface in every direction, and the
+// rotation from eye space back to the world's
+uniform bool shadows;
+uniform samplerCube shadowMap;
+uniform mat3 eyeToWorld;
+
+// Share of the light at 'light' (in eye space) that reaches a point
+// (also in eye space) whose normal makes an angle of cosine 'facing'
+// with the way to the light: none if the shadow map has a surface
+// nearer the light that way.  A texel spans more of the surface the
+// farther and the more aslant it is, so the bias grows with both.
+float lightReaching( vec3 point, vec3 light, float facing )
+{
+	if( !shadows ) {
+		return 1.0;
+	}
+	vec3 fromLight = eyeToWorld * (point - light);
+	float dist = length( fromLight );
+	float bias = 0.002 + 0.004 * dist / max( facing, 0.1 );
+	return dist - bias > texture( shadowMap, fromLight ).r ? 0.0 : 1.0;
+}
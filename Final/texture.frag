@@ -17,9 +17,13 @@ in vec3 normal;
 in vec3 light;
 in vec3 viewing;
 in vec2 texCoordinates;
+in float occlusion;
 
 out vec4 finalColor;
 
+// Share of the light that reaches a point (see shadowLookup.frag)
+float lightReaching( vec3 point, vec3 light, float facing );
+
 void main()
 {
 	// Vector to hold texture specific data.
@@ -55,10 +59,10 @@ void main()
 	vectorR = normalize( reflect( vectorL, vectorN) );
 	
 	//Apply Ambient, Diffuse and Specular lighting to quad.
-	vec4 amb = tex * ambRefCoeff * sceneAmbLightColor;
+	vec4 amb = tex * ambRefCoeff * sceneAmbLightColor * occlusion;
 	vec4 dif = tex * diffRefCoeff * max(0.0, dot( vectorN, vectorL )) * lightSourceColor;
 	vec4 spec = tex * specRefCoeff * pow( max(0.0, dot( vectorV, vectorR )), specExponent ) * lightSourceColor;
 	
 	//Result
-    finalColor = amb + dif + spec;
+    finalColor = amb + (dif + spec) * lightReaching( viewing, light, dot( vectorN, vectorL ) );
 }
@@ -11,6 +11,9 @@ in vec4 vPosition;
 // Normal vector at vertex (in model space)
 in vec3 vNormal;
 
+// Ambient occlusion at vertex (see Occlusion.h)
+in float vOcclusion;
+
 // Texture coordinate for this vertex
 in vec2 vTexCoord;
 
@@ -42,6 +45,7 @@ out vec3 normal;
 out vec3 light;
 out vec3 viewing;
 out vec2 texCoordinates;
+out float occlusion;
 
 void main()
 {
@@ -108,6 +112,7 @@ void main()
 	
 	// Copy vertices to outgoing vector
 	texCoordinates = vTexCoord;
+	occlusion = vOcclusion;
 
     // Transform the vertex location into clip space
     gl_Position =  projMat * viewMat * modelMat * vPosition;